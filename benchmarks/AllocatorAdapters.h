@@ -0,0 +1,325 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "BuddyAllocator.h"
+#include "GlobalAllocator.h"
+#include "InlineAllocator.h"
+#include "PageAllocator.h"
+#include "PageMapAllocator.h"
+#include "SizeClassAllocator.h"
+#include "SlabAllocator.h"
+#include "StackAllocator.h"
+#include "TlsfAllocator.h"
+
+#include <cstdlib>	// std::malloc
+#include <memory>	// std::unique_ptr
+#include <mutex>
+
+/// Every allocator is wrapped in an adapter with the same interface so that the access patterns
+/// can be written once:
+///		static const char * name();
+///		static constexpr bool thread_safe;	// can be used from multiple threads without a lock
+///		static constexpr bool lifo_only;	// deallocations need to happen in reverse order
+///		void * allocate(size_type bytes);
+///		void deallocate(void * mem, size_type bytes);
+///
+/// No allocation done by the benchmarks is bigger than MAX_OBJECT_SIZE, the allocators that
+/// serve objects of one size use that size.
+
+namespace benchmarks
+{
+	using memory::size_type;
+
+	constexpr size_type MIN_OBJECT_SIZE = 8;
+	constexpr size_type MAX_OBJECT_SIZE = 128;
+	constexpr size_type OBJECTS_PER_PAGE = 256;
+	constexpr size_type STACK_BYTES = 64 * 1024 * 1024;
+
+	struct MallocAdapter
+	{
+		static const char * name() { return "malloc"; }
+		static constexpr bool thread_safe = true;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type bytes) { return std::malloc(bytes); }
+		void deallocate(void * mem, size_type) { std::free(mem); }
+	};
+
+	template <template <typename> class ALLOC>
+	struct GlobalAdapterT
+	{
+		static constexpr bool thread_safe = true;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type bytes) { return ALLOC<unsigned char>::allocate(bytes); }
+		void deallocate(void * mem, size_type bytes)
+		{
+			ALLOC<unsigned char>::deallocate(reinterpret_cast<unsigned char *>(mem), bytes);
+		}
+	};
+	struct GlobalAdapter : GlobalAdapterT<memory::GlobalAllocator>
+	{
+		static const char * name() { return "GlobalAllocator"; }
+	};
+
+	template <typename ALLOC>
+	struct PageAdapterT
+	{
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type) { return m_alloc.allocate(); }
+		void deallocate(void * mem, size_type) { m_alloc.deallocate(mem); }
+
+		ALLOC m_alloc{ MAX_OBJECT_SIZE, OBJECTS_PER_PAGE };
+	};
+	struct PageAdapter : PageAdapterT<memory::PageAllocator>
+	{
+		static const char * name() { return "PageAllocator"; }
+	};
+
+	template <typename ALLOC>
+	struct SlabAdapterT
+	{
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type) { return m_alloc.allocate(); }
+		void deallocate(void * mem, size_type) { m_alloc.deallocate(mem); }
+
+		ALLOC m_alloc{ MAX_OBJECT_SIZE, OBJECTS_PER_PAGE };
+	};
+	struct SlabAdapter : SlabAdapterT<memory::SlabAllocator>
+	{
+		static const char * name() { return "SlabAllocator"; }
+	};
+
+	template <typename ALLOC>
+	struct StackAdapterT
+	{
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = true;
+
+		void * allocate(size_type bytes) { return m_alloc.allocate(bytes); }
+		void deallocate(void * mem, size_type bytes)
+		{
+			m_alloc.deallocate(reinterpret_cast<unsigned char *>(mem), bytes);
+		}
+
+		ALLOC m_alloc{ STACK_BYTES };
+	};
+	struct StackAdapter : StackAdapterT<memory::StackAllocator>
+	{
+		static const char * name() { return "StackAllocator"; }
+	};
+
+	/// \brief	Unit in which the inline allocators count their memory.
+	struct InlineBlock { alignas(16) unsigned char bytes[16]; };
+	constexpr size_type INLINE_BLOCKS = 1024;
+
+	inline size_type bytes_to_blocks(size_type bytes)
+	{
+		return (bytes + sizeof(InlineBlock) - 1) / sizeof(InlineBlock);
+	}
+
+	/// \brief	Inline allocators are created on the heap, they would be too big for the stack of the benchmark threads.
+	template <typename ALLOC>
+	struct InlineAdapterT
+	{
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type bytes) { return m_alloc->allocate(bytes_to_blocks(bytes)); }
+		void deallocate(void * mem, size_type bytes)
+		{
+			m_alloc->deallocate(reinterpret_cast<InlineBlock *>(mem), bytes_to_blocks(bytes));
+		}
+
+		std::unique_ptr<ALLOC> m_alloc{ new ALLOC };
+	};
+	/// \brief	InlineAllocator with the GlobalAllocator as fallback.
+	struct InlineAdapter : InlineAdapterT<memory::FallbackAllocator<
+		memory::InlineAllocator<INLINE_BLOCKS, InlineBlock>,
+		memory::GlobalAllocator<InlineBlock>>>
+	{
+		static const char * name() { return "InlineAllocator+GlobalAllocator"; }
+	};
+	/// \brief	Two inline allocators before hitting the global allocator.
+	///			(the allocators need different sizes, FallbackAllocator can't inherit twice from the same type)
+	struct InlineChainAdapter : InlineAdapterT<memory::FallbackAllocator<
+		memory::InlineAllocator<INLINE_BLOCKS / 4, InlineBlock>,
+		memory::FallbackAllocator<
+			memory::InlineAllocator<INLINE_BLOCKS * 3 / 4, InlineBlock>,
+			memory::GlobalAllocator<InlineBlock>>>>
+	{
+		static const char * name() { return "InlineAllocator+InlineAllocator+GlobalAllocator"; }
+	};
+
+	struct SizeClassAdapter
+	{
+		static const char * name() { return "SizeClassAllocator"; }
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type bytes) { return m_alloc.allocate(bytes); }
+		void deallocate(void * mem, size_type bytes) { m_alloc.deallocate(mem, bytes); }
+
+		memory::SizeClassAllocator m_alloc{ OBJECTS_PER_PAGE };
+	};
+
+	struct PageMapAdapter
+	{
+		static const char * name() { return "PageMapAllocator"; }
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type bytes) { return m_alloc.allocate(bytes); }
+		void deallocate(void * mem, size_type bytes) { m_alloc.sized_free(mem, bytes); }
+
+		memory::PageMapAllocator m_alloc;
+	};
+	/// \brief	Frees without the size, as free does, the size is found in the page map.
+	struct PageMapUnsizedAdapter : PageMapAdapter
+	{
+		static const char * name() { return "PageMapAllocator(unsized)"; }
+
+		void deallocate(void * mem, size_type) { m_alloc.deallocate(mem); }
+	};
+
+	struct BuddyAdapter
+	{
+		static const char * name() { return "BuddyAllocator"; }
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type bytes) { return m_alloc.allocate(bytes); }
+		void deallocate(void * mem, size_type bytes)
+		{
+			m_alloc.deallocate(reinterpret_cast<unsigned char *>(mem), bytes);
+		}
+
+		memory::BuddyAllocator m_alloc{ STACK_BYTES, MIN_OBJECT_SIZE };
+	};
+
+	struct TlsfAdapter
+	{
+		static const char * name() { return "TlsfAllocator"; }
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type bytes) { return m_alloc.allocate(bytes); }
+		void deallocate(void * mem, size_type bytes)
+		{
+			m_alloc.deallocate(reinterpret_cast<unsigned char *>(mem), bytes);
+		}
+
+		memory::TlsfAllocator m_alloc{ STACK_BYTES };
+	};
+
+#if MEMORY_DEBUG_ENABLED
+
+	struct DebugGlobalAdapter : GlobalAdapterT<memory::DebugGlobalAllocator>
+	{
+		static const char * name() { return "DebugGlobalAllocator"; }
+	};
+	struct DebugPageAdapter : PageAdapterT<memory::DebugPageAllocator>
+	{
+		static const char * name() { return "DebugPageAllocator"; }
+	};
+	struct DebugSlabAdapter : SlabAdapterT<memory::DebugSlabAllocator>
+	{
+		static const char * name() { return "DebugSlabAllocator"; }
+	};
+	struct DebugStackAdapter : StackAdapterT<memory::DebugStackAllocator>
+	{
+		static const char * name() { return "DebugStackAllocator"; }
+	};
+
+#endif
+
+#if DEBUG_INLINE_ALLOCATOR_ENABLED
+
+	struct DebugInlineAdapter
+	{
+		using Alloc = memory::impl::DebugInlineAllocator<INLINE_BLOCKS, InlineBlock>;
+
+		static const char * name() { return "DebugInlineAllocator"; }
+		static constexpr bool thread_safe = false;
+		static constexpr bool lifo_only = false;
+
+		void * allocate(size_type bytes) { return m_alloc->allocate(bytes_to_blocks(bytes)); }
+		void deallocate(void * mem, size_type bytes)
+		{
+			m_alloc->deallocate(reinterpret_cast<InlineBlock *>(mem), bytes_to_blocks(bytes));
+		}
+
+		memory::DebugInlineAllocatorStats m_stats{ __FILE__, __LINE__, "InlineBlock", sizeof(InlineBlock), INLINE_BLOCKS };
+		std::unique_ptr<Alloc> m_alloc{ new Alloc{ m_stats } };
+	};
+
+#endif
+
+	/// \brief	Serializes the accesses to allocators that are not thread safe.
+	template <typename ADAPTER>
+	struct LockedAdapter
+	{
+		static const char * name() { return ADAPTER::name(); }
+		static constexpr bool thread_safe = true;
+		static constexpr bool lifo_only = ADAPTER::lifo_only;
+
+		void * allocate(size_type bytes)
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			return m_adapter.allocate(bytes);
+		}
+		void deallocate(void * mem, size_type bytes)
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_adapter.deallocate(mem, bytes);
+		}
+
+		ADAPTER m_adapter;
+		std::mutex m_mutex;
+	};
+
+	/// \brief	Standard library allocator that forwards to an adapter, used to benchmark containers.
+	template <typename T, typename ADAPTER>
+	class StlAdapter
+	{
+	public:
+		using value_type = T;
+
+		template <typename U>
+		struct rebind { using other = StlAdapter<U, ADAPTER>; };
+
+		explicit StlAdapter(ADAPTER & adapter) : m_adapter{ &adapter } {}
+		template <typename U>
+		StlAdapter(const StlAdapter<U, ADAPTER> & other) : m_adapter{ other.get_adapter() } {}
+
+		T * allocate(size_type n)
+		{
+			return reinterpret_cast<T *>(m_adapter->allocate(n * sizeof(T)));
+		}
+		void deallocate(T * mem, size_type n)
+		{
+			m_adapter->deallocate(mem, n * sizeof(T));
+		}
+
+		ADAPTER * get_adapter() const { return m_adapter; }
+
+		template <typename U>
+		bool operator==(const StlAdapter<U, ADAPTER> & other) const { return m_adapter == other.get_adapter(); }
+		template <typename U>
+		bool operator!=(const StlAdapter<U, ADAPTER> & other) const { return m_adapter != other.get_adapter(); }
+
+	private:
+		ADAPTER * m_adapter{ nullptr };
+	};
+}
@@ -0,0 +1,157 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "Benchmark.h"
+
+#include "ProcessStats.h"
+
+#include <algorithm>	// std::sort
+#include <map>
+
+namespace benchmarks
+{
+	namespace impl
+	{
+		/// \brief	Nearest rank percentile of sorted values.
+		double percentile(const std::vector<double> & sorted, double p)
+		{
+			if (sorted.empty())	return 0.0;
+
+			auto idx = static_cast<size_type>(p * sorted.size());
+			if (idx >= sorted.size())	idx = sorted.size() - 1;
+			return sorted[idx];
+		}
+	}
+
+	void LatencyHistogram::add(double ns)
+	{
+		size_type bucket = 0;
+		if (ns >= 1.0)
+		{
+			bucket = memory::log2_floor(static_cast<size_type>(ns));
+			if (bucket >= BUCKETS)	bucket = BUCKETS - 1;
+		}
+
+		m_counts[bucket]++;
+		m_total++;
+		if (m_max_ns < ns)	m_max_ns = ns;
+	}
+
+	void Samples::stop(size_type operations)
+	{
+		const auto elapsed = std::chrono::duration<double>(clock::now() - m_batch_start).count();
+		add(elapsed, operations);
+	}
+
+	void Samples::add(double seconds, size_type operations)
+	{
+		if (operations == 0)	return;
+
+		const double ns = seconds * 1e9;
+		m_ns_per_op.push_back(ns / operations);
+		m_operations += operations;
+		m_total_ns += ns;
+	}
+
+	void Samples::add_operation(double seconds)
+	{
+		add(seconds, 1);
+		m_latency.add(seconds * 1e9);
+	}
+
+	void Samples::sample_rss()
+	{
+		const auto rss = tools::current_rss_bytes();
+		if (m_max_rss < rss)	m_max_rss = rss;
+	}
+
+	BenchmarkResult Samples::summarize(const std::string & pattern, const std::string & allocator) const
+	{
+		BenchmarkResult result;
+		result.pattern = pattern;
+		result.allocator = allocator;
+		result.operations = m_operations;
+		result.rss_bytes = m_max_rss;
+
+		if (m_operations == 0)	return result;
+
+		auto sorted = m_ns_per_op;
+		std::sort(sorted.begin(), sorted.end());
+
+		result.mean_ns = m_total_ns / m_operations;
+		result.batch_min_ns = sorted.front();
+		result.batch_p50_ns = impl::percentile(sorted, 0.50);
+		result.batch_p90_ns = impl::percentile(sorted, 0.90);
+		result.batch_p99_ns = impl::percentile(sorted, 0.99);
+		result.batch_max_ns = sorted.back();
+		return result;
+	}
+
+	void compare_with_malloc(std::vector<BenchmarkResult> & results)
+	{
+		std::map<std::string, double> malloc_ns;
+		for (const auto & result : results)
+		{
+			if (result.allocator == "malloc")
+				malloc_ns[result.pattern] = result.mean_ns;
+		}
+
+		for (auto & result : results)
+		{
+			const auto it = malloc_ns.find(result.pattern);
+			if (it != malloc_ns.end() && it->second > 0.0)
+				result.relative_to_malloc = result.mean_ns / it->second;
+		}
+	}
+
+	void write_csv(std::ostream & os, const std::vector<BenchmarkResult> & results)
+	{
+		os << "pattern,allocator,operations,mean_ns,batch_min_ns,batch_p50_ns,batch_p90_ns,batch_p99_ns,batch_max_ns,rss_bytes,relative_to_malloc\n";
+		for (const auto & r : results)
+		{
+			os << r.pattern << ',' << r.allocator << ',' << r.operations << ','
+				<< r.mean_ns << ',' << r.batch_min_ns << ',' << r.batch_p50_ns << ',' << r.batch_p90_ns << ','
+				<< r.batch_p99_ns << ',' << r.batch_max_ns << ',' << r.rss_bytes << ',' << r.relative_to_malloc << '\n';
+		}
+	}
+
+	void write_json(std::ostream & os, const std::vector<BenchmarkResult> & results)
+	{
+		os << "[\n";
+		for (size_type i = 0; i < results.size(); ++i)
+		{
+			const auto & r = results[i];
+			os << "  { \"pattern\": \"" << r.pattern << "\", \"allocator\": \"" << r.allocator << "\""
+				<< ", \"operations\": " << r.operations
+				<< ", \"mean_ns\": " << r.mean_ns
+				<< ", \"batch_min_ns\": " << r.batch_min_ns
+				<< ", \"batch_p50_ns\": " << r.batch_p50_ns
+				<< ", \"batch_p90_ns\": " << r.batch_p90_ns
+				<< ", \"batch_p99_ns\": " << r.batch_p99_ns
+				<< ", \"batch_max_ns\": " << r.batch_max_ns
+				<< ", \"rss_bytes\": " << r.rss_bytes
+				<< ", \"relative_to_malloc\": " << r.relative_to_malloc
+				<< " }" << (i + 1 < results.size() ? "," : "") << '\n';
+		}
+		os << "]\n";
+	}
+
+	void write_latency_csv(std::ostream & os, const std::vector<LatencyResult> & results)
+	{
+		os << "pattern,allocator,min_ns,max_ns,operations\n";
+		for (const auto & r : results)
+		{
+			for (size_type i = 0; i < LatencyHistogram::BUCKETS; ++i)
+			{
+				if (r.histogram.count(i) == 0)	continue;
+				os << r.pattern << ',' << r.allocator << ',' << (i == 0 ? 0 : size_type{ 1u } << i) << ','
+					<< (size_type{ 1u } << (i + 1)) << ',' << r.histogram.count(i) << '\n';
+			}
+		}
+	}
+}
@@ -0,0 +1,109 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace benchmarks
+{
+	using memory::size_type;
+
+	/// \brief	Result of running one access pattern on one allocator.
+	struct BenchmarkResult
+	{
+		std::string pattern;
+		std::string allocator;
+
+		size_type operations{ 0u };
+		double mean_ns{ 0.0 };	// all values are nanoseconds per operation
+		/// \brief	Distribution of the mean time per operation of each timed batch (or of each repetition of
+		///			the multi threaded patterns), not of single operations. The latency pattern times one
+		///			operation per batch, its histograms are the per operation latencies.
+		double batch_min_ns{ 0.0 };
+		double batch_p50_ns{ 0.0 };
+		double batch_p90_ns{ 0.0 };
+		double batch_p99_ns{ 0.0 };
+		double batch_max_ns{ 0.0 };
+
+		/// \brief	Maximum resident set size seen while running the benchmark.
+		size_type rss_bytes{ 0u };
+		/// \brief	Mean time per operation compared to the one of malloc on the same pattern.
+		double relative_to_malloc{ 0.0 };
+	};
+
+	/// \brief	Counts the operations by their latency, bucket i has the ones that took [2^i, 2^(i+1)) nanoseconds.
+	class LatencyHistogram
+	{
+	public:
+		static constexpr size_type BUCKETS = 40;
+
+		void add(double ns);
+
+		size_type count(size_type bucket) const { return m_counts[bucket]; }
+		size_type total() const { return m_total; }
+		double max_ns() const { return m_max_ns; }
+
+	private:
+		size_type m_counts[BUCKETS] = {};
+		size_type m_total{ 0u };
+		double m_max_ns{ 0.0 };
+	};
+
+	/// \brief	Latency of each single operation of one access pattern on one allocator.
+	struct LatencyResult
+	{
+		std::string pattern;
+		std::string allocator;
+		LatencyHistogram histogram;
+	};
+
+	/// \brief	Collects the mean time per operation of each batch of operations a benchmark does.
+	class Samples
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		/// \brief	Starts timing a batch.
+		void start() { m_batch_start = clock::now(); }
+		/// \brief	Stops timing the batch started with start(), that did the given number of operations.
+		void stop(size_type operations);
+
+		/// \brief	Used by multi threaded benchmarks that time the whole run.
+		void add(double seconds, size_type operations);
+		/// \brief	Used by the benchmarks that time every operation, also fills the latency histogram.
+		void add_operation(double seconds);
+
+		/// \brief	Samples the current resident set size.
+		void sample_rss();
+
+		BenchmarkResult summarize(const std::string & pattern, const std::string & allocator) const;
+		const LatencyHistogram & latency() const { return m_latency; }
+
+	private:
+		clock::time_point m_batch_start;
+		std::vector<double> m_ns_per_op;
+		size_type m_operations{ 0u };
+		double m_total_ns{ 0.0 };
+		size_type m_max_rss{ 0u };
+		LatencyHistogram m_latency;
+	};
+
+	/// \brief	Fills relative_to_malloc of all the results with the results of the "malloc" allocator.
+	void compare_with_malloc(std::vector<BenchmarkResult> & results);
+
+	void write_csv(std::ostream & os, const std::vector<BenchmarkResult> & results);
+	void write_json(std::ostream & os, const std::vector<BenchmarkResult> & results);
+	/// \brief	One row per non empty bucket: pattern, allocator, bucket range in nanoseconds and operations.
+	void write_latency_csv(std::ostream & os, const std::vector<LatencyResult> & results);
+}
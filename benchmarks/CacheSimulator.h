@@ -0,0 +1,72 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+
+#include <vector>
+
+namespace benchmarks
+{
+	using memory::size_type;
+
+	/// \brief	Set associative cache with LRU replacement, counts the hits and misses of the accessed lines.
+	///			Used to show cache set conflicts independently of the machine running the benchmark.
+	class CacheSimulator
+	{
+	public:
+		/// \brief	Defaults to a typical 32KB 8 way L1 data cache.
+		explicit CacheSimulator(size_type bytes = 32 * 1024,
+								size_type ways = 8,
+								size_type line_size = memory::CACHE_LINE_SIZE)
+			: m_ways{ ways }
+			, m_line_size{ line_size }
+			, m_sets{ bytes / (ways * line_size) }
+			, m_lines(m_sets * ways, EMPTY_LINE)
+		{}
+
+		/// \brief	Accesses the line that contains the address.
+		void access(const void * mem)
+		{
+			const auto line = memory::ptr_to_num(mem) / m_line_size;
+			auto * set = &m_lines[(line % m_sets) * m_ways];
+
+			// the lines of a set are kept from the most to the least recently used
+			size_type way = 0;
+			while (way < m_ways && set[way] != line)
+				++way;
+
+			if (way < m_ways)	m_hits++;
+			else
+			{
+				m_misses++;
+				way = m_ways - 1;
+			}
+
+			for (; way > 0; --way)
+				set[way] = set[way - 1];
+			set[0] = line;
+		}
+
+		size_type hits() const { return m_hits; }
+		size_type misses() const { return m_misses; }
+		size_type sets() const { return m_sets; }
+
+	private:
+		static constexpr size_type EMPTY_LINE = ~size_type{ 0u };
+
+		size_type m_ways{ 0u };
+		size_type m_line_size{ 0u };
+		size_type m_sets{ 0u };
+		std::vector<size_type> m_lines;
+
+		size_type m_hits{ 0u };
+		size_type m_misses{ 0u };
+	};
+}
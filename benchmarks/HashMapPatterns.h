@@ -0,0 +1,128 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "AllocatorAdapters.h"
+#include "Benchmark.h"
+#include "Patterns.h"
+
+#include "PooledHashMap.h"
+
+#include <algorithm>	// std::shuffle
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+/// Patterns that compare PooledHashMap with std::unordered_map. The adapters hold the map instead of
+/// an allocator, the results use their name as the allocator. Every batch works on all the keys.
+
+namespace benchmarks
+{
+	struct UnorderedMapAdapter
+	{
+		static const char * name() { return "std::unordered_map"; }
+
+		void insert(int key, int value) { m_map.emplace(key, value); }
+		const int * find(int key) const
+		{
+			const auto it = m_map.find(key);
+			return it != m_map.end() ? &it->second : nullptr;
+		}
+		bool erase(int key) { return m_map.erase(key) == 1; }
+		void clear() { m_map.clear(); }
+
+	private:
+		std::unordered_map<int, int> m_map;
+	};
+
+	struct PooledHashMapAdapter
+	{
+		static const char * name() { return "PooledHashMap"; }
+
+		void insert(int key, int value) { m_map.emplace(key, value); }
+		const int * find(int key) const { return m_map.find(key); }
+		bool erase(int key) { return m_map.erase(key); }
+		void clear() { m_map.clear(); }
+
+	private:
+		memory::PooledHashMap<int, int> m_map{ OBJECTS_PER_PAGE };
+	};
+
+	namespace impl
+	{
+		/// \brief	Keys 0..n-1 in random order, so the nodes are not visited in the order they were created.
+		inline std::vector<int> shuffled_keys(size_type n, unsigned seed)
+		{
+			std::vector<int> keys(n);
+			for (size_type i = 0; i < n; ++i)
+				keys[i] = static_cast<int>(i);
+			std::shuffle(keys.begin(), keys.end(), std::mt19937{ seed });
+			return keys;
+		}
+	}
+
+	/// \brief	Inserts all the keys in an empty map, the map keeps its table between batches.
+	template <typename MAP>
+	void hash_map_insert(MAP & map, Samples & samples, const PatternConfig & config)
+	{
+		const auto keys = impl::shuffled_keys(config.objects, config.seed);
+		for (size_type b = 0; b < config.batches; ++b)
+		{
+			samples.start();
+			for (const auto key : keys)
+				map.insert(key, key);
+			samples.stop(config.objects);
+			map.clear();
+		}
+	}
+
+	/// \brief	Looks up every key and as many keys that are not in the map.
+	template <typename MAP>
+	void hash_map_find(MAP & map, Samples & samples, const PatternConfig & config)
+	{
+		const auto keys = impl::shuffled_keys(config.objects, config.seed);
+		for (const auto key : keys)
+			map.insert(key, key);
+
+		const auto missing = static_cast<int>(config.objects);
+		volatile int sink = 0;
+		for (size_type b = 0; b < config.batches; ++b)
+		{
+			int found = 0;
+			samples.start();
+			for (const auto key : keys)
+			{
+				if (const auto * value = map.find(key))
+					found += *value;
+				if (map.find(key + missing) != nullptr)
+					found++;
+			}
+			samples.stop(config.objects * 2);
+			sink = sink + found;
+		}
+	}
+
+	/// \brief	Erases all the keys, in a different order than they were inserted.
+	template <typename MAP>
+	void hash_map_erase(MAP & map, Samples & samples, const PatternConfig & config)
+	{
+		const auto keys = impl::shuffled_keys(config.objects, config.seed);
+		const auto erased = impl::shuffled_keys(config.objects, config.seed + 1);
+		for (size_type b = 0; b < config.batches; ++b)
+		{
+			for (const auto key : keys)
+				map.insert(key, key);
+
+			samples.start();
+			for (const auto key : erased)
+				map.erase(key);
+			samples.stop(config.objects);
+		}
+	}
+}
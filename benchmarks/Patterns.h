@@ -0,0 +1,335 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "AllocatorAdapters.h"
+#include "Benchmark.h"
+
+#include <algorithm>	// std::shuffle
+#include <atomic>
+#include <list>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+/// Access patterns the allocators are benchmarked with.
+/// Single threaded patterns time each batch of operations, multi threaded ones time each repetition.
+
+namespace benchmarks
+{
+	struct PatternConfig
+	{
+		size_type batches{ 200u };
+		/// \brief	Objects each batch allocates.
+		size_type objects{ 1000u };
+		size_type threads{ 4u };
+		unsigned seed{ 1234u };
+	};
+
+	namespace impl
+	{
+		struct Allocation
+		{
+			void * mem;
+			size_type bytes;
+		};
+
+		/// \brief	Sizes are generated up front so that the random generator is not part of the timings.
+		inline std::vector<size_type> random_sizes(size_type n, unsigned seed)
+		{
+			std::mt19937 rng{ seed };
+			std::uniform_int_distribution<size_type> dist{ MIN_OBJECT_SIZE, MAX_OBJECT_SIZE };
+
+			std::vector<size_type> sizes(n);
+			for (auto & size : sizes)
+				size = dist(rng);
+			return sizes;
+		}
+
+		/// \brief	Single producer single consumer queue, used to pass allocations between threads.
+		class AllocationQueue
+		{
+		public:
+			explicit AllocationQueue(size_type capacity)
+				: m_slots(capacity)
+			{}
+
+			bool push(const Allocation & allocation)
+			{
+				const auto tail = m_tail.load(std::memory_order_relaxed);
+				const auto next = (tail + 1) % m_slots.size();
+				if (next == m_head.load(std::memory_order_acquire))
+					return false;
+
+				m_slots[tail] = allocation;
+				m_tail.store(next, std::memory_order_release);
+				return true;
+			}
+			bool pop(Allocation & allocation)
+			{
+				const auto head = m_head.load(std::memory_order_relaxed);
+				if (head == m_tail.load(std::memory_order_acquire))
+					return false;
+
+				allocation = m_slots[head];
+				m_head.store((head + 1) % m_slots.size(), std::memory_order_release);
+				return true;
+			}
+
+		private:
+			std::vector<Allocation> m_slots;
+			alignas(64) std::atomic<size_type> m_head{ 0u };
+			alignas(64) std::atomic<size_type> m_tail{ 0u };
+		};
+	}
+
+	/// \brief	Deallocates in the reverse order of the allocations.
+	template <typename ADAPTER>
+	void lifo(ADAPTER & alloc, Samples & samples, const PatternConfig & config)
+	{
+		const auto sizes = impl::random_sizes(config.objects, config.seed);
+		std::vector<void *> ptrs(config.objects);
+
+		for (size_type b = 0; b < config.batches; ++b)
+		{
+			samples.start();
+			for (size_type i = 0; i < config.objects; ++i)
+				ptrs[i] = alloc.allocate(sizes[i]);
+			for (size_type i = config.objects; i-- > 0; )
+				alloc.deallocate(ptrs[i], sizes[i]);
+			samples.stop(config.objects * 2);
+		}
+	}
+
+	/// \brief	Deallocates in the same order of the allocations.
+	template <typename ADAPTER>
+	void fifo(ADAPTER & alloc, Samples & samples, const PatternConfig & config)
+	{
+		const auto sizes = impl::random_sizes(config.objects, config.seed);
+		std::vector<void *> ptrs(config.objects);
+
+		for (size_type b = 0; b < config.batches; ++b)
+		{
+			samples.start();
+			for (size_type i = 0; i < config.objects; ++i)
+				ptrs[i] = alloc.allocate(sizes[i]);
+			for (size_type i = 0; i < config.objects; ++i)
+				alloc.deallocate(ptrs[i], sizes[i]);
+			samples.stop(config.objects * 2);
+		}
+	}
+
+	/// \brief	Deallocates in a random order, the memory of the allocator gets shuffled after the first batch.
+	template <typename ADAPTER>
+	void random_free(ADAPTER & alloc, Samples & samples, const PatternConfig & config)
+	{
+		const auto sizes = impl::random_sizes(config.objects, config.seed);
+		std::vector<void *> ptrs(config.objects);
+
+		std::vector<size_type> order(config.objects);
+		for (size_type i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::shuffle(order.begin(), order.end(), std::mt19937{ config.seed });
+
+		for (size_type b = 0; b < config.batches; ++b)
+		{
+			samples.start();
+			for (size_type i = 0; i < config.objects; ++i)
+				ptrs[i] = alloc.allocate(sizes[i]);
+			for (const auto i : order)
+				alloc.deallocate(ptrs[i], sizes[i]);
+			samples.stop(config.objects * 2);
+		}
+	}
+
+	/// \brief	Replaces random objects of a working set timing every single operation, the histogram of
+	///			the latencies shows the worst cases that the batch timings hide.
+	///			(the time includes the overhead of reading the clock)
+	template <typename ADAPTER>
+	void latency(ADAPTER & alloc, Samples & samples, const PatternConfig & config)
+	{
+		const auto sizes = impl::random_sizes(config.objects, config.seed);
+		std::minstd_rand rng{ config.seed };
+
+		std::vector<impl::Allocation> set;
+		for (const auto bytes : sizes)
+			set.push_back(impl::Allocation{ alloc.allocate(bytes), bytes });
+
+		for (size_type i = 0; i < config.batches * config.objects / 2; ++i)
+		{
+			auto & allocation = set[rng() % set.size()];
+			const auto bytes = sizes[rng() % sizes.size()];
+
+			auto start = Samples::clock::now();
+			alloc.deallocate(allocation.mem, allocation.bytes);
+			auto end = Samples::clock::now();
+			samples.add_operation(std::chrono::duration<double>(end - start).count());
+
+			start = Samples::clock::now();
+			allocation.mem = alloc.allocate(bytes);
+			end = Samples::clock::now();
+			samples.add_operation(std::chrono::duration<double>(end - start).count());
+			allocation.bytes = bytes;
+		}
+
+		for (const auto & allocation : set)
+			alloc.deallocate(allocation.mem, allocation.bytes);
+	}
+
+	/// \brief	One thread allocates and other thread deallocates.
+	template <typename ADAPTER>
+	void producer_consumer(ADAPTER & alloc, Samples & samples, const PatternConfig & config)
+	{
+		static_assert(ADAPTER::thread_safe, "The allocator needs to be locked to be used from multiple threads.");
+
+		const auto sizes = impl::random_sizes(config.objects, config.seed);
+		const size_type total = config.objects * 10;
+
+		// less repetitions, each one allocates 10 batches
+		for (size_type b = 0; b < config.batches / 10 + 1; ++b)
+		{
+			impl::AllocationQueue queue{ 1024 };
+
+			const auto start = Samples::clock::now();
+			std::thread consumer{ [&]()
+			{
+				impl::Allocation allocation;
+				for (size_type i = 0; i < total; ++i)
+				{
+					while (!queue.pop(allocation))
+						std::this_thread::yield();
+					alloc.deallocate(allocation.mem, allocation.bytes);
+				}
+			} };
+
+			for (size_type i = 0; i < total; ++i)
+			{
+				const auto bytes = sizes[i % sizes.size()];
+				const impl::Allocation allocation{ alloc.allocate(bytes), bytes };
+				while (!queue.push(allocation))
+					std::this_thread::yield();
+			}
+
+			consumer.join();
+			samples.add(std::chrono::duration<double>(Samples::clock::now() - start).count(), total * 2);
+		}
+	}
+
+	/// \brief	Node allocations done by a std::list with insertions and removals in the middle.
+	template <typename ADAPTER>
+	void list_churn(ADAPTER & alloc, Samples & samples, const PatternConfig & config)
+	{
+		using List = std::list<int, StlAdapter<int, ADAPTER>>;
+
+		for (size_type b = 0; b < config.batches; ++b)
+		{
+			samples.start();
+			{
+				List list{ StlAdapter<int, ADAPTER>{ alloc } };
+				for (size_type i = 0; i < config.objects; ++i)
+					list.push_back(static_cast<int>(i));
+
+				// remove every other element and fill the holes
+				for (auto it = list.begin(); it != list.end(); )
+				{
+					it = list.erase(it);
+					if (it != list.end())
+						++it;
+				}
+				for (auto it = list.begin(); it != list.end(); ++it)
+					list.insert(it, 0);
+			}
+			// objects allocations + half deallocations + half allocations + objects deallocations
+			samples.stop(config.objects * 3);
+		}
+	}
+
+	/// \brief	Node allocations done by a std::map with random keys.
+	template <typename ADAPTER>
+	void map_churn(ADAPTER & alloc, Samples & samples, const PatternConfig & config)
+	{
+		using Value = std::pair<const int, int>;
+		using Map = std::map<int, int, std::less<int>, StlAdapter<Value, ADAPTER>>;
+
+		std::vector<int> keys(config.objects);
+		for (size_type i = 0; i < keys.size(); ++i)
+			keys[i] = static_cast<int>(i);
+		std::shuffle(keys.begin(), keys.end(), std::mt19937{ config.seed });
+
+		for (size_type b = 0; b < config.batches; ++b)
+		{
+			samples.start();
+			{
+				Map map{ std::less<int>{}, StlAdapter<Value, ADAPTER>{ alloc } };
+				for (const auto key : keys)
+					map.emplace(key, key);
+				for (size_type i = 0; i < keys.size(); i += 2)
+					map.erase(keys[i]);
+			}
+			samples.stop(config.objects * 2);
+		}
+	}
+
+	/// \brief	Based on the larson server benchmark: every thread replaces random objects of its own set
+	///			and after every round the sets are passed to the next thread, which will free objects
+	///			allocated by a different thread.
+	template <typename ADAPTER>
+	void larson(ADAPTER & alloc, Samples & samples, const PatternConfig & config)
+	{
+		static_assert(ADAPTER::thread_safe, "The allocator needs to be locked to be used from multiple threads.");
+
+		const auto sizes = impl::random_sizes(config.objects, config.seed);
+		const size_type threads = config.threads < 2 ? 2 : config.threads;
+		const size_type replacements = config.objects * 4;
+
+		std::vector<std::vector<impl::Allocation>> sets(threads);
+		for (auto & set : sets)
+		{
+			for (const auto bytes : sizes)
+				set.push_back(impl::Allocation{ alloc.allocate(bytes), bytes });
+		}
+
+		for (size_type round = 0; round < config.batches / 10 + 1; ++round)
+		{
+			const auto start = Samples::clock::now();
+
+			std::vector<std::thread> workers;
+			for (size_type t = 0; t < threads; ++t)
+			{
+				workers.emplace_back([&, t]()
+				{
+					// each thread works on the set of the previous one in the last round
+					auto & set = sets[(t + round) % threads];
+					std::minstd_rand rng{ static_cast<unsigned>(config.seed + t + round) };
+
+					for (size_type i = 0; i < replacements; ++i)
+					{
+						auto & allocation = set[rng() % set.size()];
+						alloc.deallocate(allocation.mem, allocation.bytes);
+
+						allocation.bytes = sizes[rng() % sizes.size()];
+						allocation.mem = alloc.allocate(allocation.bytes);
+					}
+				});
+			}
+			for (auto & worker : workers)
+				worker.join();
+
+			samples.add(std::chrono::duration<double>(Samples::clock::now() - start).count(), threads * replacements * 2);
+			samples.sample_rss();
+		}
+
+		for (auto & set : sets)
+		{
+			for (const auto & allocation : set)
+				alloc.deallocate(allocation.mem, allocation.bytes);
+		}
+	}
+}
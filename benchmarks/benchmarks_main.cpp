@@ -0,0 +1,192 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+/// Runs the access patterns on all the allocators and on malloc as a baseline, and the hash map
+/// patterns on PooledHashMap and std::unordered_map.
+///
+///	usage: benchmarks [--format=csv|json] [--output=<file>] [--filter=<text>]
+///					  [--batches=<n>] [--objects=<n>] [--threads=<n>] [--latency=<file>]
+///
+/// --filter only runs the benchmarks whose "pattern/allocator" name contains the text.
+/// --latency writes the histograms of the latency of every single operation as CSV.
+
+#include "AllocatorAdapters.h"
+#include "Benchmark.h"
+#include "HashMapPatterns.h"
+#include "Patterns.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+using namespace benchmarks;
+
+namespace
+{
+	struct Options
+	{
+		std::string format{ "csv" };
+		std::string output;
+		std::string filter;
+		std::string latency;
+		PatternConfig config;
+	};
+
+	class Runner
+	{
+	public:
+		explicit Runner(const Options & options)
+			: m_options{ options }
+		{}
+
+		template <typename ADAPTER, typename PATTERN>
+		void run(const char * pattern_name, PATTERN pattern)
+		{
+			const std::string name = std::string{ pattern_name } + "/" + ADAPTER::name();
+			if (name.find(m_options.filter) == std::string::npos)
+				return;
+
+			std::cerr << "Running " << name << std::endl;
+
+			Samples samples;
+			{
+				// some allocators are too big for the stack
+				std::unique_ptr<ADAPTER> adapter{ new ADAPTER };
+				pattern(*adapter, samples, m_options.config);
+				samples.sample_rss();
+			}
+
+			m_results.push_back(samples.summarize(pattern_name, ADAPTER::name()));
+			if (samples.latency().total() > 0)
+				m_latencies.push_back(LatencyResult{ pattern_name, ADAPTER::name(), samples.latency() });
+		}
+
+		/// \brief	Runs all the patterns the allocator supports.
+		template <typename ADAPTER>
+		void run_all()
+		{
+			// allocators that are not thread safe are used with a lock by the multi threaded patterns
+			using Shared = typename std::conditional<ADAPTER::thread_safe, ADAPTER, LockedAdapter<ADAPTER>>::type;
+
+			run<ADAPTER>("lifo", lifo<ADAPTER>);
+			if (ADAPTER::lifo_only)
+				return;
+
+			run<ADAPTER>("fifo", fifo<ADAPTER>);
+			run<ADAPTER>("random_free", random_free<ADAPTER>);
+			run<ADAPTER>("list_churn", list_churn<ADAPTER>);
+			run<ADAPTER>("map_churn", map_churn<ADAPTER>);
+			run<ADAPTER>("latency", latency<ADAPTER>);
+			run<Shared>("producer_consumer", producer_consumer<Shared>);
+			run<Shared>("larson", larson<Shared>);
+		}
+
+		/// \brief	Runs the hash map patterns on the map of the adapter.
+		template <typename MAP>
+		void run_hash_map()
+		{
+			run<MAP>("hash_map_insert", hash_map_insert<MAP>);
+			run<MAP>("hash_map_find", hash_map_find<MAP>);
+			run<MAP>("hash_map_erase", hash_map_erase<MAP>);
+		}
+
+		std::vector<BenchmarkResult> & results() { return m_results; }
+		const std::vector<LatencyResult> & latencies() const { return m_latencies; }
+
+	private:
+		const Options & m_options;
+		std::vector<BenchmarkResult> m_results;
+		std::vector<LatencyResult> m_latencies;
+	};
+
+	bool parse_options(int argc, char ** argv, Options & options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const auto eq = arg.find('=');
+			const auto key = arg.substr(0, eq);
+			const auto value = eq == std::string::npos ? std::string{} : arg.substr(eq + 1);
+
+			if (key == "--format")			options.format = value;
+			else if (key == "--output")		options.output = value;
+			else if (key == "--filter")		options.filter = value;
+			else if (key == "--latency")	options.latency = value;
+			else if (key == "--batches")	options.config.batches = std::strtoul(value.c_str(), nullptr, 10);
+			else if (key == "--objects")	options.config.objects = std::strtoul(value.c_str(), nullptr, 10);
+			else if (key == "--threads")	options.config.threads = std::strtoul(value.c_str(), nullptr, 10);
+			else
+			{
+				std::cerr << "Unknown option " << arg << '\n';
+				return false;
+			}
+		}
+
+		return (options.format == "csv" || options.format == "json") && options.config.objects > 0;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	Options options;
+	if (!parse_options(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0] << " [--format=csv|json] [--output=<file>] [--filter=<text>]"
+			<< " [--batches=<n>] [--objects=<n>] [--threads=<n>] [--latency=<file>]\n";
+		return 1;
+	}
+
+	Runner runner{ options };
+	runner.run_all<MallocAdapter>();
+	runner.run_all<GlobalAdapter>();
+	runner.run_all<InlineAdapter>();
+	runner.run_all<InlineChainAdapter>();
+	runner.run_all<StackAdapter>();
+	runner.run_all<PageAdapter>();
+	runner.run_all<SlabAdapter>();
+	runner.run_all<SizeClassAdapter>();
+	runner.run_all<PageMapAdapter>();
+	runner.run_all<PageMapUnsizedAdapter>();
+	runner.run_all<BuddyAdapter>();
+	runner.run_all<TlsfAdapter>();
+#if MEMORY_DEBUG_ENABLED
+	runner.run_all<DebugGlobalAdapter>();
+	runner.run_all<DebugStackAdapter>();
+	runner.run_all<DebugPageAdapter>();
+	runner.run_all<DebugSlabAdapter>();
+#endif
+#if DEBUG_INLINE_ALLOCATOR_ENABLED
+	runner.run_all<DebugInlineAdapter>();
+#endif
+	runner.run_hash_map<UnorderedMapAdapter>();
+	runner.run_hash_map<PooledHashMapAdapter>();
+
+	auto & results = runner.results();
+	compare_with_malloc(results);
+
+	std::ofstream file;
+	if (!options.output.empty())
+		file.open(options.output);
+	std::ostream & os = options.output.empty() ? std::cout : file;
+
+	if (options.format == "json")
+		write_json(os, results);
+	else
+		write_csv(os, results);
+
+	if (!options.latency.empty())
+	{
+		std::ofstream latency_file{ options.latency };
+		write_latency_csv(latency_file, runner.latencies());
+	}
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+/// Shows the cache set conflicts between the pages of several PageAllocators and how coloring the
+/// pages reduces them. The objects with the same index of every page are visited together, as a
+/// system that iterates several pools in lock step does, and the accesses are run through a
+/// simulated L1 cache and timed on the machine.
+///
+///	usage: cache_coloring [--pools=<n>] [--pages=<n>] [--objects=<n>] [--passes=<n>] [--colors=<n>]
+///
+/// The pages are aligned to the system pages, as the ones that come from mmap or a NumaPageSource,
+/// so without coloring the first object of every page maps to the same cache set.
+
+#include "PageAllocator.h"
+
+#include "CacheSimulator.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace benchmarks;
+using memory::PageAllocator;
+
+namespace
+{
+	constexpr size_type PAGE_ALIGNMENT = 4096;
+	constexpr size_type OBJECT_SIZE = 256;
+
+	struct Options
+	{
+		size_type pools{ 4 };
+		size_type pages{ 8 };
+		size_type objects{ 4 };
+		size_type passes{ 1000 };
+		size_type colors{ 8 };
+	};
+
+	class AlignedPageAllocator
+		: public PageAllocator
+	{
+	public:
+		AlignedPageAllocator(size_type obj_num, size_type colors)
+			: PageAllocator{ OBJECT_SIZE, obj_num, false, colors }
+		{}
+		~AlignedPageAllocator()
+		{
+			deallocate_all_pages();
+		}
+
+	protected:
+		Page * do_page_alloc() override
+		{
+			return init_page(memory::global_aligned_alloc(get_page_size(), PAGE_ALIGNMENT));
+		}
+		void do_page_dealloc_internal(Page * page) override
+		{
+			memory::global_aligned_dealloc(page);
+		}
+	};
+
+	struct Result
+	{
+		size_type accesses{ 0u };
+		size_type misses{ 0u };
+		double ns_per_access{ 0.0 };
+	};
+
+	Result run(const Options & options, size_type colors)
+	{
+		// objects[pool][page * objects + i]
+		std::vector<std::unique_ptr<AlignedPageAllocator>> pools;
+		std::vector<std::vector<void *>> objects(options.pools);
+		for (size_type pool = 0; pool < options.pools; ++pool)
+		{
+			pools.emplace_back(new AlignedPageAllocator{ options.objects, colors });
+			objects[pool].resize(options.pages * options.objects);
+			pools.back()->allocate_bulk(objects[pool].data(), objects[pool].size());
+		}
+
+		// object i of every page of every pool
+		std::vector<unsigned char *> order;
+		for (size_type i = 0; i < options.objects; ++i)
+			for (size_type page = 0; page < options.pages; ++page)
+				for (size_type pool = 0; pool < options.pools; ++pool)
+					order.push_back(reinterpret_cast<unsigned char *>(objects[pool][page * options.objects + i]));
+
+		Result result;
+		CacheSimulator cache;
+		for (size_type pass = 0; pass < options.passes; ++pass)
+			for (auto * obj : order)
+				cache.access(obj);
+		result.accesses = cache.hits() + cache.misses();
+		result.misses = cache.misses();
+
+		using clock = std::chrono::steady_clock;
+		volatile unsigned sum = 0;
+		const auto start = clock::now();
+		for (size_type pass = 0; pass < options.passes; ++pass)
+		{
+			unsigned pass_sum = 0;
+			for (auto * obj : order)
+			{
+				pass_sum += *obj;
+				*obj = static_cast<unsigned char>(pass_sum);
+			}
+			sum = sum + pass_sum;
+		}
+		const std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+		result.ns_per_access = elapsed.count() / static_cast<double>(result.accesses);
+
+		for (size_type pool = 0; pool < options.pools; ++pool)
+			pools[pool]->deallocate_bulk(objects[pool].data(), objects[pool].size());
+		return result;
+	}
+
+	bool parse_options(int argc, char ** argv, Options & options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			const auto eq = arg.find('=');
+			const auto key = arg.substr(0, eq);
+			const auto value = std::strtoul(eq == std::string::npos ? "" : arg.c_str() + eq + 1, nullptr, 10);
+
+			if (key == "--pools")			options.pools = value;
+			else if (key == "--pages")		options.pages = value;
+			else if (key == "--objects")	options.objects = value;
+			else if (key == "--passes")		options.passes = value;
+			else if (key == "--colors")		options.colors = value;
+			else
+			{
+				std::cerr << "Unknown option " << arg << '\n';
+				return false;
+			}
+		}
+
+		return options.pools > 0 && options.pages > 0 && options.objects > 0 && options.colors > 0;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	Options options;
+	if (!parse_options(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0] << " [--pools=<n>] [--pages=<n>] [--objects=<n>] [--passes=<n>] [--colors=<n>]\n";
+		return 1;
+	}
+
+	std::cout << "colors,accesses,simulated_l1_misses,miss_rate,ns_per_access\n";
+	for (const auto colors : { size_type{ 1u }, options.colors })
+	{
+		const auto result = run(options, colors);
+		std::cout << colors << ',' << result.accesses << ',' << result.misses << ','
+			<< static_cast<double>(result.misses) / static_cast<double>(result.accesses) << ','
+			<< result.ns_per_access << '\n';
+	}
+
+	return 0;
+}
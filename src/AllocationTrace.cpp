@@ -0,0 +1,177 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "AllocationTrace.h"
+
+#include <atomic>
+
+namespace memory
+{
+	namespace impl
+	{
+		static std::atomic<TraceRecorder *> s_trace_recorder{ nullptr };
+		static std::atomic<std::uint32_t> s_next_thread_id{ 0u };
+
+		template <typename T>
+		void write_le(unsigned char *& out, T value)
+		{
+			for (size_type i = 0; i < sizeof(T); ++i)
+				*out++ = static_cast<unsigned char>((value >> (8 * i)) & 0xFF);
+		}
+
+		template <typename T>
+		T read_le(const unsigned char *& in)
+		{
+			T value = 0;
+			for (size_type i = 0; i < sizeof(T); ++i)
+				value |= static_cast<T>(*in++) << (8 * i);
+			return value;
+		}
+	}
+
+#pragma region // TraceRecorder
+
+	TraceRecorder::TraceRecorder(std::ostream & os)
+		: m_os{ os }
+		, m_start{ std::chrono::steady_clock::now() }
+	{
+		unsigned char header[trace_format::HEADER_SIZE];
+		unsigned char * out = header;
+		for (const auto c : trace_format::MAGIC)
+			*out++ = static_cast<unsigned char>(c);
+		impl::write_le(out, trace_format::VERSION);
+		impl::write_le(out, trace_format::EVENT_SIZE);
+
+		m_os.write(reinterpret_cast<const char *>(header), sizeof(header));
+	}
+
+	void TraceRecorder::record(const TraceEvent & event)
+	{
+		unsigned char raw[trace_format::EVENT_SIZE];
+		unsigned char * out = raw;
+		impl::write_le(out, event.timestamp);
+		impl::write_le(out, event.allocator_id);
+		impl::write_le(out, event.address);
+		impl::write_le(out, event.size);
+		impl::write_le(out, event.alignment);
+		impl::write_le(out, event.thread_id);
+		impl::write_le(out, static_cast<std::uint8_t>(event.type));
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_os.write(reinterpret_cast<const char *>(raw), sizeof(raw));
+		m_recorded_events++;
+	}
+
+	void TraceRecorder::record(TraceEventType type, const void * allocator,
+							   const void * mem, size_type bytes, size_type alignment)
+	{
+		const auto elapsed = std::chrono::steady_clock::now() - m_start;
+
+		TraceEvent event;
+		event.timestamp = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		event.allocator_id = ptr_to_num(allocator);
+		event.address = ptr_to_num(mem);
+		event.size = bytes;
+		event.alignment = static_cast<std::uint32_t>(alignment);
+		event.thread_id = current_thread_id();
+		event.type = type;
+		record(event);
+	}
+
+#pragma endregion
+
+#pragma region // TraceReader
+
+	TraceReader::TraceReader(std::istream & is)
+		: m_is{ is }
+	{
+		unsigned char header[trace_format::HEADER_SIZE];
+		if (!m_is.read(reinterpret_cast<char *>(header), sizeof(header)))
+			return;
+
+		for (size_type i = 0; i < sizeof(trace_format::MAGIC); ++i)
+		{
+			if (header[i] != static_cast<unsigned char>(trace_format::MAGIC[i]))
+				return;
+		}
+
+		const unsigned char * in = header + sizeof(trace_format::MAGIC);
+		const auto version = impl::read_le<std::uint32_t>(in);
+		const auto event_size = impl::read_le<std::uint32_t>(in);
+		m_valid = version == trace_format::VERSION && event_size == trace_format::EVENT_SIZE;
+	}
+
+	bool TraceReader::next(TraceEvent & event)
+	{
+		if (!m_valid)	return false;
+
+		unsigned char raw[trace_format::EVENT_SIZE];
+		if (!m_is.read(reinterpret_cast<char *>(raw), sizeof(raw)))
+			return false;
+
+		const unsigned char * in = raw;
+		event.timestamp = impl::read_le<std::uint64_t>(in);
+		event.allocator_id = impl::read_le<std::uint64_t>(in);
+		event.address = impl::read_le<std::uint64_t>(in);
+		event.size = impl::read_le<std::uint64_t>(in);
+		event.alignment = impl::read_le<std::uint32_t>(in);
+		event.thread_id = impl::read_le<std::uint32_t>(in);
+		event.type = static_cast<TraceEventType>(impl::read_le<std::uint8_t>(in));
+		return true;
+	}
+
+#pragma endregion
+
+	std::uint32_t current_thread_id()
+	{
+		thread_local const std::uint32_t id = impl::s_next_thread_id++;
+		return id;
+	}
+
+	TraceRecorder * get_trace_recorder()
+	{
+		return impl::s_trace_recorder;
+	}
+	void set_trace_recorder(TraceRecorder * recorder)
+	{
+		impl::s_trace_recorder = recorder;
+	}
+
+#if MEMORY_TRACE_ENABLED
+
+	namespace impl
+	{
+		/// \brief	Set while the thread records an event, the allocations done by the recorder
+		///			(i.e. when operator new is replaced) are not recorded, they would recurse.
+		thread_local bool s_recording = false;
+
+		void record(TraceEventType type, const void * allocator, void * mem, size_type bytes, size_type alignment)
+		{
+			auto * recorder = get_trace_recorder();
+			if (recorder == nullptr || s_recording)	return;
+
+			s_recording = true;
+			recorder->record(type, allocator, mem, bytes, alignment);
+			s_recording = false;
+		}
+	}
+
+	void trace_allocation(const void * allocator, void * mem, size_type bytes, size_type alignment)
+	{
+		// failed allocations are not part of the trace
+		if (mem == nullptr)	return;
+
+		impl::record(TraceEventType::ALLOCATE, allocator, mem, bytes, alignment);
+	}
+	void trace_deallocation(const void * allocator, void * mem, size_type bytes, size_type alignment)
+	{
+		impl::record(TraceEventType::DEALLOCATE, allocator, mem, bytes, alignment);
+	}
+
+#endif
+}
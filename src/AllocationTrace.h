@@ -0,0 +1,120 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <ostream>
+
+// Tracing can also be enabled on release builds to capture traces from production.
+#ifndef MEMORY_TRACE_ENABLED
+#define MEMORY_TRACE_ENABLED MEMORY_DEBUG_ENABLED
+#endif
+
+namespace memory
+{
+	enum class TraceEventType : std::uint8_t
+	{
+		ALLOCATE = 0,
+		DEALLOCATE = 1,
+	};
+
+	/// \brief	One allocation or deallocation done by any allocator.
+	struct TraceEvent
+	{
+		/// \brief	Nanoseconds since the recorder was created.
+		std::uint64_t timestamp{ 0u };
+		/// \brief	Address of the allocator instance (0 for allocators without state, i.e. GlobalAllocator).
+		std::uint64_t allocator_id{ 0u };
+		std::uint64_t address{ 0u };
+		std::uint64_t size{ 0u };
+		std::uint32_t alignment{ 0u };
+		std::uint32_t thread_id{ 0u };
+		TraceEventType type{ TraceEventType::ALLOCATE };
+	};
+
+	/// \brief	Binary trace format:
+	///			header: magic "MATR", version (u32), event size (u32)
+	///			events: timestamp (u64), allocator id (u64), address (u64), size (u64),
+	///					alignment (u32), thread id (u32), type (u8)
+	///			All the values are stored in little endian.
+	namespace trace_format
+	{
+		constexpr char MAGIC[4] = { 'M', 'A', 'T', 'R' };
+		constexpr std::uint32_t VERSION = 1;
+		constexpr std::uint32_t HEADER_SIZE = 12;
+		constexpr std::uint32_t EVENT_SIZE = 8 * 4 + 4 * 2 + 1;
+	}
+
+	/// \brief	Writes trace events to a binary stream, can be used from multiple threads.
+	class TraceRecorder
+	{
+	public:
+		/// \brief	The stream needs to be opened in binary mode and outlive the recorder.
+		explicit TraceRecorder(std::ostream & os);
+
+		TraceRecorder(const TraceRecorder &) = delete;
+		TraceRecorder & operator=(const TraceRecorder &) = delete;
+
+		void record(const TraceEvent & event);
+		void record(TraceEventType type, const void * allocator,
+					const void * mem, size_type bytes, size_type alignment);
+
+		std::uint64_t recorded_events() const { return m_recorded_events; }
+
+	private:
+		std::ostream & m_os;
+		std::mutex m_mutex;
+		std::chrono::steady_clock::time_point m_start;
+		std::uint64_t m_recorded_events{ 0u };
+	};
+
+	/// \brief	Reads the events written by a TraceRecorder.
+	class TraceReader
+	{
+	public:
+		/// \brief	The stream needs to be opened in binary mode and outlive the reader.
+		explicit TraceReader(std::istream & is);
+
+		/// \brief	False if the stream does not contain a trace we can read.
+		bool valid() const { return m_valid; }
+
+		/// \brief	Returns false when there are no more events to read.
+		bool next(TraceEvent & event);
+
+	private:
+		std::istream & m_is;
+		bool m_valid{ false };
+	};
+
+	/// \brief	Returns a small number that identifies the calling thread.
+	std::uint32_t current_thread_id();
+
+	/// \brief	The recorder all the allocators send their events to, nullptr to stop tracing.
+	///			The recorder needs to outlive the tracing: an allocation in an other thread may still be using it right
+	///			after it is uninstalled, so it must not be destroyed while other threads allocate.
+	TraceRecorder * get_trace_recorder();
+	void set_trace_recorder(TraceRecorder * recorder);
+
+#if MEMORY_TRACE_ENABLED
+
+	void trace_allocation(const void * allocator, void * mem, size_type bytes, size_type alignment);
+	void trace_deallocation(const void * allocator, void * mem, size_type bytes, size_type alignment);
+
+#else
+
+	inline void trace_allocation(const void *, void *, size_type, size_type) {}
+	inline void trace_deallocation(const void *, void *, size_type, size_type) {}
+
+#endif
+}
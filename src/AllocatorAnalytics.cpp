@@ -0,0 +1,59 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "AllocatorAnalytics.h"
+
+namespace memory
+{
+	constexpr size_type AllocatorAnalytics::UTILIZATION_BUCKETS;
+
+	size_type AllocatorAnalytics::analyzed_pages() const
+	{
+		size_type pages = 0;
+		for (auto count : page_utilization)
+			pages += count;
+		return pages;
+	}
+
+	void AllocatorAnalytics::add_page(size_type used_objects, size_type object_num)
+	{
+		MEMORY_ASSERT(object_num > 0 && used_objects <= object_num);
+		const auto bucket = used_objects * UTILIZATION_BUCKETS / object_num;
+		page_utilization[bucket < UTILIZATION_BUCKETS ? bucket : UTILIZATION_BUCKETS - 1]++;
+	}
+
+	AllocatorAnalytics & AllocatorAnalytics::operator+=(const AllocatorAnalytics & other)
+	{
+		requested_bytes += other.requested_bytes;
+		granted_bytes += other.granted_bytes;
+		free_bytes += other.free_bytes;
+		if (other.largest_free_block > largest_free_block)
+			largest_free_block = other.largest_free_block;
+		high_water_mark += other.high_water_mark;
+		for (size_type i = 0; i < UTILIZATION_BUCKETS; ++i)
+			page_utilization[i] += other.page_utilization[i];
+		return *this;
+	}
+}
+
+std::ostream & operator<< (std::ostream & os, const ::memory::AllocatorAnalytics & analytics)
+{
+	os << "Requested: " << analytics.requested_bytes
+		<< ", Granted: " << analytics.granted_bytes << " [" << 100.f * analytics.internal_fragmentation() << "% internal fragmentation]"
+		<< ", Free: " << analytics.free_bytes
+		<< ", Largest free block: " << analytics.largest_free_block << " [" << 100.f * analytics.external_fragmentation() << "% external fragmentation]"
+		<< ", High water mark: " << analytics.high_water_mark;
+
+	if (analytics.analyzed_pages())
+	{
+		os << "\n    Page utilization:";
+		for (::memory::size_type i = 0; i < ::memory::AllocatorAnalytics::UTILIZATION_BUCKETS; ++i)
+			os << ' ' << i * 10 << "%: " << analytics.page_utilization[i];
+	}
+	return os;
+}
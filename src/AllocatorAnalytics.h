@@ -0,0 +1,87 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+
+#include <ostream>
+
+namespace memory
+{
+	/// \brief	Fragmentation and utilization of an allocator at one point in time, to size the allocators
+	///			from data. Given by get_analytics() of the debug allocators and of the InlineAllocator,
+	///			the FallbackAllocator adds the ones of its two tiers.
+	struct AllocatorAnalytics
+	{
+		static constexpr size_type UTILIZATION_BUCKETS = 10;
+
+		/// \brief	Bytes the user asked for in the live allocations.
+		size_type requested_bytes{ 0u };
+		/// \brief	Bytes the live allocations take, with the rounding of their sizes (not the headers).
+		size_type granted_bytes{ 0u };
+		size_type free_bytes{ 0u };
+		/// \brief	Biggest allocation that can be served without more memory. The allocators of fixed size
+		///			objects report all their free bytes, any free object can be used.
+		size_type largest_free_block{ 0u };
+		/// \brief	Maximum of granted_bytes since the allocator was created.
+		size_type high_water_mark{ 0u };
+		/// \brief	Pages (or slabs) by the fraction of their objects in use: bucket i counts the ones
+		///			with [i, i + 1) tenths in use, the full ones are in the last bucket.
+		size_type page_utilization[UTILIZATION_BUCKETS]{};
+
+		/// \brief	Fraction of the granted bytes the user did not ask for.
+		float internal_fragmentation() const
+		{
+			return granted_bytes ? 1.f - static_cast<float>(requested_bytes) / granted_bytes : 0.f;
+		}
+		/// \brief	Fraction of the free bytes that the biggest possible allocation can't use.
+		float external_fragmentation() const
+		{
+			return free_bytes ? 1.f - static_cast<float>(largest_free_block) / free_bytes : 0.f;
+		}
+		size_type analyzed_pages() const;
+
+		void add_page(size_type used_objects, size_type object_num);
+		/// \brief	Adds the analytics of another allocator. The high water marks are added too, which is
+		///			an upper bound, the peaks of the two allocators may have happened at different times.
+		AllocatorAnalytics & operator+=(const AllocatorAnalytics & other);
+	};
+
+	namespace impl
+	{
+		/// \brief	Live bytes of the allocations of a debug allocator, for its analytics.
+		struct AllocationUsage
+		{
+			void allocated(size_type requested, size_type granted)
+			{
+				requested_bytes += requested;
+				granted_bytes += granted;
+				if (granted_bytes > high_water_mark)
+					high_water_mark = granted_bytes;
+			}
+			void deallocated(size_type requested, size_type granted)
+			{
+				requested_bytes -= requested;
+				granted_bytes -= granted;
+			}
+			void fill(AllocatorAnalytics & analytics) const
+			{
+				analytics.requested_bytes = requested_bytes;
+				analytics.granted_bytes = granted_bytes;
+				analytics.high_water_mark = high_water_mark;
+			}
+
+			size_type requested_bytes{ 0u };
+			size_type granted_bytes{ 0u };
+			size_type high_water_mark{ 0u };
+		};
+	}
+}
+
+std::ostream & operator<< (std::ostream & os, const ::memory::AllocatorAnalytics & analytics);
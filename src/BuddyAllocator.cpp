@@ -0,0 +1,308 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "BuddyAllocator.h"
+
+namespace memory
+{
+	namespace impl
+	{
+		inline size_type buddy_min_block_size(size_type min_block_size, size_type free_block_size)
+		{
+			return round_up_to_power_of_two(min_block_size < free_block_size ? free_block_size : min_block_size);
+		}
+		inline size_type buddy_max_order(size_type bytes, size_type min_block_size, size_type max_orders)
+		{
+			MEMORY_ASSERT(bytes >= min_block_size);
+			const auto order = log2_floor(bytes / min_block_size);
+			return order < max_orders ? order : max_orders - 1;
+		}
+		/// \brief	A binary heap of blocks with max_order + 1 levels has 2^(max_order + 1) - 1 nodes.
+		inline size_type buddy_bitmap_bytes(size_type max_order)
+		{
+			const auto bits = (size_type{ 1u } << (max_order + 1)) - 1;
+			return bits / 8 + 1;
+		}
+	}
+
+	BuddyAllocator::BuddyAllocator(size_type bytes, size_type min_block_size)
+		: m_min_block_size{ impl::buddy_min_block_size(min_block_size, sizeof(FreeBlock)) }
+		, m_max_order{ impl::buddy_max_order(bytes, m_min_block_size, MAX_ORDERS) }
+		, m_memory_chunk{ block_size(m_max_order) }
+		, m_free_bitmap{ impl::buddy_bitmap_bytes(m_max_order) }
+	{
+		std::memset(m_free_bitmap.memory(), 0, m_free_bitmap.bytes());
+		for (auto & list : m_free_lists)
+			list = nullptr;
+
+		// the whole chunk is one free block
+		push_free(m_max_order, 0);
+	}
+
+	size_type BuddyAllocator::order_for(size_type bytes) const
+	{
+		if (bytes <= m_min_block_size)	return 0;
+		return log2_floor(round_up_to_power_of_two(bytes) / m_min_block_size);
+	}
+
+	unsigned char * BuddyAllocator::allocate(size_type bytes)
+	{
+		const auto order = order_for(bytes);
+		if (order > m_max_order)	return nullptr;
+
+		// smallest block big enough that is free
+		auto current = order;
+		while (current <= m_max_order && m_free_lists[current] == nullptr)
+			++current;
+		if (current > m_max_order)	return nullptr;
+
+		auto * block = pop_free(current);
+		const auto offset = get_offset_from_base(reinterpret_cast<unsigned char *>(block));
+
+		// split it until we get a block of the requested order, the second halves remain free
+		while (current > order)
+		{
+			--current;
+			push_free(current, offset + block_size(current));
+		}
+
+		auto * result = reinterpret_cast<unsigned char *>(block);
+		trace_allocation(this, result, bytes, alignof(std::max_align_t));
+		return result;
+	}
+
+	void BuddyAllocator::deallocate(unsigned char * mem, size_type bytes)
+	{
+		MEMORY_ASSERT(owns(mem));
+		trace_deallocation(this, mem, bytes, alignof(std::max_align_t));
+
+		auto order = order_for(bytes);
+		auto offset = get_offset_from_base(mem);
+		MEMORY_ASSERT(offset % block_size(order) == 0);
+
+		// merge with the buddy for as long as it is free
+		while (order < m_max_order)
+		{
+			const auto buddy = offset ^ block_size(order);
+			if (!is_free(order, buddy))
+				break;
+
+			remove_free(order, buddy);
+			offset = offset < buddy ? offset : buddy;
+			++order;
+		}
+
+		push_free(order, offset);
+	}
+
+	bool BuddyAllocator::resize(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		MEMORY_ASSERT(owns(mem));
+
+		const auto old_order = order_for(old_bytes);
+		const auto new_order = order_for(new_bytes);
+		const auto offset = get_offset_from_base(mem);
+
+		if (new_order > old_order)
+		{
+			// the block is the first half of all the bigger blocks it becomes, and the second halves need to be free
+			if (new_order > m_max_order || offset % block_size(new_order) != 0)	return false;
+			for (auto order = old_order; order < new_order; ++order)
+			{
+				if (!is_free(order, offset + block_size(order)))
+					return false;
+			}
+
+			for (auto order = old_order; order < new_order; ++order)
+				remove_free(order, offset + block_size(order));
+		}
+		else
+		{
+			// the second halves are given back, their buddies are used so they can't be merged
+			for (auto order = old_order; order-- > new_order; )
+				push_free(order, offset + block_size(order));
+		}
+
+		trace_deallocation(this, mem, old_bytes, alignof(std::max_align_t));
+		trace_allocation(this, mem, new_bytes, alignof(std::max_align_t));
+		return true;
+	}
+
+	unsigned char * BuddyAllocator::reallocate(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		if (resize(mem, old_bytes, new_bytes))	return mem;
+
+		auto * result = allocate(new_bytes);
+		if (result == nullptr)	return nullptr;
+
+		std::memcpy(result, mem, old_bytes < new_bytes ? old_bytes : new_bytes);
+		deallocate(mem, old_bytes);
+		return result;
+	}
+
+	size_type BuddyAllocator::largest_free_block() const
+	{
+		for (auto order = m_max_order + 1; order-- > 0; )
+		{
+			if (m_free_lists[order])
+				return block_size(order);
+		}
+
+		return 0;
+	}
+
+	void BuddyAllocator::push_free(size_type order, size_type offset)
+	{
+		auto * block = as_block(offset);
+		block->m_prev = nullptr;
+		block->m_next = m_free_lists[order];
+		if (block->m_next)
+			block->m_next->m_prev = block;
+		m_free_lists[order] = block;
+
+		set_free(order, offset, true);
+		m_free_bytes += block_size(order);
+	}
+	void BuddyAllocator::remove_free(size_type order, size_type offset)
+	{
+		auto * block = as_block(offset);
+		if (block->m_prev)
+			block->m_prev->m_next = block->m_next;
+		else
+			m_free_lists[order] = block->m_next;
+		if (block->m_next)
+			block->m_next->m_prev = block->m_prev;
+
+		set_free(order, offset, false);
+		m_free_bytes -= block_size(order);
+	}
+	BuddyAllocator::FreeBlock * BuddyAllocator::pop_free(size_type order)
+	{
+		auto * block = m_free_lists[order];
+		remove_free(order, get_offset_from_base(reinterpret_cast<unsigned char *>(block)));
+		return block;
+	}
+
+	size_type BuddyAllocator::bit_index(size_type order, size_type offset) const
+	{
+		const auto level = m_max_order - order;
+		return ((size_type{ 1u } << level) - 1) + offset / block_size(order);
+	}
+	bool BuddyAllocator::is_free(size_type order, size_type offset) const
+	{
+		const auto bit = bit_index(order, offset);
+		return (m_free_bitmap.memory()[bit / 8] >> (bit % 8)) & 1u;
+	}
+	void BuddyAllocator::set_free(size_type order, size_type offset, bool free)
+	{
+		const auto bit = bit_index(order, offset);
+		const auto mask = static_cast<unsigned char>(1u << (bit % 8));
+		if (free)
+			m_free_bitmap.memory()[bit / 8] |= mask;
+		else
+			m_free_bitmap.memory()[bit / 8] &= static_cast<unsigned char>(~mask);
+	}
+
+#if MEMORY_DEBUG_ENABLED
+	DebugBuddyAllocator::DebugBuddyAllocator(size_type bytes, size_type min_block_size)
+		: Base{ bytes, min_block_size }
+	{
+		// the beginning of the chunk already holds the links of the first free block
+		const auto links = 2 * sizeof(void *);
+		fill_with_pattern(DebugPattern::ACQUIRED, m_memory_chunk.memory() + links, m_memory_chunk.bytes() - links);
+	}
+	DebugBuddyAllocator::~DebugBuddyAllocator()
+	{
+		// if we call delete on the memory, the runtime library may put its own
+		// pattern, just in case it does not (i.e. release build)
+		fill_with_pattern(DebugPattern::RELEASED, m_memory_chunk.memory(), m_memory_chunk.bytes());
+	}
+
+	unsigned char * DebugBuddyAllocator::allocate(size_type bytes)
+	{
+		if (auto * allocated = Base::allocate(bytes))
+		{
+			m_stats.allocations++;
+			m_stats.internal_fragmentation += block_size(order_for(bytes)) - bytes;
+			m_usage.allocated(bytes, block_size(order_for(bytes)));
+			fill_with_pattern(DebugPattern::ALLOCATED, allocated, bytes);
+			fill_with_pattern(DebugPattern::PADDING, allocated + bytes, block_size(order_for(bytes)) - bytes);
+			return allocated;
+		}
+
+		m_stats.failures++;
+		return nullptr;
+	}
+
+	void DebugBuddyAllocator::deallocate(unsigned char * mem, size_type bytes)
+	{
+		m_stats.deallocations++;
+		m_stats.internal_fragmentation -= block_size(order_for(bytes)) - bytes;
+		m_usage.deallocated(bytes, block_size(order_for(bytes)));
+		verify_pattern(this, mem + bytes, block_size(order_for(bytes)) - bytes, DebugPattern::PADDING);
+		// the whole block goes back to the free lists, the beginning is overwritten by the links
+		fill_with_pattern(DebugPattern::DEALLOCATED, mem, block_size(order_for(bytes)));
+		Base::deallocate(mem, bytes);
+	}
+
+	bool DebugBuddyAllocator::expand(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		if (resize(mem, old_bytes, new_bytes))	return true;
+
+		m_stats.failures++;
+		return false;
+	}
+
+	bool DebugBuddyAllocator::resize(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		const auto old_block = block_size(order_for(old_bytes));
+		const auto new_block = block_size(order_for(new_bytes));
+		verify_pattern(this, mem + old_bytes, old_block - old_bytes, DebugPattern::PADDING);
+
+		// the halves given back are free memory, before Base writes their links
+		if (new_block < old_block)
+			fill_with_pattern(DebugPattern::DEALLOCATED, mem + new_block, old_block - new_block);
+
+		if (!Base::resize(mem, old_bytes, new_bytes))
+			return false;
+
+		m_stats.internal_fragmentation -= block_size(order_for(old_bytes)) - old_bytes;
+		m_stats.internal_fragmentation += block_size(order_for(new_bytes)) - new_bytes;
+		m_usage.deallocated(old_bytes, old_block);
+		m_usage.allocated(new_bytes, new_block);
+		if (new_bytes > old_bytes)
+			fill_with_pattern(DebugPattern::ALLOCATED, mem + old_bytes, new_bytes - old_bytes);
+		fill_with_pattern(DebugPattern::PADDING, mem + new_bytes, new_block - new_bytes);
+		return true;
+	}
+
+	AllocatorAnalytics DebugBuddyAllocator::get_analytics() const
+	{
+		AllocatorAnalytics analytics;
+		m_usage.fill(analytics);
+		analytics.free_bytes = free_size();
+		analytics.largest_free_block = largest_free_block();
+		return analytics;
+	}
+
+	bool DebugBuddyAllocator::verify_heap() const
+	{
+		// merged blocks keep the links of the blocks they absorbed, any block of the smallest size may start with them
+		bool valid = true;
+		for_each_free_block([&](unsigned char * block, size_type bytes)
+		{
+			for (size_type offset = 0; offset < bytes; offset += get_min_block_size())
+			{
+				valid &= verify_free_pattern(this, block + offset + free_block_links(),
+											 get_min_block_size() - free_block_links());
+			}
+		});
+		return valid;
+	}
+#endif
+}
@@ -0,0 +1,178 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "MemoryChunk.h"
+#include "AllocationTrace.h"
+
+namespace memory
+{
+	/// \brief	Splits a chunk of memory in power of two blocks.
+	///			Allocations are served with the smallest block that fits them, splitting bigger blocks
+	///			in halves (buddies) when needed. When a block is deallocated and its buddy is free
+	///			both are merged back into the bigger block.
+	///			Allocation and deallocation are O(log n) and can happen in any order.
+	class BuddyAllocator
+	{
+		/// \brief	Free blocks are linked using their own memory.
+		struct FreeBlock
+		{
+			FreeBlock * m_prev;
+			FreeBlock * m_next;
+		};
+
+	public:
+		static constexpr size_type MAX_ORDERS = 48;
+
+		/// \brief	The memory managed is the biggest power of two multiple of min_block_size that fits in bytes.
+		///			min_block_size is rounded up to a power of two able to hold a FreeBlock.
+		explicit BuddyAllocator(size_type bytes, size_type min_block_size = 64);
+		virtual ~BuddyAllocator() = default;
+
+		BuddyAllocator(const BuddyAllocator &) = delete;
+		BuddyAllocator & operator=(const BuddyAllocator &) = delete;
+
+		virtual unsigned char * allocate(size_type bytes);
+		/// \brief	The size needs to be the same one used to allocate the memory.
+		virtual void deallocate(unsigned char * mem, size_type bytes);
+		/// \brief	Grows or shrinks the allocation without moving it. Growing merges the block with its
+		///			next buddies while they are free, so the block needs to be aligned to the new size.
+		///			Returns false if it can't.
+		virtual bool expand(unsigned char * mem, size_type old_bytes, size_type new_bytes) { return resize(mem, old_bytes, new_bytes); }
+		/// \brief	Expands the allocation or moves it to a new block. Returns nullptr if there is no room,
+		///			mem is still valid then.
+		unsigned char * reallocate(unsigned char * mem, size_type old_bytes, size_type new_bytes);
+
+		bool owns(unsigned char * mem) const { return m_memory_chunk.owns(mem); }
+		bool is_full() const { return m_free_bytes == 0; }
+		size_type free_size() const { return m_free_bytes; }
+		/// \brief	Size of the biggest allocation that would succeed at the moment.
+		size_type largest_free_block() const;
+
+		size_type get_min_block_size() const { return m_min_block_size; }
+		size_type get_max_order() const { return m_max_order; }
+		size_type block_size(size_type order) const { return m_min_block_size << order; }
+		/// \brief	Order of the smallest block able to hold the given bytes.
+		size_type order_for(size_type bytes) const;
+
+	protected:
+		/// \brief	Does the work of expand, reallocate uses it directly because failing to resize
+		///			the block in place is not a failure when the allocation can still be moved.
+		virtual bool resize(unsigned char * mem, size_type old_bytes, size_type new_bytes);
+
+		size_type get_offset_from_base(unsigned char * ptr) const
+		{
+			return ptr_to_num(ptr) - ptr_to_num(m_memory_chunk.memory());
+		}
+
+		/// \brief	Calls f with the memory and the size of every free block.
+		template <typename F>
+		void for_each_free_block(F && f) const
+		{
+			for (size_type order = 0; order <= m_max_order; ++order)
+			{
+				for (auto * block = m_free_lists[order]; block != nullptr; block = block->m_next)
+					f(reinterpret_cast<unsigned char *>(block), block_size(order));
+			}
+		}
+		/// \brief	Bytes used by the links of the free blocks.
+		static constexpr size_type free_block_links() { return sizeof(FreeBlock); }
+
+	private:
+		void push_free(size_type order, size_type offset);
+		void remove_free(size_type order, size_type offset);
+		FreeBlock * pop_free(size_type order);
+
+		/// \brief	The bitmap stores one bit per block of every order that is set while the block is free.
+		///			Blocks are laid out as a binary heap, the whole chunk being the root.
+		size_type bit_index(size_type order, size_type offset) const;
+		bool is_free(size_type order, size_type offset) const;
+		void set_free(size_type order, size_type offset, bool free);
+
+		FreeBlock * as_block(size_type offset) const
+		{
+			return reinterpret_cast<FreeBlock *>(m_memory_chunk.memory() + offset);
+		}
+
+		size_type m_min_block_size{ 0u };
+		size_type m_max_order{ 0u };
+
+	protected:
+		// IMPORTANT(Borja): the sizes are needed to create the chunks, keep them declared before
+		MemoryChunk m_memory_chunk;
+
+	private:
+		MemoryChunk m_free_bitmap;
+		FreeBlock * m_free_lists[MAX_ORDERS];
+		size_type m_free_bytes{ 0u };
+	};
+}
+
+#if MEMORY_DEBUG_ENABLED
+
+#include "AllocatorAnalytics.h"
+#include "DebugPatterns.h"
+
+namespace memory
+{
+	/// \brief	Fills the memory with debug patterns and generates statistics of the allocations.
+	///			The end of the blocks that is not used by the allocations is padding, it is checked when
+	///			the memory is deallocated to find overruns.
+	class DebugBuddyAllocator
+		: public BuddyAllocator
+	{
+	public:
+		using Base = BuddyAllocator;
+
+		struct Stats
+		{
+			size_type allocations{ 0u };
+			size_type deallocations{ 0u };
+			size_type failures{ 0u };
+			/// \brief	Bytes lost because of rounding the allocations up to a power of two.
+			size_type internal_fragmentation{ 0u };
+		};
+
+	public:
+		explicit DebugBuddyAllocator(size_type bytes, size_type min_block_size = 64);
+		~DebugBuddyAllocator();
+
+		unsigned char * allocate(size_type bytes) override;
+		void deallocate(unsigned char * mem, size_type bytes) override;
+
+		/// \brief	Counts a failure when the block can't be resized in place.
+		bool expand(unsigned char * mem, size_type old_bytes, size_type new_bytes) override;
+
+		/// \brief	Checks that nobody wrote to the free blocks, the corruptions go to the corruption callback.
+		bool verify_heap() const;
+
+		const Stats & get_stats() const { return m_stats; }
+		/// \brief	The blocks are granted, the largest free block is the biggest allocation that fits.
+		AllocatorAnalytics get_analytics() const;
+
+	protected:
+		bool resize(unsigned char * mem, size_type old_bytes, size_type new_bytes) override;
+
+	private:
+		Stats m_stats;
+		impl::AllocationUsage m_usage;
+	};
+}
+
+#endif
+
+namespace memory
+{
+#if MEMORY_DEBUG_ENABLED
+	using DefaultBuddyAllocator = DebugBuddyAllocator;
+#else
+	using DefaultBuddyAllocator = BuddyAllocator;
+#endif
+}
@@ -0,0 +1,181 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "DebugPatterns.h"
+
+#include <cstdint>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MEMORY_PATTERN_SSE2 1
+#else
+#define MEMORY_PATTERN_SSE2 0
+#endif
+
+namespace memory
+{
+	namespace impl
+	{
+		void default_corruption_callback(const PatternCorruption & corruption)
+		{
+			// endl to flush the message
+			std::cerr << "Memory corruption at " << corruption.address
+				<< " (allocator " << corruption.allocator << "): expected 0x" << std::hex
+				<< static_cast<unsigned>(corruption.expected) << ", found 0x"
+				<< static_cast<unsigned>(corruption.found) << std::dec << std::endl;
+			MEMORY_ASSERT(false);
+		}
+
+		static corruption_callback_type s_corruption_callback = default_corruption_callback;
+	}
+
+	corruption_callback_type get_corruption_callback()
+	{
+		return impl::s_corruption_callback;
+	}
+	void set_corruption_callback(corruption_callback_type callback)
+	{
+		// make sure the callback is valid
+		if (!callback)
+			callback = impl::default_corruption_callback;
+
+		impl::s_corruption_callback = callback;
+	}
+
+	const unsigned char * find_pattern_mismatch(const void * mem, size_type n, DebugPattern pattern)
+	{
+		const auto * bytes = static_cast<const unsigned char *>(mem);
+		const auto value = static_cast<unsigned char>(pattern);
+		size_type i = 0;
+
+#if MEMORY_PATTERN_SSE2
+		// the four blocks are checked together, the exact byte is only searched once we know there is one
+		const auto expected = _mm_set1_epi8(static_cast<char>(value));
+		for (; i + 64 <= n; i += 64)
+		{
+			const auto * block = reinterpret_cast<const __m128i *>(bytes + i);
+			const auto equal = _mm_and_si128(
+				_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(block), expected), _mm_cmpeq_epi8(_mm_loadu_si128(block + 1), expected)),
+				_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(block + 2), expected), _mm_cmpeq_epi8(_mm_loadu_si128(block + 3), expected)));
+			if (_mm_movemask_epi8(equal) != 0xFFFF)
+				break;
+		}
+		for (; i + 16 <= n; i += 16)
+		{
+			const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+			const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, expected)));
+			if (mask != 0xFFFFu)
+				return bytes + i + find_first_set(~mask & 0xFFFFu);
+		}
+#else
+		const auto expected = std::uint64_t{ 0x0101010101010101u } * value;
+		for (; i + 8 <= n; i += 8)
+		{
+			std::uint64_t word;
+			std::memcpy(&word, bytes + i, sizeof(word));
+			if (word != expected)
+				break;
+		}
+#endif
+
+		for (; i < n; ++i)
+		{
+			if (bytes[i] != value)
+				return bytes + i;
+		}
+		return nullptr;
+	}
+
+	bool verify_pattern(const void * allocator, const void * mem, size_type n, DebugPattern pattern)
+	{
+		// the memory was never filled
+		if (!debug_patterns_enabled())	return true;
+
+		const auto * corrupted = find_pattern_mismatch(mem, n, pattern);
+		if (corrupted == nullptr)	return true;
+
+		PatternCorruption corruption;
+		corruption.allocator = allocator;
+		corruption.address = corrupted;
+		corruption.expected = pattern;
+		corruption.found = *corrupted;
+		impl::s_corruption_callback(corruption);
+		return false;
+	}
+
+	bool verify_free_pattern(const void * allocator, const void * mem, size_type n)
+	{
+		// the memory may be poisoned when the patterns are replaced by the sanitizers
+		if (n == 0 || !debug_patterns_enabled())	return true;
+
+		const auto first = *static_cast<const unsigned char *>(mem);
+		const auto pattern = first == DebugPattern::ACQUIRED ? DebugPattern::ACQUIRED : DebugPattern::DEALLOCATED;
+		return verify_pattern(allocator, mem, n, pattern);
+	}
+
+	namespace impl
+	{
+		void DeferredFills::add(void * mem, size_type n, DebugPattern pattern)
+		{
+			if (m_count == CAPACITY)
+				flush();
+
+			m_fills[m_count++] = Fill{ static_cast<unsigned char *>(mem), n, pattern };
+		}
+
+		bool DeferredFills::cancel(const void * mem, size_type n)
+		{
+			const auto start = ptr_to_num(mem);
+			const auto end = start + n;
+
+			bool cancelled = false;
+			for (size_type i = 0; i < m_count; )
+			{
+				auto & fill = m_fills[i];
+				const auto fill_start = ptr_to_num(fill.m_mem);
+				const auto fill_end = fill_start + fill.m_bytes;
+				if (fill_end <= start || end <= fill_start)
+				{
+					++i;
+					continue;
+				}
+
+				cancelled = true;
+				const bool before = fill_start < start;
+				const bool after = end < fill_end;
+
+				// what is left on one side is done now, the other side stays in the batch
+				if (before && after)
+					fill_with_pattern(fill.m_pattern, fill.m_mem, start - fill_start);
+				if (after)
+				{
+					fill.m_mem += end - fill_start;
+					fill.m_bytes = fill_end - end;
+					++i;
+				}
+				else if (before)
+				{
+					fill.m_bytes = start - fill_start;
+					++i;
+				}
+				else
+					fill = m_fills[--m_count];
+			}
+
+			return cancelled;
+		}
+
+		void DeferredFills::flush()
+		{
+			for (size_type i = 0; i < m_count; ++i)
+				fill_with_pattern(m_fills[i].m_pattern, m_fills[i].m_mem, m_fills[i].m_bytes);
+			m_count = 0;
+		}
+	}
+}
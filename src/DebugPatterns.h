@@ -0,0 +1,77 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+
+#include <functional>
+
+namespace memory
+{
+	/// \brief	Memory of an allocator that does not have the debug pattern it should,
+	///			someone wrote to memory that was freed or past the end of an allocation.
+	struct PatternCorruption
+	{
+		const void * allocator{ nullptr };
+		/// \brief	First corrupted byte.
+		const void * address{ nullptr };
+		DebugPattern expected{ DebugPattern::DEALLOCATED };
+		unsigned char found{ 0u };
+	};
+
+	using corruption_callback_type = std::function<void(const PatternCorruption &)>;
+	corruption_callback_type get_corruption_callback();
+	/// \brief	The default callback prints the corruption and breaks.
+	void set_corruption_callback(corruption_callback_type callback);
+
+	/// \brief	First byte of the memory that is not the pattern, nullptr if all of them are.
+	///			Compares 64 bytes per iteration with SSE2 (8 at a time on other targets).
+	const unsigned char * find_pattern_mismatch(const void * mem, size_type n, DebugPattern pattern);
+
+	/// \brief	Reports the first byte that is not the pattern to the corruption callback, false if there is any.
+	///			Always true when the patterns are not enabled (see debug_patterns_enabled).
+	bool verify_pattern(const void * allocator, const void * mem, size_type n, DebugPattern pattern);
+	/// \brief	Free memory of the allocators is ACQUIRED if it was never used and DEALLOCATED otherwise,
+	///			all of it needs to have the pattern of its first byte.
+	bool verify_free_pattern(const void * allocator, const void * mem, size_type n);
+
+	namespace impl
+	{
+		/// \brief	Fills of freed memory that are delayed and done in batches. The allocators cancel the ones
+		///			of the memory they give again to the user, so memory that is reused soon is never filled.
+		///			The corruptions that happen before the fill are not detected.
+		class DeferredFills
+		{
+		public:
+			static constexpr size_type CAPACITY = 64;
+
+			/// \brief	Flushes the batch when it is full.
+			void add(void * mem, size_type n, DebugPattern pattern);
+			/// \brief	Removes the memory from the pending fills, true if any of it was pending.
+			bool cancel(const void * mem, size_type n);
+			void flush();
+			/// \brief	Forgets the pending fills without doing them (i.e. the memory is being released).
+			void clear() { m_count = 0; }
+
+			bool empty() const { return m_count == 0; }
+			size_type pending() const { return m_count; }
+
+		private:
+			struct Fill
+			{
+				unsigned char * m_mem;
+				size_type m_bytes;
+				DebugPattern m_pattern;
+			};
+
+			Fill m_fills[CAPACITY];
+			size_type m_count{ 0u };
+		};
+	}
+}
@@ -9,6 +9,7 @@ found in the top-level directory of this distribution.
 #pragma once
 
 #include "MemoryCore.h"
+#include "AllocatorAnalytics.h"
 
 namespace memory
 {
@@ -69,19 +70,95 @@ namespace memory
 			}
 		}
 
+		/// \brief	Grows or shrinks the allocation in place with the allocator that owns it.
+		bool expand(value_type * mem, size_type old_n, size_type new_n)
+		{
+			if (Primary::owns(mem))	return Primary::expand(mem, old_n, new_n);
+
+			MEMORY_ASSERT(Fallback::owns(mem));
+			return Fallback::expand(mem, old_n, new_n);
+		}
+
+		/// \brief	The allocator that owns the memory reallocates it (in place if it can), the objects are
+		///			only moved to the other allocator when it can't. Both allocators need to provide reallocate.
+		///			Returns nullptr if none of them has room, mem is still valid then.
+		value_type * reallocate(value_type * mem, size_type old_n, size_type new_n)
+		{
+			if (Primary::owns(mem))
+			{
+				if (auto * result = Primary::reallocate(mem, old_n, new_n))	return result;
+
+				auto * result = Fallback::allocate(new_n);
+				if (result == nullptr)	return nullptr;
+				copy_objects(result, mem, old_n < new_n ? old_n : new_n);
+				Primary::deallocate(mem, old_n);
+				return result;
+			}
+
+			MEMORY_ASSERT(Fallback::owns(mem));
+			if (auto * result = Fallback::reallocate(mem, old_n, new_n))	return result;
+
+			auto * result = Primary::allocate(new_n);
+			if (result == nullptr)	return nullptr;
+			copy_objects(result, mem, old_n < new_n ? old_n : new_n);
+			Fallback::deallocate(mem, old_n);
+			return result;
+		}
+
+		/// \brief	Allocates n single objects, the ones Primary can't allocate are allocated by Fallback.
+		///			Both allocators need to provide allocate_bulk, returns how many were allocated.
+		size_type allocate_bulk(value_type ** out, size_type n)
+		{
+			const size_type allocated = Primary::allocate_bulk(out, n);
+			if (allocated == n)	return n;
+			return allocated + Fallback::allocate_bulk(out + allocated, n - allocated);
+		}
+
+		/// \brief	Consecutive objects of the same allocator are deallocated together.
+		void deallocate_bulk(value_type ** in, size_type n)
+		{
+			size_type start = 0;
+			while (start < n)
+			{
+				const bool primary_owned = Primary::owns(in[start]);
+				size_type end = start + 1;
+				while (end < n && Primary::owns(in[end]) == primary_owned)
+					++end;
+
+				if (primary_owned)
+					Primary::deallocate_bulk(in + start, end - start);
+				else
+					Fallback::deallocate_bulk(in + start, end - start);
+				start = end;
+			}
+		}
+
 		bool owns(const value_type * mem) const
 		{
 			return Primary::owns(mem) || Fallback::owns(mem);
 		}
 
 		bool is_full() const { return Primary::is_full() && Fallback::is_full(); }
+		/// \brief	Memory of both allocators, saturates when one of them is unbounded (i.e. GlobalAllocator).
 		size_type free_size() const
 		{
 			const auto p = Primary::free_size();
 			const auto f = Fallback::free_size();
-			return p > f ? p : f;
+			return p + f < p ? ~size_type{ 0u } : p + f;
+		}
+		/// \brief	Both allocators need to provide analytics (i.e. the debug ones).
+		AllocatorAnalytics get_analytics() const
+		{
+			auto analytics = Primary::get_analytics();
+			analytics += Fallback::get_analytics();
+			return analytics;
 		}
 
+	private:
+		static void copy_objects(value_type * dst, const value_type * src, size_type n)
+		{
+			std::memcpy(static_cast<void *>(dst), static_cast<const void *>(src), n * sizeof(value_type));
+		}
 	};
 	
 	/// \brief	Helper to rebind both input allocators to allocators of T.
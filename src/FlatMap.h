@@ -0,0 +1,120 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "GlobalAllocator.h"
+#include "SmallVector.h"
+
+#include <functional>	// std::less
+#include <utility>		// std::pair, std::move, std::forward
+
+namespace memory
+{
+	/// \brief	Map that keeps its pairs sorted by key in a SmallVector, the first N of them inside the map and
+	///			the rest in memory of Fallback (an allocator of the pairs with the interface of the GlobalAllocator).
+	///			Lookups are binary searches over contiguous memory, inserting and erasing move the pairs that
+	///			follow, so it suits maps that are read much more than they are modified.
+	///			The keys of the pairs must not be modified.
+	template <typename K,
+			  typename V,
+			  size_type N = 8,
+			  typename Compare = std::less<K>,
+			  typename Fallback = DefaultGlobalAllocator<std::pair<K, V>>>
+	class FlatMap
+		: private Compare
+	{
+		using Storage = SmallVector<std::pair<K, V>, N, Fallback>;
+
+	public:
+		using value_type = std::pair<K, V>;
+		using iterator = typename Storage::iterator;
+		using const_iterator = typename Storage::const_iterator;
+
+		FlatMap() = default;
+
+		/// \brief	Constructs the value with args if the key is not in the map.
+		///			Returns the pair of the key and true if it was inserted.
+		template <typename... Args>
+		std::pair<iterator, bool> emplace(const K & key, Args &&... args)
+		{
+			auto it = lower_bound(key);
+			if (it != end() && !less(key, it->first))
+				return { it, false };
+
+			// the keys usually come in order, appending doesn't need to move the pairs
+			if (it == end())
+			{
+				m_pairs.emplace_back(key, V(std::forward<Args>(args)...));
+				return { end() - 1, true };
+			}
+			return { m_pairs.insert(it, value_type(key, V(std::forward<Args>(args)...))), true };
+		}
+		V & operator[](const K & key) { return emplace(key).first->second; }
+
+		/// \brief	First pair whose key is not less than key.
+		iterator lower_bound(const K & key)
+		{
+			auto first = begin();
+			auto count = size();
+			while (count > 0)
+			{
+				const auto half = count / 2;
+				if (less(first[half].first, key))
+				{
+					first += half + 1;
+					count -= half + 1;
+				}
+				else
+					count = half;
+			}
+			return first;
+		}
+		const_iterator lower_bound(const K & key) const { return const_cast<FlatMap *>(this)->lower_bound(key); }
+
+		iterator find(const K & key)
+		{
+			auto it = lower_bound(key);
+			return it != end() && !less(key, it->first) ? it : end();
+		}
+		const_iterator find(const K & key) const { return const_cast<FlatMap *>(this)->find(key); }
+		bool contains(const K & key) const { return find(key) != end(); }
+
+		/// \brief	Returns the pair after pos.
+		iterator erase(const_iterator pos) { return m_pairs.erase(pos); }
+		/// \brief	Returns false if the key was not in the map.
+		bool erase(const K & key)
+		{
+			auto it = find(key);
+			if (it == end())	return false;
+
+			m_pairs.erase(it);
+			return true;
+		}
+
+		void reserve(size_type n) { m_pairs.reserve(n); }
+		void clear() { m_pairs.clear(); }
+		void shrink_to_fit() { m_pairs.shrink_to_fit(); }
+
+		iterator begin() { return m_pairs.begin(); }
+		iterator end() { return m_pairs.end(); }
+		const_iterator begin() const { return m_pairs.begin(); }
+		const_iterator end() const { return m_pairs.end(); }
+
+		size_type size() const { return m_pairs.size(); }
+		bool empty() const { return m_pairs.empty(); }
+		/// \brief	True while the pairs are in the buffer of the map.
+		bool is_inline() const { return m_pairs.is_inline(); }
+
+	private:
+		bool less(const K & lhs, const K & rhs) const { return Compare::operator()(lhs, rhs); }
+
+		Storage m_pairs;
+	};
+}
@@ -9,7 +9,9 @@ found in the top-level directory of this distribution.
 #pragma once
 
 #include "MemoryCore.h"
+#include "AllocatorAnalytics.h"
 #include "FallbackAllocator.h"
+#include "AllocationTrace.h"
 
 namespace memory
 {
@@ -29,17 +31,55 @@ namespace memory
 
 		static T * allocate(size_type n)
 		{
-			return reinterpret_cast<T *>(global_alloc(n * sizeof(T)));
+			auto * result = reinterpret_cast<T *>(global_alloc(n * sizeof(T)));
+			trace_allocation(nullptr, result, n * sizeof(T), alignof(T));
+			return result;
 		}
-		static void deallocate(T * mem, size_type = 1)
+		static void deallocate(T * mem, size_type n = 1)
 		{
+			trace_deallocation(nullptr, mem, n * sizeof(T), alignof(T));
 			return global_dealloc(reinterpret_cast<void *>(mem));
 		}
 
+		/// \brief	The size of the memory given by the system is not known, it can only shrink.
+		static bool expand(T * mem, size_type old_n, size_type new_n)
+		{
+			if (new_n > old_n)	return false;
+
+			trace_deallocation(nullptr, mem, old_n * sizeof(T), alignof(T));
+			trace_allocation(nullptr, mem, new_n * sizeof(T), alignof(T));
+			return true;
+		}
+		static T * reallocate(T * mem, size_type old_n, size_type new_n)
+		{
+			if (expand(mem, old_n, new_n))	return mem;
+
+			// mem is still valid when there is no memory for the copy
+			auto * result = allocate(new_n);
+			if (result == nullptr)	return nullptr;
+			std::memcpy(static_cast<void *>(result), static_cast<const void *>(mem), old_n * sizeof(T));
+			deallocate(mem, old_n);
+			return result;
+		}
+
+		static size_type allocate_bulk(T ** out, size_type n)
+		{
+			for (size_type i = 0; i < n; ++i)
+				out[i] = allocate(1);
+			return n;
+		}
+		static void deallocate_bulk(T ** in, size_type n)
+		{
+			for (size_type i = 0; i < n; ++i)
+				deallocate(in[i]);
+		}
+
 		// assume we own all memory and that we won't allocate more memory than the one the system can handle
 		static bool owns(const T * p) { return p != nullptr; }
 		static bool is_full() { return false; }
-		static size_type free_size() { return ~0ul; }
+		static size_type free_size() { return ~size_type{ 0u }; }
+		/// \brief	The memory of the system is not tracked, so that it can be used as a fallback.
+		static AllocatorAnalytics get_analytics() { return AllocatorAnalytics{}; }
 	};
 
 #if MEMORY_DEBUG_ENABLED
@@ -61,21 +101,59 @@ namespace memory
 		static T * allocate(size_type n)
 		{
 			auto * result = reinterpret_cast<T *>(global_alloc(n * sizeof(T)));
+			trace_allocation(nullptr, result, n * sizeof(T), alignof(T));
 			fill_with_pattern(DebugPattern::ALLOCATED, result, n * sizeof(T));
 			return result;
 		}
 		static void deallocate(T * mem, size_type n = 1)
 		{
+			trace_deallocation(nullptr, mem, n * sizeof(T), alignof(T));
 			fill_with_pattern(DebugPattern::DEALLOCATED, mem, n * sizeof(T));
 			global_dealloc(reinterpret_cast<void *>(mem));
 		}
 
+		/// \brief	The size of the memory given by the system is not known, it can only shrink.
+		static bool expand(T * mem, size_type old_n, size_type new_n)
+		{
+			if (new_n > old_n)	return false;
+
+			trace_deallocation(nullptr, mem, old_n * sizeof(T), alignof(T));
+			trace_allocation(nullptr, mem, new_n * sizeof(T), alignof(T));
+			fill_with_pattern(DebugPattern::DEALLOCATED, mem + new_n, (old_n - new_n) * sizeof(T));
+			return true;
+		}
+		static T * reallocate(T * mem, size_type old_n, size_type new_n)
+		{
+			if (expand(mem, old_n, new_n))	return mem;
+
+			// mem is still valid when there is no memory for the copy
+			auto * result = allocate(new_n);
+			if (result == nullptr)	return nullptr;
+			std::memcpy(static_cast<void *>(result), static_cast<const void *>(mem), old_n * sizeof(T));
+			deallocate(mem, old_n);
+			return result;
+		}
+
+		static size_type allocate_bulk(T ** out, size_type n)
+		{
+			for (size_type i = 0; i < n; ++i)
+				out[i] = allocate(1);
+			return n;
+		}
+		static void deallocate_bulk(T ** in, size_type n)
+		{
+			for (size_type i = 0; i < n; ++i)
+				deallocate(in[i]);
+		}
+
 		// assume we own all memory
 		static bool owns(const T * p) { return p != nullptr; }
 		// assume the application won't allocate more memory than the one the system can handle
 		static bool is_full() { return false; }
 		// assume the application won't allocate more memory than the one the system can handle
-		static size_type free_size() { return ~0ul; }
+		static size_type free_size() { return ~size_type{ 0u }; }
+		/// \brief	The memory of the system is not tracked, so that it can be used as a fallback.
+		static AllocatorAnalytics get_analytics() { return AllocatorAnalytics{}; }
 	};
 
 	template <typename T>
@@ -0,0 +1,120 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "GuardPageAllocator.h"
+
+namespace memory
+{
+	namespace impl
+	{
+		inline size_type guard_round_up(size_type n, size_type alignment)
+		{
+			return (n + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	GuardPageAllocator::GuardPageAllocator(const GuardPageConfig & config)
+		: m_config{ config }
+	{}
+	GuardPageAllocator::~GuardPageAllocator()
+	{
+		deallocate_all();
+	}
+
+	unsigned char * GuardPageAllocator::allocate(size_type bytes, size_type alignment)
+	{
+		const auto page_size = system_page_size();
+		MEMORY_ASSERT(is_power_of_two(alignment) && alignment <= page_size);
+
+		const auto size = impl::guard_round_up(bytes ? bytes : 1, alignment);
+		const auto data_bytes = impl::guard_round_up(size, page_size);
+
+		Region region;
+		region.m_bytes = data_bytes + page_size;
+		region.m_alignment = alignment;
+		region.m_size = size;
+		region.m_base = reinterpret_cast<unsigned char *>(system_map(region.m_bytes, page_size));
+		if (region.m_base == nullptr)	return nullptr;
+		m_mapped_bytes += region.m_bytes;
+
+		unsigned char * mem = nullptr;
+		if (m_config.protect_below)
+		{
+			system_protect(region.m_base, page_size, false);
+			mem = region.m_base + page_size;
+		}
+		else
+		{
+			// the end of the allocation touches the guard page
+			system_protect(region.m_base + data_bytes, page_size, false);
+			mem = region.m_base + data_bytes - size;
+		}
+
+		m_allocations.emplace(mem, region);
+		trace_allocation(this, mem, bytes, alignment);
+		return mem;
+	}
+
+	size_type GuardPageAllocator::usable_size(const unsigned char * mem) const
+	{
+		const auto it = m_allocations.find(mem);
+		MEMORY_ASSERT(it != m_allocations.end());
+		return it->second.m_size;
+	}
+
+	void GuardPageAllocator::deallocate(unsigned char * mem, size_type bytes)
+	{
+		const auto it = m_allocations.find(mem);
+		MEMORY_ASSERT(it != m_allocations.end());
+		trace_deallocation(this, mem, bytes, it->second.m_alignment);
+
+		const auto region = it->second;
+		m_allocations.erase(it);
+
+		// any access to the memory faults from now on
+		if (m_config.quarantine == 0)
+		{
+			unmap(region);
+			return;
+		}
+
+		system_protect(region.m_base, region.m_bytes, false);
+		m_quarantine.push_back(region);
+		if (m_quarantine.size() > m_config.quarantine)
+		{
+			unmap(m_quarantine.front());
+			m_quarantine.pop_front();
+		}
+	}
+
+	void GuardPageAllocator::deallocate_all()
+	{
+		for (const auto & allocation : m_allocations)
+			unmap(allocation.second);
+		for (const auto & region : m_quarantine)
+			unmap(region);
+
+		m_allocations.clear();
+		m_quarantine.clear();
+	}
+
+	bool GuardPageAllocator::should_guard()
+	{
+		if (m_config.sample_rate == 0)	return false;
+
+		if (++m_sample_counter < m_config.sample_rate)	return false;
+		m_sample_counter = 0;
+		return true;
+	}
+
+	void GuardPageAllocator::unmap(const Region & region)
+	{
+		system_unmap(region.m_base, region.m_bytes);
+		m_mapped_bytes -= region.m_bytes;
+	}
+}
@@ -0,0 +1,155 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "AllocationTrace.h"
+
+#include <cstddef>	// std::max_align_t
+#include <cstring>	// std::memcpy
+#include <deque>
+#include <unordered_map>
+#include <utility>	// std::forward
+
+namespace memory
+{
+	struct GuardPageConfig
+	{
+		/// \brief	1 in sample_rate allocations is guarded (1 guards all of them, 0 none of them).
+		size_type sample_rate{ 1u };
+		/// \brief	Puts the guard page before the allocations to catch underruns instead of overruns.
+		bool protect_below{ false };
+		/// \brief	Freed allocations stay inaccessible until this many more are freed, to catch uses after free.
+		size_type quarantine{ 0u };
+	};
+
+	/// \brief	Electric fence style allocator: every allocation gets its own pages mapped from the system
+	///			and is placed right against an inaccessible guard page, so an overrun (or an underrun with
+	///			protect_below) faults on the instruction that does it instead of corrupting memory.
+	///			The end of the allocation is only rounded up to its alignment, use 1 to catch any overrun.
+	///			Deallocated memory is made inaccessible too.
+	///			Each allocation takes at least two pages, the debug allocators and GuardedAllocator use
+	///			should_guard to only guard some of their allocations.
+	class GuardPageAllocator
+	{
+	public:
+		explicit GuardPageAllocator(const GuardPageConfig & config = GuardPageConfig{});
+		~GuardPageAllocator();
+
+		GuardPageAllocator(const GuardPageAllocator &) = delete;
+		GuardPageAllocator & operator=(const GuardPageAllocator &) = delete;
+
+		/// \brief	Every call is guarded. alignment needs to be a power of two up to the page size.
+		///			Returns nullptr if the pages can't be mapped.
+		unsigned char * allocate(size_type bytes, size_type alignment = alignof(std::max_align_t));
+		void deallocate(unsigned char * mem, size_type bytes);
+		/// \brief	Releases all the allocations and the quarantine.
+		void deallocate_all();
+
+		bool owns(const unsigned char * mem) const { return m_allocations.count(mem) != 0; }
+		/// \brief	The bytes requested rounded up to the alignment.
+		size_type usable_size(const unsigned char * mem) const;
+
+		/// \brief	True once every sample_rate calls, tells if the next allocation should be guarded.
+		bool should_guard();
+
+		size_type guarded_allocations() const { return m_allocations.size(); }
+		/// \brief	Bytes mapped for the live and the quarantined allocations, including the guard pages.
+		size_type mapped_bytes() const { return m_mapped_bytes; }
+		const GuardPageConfig & get_config() const { return m_config; }
+
+	private:
+		struct Region
+		{
+			unsigned char * m_base;
+			size_type m_bytes;
+			size_type m_alignment;
+			size_type m_size;
+		};
+
+		void unmap(const Region & region);
+
+		GuardPageConfig m_config;
+		std::unordered_map<const unsigned char *, Region> m_allocations;
+		std::deque<Region> m_quarantine;
+		size_type m_mapped_bytes{ 0u };
+		size_type m_sample_counter{ 0u };
+	};
+
+	/// \brief	Guards 1 in sample_rate allocations of Alloc, an allocator of bytes with the interface
+	///			of the StackAllocator (i.e. GuardedAllocator<TlsfAllocator>), cheap enough to be left on
+	///			in release builds. The guarded allocations never reach Alloc, they are aligned to
+	///			std::max_align_t (which covers the alignment of the allocators of the library) and are
+	///			moved to a new allocation when they are reallocated.
+	template <typename Alloc>
+	class GuardedAllocator
+		: public Alloc
+	{
+	public:
+		/// \brief	Alignment of the guarded allocations.
+		static constexpr size_type GUARD_ALIGNMENT = alignof(std::max_align_t);
+
+		template <typename ... Args>
+		explicit GuardedAllocator(const GuardPageConfig & config, Args && ... args)
+			: Alloc( std::forward<Args>(args)... )
+			, m_guard{ config }
+		{}
+
+		unsigned char * allocate(size_type bytes)
+		{
+			if (m_guard.should_guard())
+			{
+				if (auto * mem = m_guard.allocate(bytes, GUARD_ALIGNMENT))
+					return mem;
+			}
+			return Alloc::allocate(bytes);
+		}
+		void deallocate(unsigned char * mem, size_type bytes)
+		{
+			if (m_guard.owns(mem))
+				m_guard.deallocate(mem, bytes);
+			else
+				Alloc::deallocate(mem, bytes);
+		}
+		/// \brief	The guarded allocations are against the guard page, they can't be resized in place.
+		bool expand(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+		{
+			if (m_guard.owns(mem))	return false;
+			return Alloc::expand(mem, old_bytes, new_bytes);
+		}
+		/// \brief	Returns nullptr if there is no room, mem is still valid then.
+		unsigned char * reallocate(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+		{
+			if (!m_guard.owns(mem))	return Alloc::reallocate(mem, old_bytes, new_bytes);
+
+			auto * result = allocate(new_bytes);
+			if (result == nullptr)	return nullptr;
+
+			std::memcpy(result, mem, old_bytes < new_bytes ? old_bytes : new_bytes);
+			m_guard.deallocate(mem, old_bytes);
+			return result;
+		}
+		size_type usable_size(const unsigned char * mem) const
+		{
+			if (m_guard.owns(mem))	return m_guard.usable_size(mem);
+			return Alloc::usable_size(mem);
+		}
+
+		bool owns(unsigned char * mem) const { return m_guard.owns(mem) || Alloc::owns(mem); }
+
+		GuardPageAllocator & get_guard() { return m_guard; }
+		const GuardPageAllocator & get_guard() const { return m_guard; }
+
+	private:
+		GuardPageAllocator m_guard;
+	};
+
+	template <typename Alloc>
+	constexpr size_type GuardedAllocator<Alloc>::GUARD_ALIGNMENT;
+}
@@ -0,0 +1,222 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "PageAllocator.h"
+
+#include <cstdint>
+#include <memory>		// std::unique_ptr
+#include <new>			// placement new
+#include <utility>		// std::forward, std::move
+#include <vector>
+
+namespace memory
+{
+	/// \brief	Identifies an object of a HandlePool: the index of its slot and the generation of the slot
+	///			when the object was created. The value 0 is never a valid handle.
+	template <typename Int, size_type INDEX_BITS>
+	struct Handle
+	{
+		static_assert(INDEX_BITS < sizeof(Int) * 8, "The handle needs bits for the generation.");
+
+		using value_type = Int;
+		static constexpr size_type index_bits = INDEX_BITS;
+		static constexpr size_type generation_bits = sizeof(Int) * 8 - INDEX_BITS;
+		static constexpr Int max_index = (Int{ 1u } << INDEX_BITS) - 1;
+		static constexpr Int max_generation = static_cast<Int>(static_cast<Int>(~Int{ 0u }) >> INDEX_BITS);
+
+		static Handle make(Int index, Int generation)
+		{
+			MEMORY_ASSERT(index <= max_index && generation <= max_generation);
+			return Handle{ static_cast<Int>((generation << INDEX_BITS) | index) };
+		}
+
+		Int index() const { return m_value & max_index; }
+		Int generation() const { return m_value >> INDEX_BITS; }
+		bool is_null() const { return m_value == 0; }
+
+		bool operator==(const Handle & other) const { return m_value == other.m_value; }
+		bool operator!=(const Handle & other) const { return m_value != other.m_value; }
+
+		Int m_value{ 0u };
+	};
+
+	/// \brief	~1M objects alive at once, a slot can be reused 4095 times.
+	using Handle32 = Handle<std::uint32_t, 20>;
+	using Handle64 = Handle<std::uint64_t, 32>;
+
+	/// \brief	Creates objects in the pages of a PageAllocator and gives handles to them instead of pointers.
+	///			The handles are resolved in O(1) through a table of slots that stores the object and the
+	///			current generation of the slot, handles of destroyed objects are detected on every build.
+	///			As the users only keep handles the objects can be moved, compact() packs them in new pages.
+	///			PageAlloc can be PageAllocator or DebugPageAllocator.
+	template <typename T, typename HandleT = Handle32, typename PageAlloc = PageAllocator>
+	class HandlePool
+	{
+		using Int = typename HandleT::value_type;
+
+		struct Slot
+		{
+			T * m_object;
+			Int m_generation;
+			/// \brief	Next slot of the free list while the slot is free.
+			Int m_next_free;
+		};
+
+		/// \brief	The free list of slots ends with this index.
+		static constexpr Int NO_SLOT = HandleT::max_index;
+
+		static_assert(alignof(T) <= alignof(void *), "PageAllocator only aligns the objects to pointers.");
+
+	public:
+		using handle_type = HandleT;
+
+		/// \brief	The number of objects is limited by the bits of the index (one index is reserved).
+		static constexpr size_type max_objects = HandleT::max_index;
+
+		explicit HandlePool(size_type objects_per_page = 64)
+			: m_objects{ new PageAlloc{ sizeof(T), objects_per_page, false } }
+		{}
+		~HandlePool()
+		{
+			destroy_all();
+		}
+
+		HandlePool(const HandlePool &) = delete;
+		HandlePool & operator=(const HandlePool &) = delete;
+
+		/// \brief	Returns a null handle when all the indices are used.
+		template <typename... Args>
+		handle_type create(Args &&... args)
+		{
+			const bool new_slot = m_free_slots == NO_SLOT;
+			if (new_slot && m_slots.size() >= max_objects)	return handle_type{};
+
+			auto * mem = m_objects->allocate();
+			try
+			{
+				new (mem) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				m_objects->deallocate(mem);
+				throw;
+			}
+
+			Int index = m_free_slots;
+			if (new_slot)
+			{
+				index = static_cast<Int>(m_slots.size());
+				m_slots.push_back(Slot{ nullptr, 1u, NO_SLOT });
+			}
+			else
+				m_free_slots = m_slots[index].m_next_free;
+
+			auto & slot = m_slots[index];
+			slot.m_object = reinterpret_cast<T *>(mem);
+			m_live_objects++;
+
+			return handle_type::make(index, slot.m_generation);
+		}
+
+		/// \brief	Returns false if the handle does not identify a live object.
+		bool destroy(handle_type handle)
+		{
+			auto * obj = get(handle);
+			if (obj == nullptr)	return false;
+
+			obj->~T();
+			m_objects->deallocate(obj);
+			m_live_objects--;
+
+			auto & slot = m_slots[handle.index()];
+			slot.m_object = nullptr;
+
+			// slots that used all the generations are not used again, their handles could be repeated
+			if (slot.m_generation == HandleT::max_generation)
+				return true;
+
+			slot.m_generation++;
+			slot.m_next_free = m_free_slots;
+			m_free_slots = handle.index();
+			return true;
+		}
+
+		/// \brief	nullptr if the object of the handle has been destroyed.
+		T * get(handle_type handle) const
+		{
+			const auto index = handle.index();
+			if (index >= m_slots.size())	return nullptr;
+
+			const auto & slot = m_slots[index];
+			return slot.m_generation == handle.generation() ? slot.m_object : nullptr;
+		}
+		bool is_valid(handle_type handle) const { return get(handle) != nullptr; }
+
+		size_type live_objects() const { return m_live_objects; }
+		size_type allocated_pages() const { return m_objects->allocated_pages(); }
+
+		/// \brief	Calls f(handle, object) with every live object in the order of the slots.
+		template <typename F>
+		void for_each(F && f)
+		{
+			for (size_type i = 0; i < m_slots.size(); ++i)
+			{
+				auto & slot = m_slots[i];
+				if (slot.m_object)
+					f(handle_type::make(static_cast<Int>(i), slot.m_generation), *slot.m_object);
+			}
+		}
+
+		void destroy_all()
+		{
+			for (size_type i = 0; i < m_slots.size(); ++i)
+			{
+				auto & slot = m_slots[i];
+				if (slot.m_object)
+					destroy(handle_type::make(static_cast<Int>(i), slot.m_generation));
+			}
+		}
+
+		/// \brief	Moves the live objects to new pages in the order of their slots and releases the old pages.
+		///			The handles remain valid, the pointers to the objects don't.
+		void compact()
+		{
+			std::unique_ptr<PageAlloc> compacted{ new PageAlloc{ m_objects->get_obj_size(), m_objects->get_per_page_obj_num(), false } };
+
+			// the objects of the new pages are allocated contiguously
+			std::vector<void *> mem(m_live_objects);
+			if (m_live_objects)
+				compacted->allocate_bulk(mem.data(), m_live_objects);
+
+			size_type next = 0;
+			for (auto & slot : m_slots)
+			{
+				if (slot.m_object == nullptr)	continue;
+
+				auto * moved = new (mem[next++]) T(std::move(*slot.m_object));
+				slot.m_object->~T();
+				m_objects->deallocate(slot.m_object);
+				slot.m_object = moved;
+			}
+
+			m_objects = std::move(compacted);
+		}
+
+		/// \brief	Underlying allocator, i.e. to read the statistics of DebugPageAllocator.
+		const PageAlloc & get_page_allocator() const { return *m_objects; }
+
+	private:
+		std::unique_ptr<PageAlloc> m_objects;
+		std::vector<Slot> m_slots;
+		Int m_free_slots{ NO_SLOT };
+		size_type m_live_objects{ 0u };
+	};
+}
@@ -6,21 +6,248 @@ This file is subject to the license terms in the LICENSE file
 found in the top-level directory of this distribution.
 */
 
+// the stats are built even without the debug allocators, the code that uses them can enable them on its own
+#ifndef DEBUG_INLINE_ALLOCATOR_ENABLED
+#define DEBUG_INLINE_ALLOCATOR_ENABLED 1
+#endif
 #include "InlineAllocator.h"
 
 
 #if DEBUG_INLINE_ALLOCATOR_ENABLED
 
+#include <cmath>
+#include <mutex>
+
+namespace memory
+{
+	constexpr size_type DebugInlineAllocatorStats::PEAK_HISTOGRAM_SIZE;
+	constexpr size_type DebugInlineAllocatorStats::SHARD_NUM;
+
+	namespace impl
+	{
+		// the stats are function local statics, they may be constructed from any thread
+		static std::mutex & inline_stats_mutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+		static DebugInlineAllocatorStats * s_first_inline_stats = nullptr;
+
+		// the rebound stats are created while other stats may be registering
+		static std::mutex & rebound_stats_mutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		static void write_json_string(std::ostream & os, const char * str)
+		{
+			os << '"';
+			for (; *str; ++str)
+			{
+				if (*str == '"' || *str == '\\')
+					os << '\\';
+				os << *str;
+			}
+			os << '"';
+		}
+	}
+
+	DebugInlineAllocatorStats::DebugInlineAllocatorStats(const char * file, long l,
+														 const char * name, size_type size,
+														 size_type inline_obj_num,
+														 const std::type_info * obj_type)
+		: type_name{ name }
+		, filename{ file }
+		, line{ l }
+		, inline_object_num{ inline_obj_num }
+		, object_size{ size }
+		, object_type{ obj_type }
+	{
+		std::lock_guard<std::mutex> lock{ impl::inline_stats_mutex() };
+		m_next = impl::s_first_inline_stats;
+		if (m_next)
+			m_next->m_prev = this;
+		impl::s_first_inline_stats = this;
+	}
+	DebugInlineAllocatorStats::~DebugInlineAllocatorStats()
+	{
+		while (auto * rebound = m_first_rebound)
+		{
+			m_first_rebound = rebound->m_next_rebound;
+			delete rebound;
+		}
+
+		std::lock_guard<std::mutex> lock{ impl::inline_stats_mutex() };
+		if (m_prev)
+			m_prev->m_next = m_next;
+		else
+			impl::s_first_inline_stats = m_next;
+		if (m_next)
+			m_next->m_prev = m_prev;
+	}
+
+	DebugInlineAllocatorStats & DebugInlineAllocatorStats::get_rebound(const std::type_info & type, size_type size)
+	{
+		auto * site = m_site ? m_site : this;
+		const auto is_type = [&](const DebugInlineAllocatorStats & stats)
+		{
+			return stats.object_type != nullptr && *stats.object_type == type;
+		};
+		if (is_type(*site))	return *site;
+
+		std::lock_guard<std::mutex> lock{ impl::rebound_stats_mutex() };
+		for (auto * rebound = site->m_first_rebound; rebound != nullptr; rebound = rebound->m_next_rebound)
+		{
+			if (is_type(*rebound))
+				return *rebound;
+		}
+
+		auto * rebound = new DebugInlineAllocatorStats{ site->filename, site->line, type.name(), size, site->inline_object_num, &type };
+		rebound->m_site = site;
+		rebound->m_next_rebound = site->m_first_rebound;
+		site->m_first_rebound = rebound;
+		return *rebound;
+	}
+
+	void DebugInlineAllocatorStats::Counters::add_use_peak(size_type peak_objects)
+	{
+		peak_histogram[peak_objects < PEAK_HISTOGRAM_SIZE ? peak_objects : PEAK_HISTOGRAM_SIZE - 1]++;
+		if (peak_objects > max_peak_objects)
+			max_peak_objects = peak_objects;
+	}
+
+	DebugInlineAllocatorStats::Counters & DebugInlineAllocatorStats::Counters::operator+=(const Counters & other)
+	{
+		use_num += other.use_num;
+		uses_implying_non_inline_allocs += other.uses_implying_non_inline_allocs;
+		allocation_num += other.allocation_num;
+		non_inline_allocs += other.non_inline_allocs;
+		total_alloc_objects += other.total_alloc_objects;
+		for (size_type i = 0; i < PEAK_HISTOGRAM_SIZE; ++i)
+			peak_histogram[i] += other.peak_histogram[i];
+		if (other.max_peak_objects > max_peak_objects)
+			max_peak_objects = other.max_peak_objects;
+		return *this;
+	}
+
+	void DebugInlineAllocatorStats::add_use(const Counters & use)
+	{
+		// consecutive thread ids, the threads that run at the same time get different shards
+		auto & shard = m_shards[current_thread_id() % SHARD_NUM];
+		std::lock_guard<std::mutex> lock{ shard.m_mutex };
+		shard.m_counters += use;
+	}
+
+	void DebugInlineAllocatorStats::add_use_peak(size_type peak_objects)
+	{
+		Counters use;
+		use.use_num = 1;
+		use.add_use_peak(peak_objects);
+		add_use(use);
+	}
+
+	DebugInlineAllocatorStats::Counters DebugInlineAllocatorStats::get_counters() const
+	{
+		Counters counters;
+		for (const auto & shard : m_shards)
+		{
+			std::lock_guard<std::mutex> lock{ shard.m_mutex };
+			counters += shard.m_counters;
+		}
+		return counters;
+	}
+
+	float DebugInlineAllocatorStats::inline_hit_rate(size_type n) const
+	{
+		const auto counters = get_counters();
+		const auto uses = counters.use_num;
+		if (uses == 0)	return 1.f;
+
+		// the last bucket only fits if all the peaks do
+		size_type hits = 0;
+		for (size_type i = 0; i < PEAK_HISTOGRAM_SIZE - 1 && i <= n; ++i)
+			hits += counters.peak_histogram[i];
+		if (n >= counters.max_peak_objects)
+			hits = uses;
+		return static_cast<float>(hits) / uses;
+	}
+
+	size_type DebugInlineAllocatorStats::recommended_inline_objects(float target_hit_rate) const
+	{
+		const auto counters = get_counters();
+		const auto uses = counters.use_num;
+		if (uses == 0)	return inline_object_num;
+
+		const auto needed = static_cast<size_type>(std::ceil(target_hit_rate * uses));
+		size_type hits = 0;
+		for (size_type i = 0; i < PEAK_HISTOGRAM_SIZE - 1; ++i)
+		{
+			hits += counters.peak_histogram[i];
+			if (hits >= needed)
+				return i ? i : 1;
+		}
+		return counters.max_peak_objects;
+	}
+
+	void for_each_inline_allocator_stats(const std::function<void(const DebugInlineAllocatorStats &)> & f)
+	{
+		std::lock_guard<std::mutex> lock{ impl::inline_stats_mutex() };
+		for (auto * stats = impl::s_first_inline_stats; stats != nullptr; stats = stats->m_next)
+			f(*stats);
+	}
+
+	void write_inline_allocator_report(std::ostream & os, float target_hit_rate)
+	{
+		bool first = true;
+		os << "[\n";
+		for_each_inline_allocator_stats([&](const DebugInlineAllocatorStats & stats)
+		{
+			const auto counters = stats.get_counters();
+			const auto recommended = stats.recommended_inline_objects(target_hit_rate);
+
+			os << (first ? "" : ",\n") << "  { \"file\": ";
+			impl::write_json_string(os, stats.filename);
+			os << ", \"line\": " << stats.line << ", \"type\": ";
+			impl::write_json_string(os, stats.type_name);
+			os << ", \"object_size\": " << stats.object_size
+				<< ", \"inline_objects\": " << stats.inline_object_num
+				<< ", \"uses\": " << counters.use_num
+				<< ", \"non_inline_uses\": " << counters.uses_implying_non_inline_allocs
+				<< ", \"inline_hit_rate\": " << stats.inline_hit_rate(stats.inline_object_num)
+				<< ", \"max_peak_objects\": " << counters.max_peak_objects
+				<< ", \"peak_histogram\": [";
+
+			// only the peaks that happened, as [objects, uses]
+			bool first_peak = true;
+			for (size_type i = 0; i < DebugInlineAllocatorStats::PEAK_HISTOGRAM_SIZE; ++i)
+			{
+				if (counters.peak_histogram[i] == 0)	continue;
+				os << (first_peak ? "" : ", ") << '[' << i << ", " << counters.peak_histogram[i] << ']';
+				first_peak = false;
+			}
+
+			os << "], \"target_hit_rate\": " << target_hit_rate
+				<< ", \"recommended_inline_objects\": " << recommended
+				<< ", \"recommended_inline_bytes\": " << recommended * stats.object_size
+				<< " }";
+			first = false;
+		});
+		os << (first ? "" : "\n") << "]\n";
+	}
+}
+
 std::ostream & operator<< (std::ostream & os, const ::memory::DebugInlineAllocatorStats & stats)
 {
+	const auto counters = stats.get_counters();
 	os << stats.filename << "[" << stats.line << "]: " << stats.type_name << '\n'
 		<< "    Object size: " << stats.object_size
 		<< ", Inlined Objects: " << stats.inline_object_num << "[#" << stats.object_size * stats.inline_object_num << " bytes]"
-		<< ", Allocs: " << stats.allocation_num
-		<< ", Uses: " << stats.use_num
+		<< ", Allocs: " << counters.allocation_num
+		<< ", Uses: " << counters.use_num
 		<< ", Average Size: " << stats.average_objects()
-		<< ", Non inline alloc uses: " << stats.uses_implying_non_inline_allocs << " [" << stats.non_inline_alloc_use_percentage() << "%]"
-		<< ", Non inline allocs: " << stats.non_inline_allocs << " [" << stats.non_inline_alloc_percentage() << "%]";
+		<< ", Non inline alloc uses: " << counters.uses_implying_non_inline_allocs << " [" << stats.non_inline_alloc_use_percentage() << "%]"
+		<< ", Non inline allocs: " << counters.non_inline_allocs << " [" << stats.non_inline_alloc_percentage() << "%]";
 	return os;
 }
 
@@ -9,10 +9,15 @@ found in the top-level directory of this distribution.
 #pragma once
 
 #include "MemoryCore.h"
+#include "AllocatorAnalytics.h"
 #include "FallbackAllocator.h"
 #include "GlobalAllocator.h"
+#include "AllocationTrace.h"
 
 #include <bitset>
+#include <functional>
+#include <mutex>
+#include <typeinfo>
 
 #ifndef DEBUG_INLINE_ALLOCATOR_ENABLED 
 #define DEBUG_INLINE_ALLOCATOR_ENABLED MEMORY_DEBUG_ENABLED
@@ -59,12 +64,43 @@ namespace memory
 		static constexpr size_type total_size = object_size * object_num;
 		using value_type = T;
 
-		InlineAllocator() = default;
-		InlineAllocator(const InlineAllocator &) = default;
-		InlineAllocator(InlineAllocator &&) = default;
+		InlineAllocator()
+		{
+			poison_memory(m_memory, total_size);
+		}
+		InlineAllocator(const InlineAllocator & other)
+			: m_alloc_flags{ other.m_alloc_flags }
+		{
+			copy_objects(other);
+		}
+		/// \brief	The objects are inside the allocators, moving copies the allocated ones as the copy does.
+		InlineAllocator(InlineAllocator && other) noexcept
+			: m_alloc_flags{ other.m_alloc_flags }
+		{
+			copy_objects(other);
+		}
 		template <typename U>
-		InlineAllocator(const rebind_t<U> &) {}
-		virtual ~InlineAllocator() = default;
+		InlineAllocator(const rebind_t<U> &)
+		{
+			poison_memory(m_memory, total_size);
+		}
+		InlineAllocator & operator=(const InlineAllocator & other)
+		{
+			m_alloc_flags = other.m_alloc_flags;
+			copy_objects(other);
+			return *this;
+		}
+		InlineAllocator & operator=(InlineAllocator && other) noexcept
+		{
+			m_alloc_flags = other.m_alloc_flags;
+			copy_objects(other);
+			return *this;
+		}
+		virtual ~InlineAllocator()
+		{
+			// the memory may be reused by the stack frames that come after this one
+			unpoison_memory(m_memory, total_size);
+		}
 
 		virtual T * allocate(size_type n = 1)
 		{
@@ -72,7 +108,10 @@ namespace memory
 			if (idx < object_num)
 			{
 				set_flags(idx, n, true);
-				return reinterpret_cast<T *>(m_memory + idx * object_size);
+				auto * result = reinterpret_cast<T *>(m_memory + idx * object_size);
+				sanitizer_allocate(result, n * object_size);
+				trace_allocation(this, result, n * object_size, alignof(T));
+				return result;
 			}
 
 			return nullptr;
@@ -81,9 +120,75 @@ namespace memory
 		virtual void deallocate(T * mem, size_type n = 1)
 		{
 			MEMORY_ASSERT(owns(mem));
+			trace_deallocation(this, mem, n * object_size, alignof(T));
+			sanitizer_deallocate(mem, n * object_size);
 			set_flags(get_idx(mem), n, false);
 		}
 
+		/// \brief	Grows or shrinks the allocation of old_n objects to new_n objects without moving it,
+		///			the objects that follow it need to be free to grow. Returns false if it can't.
+		bool expand(T * mem, size_type old_n, size_type new_n)
+		{
+			MEMORY_ASSERT(owns(mem));
+			const auto idx = get_idx(mem);
+			if (new_n > old_n)
+			{
+				if (idx + new_n > object_num)	return false;
+				for (size_type i = idx + old_n; i < idx + new_n; ++i)
+				{
+					if (m_alloc_flags.test(i))
+						return false;
+				}
+				set_flags(idx + old_n, new_n - old_n, true);
+			}
+			else
+				set_flags(idx + new_n, old_n - new_n, false);
+
+			sanitizer_resize(mem, old_n * object_size, new_n * object_size);
+			trace_deallocation(this, mem, old_n * object_size, alignof(T));
+			trace_allocation(this, mem, new_n * object_size, alignof(T));
+			return true;
+		}
+
+		/// \brief	Expands the allocation in place or moves it to another block of this allocator, copying
+		///			the objects byte by byte. Returns nullptr if there is no room, mem is still valid then.
+		T * reallocate(T * mem, size_type old_n, size_type new_n)
+		{
+			if (expand(mem, old_n, new_n))	return mem;
+
+			// not the virtual ones, the derived allocators may allocate the memory somewhere else
+			auto * result = InlineAllocator::allocate(new_n);
+			if (result == nullptr)	return nullptr;
+
+			std::memcpy(result, mem, (old_n < new_n ? old_n : new_n) * object_size);
+			InlineAllocator::deallocate(mem, old_n);
+			return result;
+		}
+
+		/// \brief	Allocates up to n single objects in one pass over the flags, returns how many were allocated.
+		virtual size_type allocate_bulk(T ** out, size_type n)
+		{
+			size_type allocated = 0;
+			for (size_type i = 0; i < object_num && allocated < n; ++i)
+			{
+				if (m_alloc_flags.test(i))	continue;
+
+				m_alloc_flags.set(i);
+				auto * result = reinterpret_cast<T *>(m_memory + i * object_size);
+				sanitizer_allocate(result, object_size);
+				trace_allocation(this, result, object_size, alignof(T));
+				out[allocated++] = result;
+			}
+
+			return allocated;
+		}
+
+		virtual void deallocate_bulk(T ** in, size_type n)
+		{
+			for (size_type i = 0; i < n; ++i)
+				deallocate_single(in[i]);
+		}
+
 		bool is_full() const
 		{
 			return m_alloc_flags.all();
@@ -104,8 +209,60 @@ namespace memory
 			const auto free_objects = N - m_alloc_flags.count();
 			return free_objects * object_size;
 		}
+		/// \brief	Only the current usage is known, the high water mark is the memory in use now.
+		///			The biggest allocation is the longest run of free objects.
+		AllocatorAnalytics get_analytics() const
+		{
+			AllocatorAnalytics analytics;
+			analytics.granted_bytes = m_alloc_flags.count() * object_size;
+			analytics.requested_bytes = analytics.granted_bytes;
+			analytics.free_bytes = free_size();
+			analytics.high_water_mark = analytics.granted_bytes;
+			analytics.add_page(m_alloc_flags.count(), object_num);
+
+			size_type run = 0;
+			for (size_type i = 0; i < object_num; ++i)
+			{
+				run = m_alloc_flags.test(i) ? 0 : run + 1;
+				if (run * object_size > analytics.largest_free_block)
+					analytics.largest_free_block = run * object_size;
+			}
+			return analytics;
+		}
 		
 	private:
+		/// \brief	Copies the bytes of the runs of allocated objects, the free ones stay poisoned.
+		void copy_objects(const InlineAllocator & other)
+		{
+			for (size_type first = 0; first < object_num;)
+			{
+				const bool allocated = m_alloc_flags.test(first);
+				auto last = first + 1;
+				while (last < object_num && m_alloc_flags.test(last) == allocated)
+					++last;
+
+				const auto offset = first * object_size;
+				const auto bytes = (last - first) * object_size;
+				if (allocated)
+				{
+					unpoison_memory(m_memory + offset, bytes);
+					std::memcpy(m_memory + offset, other.m_memory + offset, bytes);
+				}
+				else
+					poison_memory(m_memory + offset, bytes);
+				first = last;
+			}
+		}
+		void deallocate_single(T * mem)
+		{
+			MEMORY_ASSERT(owns(mem));
+			trace_deallocation(this, mem, object_size, alignof(T));
+			sanitizer_deallocate(mem, object_size);
+
+			const auto idx = get_idx(mem);
+			MEMORY_ASSERT(m_alloc_flags.test(idx));
+			m_alloc_flags.reset(idx);
+		}
 		void set_flags(size_type idx, size_type n, bool flag)
 		{
 			n += idx;
@@ -162,29 +319,64 @@ namespace memory
 #if DEBUG_INLINE_ALLOCATOR_ENABLED
 
 	/// \brief	Statistics of one of an inline allocator declared in a function.
+	///			All the stats alive are registered, see for_each_inline_allocator_stats.
+	///			When the allocator is rebound to other type (i.e. by a list to its nodes) the rebound
+	///			allocator uses other stats of the same call site, see get_rebound.
+	///			The function may run on several threads: each allocator counts its use on its own and adds
+	///			it to one of the shards of the stats when it is destroyed, get_counters merges the shards.
 	struct DebugInlineAllocatorStats
 	{
-		// TODO(Borja): we need a way to access all the inline allocators of our program.
-		// TODO(Borja): Some of the data (i.e. object size and name) may not be correct if the allocator has been rebound to other type (i.e. because we used it with a list)
+		/// \brief	Peaks of PEAK_HISTOGRAM_SIZE - 1 objects or more share the last bucket.
+		static constexpr size_type PEAK_HISTOGRAM_SIZE = 64;
+		/// \brief	Threads that add their uses at the same time without waiting for each other.
+		static constexpr size_type SHARD_NUM = 8;
+
+		struct Counters
+		{
+			void add_use_peak(size_type peak_objects);
+			Counters & operator+=(const Counters & other);
+
+			size_type use_num{ 0ul };
+			size_type uses_implying_non_inline_allocs{ 0ul };
+			size_type allocation_num{ 0ul };
+			size_type non_inline_allocs{ 0ul };
+			size_type total_alloc_objects{ 0ul };
+			/// \brief	Number of uses by the maximum number of objects they had allocated at once.
+			size_type peak_histogram[PEAK_HISTOGRAM_SIZE]{};
+			size_type max_peak_objects{ 0ul };
+		};
 
 		DebugInlineAllocatorStats(const char * file, long l,
 								  const char * name, size_type size, 
-								  size_type inline_obj_num)
-			: type_name{ name }
-			, object_size{ size }
-			, filename{ file }
-			, line{ l }
-			, inline_object_num{ inline_obj_num }
-		{}
+								  size_type inline_obj_num,
+								  const std::type_info * obj_type = nullptr);
+		~DebugInlineAllocatorStats();
+
+		DebugInlineAllocatorStats(const DebugInlineAllocatorStats &) = delete;
+		DebugInlineAllocatorStats & operator=(const DebugInlineAllocatorStats &) = delete;
+
+		/// \brief	Stats of the call site for objects of other type, created the first time they are needed
+		///			and owned by the stats of the call site. Their type name is the one of std::type_info.
+		DebugInlineAllocatorStats & get_rebound(const std::type_info & type, size_type size);
+		template <typename U>
+		DebugInlineAllocatorStats & get_rebound() { return get_rebound(typeid(U), sizeof(U)); }
+
+		/// \brief	Adds the counters of a finished use to the shard of the calling thread.
+		void add_use(const Counters & use);
+		/// \brief	Adds a use that only has a peak.
+		void add_use_peak(size_type peak_objects);
+		/// \brief	The counters of all the shards, the uses that didn't finish are not in them.
+		Counters get_counters() const;
 
 		float average_objects() const
 		{
-			return static_cast<float>(total_alloc_objects) / use_num;
+			const auto counters = get_counters();
+			return static_cast<float>(counters.total_alloc_objects) / counters.use_num;
 		}
 
 		size_type allocated_bytes() const
 		{
-			return total_alloc_objects * object_size;
+			return get_counters().total_alloc_objects * object_size;
 		}
 
 		float growth_percentage() const
@@ -194,26 +386,58 @@ namespace memory
 
 		float non_inline_alloc_use_percentage() const
 		{
-			return 100.f * static_cast<float>(uses_implying_non_inline_allocs) / use_num;
+			const auto counters = get_counters();
+			return 100.f * static_cast<float>(counters.uses_implying_non_inline_allocs) / counters.use_num;
 		}
 
 		float non_inline_alloc_percentage() const
 		{
-			return 100.f * static_cast<float>(non_inline_allocs) / total_alloc_objects;
+			const auto counters = get_counters();
+			return 100.f * static_cast<float>(counters.non_inline_allocs) / counters.total_alloc_objects;
 		}
 
+		/// \brief	Fraction of the uses whose peak fits in n objects. It is an upper bound of the uses
+		///			that would not allocate out of line, the objects of an allocation need to be contiguous.
+		float inline_hit_rate(size_type n) const;
+		/// \brief	Smallest number of inline objects with which target_hit_rate of the uses fit inline,
+		///			the current one if there are no uses.
+		size_type recommended_inline_objects(float target_hit_rate) const;
+
 		const char * const type_name{ "" };
 		const char * const filename{ "" };
 		const long line{ 0u };
 		const size_type inline_object_num{ 0ul };
 		const size_type object_size{ 0ul };
+		/// \brief	nullptr if it is not known, the allocator is never rebound back to this stats.
+		const std::type_info * const object_type{ nullptr };
+
+	private:
+		friend void for_each_inline_allocator_stats(const std::function<void(const DebugInlineAllocatorStats &)> & f);
+
+		struct Shard
+		{
+			mutable std::mutex m_mutex;
+			Counters m_counters;
+			/// \brief	The hot data of two shards is never in the same cache line.
+			unsigned char m_padding[CACHE_LINE_SIZE];
+		};
+
+		Shard m_shards[SHARD_NUM];
 
-		size_type use_num{ 0ul };
-		size_type uses_implying_non_inline_allocs{ 0ul };
-		size_type allocation_num{ 0ul };
-		size_type non_inline_allocs{ 0ul };
-		size_type total_alloc_objects{ 0ul };
+		DebugInlineAllocatorStats * m_prev{ nullptr };
+		DebugInlineAllocatorStats * m_next{ nullptr };
+
+		/// \brief	The stats of the call site for the rebound ones, nullptr for the stats of the call site.
+		DebugInlineAllocatorStats * m_site{ nullptr };
+		DebugInlineAllocatorStats * m_first_rebound{ nullptr };
+		DebugInlineAllocatorStats * m_next_rebound{ nullptr };
 	};
+
+	/// \brief	Calls f with the stats of every DEBUG_INLINE_ALLOCATOR whose function was called.
+	void for_each_inline_allocator_stats(const std::function<void(const DebugInlineAllocatorStats &)> & f);
+	/// \brief	Writes a JSON array with the stats of every inline allocator and the number of inline objects
+	///			that target_hit_rate of its uses need, to size the inline allocators after a profiling run.
+	void write_inline_allocator_report(std::ostream & os, float target_hit_rate = 0.95f);
 	
 	namespace impl
 	{
@@ -226,54 +450,142 @@ namespace memory
 		private:
 			using Base = DefaultInlineAllocator<N, T>;
 
+			template <size_type, typename>
+			friend class DebugInlineAllocator;
+
 		public:
 			template <typename U>
 			using rebind = DebugInlineAllocator<N, U>;
 			
 			explicit DebugInlineAllocator(DebugInlineAllocatorStats & stats)
 				: m_stats{ &stats }
-				, m_initial_non_inline_allocs{ stats.non_inline_allocs }
 			{
-				m_stats->use_num++;
-				fill_with_pattern(DebugPattern::ACQUIRED, get_primary().m_memory, total_size);
+				fill_with_pattern(DebugPattern::ACQUIRED, this->get_primary().m_memory, Base::primary::total_size);
 			}
+			/// \brief	The copy has the objects of other, it is one more use of the call site.
+			DebugInlineAllocator(const DebugInlineAllocator & other)
+				: Base{ other }
+				, m_stats{ other.m_stats }
+				, m_live_objects{ other.m_live_objects }
+				, m_peak_objects{ other.m_live_objects }
+			{
+			}
+			/// \brief	The rebound allocator is a use of the stats of the call site for T.
 			template <typename U>
 			DebugInlineAllocator(const DebugInlineAllocator<N, U> & other)
-				: m_stats{ other.m_stats }
+				: DebugInlineAllocator{ other.m_stats->template get_rebound<T>() }
 			{
-				fill_with_pattern(DebugPattern::ACQUIRED, get_primary().m_memory, total_size);
 			}
+			/// \brief	The use is added to the stats at once, so that the threads only share them once per use.
 			~DebugInlineAllocator()
 			{
-				// if there was any allocation we couldn't track, track it
-				if (m_initial_non_inline_allocs != m_stats->non_inline_allocs)
-					m_stats->uses_implying_non_inline_allocs++;
-
-				fill_with_pattern(DebugPattern::RELEASED, get_primary().m_memory, total_size);
+				DebugInlineAllocatorStats::Counters use;
+				use.use_num = 1;
+				use.uses_implying_non_inline_allocs = m_non_inline_allocs ? 1 : 0;
+				use.allocation_num = m_allocation_num;
+				use.non_inline_allocs = m_non_inline_allocs;
+				use.total_alloc_objects = m_total_alloc_objects;
+				use.add_use_peak(m_peak_objects);
+				m_stats->add_use(use);
+
+				fill_with_pattern(DebugPattern::RELEASED, this->get_primary().m_memory, Base::primary::total_size);
 			}
 
 			T * allocate(size_type n = 1) override final
 			{
-				m_stats->allocation_num++;
-				m_stats->total_alloc_objects += n;
-				if (Base::primary::free_size() < n * sizeof(T)) m_stats->non_inline_allocs++;
+				m_allocation_num++;
+				m_total_alloc_objects += n;
+				if (Base::primary::free_size() < n * sizeof(T)) m_non_inline_allocs++;
 
 				auto * result = Base::allocate(n);
-				fill_with_pattern(DebugPattern::ALLOCATED, result, n * object_size);
+				track_objects(n, 0);
+				fill_with_pattern(DebugPattern::ALLOCATED, result, n * Base::primary::object_size);
 				return result;
 			}
 
 			void deallocate(T * ptr, size_type n = 1)
 			{
-				fill_with_pattern(DebugPattern::DEALLOCATED, ptr, n * object_size);
+				track_objects(0, n);
+				fill_with_pattern(DebugPattern::DEALLOCATED, ptr, n * Base::primary::object_size);
 				Base::deallocate(ptr, n);
 			}
 
+			bool expand(T * ptr, size_type old_n, size_type new_n)
+			{
+				if (!Base::expand(ptr, old_n, new_n))	return false;
+
+				track_objects(new_n, old_n);
+				if (new_n > old_n)
+					fill_with_pattern(DebugPattern::ALLOCATED, ptr + old_n, (new_n - old_n) * Base::primary::object_size);
+				else
+					fill_with_pattern(DebugPattern::DEALLOCATED, ptr + new_n, (old_n - new_n) * Base::primary::object_size);
+				return true;
+			}
+
+			/// \brief	Counts as one allocation of new_n objects, that did not fit inline if it had to be moved out.
+			T * reallocate(T * ptr, size_type old_n, size_type new_n)
+			{
+				m_allocation_num++;
+				m_total_alloc_objects += new_n;
+
+				// the expand of this class fills the objects it adds or releases
+				if (expand(ptr, old_n, new_n))	return ptr;
+
+				const bool was_inline = Base::primary::owns(ptr);
+				auto * result = Base::reallocate(ptr, old_n, new_n);
+				if (result == nullptr)	return nullptr;
+
+				track_objects(new_n, old_n);
+				if (!Base::primary::owns(result))	m_non_inline_allocs++;
+				if (new_n > old_n)
+					fill_with_pattern(DebugPattern::ALLOCATED, result + old_n, (new_n - old_n) * Base::primary::object_size);
+				// the objects were moved, the fallback fills the memory it frees itself
+				if (was_inline)
+					fill_with_pattern(DebugPattern::DEALLOCATED, ptr, old_n * Base::primary::object_size);
+				return result;
+			}
+
+			/// \brief	Every object counts as one allocation of one object.
+			size_type allocate_bulk(T ** out, size_type n)
+			{
+				const auto inline_free = Base::primary::free_size() / Base::primary::object_size;
+				m_allocation_num += n;
+				m_total_alloc_objects += n;
+				if (inline_free < n) m_non_inline_allocs += n - inline_free;
+
+				const auto allocated = Base::allocate_bulk(out, n);
+				track_objects(allocated, 0);
+				for (size_type i = 0; i < allocated; ++i)
+					fill_with_pattern(DebugPattern::ALLOCATED, out[i], Base::primary::object_size);
+				return allocated;
+			}
+
+			void deallocate_bulk(T ** in, size_type n)
+			{
+				track_objects(0, n);
+				for (size_type i = 0; i < n; ++i)
+					fill_with_pattern(DebugPattern::DEALLOCATED, in[i], Base::primary::object_size);
+				Base::deallocate_bulk(in, n);
+			}
+
 		private:
+			void track_objects(size_type allocated, size_type deallocated)
+			{
+				m_live_objects += allocated;
+				m_live_objects -= deallocated < m_live_objects ? deallocated : m_live_objects;
+				if (m_live_objects > m_peak_objects)
+					m_peak_objects = m_live_objects;
+			}
+
 			DebugInlineAllocatorStats * m_stats{ nullptr };
 
-			/// \brief	Used to check if this instance of the allocator coulnd't handle an allocation.
-			size_type m_initial_non_inline_allocs{ 0u };
+			/// \brief	Counters of this use, only this allocator writes them.
+			size_type m_allocation_num{ 0u };
+			size_type m_non_inline_allocs{ 0u };
+			size_type m_total_alloc_objects{ 0u };
+			/// \brief	Objects allocated at the same time (inline or not), the peak is added to the stats.
+			size_type m_live_objects{ 0u };
+			size_type m_peak_objects{ 0u };
 		};
 	}
 #endif
@@ -289,7 +601,7 @@ std::ostream & operator<< (std::ostream & os, const ::memory::DebugInlineAllocat
 /// \brief	Must be used to define inline allocators from which we want statistics.
 #	define DEBUG_INLINE_ALLOCATOR(N, T, allocator_name, alloc_typename)														\
 			using alloc_typename = ::memory::impl::DebugInlineAllocator<N, T>;												\
-			static ::memory::DebugInlineAllocatorStats allocator_name ## _stats{ __FILE__, __LINE__, #T, sizeof(T), N };	\
+			static ::memory::DebugInlineAllocatorStats allocator_name ## _stats{ __FILE__, __LINE__, #T, sizeof(T), N, &typeid(T) };	\
 			alloc_typename allocator_name{ allocator_name ## _stats }
 
 #else
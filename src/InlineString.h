@@ -0,0 +1,165 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "SmallVector.h"
+
+#include <cstring>
+#include <ostream>
+
+namespace memory
+{
+	/// \brief	String that stores up to N characters (plus the terminator) inside the object and allocates
+	///			from Fallback (an allocator of char) when they don't fit. Moving it steals the fallback memory.
+	template <size_type N, typename Fallback = DefaultGlobalAllocator<char>>
+	class InlineString
+	{
+	public:
+		using iterator = char *;
+		using const_iterator = const char *;
+
+		static constexpr size_type inline_capacity = N;
+
+		InlineString()
+		{
+			m_chars.push_back('\0');
+		}
+		InlineString(const char * str)
+			: InlineString(str, std::strlen(str))
+		{}
+		InlineString(const char * str, size_type length)
+		{
+			m_chars.reserve(length + 1);
+			m_chars.append(str, str + length);
+			m_chars.push_back('\0');
+		}
+		InlineString(const InlineString &) = default;
+		/// \brief	other is left empty.
+		InlineString(InlineString && other) noexcept
+			: m_chars{ std::move(other.m_chars) }
+		{
+			other.m_chars.push_back('\0');
+		}
+
+		InlineString & operator=(const InlineString &) = default;
+		InlineString & operator=(InlineString && other) noexcept
+		{
+			if (this != &other)
+			{
+				m_chars = std::move(other.m_chars);
+				other.m_chars.push_back('\0');
+			}
+			return *this;
+		}
+
+		/// \brief	str can be part of this string.
+		InlineString & append(const char * str, size_type length)
+		{
+			// growing may move the characters of str
+			const bool aliased = str >= begin() && str < end();
+			const auto offset = static_cast<size_type>(str - begin());
+			m_chars.reserve(m_chars.size() + length);
+			if (aliased)
+				str = begin() + offset;
+
+			m_chars.pop_back();
+			m_chars.append(str, str + length);
+			m_chars.push_back('\0');
+			return *this;
+		}
+		InlineString & append(const char * str) { return append(str, std::strlen(str)); }
+		template <size_type M, typename F>
+		InlineString & append(const InlineString<M, F> & str) { return append(str.data(), str.size()); }
+
+		InlineString & operator+=(const char * str) { return append(str); }
+		InlineString & operator+=(char c) { push_back(c); return *this; }
+		template <size_type M, typename F>
+		InlineString & operator+=(const InlineString<M, F> & str) { return append(str); }
+
+		void push_back(char c)
+		{
+			m_chars.back() = c;
+			m_chars.push_back('\0');
+		}
+		void pop_back()
+		{
+			MEMORY_ASSERT(!empty());
+			m_chars.pop_back();
+			m_chars.back() = '\0';
+		}
+
+		void resize(size_type length, char c = '\0')
+		{
+			m_chars.pop_back();
+			m_chars.resize(length, c);
+			m_chars.push_back('\0');
+		}
+		void reserve(size_type length) { m_chars.reserve(length + 1); }
+		void clear()
+		{
+			m_chars.clear();
+			m_chars.push_back('\0');
+		}
+		void shrink_to_fit() { m_chars.shrink_to_fit(); }
+
+		char & operator[](size_type idx) { MEMORY_ASSERT(idx < size()); return m_chars[idx]; }
+		char operator[](size_type idx) const { MEMORY_ASSERT(idx < size()); return m_chars[idx]; }
+
+		const char * c_str() const { return m_chars.data(); }
+		char * data() { return m_chars.data(); }
+		const char * data() const { return m_chars.data(); }
+		iterator begin() { return m_chars.begin(); }
+		iterator end() { return m_chars.end() - 1; }
+		const_iterator begin() const { return m_chars.begin(); }
+		const_iterator end() const { return m_chars.end() - 1; }
+
+		size_type size() const { return m_chars.size() - 1; }
+		size_type length() const { return size(); }
+		size_type capacity() const { return m_chars.capacity() - 1; }
+		bool empty() const { return size() == 0; }
+		/// \brief	True while the characters are in the buffer of the string.
+		bool is_inline() const { return m_chars.is_inline(); }
+
+		/// \brief	Same as strcmp.
+		int compare(const char * str, size_type length) const
+		{
+			const auto common = size() < length ? size() : length;
+			const auto result = std::memcmp(data(), str, common);
+			if (result != 0)	return result;
+			return size() < length ? -1 : (size() > length ? 1 : 0);
+		}
+		int compare(const char * str) const { return compare(str, std::strlen(str)); }
+		template <size_type M, typename F>
+		int compare(const InlineString<M, F> & str) const { return compare(str.data(), str.size()); }
+
+	private:
+		SmallVector<char, N + 1, Fallback> m_chars;
+	};
+
+	template <size_type N, typename Fallback>
+	constexpr size_type InlineString<N, Fallback>::inline_capacity;
+
+	template <size_type N, typename A, size_type M, typename B>
+	bool operator==(const InlineString<N, A> & lhs, const InlineString<M, B> & rhs) { return lhs.compare(rhs) == 0; }
+	template <size_type N, typename A, size_type M, typename B>
+	bool operator!=(const InlineString<N, A> & lhs, const InlineString<M, B> & rhs) { return lhs.compare(rhs) != 0; }
+	template <size_type N, typename A, size_type M, typename B>
+	bool operator<(const InlineString<N, A> & lhs, const InlineString<M, B> & rhs) { return lhs.compare(rhs) < 0; }
+	template <size_type N, typename A>
+	bool operator==(const InlineString<N, A> & lhs, const char * rhs) { return lhs.compare(rhs) == 0; }
+	template <size_type N, typename A>
+	bool operator!=(const InlineString<N, A> & lhs, const char * rhs) { return lhs.compare(rhs) != 0; }
+
+	template <size_type N, typename A>
+	std::ostream & operator<<(std::ostream & os, const InlineString<N, A> & str)
+	{
+		return os.write(str.data(), static_cast<std::streamsize>(str.size()));
+	}
+}
@@ -0,0 +1,300 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "ObjectPool.h"
+#include "PageAllocator.h"
+
+#include <iterator>		// std::distance
+#include <type_traits>	// std::enable_if, std::is_convertible
+#include <utility>		// std::forward
+
+namespace memory
+{
+	/// \brief	Links of an object in an IntrusiveList, the objects derive from it.
+	///			The Tag allows an object to be in several lists at once (one base per list).
+	template <typename Tag = void>
+	struct IntrusiveListHook
+	{
+		IntrusiveListHook * m_prev{ nullptr };
+		IntrusiveListHook * m_next{ nullptr };
+
+		bool is_linked() const { return m_next != nullptr; }
+	};
+
+	/// \brief	Doubly linked list of objects that derive from IntrusiveListHook<Tag>.
+	///			The list never allocates nor owns the objects, they need to outlive it or be removed before
+	///			being destroyed. The list is circular around a hook of its own, so it can't be copied nor moved.
+	template <typename T, typename Tag = void>
+	class IntrusiveList
+	{
+		using Hook = IntrusiveListHook<Tag>;
+
+	public:
+		template <typename Ref, typename HookPtr>
+		class Iterator
+		{
+		public:
+			explicit Iterator(HookPtr hook) : m_hook{ hook } {}
+			/// \brief	iterator to const_iterator.
+			template <typename R, typename H, typename = typename std::enable_if<std::is_convertible<H, HookPtr>::value>::type>
+			Iterator(const Iterator<R, H> & other) : m_hook{ other.m_hook } {}
+
+			Ref operator*() const { return static_cast<Ref>(*m_hook); }
+			auto operator->() const -> decltype(&**this) { return &**this; }
+
+			Iterator & operator++() { m_hook = m_hook->m_next; return *this; }
+			Iterator & operator--() { m_hook = m_hook->m_prev; return *this; }
+
+			bool operator==(const Iterator & other) const { return m_hook == other.m_hook; }
+			bool operator!=(const Iterator & other) const { return m_hook != other.m_hook; }
+
+		private:
+			friend class IntrusiveList;
+			template <typename, typename> friend class Iterator;
+			HookPtr m_hook;
+		};
+		using iterator = Iterator<T &, Hook *>;
+		using const_iterator = Iterator<const T &, const Hook *>;
+
+		IntrusiveList()
+		{
+			m_root.m_prev = &m_root;
+			m_root.m_next = &m_root;
+		}
+		~IntrusiveList()
+		{
+			clear();
+		}
+
+		IntrusiveList(const IntrusiveList &) = delete;
+		IntrusiveList & operator=(const IntrusiveList &) = delete;
+
+		void push_front(T & obj) { link(obj, m_root.m_next); }
+		void push_back(T & obj) { link(obj, &m_root); }
+		/// \brief	Links obj before pos.
+		iterator insert(const_iterator pos, T & obj)
+		{
+			link(obj, const_cast<Hook *>(pos.m_hook));
+			return iterator{ as_hook(obj) };
+		}
+
+		void pop_front() { MEMORY_ASSERT(!empty()); unlink(front()); }
+		void pop_back() { MEMORY_ASSERT(!empty()); unlink(back()); }
+		/// \brief	Returns the object after obj.
+		iterator erase(T & obj)
+		{
+			auto * next = as_hook(obj)->m_next;
+			unlink(obj);
+			return iterator{ next };
+		}
+		iterator erase(const_iterator pos) { return erase(const_cast<T &>(*pos)); }
+
+		/// \brief	Unlinks all the objects, they are not destroyed.
+		void clear()
+		{
+			for (auto * curr = m_root.m_next; curr != &m_root;)
+			{
+				auto * next = curr->m_next;
+				curr->m_prev = curr->m_next = nullptr;
+				curr = next;
+			}
+			forget_all();
+		}
+		/// \brief	Empties the list without visiting the objects, for when all of them are about to be destroyed.
+		void forget_all()
+		{
+			m_root.m_prev = m_root.m_next = &m_root;
+			m_size = 0;
+		}
+
+		T & front() { MEMORY_ASSERT(!empty()); return static_cast<T &>(*m_root.m_next); }
+		const T & front() const { MEMORY_ASSERT(!empty()); return static_cast<const T &>(*m_root.m_next); }
+		T & back() { MEMORY_ASSERT(!empty()); return static_cast<T &>(*m_root.m_prev); }
+		const T & back() const { MEMORY_ASSERT(!empty()); return static_cast<const T &>(*m_root.m_prev); }
+
+		iterator begin() { return iterator{ m_root.m_next }; }
+		iterator end() { return iterator{ &m_root }; }
+		const_iterator begin() const { return const_iterator{ m_root.m_next }; }
+		const_iterator end() const { return const_iterator{ &m_root }; }
+
+		size_type size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+	private:
+		static Hook * as_hook(T & obj) { return static_cast<Hook *>(&obj); }
+
+		void link(T & obj, Hook * next)
+		{
+			auto * hook = as_hook(obj);
+			MEMORY_ASSERT(!hook->is_linked());
+
+			hook->m_prev = next->m_prev;
+			hook->m_next = next;
+			next->m_prev->m_next = hook;
+			next->m_prev = hook;
+			m_size++;
+		}
+		void unlink(T & obj)
+		{
+			auto * hook = as_hook(obj);
+			MEMORY_ASSERT(hook->is_linked());
+
+			hook->m_prev->m_next = hook->m_next;
+			hook->m_next->m_prev = hook->m_prev;
+			hook->m_prev = hook->m_next = nullptr;
+			m_size--;
+		}
+
+		Hook m_root;
+		size_type m_size{ 0u };
+	};
+
+	/// \brief	Doubly linked list that creates its nodes in the pages of a PageAllocator (through an ObjectPool),
+	///			so the nodes of a page are allocated together and clear() drops the pages instead of
+	///			freeing the nodes one by one. The nodes are allocated a page at a time through the bulk
+	///			allocation of the pool. PageAlloc can be PageAllocator or DebugPageAllocator.
+	template <typename T, typename PageAlloc = PageAllocator>
+	class PooledList
+	{
+		struct Node
+			: IntrusiveListHook<>
+		{
+			template <typename... Args>
+			explicit Node(Args &&... args) : m_value(std::forward<Args>(args)...) {}
+
+			T m_value;
+		};
+		using List = IntrusiveList<Node>;
+
+	public:
+		template <typename Ref, typename ListIt>
+		class Iterator
+		{
+		public:
+			explicit Iterator(ListIt it) : m_it{ it } {}
+			/// \brief	iterator to const_iterator.
+			template <typename R, typename It, typename = typename std::enable_if<std::is_convertible<It, ListIt>::value>::type>
+			Iterator(const Iterator<R, It> & other) : m_it{ other.m_it } {}
+
+			Ref operator*() const { return m_it->m_value; }
+			auto operator->() const -> decltype(&**this) { return &**this; }
+
+			Iterator & operator++() { ++m_it; return *this; }
+			Iterator & operator--() { --m_it; return *this; }
+
+			bool operator==(const Iterator & other) const { return m_it == other.m_it; }
+			bool operator!=(const Iterator & other) const { return m_it != other.m_it; }
+
+		private:
+			friend class PooledList;
+			template <typename, typename> friend class Iterator;
+			ListIt m_it;
+		};
+		using iterator = Iterator<T &, typename List::iterator>;
+		using const_iterator = Iterator<const T &, typename List::const_iterator>;
+
+		explicit PooledList(size_type nodes_per_page = 64)
+			: m_pool{ nodes_per_page }
+		{}
+
+		PooledList(const PooledList &) = delete;
+		PooledList & operator=(const PooledList &) = delete;
+
+		template <typename... Args>
+		T & emplace_back(Args &&... args)
+		{
+			auto * node = create_node(std::forward<Args>(args)...);
+			m_list.push_back(*node);
+			return node->m_value;
+		}
+		template <typename... Args>
+		T & emplace_front(Args &&... args)
+		{
+			auto * node = create_node(std::forward<Args>(args)...);
+			m_list.push_front(*node);
+			return node->m_value;
+		}
+		template <typename... Args>
+		iterator emplace(const_iterator pos, Args &&... args)
+		{
+			auto * node = create_node(std::forward<Args>(args)...);
+			return iterator{ m_list.insert(pos.m_it, *node) };
+		}
+		void push_back(const T & value) { emplace_back(value); }
+		void push_front(const T & value) { emplace_front(value); }
+		/// \brief	Inserts copies of [first, last) before pos, their nodes are allocated at once.
+		template <typename ForwardIt>
+		void insert(const_iterator pos, ForwardIt first, ForwardIt last)
+		{
+			reserve(static_cast<size_type>(std::distance(first, last)));
+			for (; first != last; ++first)
+				emplace(pos, *first);
+		}
+		/// \brief	Allocates the nodes of n more elements at once.
+		void reserve(size_type n)
+		{
+			if (n > m_pool.reserved_objects())
+				m_pool.reserve(n - m_pool.reserved_objects());
+		}
+
+		void pop_front() { destroy(m_list.front()); }
+		void pop_back() { destroy(m_list.back()); }
+		/// \brief	Returns the element after pos.
+		iterator erase(const_iterator pos)
+		{
+			auto & node = const_cast<Node &>(*pos.m_it);
+			auto next = m_list.erase(node);
+			m_pool.destroy(&node);
+			return iterator{ next };
+		}
+
+		/// \brief	Destroys the elements and releases the pages of the nodes at once.
+		void clear()
+		{
+			m_list.forget_all();
+			m_pool.destroy_all();
+		}
+
+		T & front() { return m_list.front().m_value; }
+		const T & front() const { return m_list.front().m_value; }
+		T & back() { return m_list.back().m_value; }
+		const T & back() const { return m_list.back().m_value; }
+
+		iterator begin() { return iterator{ m_list.begin() }; }
+		iterator end() { return iterator{ m_list.end() }; }
+		const_iterator begin() const { return const_iterator{ m_list.begin() }; }
+		const_iterator end() const { return const_iterator{ m_list.end() }; }
+
+		size_type size() const { return m_list.size(); }
+		bool empty() const { return m_list.empty(); }
+
+		/// \brief	Pool of the nodes, i.e. to read the pages it uses.
+		const ObjectPool<Node, PageAlloc> & get_pool() const { return m_pool; }
+
+	private:
+		template <typename... Args>
+		Node * create_node(Args &&... args)
+		{
+			if (m_pool.reserved_objects() == 0)
+				m_pool.reserve(m_pool.get_per_page_obj_num());
+			return m_pool.create(std::forward<Args>(args)...);
+		}
+		void destroy(Node & node)
+		{
+			m_list.erase(node);
+			m_pool.destroy(&node);
+		}
+
+		// IMPORTANT: the pool needs to be destroyed after the list
+		ObjectPool<Node, PageAlloc> m_pool;
+		List m_list;
+	};
+}
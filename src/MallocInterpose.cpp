@@ -0,0 +1,140 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+/// Replaces malloc/free/realloc/calloc and the aligned allocation functions of the C library with the
+/// ThreadCachedAllocator. Built as a shared library (memory_malloc_preload in CMake, Linux only)
+/// that is loaded before the C library:
+///
+///		LD_PRELOAD=libmemory_malloc_preload.so <program>
+///
+/// The library is built without debug checks and tracing, the tracing could allocate.
+
+#include "ThreadCachedAllocator.h"
+
+#include <cerrno>
+#include <cstring>	// std::memcpy, std::memset
+#include <malloc.h>
+#include <stdlib.h>
+
+// the C library declares its functions with __THROW (noexcept), the replacements need to match
+#ifndef __THROW
+#define __THROW
+#endif
+
+#define MEMORY_INTERPOSE extern "C" __attribute__((visibility("default")))
+
+using memory::ThreadCachedAllocator;
+
+namespace
+{
+	bool valid_alignment(size_t alignment)
+	{
+		return memory::is_power_of_two(alignment);
+	}
+
+	void * allocate(size_t bytes)
+	{
+		auto * mem = ThreadCachedAllocator::allocate(bytes);
+		if (mem == nullptr)
+			errno = ENOMEM;
+		return mem;
+	}
+}
+
+MEMORY_INTERPOSE void * malloc(size_t bytes) __THROW
+{
+	return allocate(bytes);
+}
+
+MEMORY_INTERPOSE void free(void * mem) __THROW
+{
+	// memory that is not ours can't be given back to anybody
+	if (ThreadCachedAllocator::owns(mem))
+		ThreadCachedAllocator::deallocate(mem);
+}
+
+MEMORY_INTERPOSE void * calloc(size_t num, size_t size) __THROW
+{
+	const auto bytes = num * size;
+	if (size && bytes / size != num)
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
+
+	// the memory of the thread caches is reused, it is not zeroed as the new spans from the system
+	auto * mem = allocate(bytes);
+	if (mem)
+		std::memset(mem, 0, bytes);
+	return mem;
+}
+
+MEMORY_INTERPOSE void * realloc(void * mem, size_t bytes) __THROW
+{
+	if (mem == nullptr)	return allocate(bytes);
+	if (bytes == 0)
+	{
+		free(mem);
+		return nullptr;
+	}
+
+	// the object already has room, the size classes are powers of two
+	const auto usable = ThreadCachedAllocator::usable_size(mem);
+	if (bytes <= usable)	return mem;
+
+	auto * result = allocate(bytes);
+	if (result)
+	{
+		std::memcpy(result, mem, usable);
+		ThreadCachedAllocator::sized_free(mem, usable);
+	}
+	return result;
+}
+
+MEMORY_INTERPOSE int posix_memalign(void ** out, size_t alignment, size_t bytes) __THROW
+{
+	if (!valid_alignment(alignment) || alignment % sizeof(void *) != 0)
+		return EINVAL;
+
+	auto * mem = ThreadCachedAllocator::allocate_aligned(bytes, alignment);
+	if (mem == nullptr)
+		return ENOMEM;
+
+	*out = mem;
+	return 0;
+}
+
+MEMORY_INTERPOSE void * aligned_alloc(size_t alignment, size_t bytes) __THROW
+{
+	if (!valid_alignment(alignment))
+	{
+		errno = EINVAL;
+		return nullptr;
+	}
+	return ThreadCachedAllocator::allocate_aligned(bytes, alignment);
+}
+
+MEMORY_INTERPOSE void * memalign(size_t alignment, size_t bytes) __THROW
+{
+	return aligned_alloc(alignment, bytes);
+}
+
+MEMORY_INTERPOSE void * valloc(size_t bytes) __THROW
+{
+	return aligned_alloc(4096, bytes);
+}
+
+MEMORY_INTERPOSE void * pvalloc(size_t bytes) __THROW
+{
+	return aligned_alloc(4096, (bytes + 4095) & ~size_t{ 4095 });
+}
+
+MEMORY_INTERPOSE size_t malloc_usable_size(void * mem) __THROW
+{
+	return mem ? ThreadCachedAllocator::usable_size(mem) : 0;
+}
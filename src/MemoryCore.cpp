@@ -1,8 +1,17 @@
 
 #include "MemoryCore.h"
 
+#include <cstdlib>	// posix_memalign, std::free
 #include <iostream>
 
+#if defined(_WIN32)
+#include <malloc.h>	// _aligned_malloc
+#include <windows.h>	// VirtualAlloc
+#else
+#include <sys/mman.h>	// mmap
+#include <unistd.h>		// sysconf
+#endif
+
 namespace memory
 {
 	namespace impl
@@ -21,6 +30,38 @@ namespace memory
 			const auto callback = get_out_of_memory_callback();
 			callback();
 		}
+
+		void * aligned_alloc(size_type n, size_type alignment)
+		{
+#if defined(_WIN32)
+			return _aligned_malloc(n, alignment);
+#else
+			void * mem = nullptr;
+			return posix_memalign(&mem, alignment, n) == 0 ? mem : nullptr;
+#endif
+		}
+
+		void * system_map(size_type n, size_type alignment)
+		{
+#if defined(_WIN32)
+			// VirtualAlloc returns memory aligned to the allocation granularity (64KB)
+			return VirtualAlloc(nullptr, n, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+			// map extra memory to be able to align it and give back what is not needed
+			const auto extra = alignment > kilobyte_to_byte(4) ? alignment : 0;
+			void * mem = mmap(nullptr, n + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mem == MAP_FAILED)	return nullptr;
+			if (extra == 0)	return mem;
+
+			const auto start = ptr_to_num(mem);
+			const auto aligned = (start + alignment - 1) & ~(alignment - 1);
+			if (aligned != start)
+				munmap(mem, aligned - start);
+			if (aligned + n != start + n + extra)
+				munmap(reinterpret_cast<void *>(aligned + n), start + extra - aligned);
+			return reinterpret_cast<void *>(aligned);
+#endif
+		}
 	}
 
 	out_of_memory_callback_type get_out_of_memory_callback()
@@ -50,4 +91,72 @@ namespace memory
 		// expect the user to have deallocated some memory
 		return ::operator new(n);
 	}
+
+	void * global_aligned_alloc(size_type n, size_type alignment)
+	{
+		MEMORY_ASSERT(is_power_of_two(alignment) && alignment % sizeof(void *) == 0);
+
+		if (auto * mem = impl::aligned_alloc(n, alignment))
+			return mem;
+
+		impl::out_of_memory();
+
+		// expect the user to have deallocated some memory
+		return impl::aligned_alloc(n, alignment);
+	}
+	void * system_map(size_type n, size_type alignment)
+	{
+		MEMORY_ASSERT(is_power_of_two(alignment));
+#if defined(_WIN32)
+		MEMORY_ASSERT(alignment <= kilobyte_to_byte(64));
+#endif
+
+		if (auto * mem = impl::system_map(n, alignment))
+			return mem;
+
+		impl::out_of_memory();
+
+		// expect the user to have deallocated some memory
+		return impl::system_map(n, alignment);
+	}
+	void system_unmap(void * mem, size_type n)
+	{
+#if defined(_WIN32)
+		(void)n;
+		VirtualFree(mem, 0, MEM_RELEASE);
+#else
+		munmap(mem, n);
+#endif
+	}
+
+	size_type system_page_size()
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		static const auto page_size = static_cast<size_type>(sysconf(_SC_PAGESIZE));
+		return page_size;
+#endif
+	}
+	void system_protect(void * mem, size_type n, bool accessible)
+	{
+		MEMORY_ASSERT(ptr_to_num(mem) % system_page_size() == 0);
+#if defined(_WIN32)
+		DWORD old_protection;
+		VirtualProtect(mem, n, accessible ? PAGE_READWRITE : PAGE_NOACCESS, &old_protection);
+#else
+		mprotect(mem, n, accessible ? PROT_READ | PROT_WRITE : PROT_NONE);
+#endif
+	}
+
+	void global_aligned_dealloc(void * mem)
+	{
+#if defined(_WIN32)
+		_aligned_free(mem);
+#else
+		std::free(mem);
+#endif
+	}
 }
@@ -8,17 +8,53 @@ found in the top-level directory of this distribution.
 
 #pragma once
 
-// TODO(Borja): When integrating this code in an actual project, this should go in the project configuration.
+// Defaults in case the project configuration (i.e. CMake options) does not define them.
+#ifndef MEMORY_DEBUG_ENABLED
 #define MEMORY_DEBUG_ENABLED 1
+#endif
+#ifndef MEMORY_ENABLE_DEBUG_PATTERNS
 #define MEMORY_ENABLE_DEBUG_PATTERNS 1
+#endif
+
+// AddressSanitizer is detected from the compiler flags, Valgrind needs its headers (MEMORY_VALGRIND_ENABLED).
+#ifndef MEMORY_ASAN_ENABLED
+#	if defined(__SANITIZE_ADDRESS__)
+#		define MEMORY_ASAN_ENABLED 1
+#	elif defined(__has_feature)
+#		if __has_feature(address_sanitizer)
+#			define MEMORY_ASAN_ENABLED 1
+#		endif
+#	endif
+#	ifndef MEMORY_ASAN_ENABLED
+#		define MEMORY_ASAN_ENABLED 0
+#	endif
+#endif
+#ifndef MEMORY_VALGRIND_ENABLED
+#define MEMORY_VALGRIND_ENABLED 0
+#endif
+
+// the poisoned memory is checked on every access, the patterns would only hide the reports
+#if MEMORY_ASAN_ENABLED
+#	undef MEMORY_ENABLE_DEBUG_PATTERNS
+#	define MEMORY_ENABLE_DEBUG_PATTERNS 0
+#endif
+
+#if defined(_MSC_VER)
+#	define MEMORY_DEBUG_BREAK() __debugbreak()
+#elif defined(__GNUC__) || defined(__clang__)
+#	define MEMORY_DEBUG_BREAK() __builtin_trap()
+#else
+#	include <cstdlib>
+#	define MEMORY_DEBUG_BREAK() std::abort()
+#endif
 
 #if MEMORY_DEBUG_ENABLED
 
-#define MEMORY_ASSERT(x)	\
-	do						\
-	{						\
-		if(!(x))			\
-			__debugbreak();	\
+#define MEMORY_ASSERT(x)			\
+	do								\
+	{								\
+		if(!(x))					\
+			MEMORY_DEBUG_BREAK();	\
 	} while(0)
 
 #else
@@ -32,10 +68,24 @@ found in the top-level directory of this distribution.
 
 #include <functional>
 
+#if defined(_MSC_VER)
+#include <intrin.h>	// _BitScanForward, _BitScanReverse
+#endif
+
+#if MEMORY_ASAN_ENABLED
+#include <sanitizer/asan_interface.h>
+#endif
+#if MEMORY_VALGRIND_ENABLED
+#include <valgrind/memcheck.h>
+#endif
+
 namespace memory
 {
 	using size_type = std::size_t;
 
+	/// \brief	Size of the cache lines of the targeted cpus.
+	constexpr size_type CACHE_LINE_SIZE = 64;
+
 	using out_of_memory_callback_type = std::function<void()>;
 	out_of_memory_callback_type get_out_of_memory_callback();
 	void set_out_of_memory_callback(out_of_memory_callback_type callback);
@@ -46,6 +96,22 @@ namespace memory
 		::operator delete(mem);
 	}
 
+	/// \brief	alignment needs to be a power of two multiple of sizeof(void *).
+	///			The memory needs to be deallocated with global_aligned_dealloc.
+	void * global_aligned_alloc(size_type n, size_type alignment);
+	void global_aligned_dealloc(void * mem);
+
+	/// \brief	Maps zeroed memory straight from the system (mmap/VirtualAlloc), without going through
+	///			malloc or operator new, so it can be used by the allocators that replace them.
+	///			alignment needs to be a power of two, at most 64KB on Windows.
+	void * system_map(size_type n, size_type alignment);
+	/// \brief	n needs to be the size used to map the memory.
+	void system_unmap(void * mem, size_type n);
+	/// \brief	Size of the pages of the system, the granularity of system_protect.
+	size_type system_page_size();
+	/// \brief	Makes whole pages of mapped memory accessible (read/write) or not (any access faults).
+	void system_protect(void * mem, size_type n, bool accessible);
+
 	inline size_type kilobyte_to_byte(size_type kb)
 	{
 		return kb * 1024;
@@ -55,6 +121,66 @@ namespace memory
 		return kilobyte_to_byte(mb * 1024);
 	}
 
+	inline bool is_power_of_two(size_type n)
+	{
+		return n != 0 && (n & (n - 1)) == 0;
+	}
+	/// \brief	Index of the least significant bit set, n can't be 0.
+	inline size_type find_first_set(size_type n)
+	{
+		MEMORY_ASSERT(n != 0);
+#if defined(_MSC_VER) && defined(_WIN64)
+		unsigned long idx;
+		_BitScanForward64(&idx, n);
+		return idx;
+#elif defined(_MSC_VER)
+		unsigned long idx;
+		_BitScanForward(&idx, n);
+		return idx;
+#elif defined(__GNUC__) || defined(__clang__)
+		return static_cast<size_type>(__builtin_ctzll(n));
+#else
+		size_type result = 0;
+		while ((n & 1u) == 0)
+		{
+			n >>= 1;
+			++result;
+		}
+		return result;
+#endif
+	}
+	/// \brief	Index of the most significant bit set, n can't be 0.
+	inline size_type find_last_set(size_type n)
+	{
+		MEMORY_ASSERT(n != 0);
+#if defined(_MSC_VER) && defined(_WIN64)
+		unsigned long idx;
+		_BitScanReverse64(&idx, n);
+		return idx;
+#elif defined(_MSC_VER)
+		unsigned long idx;
+		_BitScanReverse(&idx, n);
+		return idx;
+#elif defined(__GNUC__) || defined(__clang__)
+		return static_cast<size_type>(63 - __builtin_clzll(n));
+#else
+		size_type result = 0;
+		while (n >>= 1)
+			++result;
+		return result;
+#endif
+	}
+	/// \brief	n can't be 0.
+	inline size_type log2_floor(size_type n)
+	{
+		return find_last_set(n);
+	}
+	inline size_type round_up_to_power_of_two(size_type n)
+	{
+		if (n <= 1)	return 1;
+		return size_type{ 1u } << (log2_floor(n - 1) + 1);
+	}
+
 	/// \brief hHelper function to convert an address to a numerical value.
 	template <typename T>
 	inline size_type ptr_to_num(const T * ptr)
@@ -71,15 +197,94 @@ namespace memory
 		RELEASED = 0xFF,	// memory that no longer belongs to allocators (could be freed memory or stack memory)
 	};
 
+	/// \brief	False when the patterns are disabled or the program runs under Valgrind, which reports
+	///			the accesses to the poisoned memory instead (AddressSanitizer disables them when compiling).
+	inline bool debug_patterns_enabled()
+	{
+#if !MEMORY_ENABLE_DEBUG_PATTERNS
+		return false;
+#elif MEMORY_VALGRIND_ENABLED
+		return RUNNING_ON_VALGRIND == 0;
+#else
+		return true;
+#endif
+	}
+
 #if MEMORY_ENABLE_DEBUG_PATTERNS
 
 	inline void fill_with_pattern(DebugPattern pattern, void * mem, size_type n)
 	{
-		std::memset(mem, static_cast<unsigned char>(pattern), n);
+		if (debug_patterns_enabled())
+			std::memset(mem, static_cast<unsigned char>(pattern), n);
 	}
 	
 #else
 	inline void fill_with_pattern(DebugPattern, void *, size_type) {}
 #endif
+
+	// The allocators that recycle memory tell the sanitizers which parts of it the user can access,
+	// so the accesses to free memory are reported even though it was never given back to the system.
+	// All of them are no-ops without MEMORY_ASAN_ENABLED or MEMORY_VALGRIND_ENABLED.
+
+	/// \brief	Memory that belongs to the allocator but not to the user (free or not used yet).
+	///			AddressSanitizer may leave unpoisoned the bytes that don't fill its 8 byte granules.
+	inline void poison_memory(const void * mem, size_type n)
+	{
+#if MEMORY_ASAN_ENABLED
+		ASAN_POISON_MEMORY_REGION(mem, n);
+#endif
+#if MEMORY_VALGRIND_ENABLED
+		VALGRIND_MAKE_MEM_NOACCESS(mem, n);
+#endif
+		(void)mem; (void)n;
+	}
+	/// \brief	Makes poisoned memory accessible again, i.e. for the allocator to write its own data or release it.
+	inline void unpoison_memory(const void * mem, size_type n)
+	{
+#if MEMORY_ASAN_ENABLED
+		ASAN_UNPOISON_MEMORY_REGION(mem, n);
+#endif
+#if MEMORY_VALGRIND_ENABLED
+		VALGRIND_MAKE_MEM_UNDEFINED(mem, n);
+#endif
+		(void)mem; (void)n;
+	}
+	/// \brief	Memory given to the user, Valgrind tracks it as a heap block.
+	inline void sanitizer_allocate(const void * mem, size_type n)
+	{
+#if MEMORY_ASAN_ENABLED
+		ASAN_UNPOISON_MEMORY_REGION(mem, n);
+#endif
+#if MEMORY_VALGRIND_ENABLED
+		VALGRIND_MALLOCLIKE_BLOCK(mem, n, 0, 0);
+#endif
+		(void)mem; (void)n;
+	}
+	/// \brief	Memory returned by the user, any access to it is reported.
+	inline void sanitizer_deallocate(const void * mem, size_type n)
+	{
+#if MEMORY_VALGRIND_ENABLED
+		VALGRIND_FREELIKE_BLOCK(mem, 0);
+#endif
+#if MEMORY_ASAN_ENABLED
+		ASAN_POISON_MEMORY_REGION(mem, n);
+#endif
+		(void)mem; (void)n;
+	}
+	/// \brief	An allocation that grows or shrinks without moving.
+	inline void sanitizer_resize(const void * mem, size_type old_n, size_type new_n)
+	{
+#if MEMORY_ASAN_ENABLED
+		const auto * bytes = static_cast<const unsigned char *>(mem);
+		if (new_n > old_n)
+			ASAN_UNPOISON_MEMORY_REGION(bytes + old_n, new_n - old_n);
+		else
+			ASAN_POISON_MEMORY_REGION(bytes + new_n, old_n - new_n);
+#endif
+#if MEMORY_VALGRIND_ENABLED
+		VALGRIND_RESIZEINPLACE_BLOCK(mem, old_n, new_n, 0);
+#endif
+		(void)mem; (void)old_n; (void)new_n;
+	}
 }
 
@@ -0,0 +1,212 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "NumaPageSource.h"
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#endif
+
+namespace memory
+{
+	namespace impl
+	{
+#if defined(__linux__)
+		// values of linux/mempolicy.h, the header (or libnuma) may not be installed
+		constexpr int NUMA_MPOL_BIND = 2;
+		constexpr unsigned NUMA_MPOL_MF_MOVE = 1u << 1;
+		constexpr unsigned long NUMA_MPOL_F_NODE = 1u << 0;
+		constexpr unsigned long NUMA_MPOL_F_ADDR = 1u << 1;
+		constexpr size_type NUMA_MAX_NODES = sizeof(unsigned long) * 8;
+
+		/// \brief	Parses the last node of a list like "0-1" or "0,2".
+		size_type numa_online_nodes()
+		{
+			std::ifstream file{ "/sys/devices/system/node/online" };
+			std::string online;
+			if (!(file >> online) || online.empty())	return 1;
+
+			const auto last = online.find_last_of("-,");
+			const auto number = last == std::string::npos ? online : online.substr(last + 1);
+			const auto max_node = static_cast<size_type>(std::stoul(number));
+			return max_node + 1 < NUMA_MAX_NODES ? max_node + 1 : NUMA_MAX_NODES;
+		}
+#endif
+
+		/// \brief	Node of the calling thread in the fake topologies.
+		thread_local size_type s_fake_numa_node = 0;
+	}
+
+	SystemNumaTopology::SystemNumaTopology()
+	{
+#if defined(__linux__)
+		m_node_count = impl::numa_online_nodes();
+#endif
+	}
+
+	size_type SystemNumaTopology::current_node() const
+	{
+#if defined(__linux__) && defined(SYS_getcpu)
+		unsigned cpu = 0, node = 0;
+		if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+			return node;
+		return UNKNOWN_NODE;
+#else
+		return 0;
+#endif
+	}
+
+	bool SystemNumaTopology::bind(void * mem, size_type bytes, size_type node)
+	{
+#if defined(__linux__) && defined(SYS_mbind)
+		if (node >= m_node_count)	return false;
+
+		const unsigned long node_mask = 1ul << node;
+		return syscall(SYS_mbind, mem, bytes, impl::NUMA_MPOL_BIND, &node_mask, impl::NUMA_MAX_NODES, impl::NUMA_MPOL_MF_MOVE) == 0;
+#else
+		(void)mem; (void)bytes;
+		return node == 0;
+#endif
+	}
+
+	size_type SystemNumaTopology::node_of(const void * mem) const
+	{
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+		int node = -1;
+		if (syscall(SYS_get_mempolicy, &node, nullptr, 0ul, mem, impl::NUMA_MPOL_F_NODE | impl::NUMA_MPOL_F_ADDR) == 0 && node >= 0)
+			return static_cast<size_type>(node);
+		return UNKNOWN_NODE;
+#else
+		(void)mem;
+		return 0;
+#endif
+	}
+
+	FakeNumaTopology::FakeNumaTopology(size_type node_count)
+		: m_node_count{ node_count }
+	{
+		MEMORY_ASSERT(node_count > 0);
+	}
+
+	size_type FakeNumaTopology::current_node() const
+	{
+		return impl::s_fake_numa_node;
+	}
+	void FakeNumaTopology::set_current_node(size_type node)
+	{
+		MEMORY_ASSERT(node < m_node_count);
+		impl::s_fake_numa_node = node;
+	}
+
+	bool FakeNumaTopology::bind(void * mem, size_type bytes, size_type node)
+	{
+		if (node >= m_node_count)	return false;
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_ranges[ptr_to_num(mem)] = std::make_pair(ptr_to_num(mem) + bytes, node);
+		return true;
+	}
+
+	size_type FakeNumaTopology::node_of(const void * mem) const
+	{
+		const auto address = ptr_to_num(mem);
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		auto it = m_ranges.upper_bound(address);
+		if (it == m_ranges.begin())	return UNKNOWN_NODE;
+
+		--it;
+		return address < it->second.first ? it->second.second : UNKNOWN_NODE;
+	}
+
+	NumaPageSource::NumaPageSource(NumaTopology & topology)
+		: m_topology(topology)
+		, m_stats(topology.node_count())
+	{}
+
+	size_type NumaPageSource::system_page_size()
+	{
+#if defined(__linux__)
+		static const size_type page_size = static_cast<size_type>(sysconf(_SC_PAGESIZE));
+		return page_size;
+#else
+		return kilobyte_to_byte(4);
+#endif
+	}
+
+	void * NumaPageSource::allocate(size_type bytes, size_type node)
+	{
+		MEMORY_ASSERT(node < m_stats.size());
+
+		// whole system pages, the binding can't split them
+		const auto page_size = system_page_size();
+		const auto pages = (bytes + page_size - 1) / page_size;
+		auto * mem = global_aligned_alloc(pages * page_size, page_size);
+
+		// bound before the memory is touched, so the pages are created on the node
+		const bool placed = m_topology.bind(mem, pages * page_size, node) && m_topology.node_of(mem) == node;
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		auto & stats = m_stats[node];
+		stats.allocated_pages += pages;
+		stats.allocated_bytes += pages * page_size;
+		if (!placed)
+			stats.misplaced_pages += pages;
+		return mem;
+	}
+
+	void NumaPageSource::deallocate(void * mem, size_type bytes, size_type node)
+	{
+		MEMORY_ASSERT(node < m_stats.size());
+
+		const auto page_size = system_page_size();
+		const auto pages = (bytes + page_size - 1) / page_size;
+		global_aligned_dealloc(mem);
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		auto & stats = m_stats[node];
+		stats.allocated_pages -= pages;
+		stats.allocated_bytes -= pages * page_size;
+	}
+
+	NumaPageSource::NodeStats NumaPageSource::get_node_stats(size_type node) const
+	{
+		MEMORY_ASSERT(node < m_stats.size());
+
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		return m_stats[node];
+	}
+
+	NumaPageAllocator::NumaPageAllocator(NumaPageSource & source,
+										 size_type node,
+										 size_type obj_size,
+										 size_type obj_num)
+		// the virtual do_page_alloc can't be called from the constructor of the base
+		: Base{ obj_size, obj_num, false }
+		, m_source(source)
+		, m_node{ node }
+	{}
+	NumaPageAllocator::~NumaPageAllocator()
+	{
+		// the pages need to be given back to the source, not to the global allocator
+		deallocate_all_pages();
+	}
+
+	NumaPageAllocator::Page * NumaPageAllocator::do_page_alloc()
+	{
+		return init_page(m_source.allocate(get_page_size(), m_node));
+	}
+	void NumaPageAllocator::do_page_dealloc_internal(Page * page)
+	{
+		m_source.deallocate(page, get_page_size(), m_node);
+	}
+}
@@ -0,0 +1,176 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "PageAllocator.h"
+
+#include <map>
+#include <memory>	// std::unique_ptr
+#include <mutex>
+#include <vector>
+
+namespace memory
+{
+	/// \brief	Memory nodes of the machine and how to place memory on them.
+	class NumaTopology
+	{
+	public:
+		static constexpr size_type UNKNOWN_NODE = ~size_type{ 0u };
+
+		virtual ~NumaTopology() = default;
+
+		virtual size_type node_count() const = 0;
+		/// \brief	Node of the cpu the calling thread is running on.
+		virtual size_type current_node() const = 0;
+		/// \brief	Places the pages of the range in the node, the range needs to be aligned to the system pages.
+		///			Returns false if the memory could not be bound.
+		virtual bool bind(void * mem, size_type bytes, size_type node) = 0;
+		/// \brief	Node the memory is placed on, UNKNOWN_NODE if it can't be queried.
+		virtual size_type node_of(const void * mem) const = 0;
+	};
+
+	/// \brief	Topology of the machine, uses the mbind/get_mempolicy/getcpu system calls on Linux.
+	///			On other systems there is a single node and the memory is never bound.
+	class SystemNumaTopology
+		: public NumaTopology
+	{
+	public:
+		SystemNumaTopology();
+
+		size_type node_count() const override { return m_node_count; }
+		size_type current_node() const override;
+		bool bind(void * mem, size_type bytes, size_type node) override;
+		size_type node_of(const void * mem) const override;
+
+	private:
+		size_type m_node_count{ 1u };
+	};
+
+	/// \brief	Simulates a machine with several nodes, i.e. to test NUMA code on single node machines.
+	///			The node of the calling thread is chosen with set_current_node and bind only records the node.
+	class FakeNumaTopology
+		: public NumaTopology
+	{
+	public:
+		explicit FakeNumaTopology(size_type node_count);
+
+		size_type node_count() const override { return m_node_count; }
+		size_type current_node() const override;
+		bool bind(void * mem, size_type bytes, size_type node) override;
+		size_type node_of(const void * mem) const override;
+
+		/// \brief	Affects only the calling thread.
+		void set_current_node(size_type node);
+
+	private:
+		size_type m_node_count{ 0u };
+
+		mutable std::mutex m_mutex;
+		/// \brief	Start of every bound range to its end and node.
+		std::map<size_type, std::pair<size_type, size_type>> m_ranges;
+	};
+
+	/// \brief	Source of page sized memory placed on a given node of the topology.
+	///			The memory is aligned to the system pages and bound before it is returned,
+	///			it keeps statistics of the memory given to every node and where it was actually placed.
+	///			Thread safe, the pools of different nodes can share the source.
+	class NumaPageSource
+	{
+	public:
+		struct NodeStats
+		{
+			size_type allocated_pages{ 0u };
+			size_type allocated_bytes{ 0u };
+			/// \brief	Pages that could not be bound or that the system placed on a different node,
+			///			counts all the pages allocated since the source was created.
+			size_type misplaced_pages{ 0u };
+		};
+
+		explicit NumaPageSource(NumaTopology & topology);
+
+		NumaPageSource(const NumaPageSource &) = delete;
+		NumaPageSource & operator=(const NumaPageSource &) = delete;
+
+		void * allocate(size_type bytes, size_type node);
+		/// \brief	bytes and node need to be the ones used to allocate the memory.
+		void deallocate(void * mem, size_type bytes, size_type node);
+
+		NumaTopology & get_topology() const { return m_topology; }
+		NodeStats get_node_stats(size_type node) const;
+
+		/// \brief	Granularity of the binding, the allocations are rounded up to it.
+		static size_type system_page_size();
+
+	private:
+		NumaTopology & m_topology;
+
+		mutable std::mutex m_mutex;
+		std::vector<NodeStats> m_stats;
+	};
+
+	/// \brief	PageAllocator whose pages come from a NumaPageSource and are placed on one node.
+	///			The pages are allocated on demand.
+	class NumaPageAllocator
+		: public PageAllocator
+	{
+		using Base = PageAllocator;
+	public:
+		NumaPageAllocator(NumaPageSource & source,
+						  size_type node,
+						  size_type obj_size,
+						  size_type obj_num);
+		~NumaPageAllocator();
+
+		size_type get_node() const { return m_node; }
+
+	protected:
+		Page * do_page_alloc() override;
+		void do_page_dealloc_internal(Page * page) override;
+
+	private:
+		NumaPageSource & m_source;
+		size_type m_node{ 0u };
+	};
+
+	/// \brief	One pool per node of the topology, local() selects the pool of the node the calling
+	///			thread runs on. The pools are not made thread safe, the threads of one node share its pool.
+	template <typename Pool>
+	class PerNodePools
+	{
+	public:
+		/// \brief	make_pool(node) returns a std::unique_ptr<Pool> that allocates its memory on the node.
+		template <typename MakePool>
+		PerNodePools(const NumaTopology & topology, MakePool && make_pool)
+			: m_topology(topology)
+		{
+			for (size_type node = 0; node < topology.node_count(); ++node)
+				m_pools.push_back(make_pool(node));
+		}
+
+		Pool & local() { return on_node(local_node()); }
+		Pool & on_node(size_type node)
+		{
+			MEMORY_ASSERT(node < m_pools.size());
+			return *m_pools[node];
+		}
+
+		/// \brief	Falls back to the first node when the node of the thread is not known.
+		size_type local_node() const
+		{
+			const auto node = m_topology.current_node();
+			return node < m_pools.size() ? node : 0;
+		}
+		size_type node_count() const { return m_pools.size(); }
+
+	private:
+		const NumaTopology & m_topology;
+		std::vector<std::unique_ptr<Pool>> m_pools;
+	};
+}
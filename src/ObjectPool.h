@@ -0,0 +1,199 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "PageAllocator.h"
+
+#include <cstddef>		// offsetof
+#include <new>			// placement new
+#include <type_traits>	// std::is_trivially_destructible
+#include <utility>		// std::forward
+
+namespace memory
+{
+	/// \brief	Creates and destroys objects of type T in the pages of a PageAllocator.
+	///			Every slot knows if it holds a live object, so the live objects can be visited walking
+	///			the pages linearly and all of them can be destroyed at once.
+	///			reserve takes the slots of several objects in one allocate_bulk, the next creations use them.
+	///			PageAlloc can be PageAllocator or DebugPageAllocator.
+	template <typename T, typename PageAlloc = PageAllocator>
+	class ObjectPool
+		: private PageAlloc
+	{
+		using Page = typename PageAlloc::Page;
+
+		/// \brief	The free list of the allocator uses the beginning of the free slots,
+		///			the live flag needs to be after it.
+		struct Slot
+		{
+			alignas(T) unsigned char m_storage[sizeof(T) < sizeof(void *) ? sizeof(void *) : sizeof(T)];
+			bool m_live;
+		};
+		static_assert(alignof(Slot) <= alignof(void *), "PageAllocator only aligns the objects to pointers.");
+
+	public:
+		explicit ObjectPool(size_type objects_per_page = 64)
+			// pages are allocated on demand, the virtual do_page_alloc can't be called from the constructor
+			: PageAlloc{ sizeof(Slot), objects_per_page, false }
+		{
+			// the live flag is also read and written in the free slots
+			PageAlloc::keep_free_bytes(offsetof(Slot, m_live), sizeof(bool));
+		}
+		~ObjectPool()
+		{
+			destroy_all();
+		}
+
+		ObjectPool(const ObjectPool &) = delete;
+		ObjectPool & operator=(const ObjectPool &) = delete;
+
+		template <typename... Args>
+		T * create(Args &&... args)
+		{
+			auto * slot = m_reserved ? pop_reserved() : reinterpret_cast<Slot *>(PageAlloc::allocate());
+			try
+			{
+				new (slot->m_storage) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				release_slot(slot);
+				throw;
+			}
+
+			slot->m_live = true;
+			m_live_objects++;
+			return as_object(slot);
+		}
+
+		void destroy(T * obj)
+		{
+			auto * slot = reinterpret_cast<Slot *>(obj);
+			MEMORY_ASSERT(PageAlloc::owns(slot) && slot->m_live);
+
+			obj->~T();
+			release_slot(slot);
+			m_live_objects--;
+		}
+
+		/// \brief	Destroys all the objects and releases the pages.
+		///			When T is trivially destructible the objects are not visited, the pages are dropped.
+		void destroy_all()
+		{
+			if (!std::is_trivially_destructible<T>::value)
+			{
+				for_each_live_slot([](Slot * slot) { as_object(slot)->~T(); });
+			}
+
+			PageAlloc::deallocate_all();
+			m_live_objects = 0;
+			m_reserved = nullptr;
+			m_reserved_num = 0;
+		}
+
+		/// \brief	Takes the slots of n more objects from the allocator at once, in the order of the pages.
+		///			For the allocator they are allocated until the objects created in them are destroyed.
+		void reserve(size_type n)
+		{
+			constexpr size_type BATCH = 64;
+			void * slots[BATCH];
+			while (n > 0)
+			{
+				const auto count = n < BATCH ? n : BATCH;
+				PageAlloc::allocate_bulk(slots, count);
+				// pushed backwards so the first slot is the first one created
+				for (auto i = count; i > 0; --i)
+					push_reserved(reinterpret_cast<Slot *>(slots[i - 1]));
+				n -= count;
+			}
+		}
+
+		/// \brief	Calls f with every live object, walking the slots of each page in order.
+		template <typename F>
+		void for_each_live(F && f)
+		{
+			for_each_live_slot([&](Slot * slot) { f(*as_object(slot)); });
+		}
+		template <typename F>
+		void for_each_live(F && f) const
+		{
+			for_each_live_slot([&](Slot * slot) { f(static_cast<const T &>(*as_object(slot))); });
+		}
+
+		bool owns(const T * obj) const { return PageAlloc::owns(const_cast<T *>(obj)); }
+		size_type live_objects() const { return m_live_objects; }
+		size_type reserved_objects() const { return m_reserved_num; }
+
+		using PageAlloc::allocated_pages;
+		using PageAlloc::get_per_page_obj_num;
+
+		/// \brief	Underlying allocator, i.e. to read the statistics of DebugPageAllocator.
+		const PageAlloc & get_page_allocator() const { return *this; }
+
+	protected:
+		/// \brief	The slots of new pages are not live.
+		Page * do_page_alloc() override
+		{
+			auto * page = PageAlloc::do_page_alloc();
+
+			auto * slots = reinterpret_cast<Slot *>(PageAlloc::offset_to_memory(page));
+			for (size_type i = 0; i < PageAlloc::get_per_page_obj_num(); ++i)
+				slots[i].m_live = false;
+
+			return page;
+		}
+
+	private:
+		static T * as_object(Slot * slot) { return reinterpret_cast<T *>(slot->m_storage); }
+		static Slot *& next_reserved(Slot * slot) { return *reinterpret_cast<Slot **>(slot->m_storage); }
+
+		void push_reserved(Slot * slot)
+		{
+			// the debug allocators fill the whole slot when allocating it
+			slot->m_live = false;
+			next_reserved(slot) = m_reserved;
+			m_reserved = slot;
+			m_reserved_num++;
+		}
+		Slot * pop_reserved()
+		{
+			auto * slot = m_reserved;
+			m_reserved = next_reserved(slot);
+			m_reserved_num--;
+			return slot;
+		}
+
+		void release_slot(Slot * slot)
+		{
+			PageAlloc::deallocate(slot);
+			// after deallocating, the debug allocators fill the whole slot with patterns
+			slot->m_live = false;
+		}
+
+		template <typename F>
+		void for_each_live_slot(F && f) const
+		{
+			const auto slot_num = PageAlloc::get_per_page_obj_num();
+			PageAlloc::for_each_page([&](void * objects)
+			{
+				auto * slots = reinterpret_cast<Slot *>(objects);
+				for (size_type i = 0; i < slot_num; ++i)
+				{
+					if (slots[i].m_live)
+						f(slots + i);
+				}
+			});
+		}
+
+		size_type m_live_objects{ 0u };
+		Slot * m_reserved{ nullptr };
+		size_type m_reserved_num{ 0u };
+	};
+}
@@ -0,0 +1,85 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+/// Replaces the global operator new/delete (all the sized, aligned and nothrow overloads) with the
+/// ThreadCachedAllocator. It is not part of the library, link it to the executables that want it
+/// (the memory_operator_new object library in CMake).
+/// The aligned overloads need C++17, the sized deallocations need -fsized-deallocation on C++14.
+
+#include "ThreadCachedAllocator.h"
+
+#include <cstddef>
+#include <new>
+
+namespace
+{
+	/// \brief	Behaves as the standard operator new, calls the new handler until the memory can be allocated.
+	void * allocate_or_throw(std::size_t bytes, std::size_t alignment)
+	{
+		for (;;)
+		{
+			auto * mem = alignment ? memory::ThreadCachedAllocator::allocate_aligned(bytes, alignment)
+								   : memory::ThreadCachedAllocator::allocate(bytes);
+			if (mem)	return mem;
+
+			auto handler = std::get_new_handler();
+			if (handler == nullptr)
+				throw std::bad_alloc{};
+			handler();
+		}
+	}
+
+	void * allocate_nothrow(std::size_t bytes, std::size_t alignment) noexcept
+	{
+		try
+		{
+			return allocate_or_throw(bytes, alignment);
+		}
+		catch (...)
+		{
+			return nullptr;
+		}
+	}
+}
+
+void * operator new(std::size_t bytes) { return allocate_or_throw(bytes, 0); }
+void * operator new[](std::size_t bytes) { return allocate_or_throw(bytes, 0); }
+void * operator new(std::size_t bytes, const std::nothrow_t &) noexcept { return allocate_nothrow(bytes, 0); }
+void * operator new[](std::size_t bytes, const std::nothrow_t &) noexcept { return allocate_nothrow(bytes, 0); }
+
+void operator delete(void * mem) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+void operator delete[](void * mem) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+void operator delete(void * mem, const std::nothrow_t &) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+void operator delete[](void * mem, const std::nothrow_t &) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+
+// the size skips the lookup in the page map
+void operator delete(void * mem, std::size_t bytes) noexcept { memory::ThreadCachedAllocator::sized_free(mem, bytes); }
+void operator delete[](void * mem, std::size_t bytes) noexcept { memory::ThreadCachedAllocator::sized_free(mem, bytes); }
+
+#if defined(__cpp_aligned_new)
+
+void * operator new(std::size_t bytes, std::align_val_t alignment) { return allocate_or_throw(bytes, static_cast<std::size_t>(alignment)); }
+void * operator new[](std::size_t bytes, std::align_val_t alignment) { return allocate_or_throw(bytes, static_cast<std::size_t>(alignment)); }
+void * operator new(std::size_t bytes, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return allocate_nothrow(bytes, static_cast<std::size_t>(alignment));
+}
+void * operator new[](std::size_t bytes, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return allocate_nothrow(bytes, static_cast<std::size_t>(alignment));
+}
+
+// the aligned allocations are rounded up to the alignment, the size alone does not tell their size class
+void operator delete(void * mem, std::align_val_t) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+void operator delete[](void * mem, std::align_val_t) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+void operator delete(void * mem, std::align_val_t, const std::nothrow_t &) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+void operator delete[](void * mem, std::align_val_t, const std::nothrow_t &) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+void operator delete(void * mem, std::size_t, std::align_val_t) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+void operator delete[](void * mem, std::size_t, std::align_val_t) noexcept { memory::ThreadCachedAllocator::deallocate(mem); }
+
+#endif
@@ -1,6 +1,10 @@
 
 #include "PageAllocator.h"
 
+#include <algorithm>	// std::sort, std::upper_bound
+#include <iterator>		// std::prev
+#include <utility>		// std::pair
+
 namespace memory
 {
 	namespace impl
@@ -45,6 +49,28 @@ namespace memory
 				}
 			}
 		}
+		size_type FreeList::extract_n(void ** out, size_type n)
+		{
+			size_type extracted = 0;
+			auto * curr = m_head;
+			while (curr && extracted < n)
+			{
+				out[extracted++] = curr;
+				curr = curr->m_next;
+			}
+
+			m_head = curr;
+			return extracted;
+		}
+		void FreeList::insert_n(void ** in, size_type n)
+		{
+			if (n == 0)	return;
+
+			for (size_type i = 0; i + 1 < n; ++i)
+				reinterpret_cast<Object *>(in[i])->m_next = reinterpret_cast<Object *>(in[i + 1]);
+			reinterpret_cast<Object *>(in[n - 1])->m_next = m_head;
+			m_head = reinterpret_cast<Object *>(in[0]);
+		}
 		void FreeList::insert_all(void * mem_start, size_type object_size, size_type object_num)
 		{
 			unsigned char * raw = reinterpret_cast<unsigned char *>(mem_start);
@@ -71,10 +97,12 @@ namespace memory
 
 	PageAllocator::PageAllocator(size_type obj_size, 
 								 size_type obj_num,
-								 bool allocate_first_page)
+								 bool allocate_first_page,
+								 size_type colors)
 		: m_object_num{ obj_num }
 		// we need to be able to link the memory chunks
 		, m_object_size{ obj_size < m_free_list.min_size() ? m_free_list.min_size() : obj_size }
+		, m_colors{ colors ? colors : 1 }
 	{
 		if (allocate_first_page)
 			allocate_page();
@@ -84,24 +112,32 @@ namespace memory
 		deallocate_all_pages();
 	}
 
-	inline void * PageAllocator::offset_to_memory(Page * page) const
-	{
-		return reinterpret_cast<void *>(page + 1);
-	}
-	inline size_type PageAllocator::get_page_size() const
+	size_type PageAllocator::get_page_size() const
 	{
-		return m_object_num * m_object_size + sizeof(void*);
+		// room for the offset of the biggest color
+		return m_object_num * m_object_size + header_size() + (m_colors - 1) * CACHE_LINE_SIZE;
 	}
 
 	PageAllocator::Page * PageAllocator::do_page_alloc()
 	{
-		return as_page(global_alloc(get_page_size()));
+		return init_page(global_alloc(get_page_size()));
+	}
+	PageAllocator::Page * PageAllocator::init_page(void * mem)
+	{
+		auto * page = as_page(mem);
+		if (m_colors > 1)
+		{
+			*reinterpret_cast<size_type *>(page + 1) = m_next_color * CACHE_LINE_SIZE;
+			m_next_color = (m_next_color + 1) % m_colors;
+		}
+		return page;
 	}
 	void PageAllocator::do_page_dealloc(Page * page, bool remove_objects_from_free_list)
 	{
 		if (remove_objects_from_free_list)
 			m_free_list.remove_all(offset_to_memory(page), m_object_size, m_object_num);
 
+		unpoison_memory(page, get_page_size());
 		do_page_dealloc_internal(page);
 	}
 	void PageAllocator::do_page_dealloc_internal(Page * page)
@@ -111,13 +147,19 @@ namespace memory
 
 	void PageAllocator::allocate_page()
 	{
-		Page * new_page = do_page_alloc();
-		new_page->m_next = m_pages;
-		m_pages = new_page;
+		Page * new_page = link_new_page();
 
 		// STUDY(Borja): we could track the number of free objects we have in the current page and in that way we could avoid this O(N) operation.
 		// add all the objects to the free list
 		m_free_list.insert_all(offset_to_memory(new_page), m_object_size, m_object_num);
+		poison_free_objects(offset_to_memory(new_page), m_object_num);
+	}
+	PageAllocator::Page * PageAllocator::link_new_page()
+	{
+		Page * new_page = do_page_alloc();
+		new_page->m_next = m_pages;
+		m_pages = new_page;
+		return new_page;
 	}
 	void PageAllocator::deallocate_all_pages()
 	{
@@ -137,14 +179,67 @@ namespace memory
 	{
 		if (m_free_list.empty())	allocate_page();
 
-		return m_free_list.extract();
+		auto * mem = m_free_list.extract();
+		sanitizer_allocate(mem, m_object_size);
+		trace_allocation(this, mem, m_object_size, alignof(Page));
+		return mem;
 	}
 	void PageAllocator::deallocate(void * mem)
 	{
 		MEMORY_ASSERT(owns(mem));
+		trace_deallocation(this, mem, m_object_size, alignof(Page));
+		sanitizer_deallocate(mem, m_object_size);
+		unpoison_free_object(mem);
 		m_free_list.insert(mem);
 	}
 
+	void PageAllocator::allocate_bulk(void ** out, size_type n)
+	{
+		auto allocated = m_free_list.extract_n(out, n);
+		while (allocated < n)
+		{
+			// carve the objects from a new page, only the ones we don't need go to the free list
+			auto * objects = reinterpret_cast<unsigned char *>(offset_to_memory(link_new_page()));
+			const auto remaining = n - allocated;
+			const auto carved = remaining < m_object_num ? remaining : m_object_num;
+			for (size_type i = 0; i < carved; ++i)
+				out[allocated++] = objects + i * m_object_size;
+
+			m_free_list.insert_all(objects + carved * m_object_size, m_object_size, m_object_num - carved);
+			poison_free_objects(objects + carved * m_object_size, m_object_num - carved);
+		}
+
+		for (size_type i = 0; i < n; ++i)
+		{
+			sanitizer_allocate(out[i], m_object_size);
+			trace_allocation(this, out[i], m_object_size, alignof(Page));
+		}
+	}
+	void PageAllocator::deallocate_bulk(void ** in, size_type n)
+	{
+		for (size_type i = 0; i < n; ++i)
+		{
+			MEMORY_ASSERT(owns(in[i]));
+			trace_deallocation(this, in[i], m_object_size, alignof(Page));
+			sanitizer_deallocate(in[i], m_object_size);
+			unpoison_free_object(in[i]);
+		}
+
+		m_free_list.insert_n(in, n);
+	}
+
+	void PageAllocator::deallocate_all()
+	{
+		deallocate_all_pages();
+	}
+
+	void PageAllocator::keep_free_bytes(size_type offset, size_type bytes)
+	{
+		MEMORY_ASSERT(offset >= m_free_list.min_size() && offset + bytes <= m_object_size);
+		m_kept_offset = offset;
+		m_kept_bytes = bytes;
+	}
+
 	bool PageAllocator::owns(void * mem) const
 	{
 		for (auto * curr = m_pages; curr != nullptr; curr = curr->m_next)
@@ -156,6 +251,24 @@ namespace memory
 		return false;
 	}
 
+	void PageAllocator::poison_free_objects(void * mem_start, size_type object_num)
+	{
+		auto * raw = reinterpret_cast<unsigned char *>(mem_start);
+		const auto kept_end = m_kept_offset + m_kept_bytes;
+		for (size_type i = 0; i < object_num; ++i)
+		{
+			poison_memory(raw + m_free_list.min_size(), m_kept_offset - m_free_list.min_size());
+			poison_memory(raw + kept_end, m_object_size - kept_end);
+			raw += m_object_size;
+		}
+	}
+	void PageAllocator::unpoison_free_object(void * mem)
+	{
+		auto * raw = reinterpret_cast<unsigned char *>(mem);
+		unpoison_memory(raw, m_free_list.min_size());
+		unpoison_memory(raw + m_kept_offset, m_kept_bytes);
+	}
+
 	bool PageAllocator::belongs_to_page(Page * page, void * mem) const
 	{
 		const auto page_int = static_cast<size_type>(reinterpret_cast<std::ptrdiff_t>(offset_to_memory(page)));
@@ -173,6 +286,24 @@ namespace memory
 		return false;
 	}
 
+	std::vector<size_type> PageAllocator::free_objects_per_page() const
+	{
+		// the pages sorted by address, to find the page of each free object with a binary search
+		std::vector<std::pair<size_type, size_type>> pages;
+		for (auto * curr = m_pages; curr != nullptr; curr = curr->m_next)
+			pages.emplace_back(ptr_to_num(offset_to_memory(curr)), pages.size());
+		std::sort(pages.begin(), pages.end());
+
+		std::vector<size_type> free_objects(pages.size(), 0u);
+		m_free_list.for_each([&](void * obj)
+		{
+			const auto it = std::upper_bound(pages.begin(), pages.end(), std::make_pair(ptr_to_num(obj), pages.size()));
+			MEMORY_ASSERT(it != pages.begin());
+			free_objects[std::prev(it)->second]++;
+		});
+		return free_objects;
+	}
+
 	size_type PageAllocator::allocated_pages() const
 	{
 		size_type page_num = 0;
@@ -188,36 +319,204 @@ namespace memory
 
 	DebugPageAllocator::DebugPageAllocator(size_type obj_size,
 					   size_type obj_num,
-					   bool allocate_page)
-		: Base{ obj_size, obj_num, allocate_page }
-	{}
+					   bool allocate_page,
+					   size_type colors)
+		: Base{ obj_size, obj_num, allocate_page, colors }
+		, m_requested_obj_size{ obj_size }
+	{
+		// the page of the base constructor was not filled nor counted, the debug do_page_alloc can't be called from it
+		m_stats.allocated_pages = allocated_pages();
+		for_each_free_object([&](void * obj)
+		{
+			fill_with_pattern(DebugPattern::ACQUIRED, reinterpret_cast<unsigned char *>(obj) + link_size(), get_obj_size() - link_size());
+			m_stats.free_objects++;
+		});
+	}
 	DebugPageAllocator::~DebugPageAllocator()
 	{
 		deallocate_all_pages();
 	}
 	void * DebugPageAllocator::allocate()
 	{
+		// the object comes from the pages if the guard can't map its own
+		auto * guarded = m_guard && m_guard->should_guard() ? m_guard->allocate(get_obj_size(), guarded_alignment()) : nullptr;
+		if (guarded != nullptr)
+		{
+			fill_with_pattern(DebugPattern::ALLOCATED, guarded, get_obj_size());
+			m_stats.guarded_objects++;
+			return guarded;
+		}
+
 		auto * mem = Base::allocate();
+		check_reused(mem);
 		fill_with_pattern(DebugPattern::ALLOCATED, mem, get_obj_size());
 		
 		m_stats.allocated_objects++;
 		m_stats.free_objects--;
+		if (m_stats.allocated_objects > m_stats.max_allocated_objects)
+			m_stats.max_allocated_objects = m_stats.allocated_objects;
 
 		return mem;
 	}
 	void DebugPageAllocator::deallocate(void * ptr)
 	{
-		fill_with_pattern(DebugPattern::DEALLOCATED, ptr, get_obj_size());
+		if (is_guarded(ptr))
+		{
+			m_guard->deallocate(reinterpret_cast<unsigned char *>(ptr), get_obj_size());
+			m_stats.guarded_objects--;
+			return;
+		}
+
+		fill_freed(ptr);
 		Base::deallocate(ptr);
 
 		m_stats.allocated_objects--;
 		m_stats.free_objects++;
 	}
 
+	void DebugPageAllocator::allocate_bulk(void ** out, size_type n)
+	{
+		// the guarded objects first, the rest come from the pages in one pass
+		size_type guarded = 0;
+		if (m_guard)
+		{
+			for (size_type i = 0; i < n; ++i)
+			{
+				auto * mem = m_guard->should_guard() ? m_guard->allocate(get_obj_size(), guarded_alignment()) : nullptr;
+				if (mem != nullptr)
+					out[guarded++] = mem;
+			}
+			m_stats.guarded_objects += guarded;
+		}
+
+		Base::allocate_bulk(out + guarded, n - guarded);
+		for (size_type i = guarded; i < n; ++i)
+			check_reused(out[i]);
+		for (size_type i = 0; i < n; ++i)
+			fill_with_pattern(DebugPattern::ALLOCATED, out[i], get_obj_size());
+
+		m_stats.allocated_objects += n - guarded;
+		m_stats.free_objects -= n - guarded;
+		if (m_stats.allocated_objects > m_stats.max_allocated_objects)
+			m_stats.max_allocated_objects = m_stats.allocated_objects;
+	}
+	void DebugPageAllocator::deallocate_bulk(void ** in, size_type n)
+	{
+		// consecutive objects of the pages are deallocated together
+		size_type start = 0;
+		while (start < n)
+		{
+			if (is_guarded(in[start]))
+			{
+				deallocate(in[start++]);
+				continue;
+			}
+
+			size_type end = start + 1;
+			while (end < n && !is_guarded(in[end]))
+				++end;
+
+			for (size_type i = start; i < end; ++i)
+				fill_freed(in[i]);
+			Base::deallocate_bulk(in + start, end - start);
+
+			m_stats.allocated_objects -= end - start;
+			m_stats.free_objects += end - start;
+			start = end;
+		}
+	}
+	void DebugPageAllocator::deallocate_all()
+	{
+		if (m_guard)
+			m_guard->deallocate_all();
+		m_stats.guarded_objects = 0;
+
+		// the pages only account for the free objects when they are released
+		m_stats.free_objects += m_stats.allocated_objects;
+		m_stats.allocated_objects = 0;
+		Base::deallocate_all();
+	}
+
+	void DebugPageAllocator::enable_guard_pages(const GuardPageConfig & config)
+	{
+		m_guard.reset(new GuardPageAllocator{ config });
+	}
+
+	AllocatorAnalytics DebugPageAllocator::get_analytics() const
+	{
+		AllocatorAnalytics analytics;
+		analytics.requested_bytes = m_stats.allocated_objects * m_requested_obj_size;
+		analytics.granted_bytes = m_stats.allocated_objects * get_obj_size();
+		analytics.free_bytes = m_stats.free_objects * get_obj_size();
+		analytics.largest_free_block = analytics.free_bytes;
+		analytics.high_water_mark = m_stats.max_allocated_objects * get_obj_size();
+
+		for (auto free_objects : free_objects_per_page())
+			analytics.add_page(get_per_page_obj_num() - free_objects, get_per_page_obj_num());
+		return analytics;
+	}
+
+	void DebugPageAllocator::defer_fills(bool defer)
+	{
+		if (!defer)
+			m_deferred_fills.flush();
+		m_defer_fills = defer;
+	}
+
+	bool DebugPageAllocator::verify_heap()
+	{
+		m_deferred_fills.flush();
+
+		bool valid = true;
+		for_each_free_object([&](void * obj)
+		{
+			valid &= verify_free_object(reinterpret_cast<unsigned char *>(obj));
+		});
+		return valid;
+	}
+
+	void DebugPageAllocator::fill_freed(void * mem)
+	{
+		// the link of the free list is written after the fill
+		auto * bytes = reinterpret_cast<unsigned char *>(mem);
+		if (m_defer_fills)
+		{
+			// the kept bytes are written by the user after deallocating
+			const auto kept_end = get_kept_offset() + get_kept_bytes();
+			if (get_kept_offset() > link_size())
+				m_deferred_fills.add(bytes + link_size(), get_kept_offset() - link_size(), DebugPattern::DEALLOCATED);
+			if (kept_end < get_obj_size())
+				m_deferred_fills.add(bytes + kept_end, get_obj_size() - kept_end, DebugPattern::DEALLOCATED);
+		}
+		else
+			fill_with_pattern(DebugPattern::DEALLOCATED, bytes, get_obj_size());
+	}
+
+	void DebugPageAllocator::check_reused(void * mem)
+	{
+		auto * bytes = reinterpret_cast<unsigned char *>(mem);
+		if (!m_deferred_fills.cancel(bytes + link_size(), get_obj_size() - link_size()))
+			verify_free_object(bytes);
+	}
+
+	bool DebugPageAllocator::verify_free_object(const unsigned char * obj) const
+	{
+		const auto kept_end = get_kept_offset() + get_kept_bytes();
+		const bool before = verify_free_pattern(this, obj + link_size(), get_kept_offset() - link_size());
+		return verify_free_pattern(this, obj + kept_end, get_obj_size() - kept_end) && before;
+	}
+
+	size_type DebugPageAllocator::guarded_alignment() const
+	{
+		const auto alignment = size_type{ 1u } << find_first_set(get_obj_size());
+		return alignment < alignof(std::max_align_t) ? alignment : alignof(std::max_align_t);
+	}
+
 	DebugPageAllocator::Page * DebugPageAllocator::do_page_alloc()
 	{
 		auto * page = Base::do_page_alloc();
-		fill_with_pattern(DebugPattern::ACQUIRED, page, get_page_size());
+		// the header has the color of the page
+		fill_with_pattern(DebugPattern::ACQUIRED, reinterpret_cast<unsigned char *>(page) + header_size(), get_page_size() - header_size());
 		
 		m_stats.allocated_pages++;
 		m_stats.free_objects += get_per_page_obj_num();
@@ -226,6 +525,8 @@ namespace memory
 	}
 	void DebugPageAllocator::do_page_dealloc_internal(Page * page)
 	{
+		m_deferred_fills.cancel(page, get_page_size());
+
 		// if we call delete on the memory of the page, the runtime library may put its own
 		// pattern, just in case it does not (i.e. release build)
 		fill_with_pattern(DebugPattern::RELEASED, page, get_page_size());
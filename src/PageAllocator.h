@@ -9,6 +9,17 @@ found in the top-level directory of this distribution.
 #pragma once
 
 #include "MemoryCore.h"
+#include "AllocationTrace.h"
+
+#include <vector>
+
+#if MEMORY_DEBUG_ENABLED
+#include "AllocatorAnalytics.h"
+#include "DebugPatterns.h"
+#include "GuardPageAllocator.h"
+
+#include <memory>	// std::unique_ptr
+#endif
 
 namespace memory
 {
@@ -26,10 +37,21 @@ namespace memory
 			void * extract();
 			void insert(void * mem);
 			void remove(void * mem);
+			/// \brief	Extracts up to n objects in a single pass, returns how many were extracted.
+			size_type extract_n(void ** out, size_type n);
+			/// \brief	Links the n objects between them and then attaches them to the list.
+			void insert_n(void ** in, size_type n);
 			void insert_all(void * mem_start, size_type object_size, size_type object_num);
 			void remove_all(void * mem_start, size_type object_size, size_type object_num);
 			void clear() { m_head = nullptr; }
 
+			template <typename F>
+			void for_each(F && f) const
+			{
+				for (auto * curr = m_head; curr != nullptr; curr = curr->m_next)
+					f(reinterpret_cast<void *>(curr));
+			}
+
 			bool empty() const;
 
 		private:
@@ -41,6 +63,9 @@ namespace memory
 	/// \brief	Allocates a chunk of memory big enough to hold N objects of size S.
 	///			Can only retrieve one object when the user calls to allocate. 
 	///			(i.e. Cannot be used to allocate arrays)
+	///			With more than one color the objects of each new page start CACHE_LINE_SIZE bytes after
+	///			the ones of the previous page (rotating through the colors), so the first objects of
+	///			the pages don't compete for the same cache sets.
 	class PageAllocator
 	{
 	protected:
@@ -50,35 +75,88 @@ namespace memory
 	public:
 		PageAllocator(size_type obj_size,
 					  size_type obj_num,
-					  bool allocate_page = true);
+					  bool allocate_page = true,
+					  size_type colors = 1);
 		virtual ~PageAllocator();
 
 		virtual void * allocate();
 		virtual void deallocate(void * mem);
 
+		/// \brief	Allocates n objects, taking them from the free list in one pass or 
+		///			as contiguous objects of new pages when the free list runs out.
+		virtual void allocate_bulk(void ** out, size_type n);
+		virtual void deallocate_bulk(void ** in, size_type n);
+
 		size_type get_page_size() const;
 		size_type allocated_pages() const;
 
 		size_type get_obj_size() const { return m_object_size; }
 		size_type get_per_page_obj_num() const { return m_object_num; }
+		size_type get_colors() const { return m_colors; }
 
 		bool owns(void * mem) const;
 
+		/// \brief	Bytes of the free objects the user writes after deallocating them (i.e. the live flag
+		///			of ObjectPool), they are not poisoned for the sanitizers nor verified by the debug allocator.
+		void keep_free_bytes(size_type offset, size_type bytes);
+
+		/// \brief	Releases all the pages at once, all the allocated objects become invalid.
+		virtual void deallocate_all();
+
+		/// \brief	Calls f with the memory of the first object of every page, 
+		///			the objects are get_obj_size() bytes apart.
+		template <typename F>
+		void for_each_page(F && f) const
+		{
+			for (auto * curr = m_pages; curr != nullptr; curr = curr->m_next)
+				f(offset_to_memory(curr));
+		}
+
 	protected:
-		/// \brief	Allocates memory for the page.
+		/// \brief	Calls f with every object in the free list.
+		template <typename F>
+		void for_each_free_object(F && f) const
+		{
+			m_free_list.for_each(f);
+		}
+		/// \brief	Number of free objects of each page, in the order of for_each_page.
+		std::vector<size_type> free_objects_per_page() const;
+		size_type get_kept_offset() const { return m_kept_offset; }
+		size_type get_kept_bytes() const { return m_kept_bytes; }
+
+		/// \brief	Allocates memory for the page, overrides that don't call the base one need to
+		///			give the memory to init_page.
 		virtual Page * do_page_alloc();
 		/// \brief	Deallocates the memory of the page.
 		void do_page_dealloc(Page * page, bool remove_objects_from_free_list = true);
 		virtual void do_page_dealloc_internal(Page * page);
 		void deallocate_all_pages();
 
+		/// \brief	Writes the color of a new page.
+		Page * init_page(void * mem);
+		/// \brief	Colored pages store the offset of their color after the Page.
+		size_type header_size() const { return m_colors > 1 ? sizeof(Page) + sizeof(size_type) : sizeof(Page); }
+
+		void * offset_to_memory(Page * page) const
+		{
+			if (m_colors <= 1)	return reinterpret_cast<void *>(page + 1);
+
+			const auto color_offset = *reinterpret_cast<const size_type *>(page + 1);
+			return reinterpret_cast<unsigned char *>(page) + header_size() + color_offset;
+		}
+
 	private:
+		/// \brief	Poisons the free objects for the sanitizers, all but the link of the free list and the kept bytes.
+		void poison_free_objects(void * mem_start, size_type object_num);
+		/// \brief	Makes the link and the kept bytes of a deallocated object accessible again.
+		void unpoison_free_object(void * mem);
 		bool belongs_to_page(Page * page, void * mem) const;
 		Page * as_page(void * p) { return reinterpret_cast<Page *>(p); }
-		void * offset_to_memory(Page * page) const;
 
 		/// \brief	Allocates a new page and links it.
 		void allocate_page();
+		/// \brief	Allocates a new page and links it, without adding its objects to the free list.
+		Page * link_new_page();
 
 	private:
 		Page * m_pages{ nullptr };
@@ -86,6 +164,12 @@ namespace memory
 
 		size_type m_object_num{ 0 };
 		size_type m_object_size{ 0 };
+
+		size_type m_colors{ 1 };
+		size_type m_next_color{ 0 };
+
+		size_type m_kept_offset{ impl::FreeList::min_size() };
+		size_type m_kept_bytes{ 0 };
 	};
 
 #if MEMORY_DEBUG_ENABLED
@@ -102,24 +186,65 @@ namespace memory
 			size_type allocated_pages{ 0u };
 			size_type allocated_objects{ 0u };
 			size_type free_objects{ 0u };
+			/// \brief	Live objects that got their own guard page, they are not in allocated_objects.
+			size_type guarded_objects{ 0u };
+			/// \brief	Maximum of allocated_objects.
+			size_type max_allocated_objects{ 0u };
 		};
 
 	public:
 		DebugPageAllocator(size_type obj_size,
 						   size_type obj_num,
-						   bool allocate_page = true);
+						   bool allocate_page = true,
+						   size_type colors = 1);
 		~DebugPageAllocator();
 
 		void * allocate() override;
 		void deallocate(void * ptr) override;
+		void allocate_bulk(void ** out, size_type n) override;
+		void deallocate_bulk(void ** in, size_type n) override;
+		void deallocate_all() override;
+
+		/// \brief	The sampled objects are served by a GuardPageAllocator instead of the pages, so an
+		///			overrun faults right away. owns is false for them. Needs to be called before allocating.
+		void enable_guard_pages(const GuardPageConfig & config = GuardPageConfig{});
+		const GuardPageAllocator * get_guard() const { return m_guard.get(); }
+
+		/// \brief	The free objects are filled in batches, the ones allocated again before are never filled.
+		void defer_fills(bool defer);
+		/// \brief	Checks that nobody wrote to the free objects, the corruptions go to the corruption callback.
+		///			The objects are also checked when they are allocated again.
+		bool verify_heap();
 
 		const Stats & get_stats() const { return m_stats; }
+		/// \brief	The objects of the pages, without the guarded ones. The requested bytes use the object size
+		///			given to the constructor, the granted ones the size of the objects in the pages.
+		AllocatorAnalytics get_analytics() const;
+
+	protected:
+		Page * do_page_alloc() override;
+		void do_page_dealloc_internal(Page * page) override;
 
 	private:
-		Page * do_page_alloc();
-		void do_page_dealloc_internal(Page * page);
+		bool is_guarded(void * mem) const
+		{
+			return m_guard && m_guard->owns(reinterpret_cast<const unsigned char *>(mem));
+		}
+		/// \brief	Biggest power of two that divides the object size, as the objects in the pages.
+		size_type guarded_alignment() const;
+
+		/// \brief	The free list uses the beginning of the free objects.
+		static size_type link_size() { return impl::FreeList::min_size(); }
+		void fill_freed(void * mem);
+		/// \brief	Verifies the pattern of an object that was in the free list.
+		void check_reused(void * mem);
+		bool verify_free_object(const unsigned char * obj) const;
 
 		Stats m_stats;
+		size_type m_requested_obj_size{ 0u };
+		std::unique_ptr<GuardPageAllocator> m_guard;
+		impl::DeferredFills m_deferred_fills;
+		bool m_defer_fills{ false };
 	};
 
 #endif
@@ -0,0 +1,214 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "PageMapAllocator.h"
+#include "AllocationTrace.h"
+
+namespace memory
+{
+	namespace impl
+	{
+		constexpr size_type PAGE_MAP_ALIGNMENT = 4096;
+	}
+
+	PageMapAllocator::PageMapAllocator(bool traced)
+		// the system gives zeroed memory, the parts of the page map that are never used are not touched
+		: m_root{ reinterpret_cast<Entry **>(system_map(ROOT_BYTES, impl::PAGE_MAP_ALIGNMENT)) }
+		, m_traced{ traced }
+	{
+		for (auto & list : m_free_lists)
+			list = nullptr;
+	}
+
+	PageMapAllocator::~PageMapAllocator()
+	{
+		// the page map knows all the spans, the ones of the size classes and the big allocations
+		for (size_type root = 0; root < (size_type{ 1u } << ROOT_BITS); ++root)
+		{
+			auto * leaf = m_root[root];
+			if (leaf == nullptr)	continue;
+
+			for (size_type i = 0; i < (size_type{ 1u } << LEAF_BITS); ++i)
+			{
+				if (leaf[i] == 0)	continue;
+
+				const auto span = ((root << LEAF_BITS) | i) << SPAN_SHIFT;
+				const auto spans = (leaf[i] & LARGE_SPAN) ? (leaf[i] & ~LARGE_SPAN) : 1;
+				system_unmap(reinterpret_cast<void *>(span), spans << SPAN_SHIFT);
+			}
+			system_unmap(leaf, LEAF_BYTES);
+		}
+		system_unmap(m_root, ROOT_BYTES);
+	}
+
+	void * PageMapAllocator::allocate(size_type bytes)
+	{
+		const auto class_idx = SizeClassAllocator::class_index(bytes);
+		if (class_idx == SizeClassAllocator::CLASS_NUM)
+			return allocate_large(bytes);
+
+		if (m_free_lists[class_idx] == nullptr && !refill(class_idx))
+			return nullptr;
+
+		auto * mem = pop(class_idx);
+		if (m_traced)
+			trace_allocation(this, mem, bytes, SizeClassAllocator::class_size(class_idx));
+		return mem;
+	}
+
+	void * PageMapAllocator::allocate_aligned(size_type bytes, size_type alignment)
+	{
+		MEMORY_ASSERT(is_power_of_two(alignment));
+
+		// the objects of the size classes are aligned to their size and the big allocations to the spans
+		if (alignment <= SPAN_SIZE)
+			return allocate(bytes < alignment ? alignment : bytes);
+		return allocate_large(bytes, alignment);
+	}
+
+	void PageMapAllocator::deallocate(void * mem)
+	{
+		if (mem == nullptr)	return;
+
+		const auto entry = lookup(mem);
+		MEMORY_ASSERT(entry != 0);
+
+		if (entry & LARGE_SPAN)
+			deallocate_large(mem, entry & ~LARGE_SPAN);
+		else
+		{
+			const auto class_idx = entry - 1;
+			if (m_traced)
+				trace_deallocation(this, mem, SizeClassAllocator::class_size(class_idx), SizeClassAllocator::class_size(class_idx));
+			push(mem, class_idx);
+		}
+	}
+
+	void PageMapAllocator::sized_free(void * mem, size_type bytes)
+	{
+		if (mem == nullptr)	return;
+
+		const auto class_idx = SizeClassAllocator::class_index(bytes);
+		if (class_idx == SizeClassAllocator::CLASS_NUM)
+		{
+			deallocate_large(mem, (bytes + SPAN_SIZE - 1) >> SPAN_SHIFT);
+			return;
+		}
+
+		MEMORY_ASSERT(lookup(mem) == class_idx + 1);
+		if (m_traced)
+			trace_deallocation(this, mem, bytes, SizeClassAllocator::class_size(class_idx));
+		push(mem, class_idx);
+	}
+
+	size_type PageMapAllocator::usable_size(const void * mem) const
+	{
+		const auto entry = lookup(mem);
+		MEMORY_ASSERT(entry != 0);
+
+		if (entry & LARGE_SPAN)
+			return static_cast<size_type>(entry & ~LARGE_SPAN) << SPAN_SHIFT;
+		return SizeClassAllocator::class_size(entry - 1);
+	}
+
+	bool PageMapAllocator::owns(const void * mem) const
+	{
+		const auto entry = lookup(mem);
+		if (entry == 0)	return false;
+
+		// big allocations only own the address they returned, the objects need to be at their offset
+		if (entry & LARGE_SPAN)
+			return (ptr_to_num(mem) & (SPAN_SIZE - 1)) == 0;
+		return (ptr_to_num(mem) & (SizeClassAllocator::class_size(entry - 1) - 1)) == 0;
+	}
+
+	PageMapAllocator::Entry PageMapAllocator::lookup(const void * mem) const
+	{
+		const auto key = ptr_to_num(mem) >> SPAN_SHIFT;
+		if (key >> (ROOT_BITS + LEAF_BITS))	return 0;
+
+		const auto * leaf = m_root[key >> LEAF_BITS];
+		return leaf ? leaf[key & ((size_type{ 1u } << LEAF_BITS) - 1)] : 0;
+	}
+
+	bool PageMapAllocator::set_entry(const void * span, Entry entry)
+	{
+		const auto key = ptr_to_num(span) >> SPAN_SHIFT;
+		MEMORY_ASSERT((key >> (ROOT_BITS + LEAF_BITS)) == 0);
+
+		auto *& leaf = m_root[key >> LEAF_BITS];
+		if (leaf == nullptr)
+			leaf = reinterpret_cast<Entry *>(system_map(LEAF_BYTES, impl::PAGE_MAP_ALIGNMENT));
+		if (leaf == nullptr)	return false;
+
+		leaf[key & ((size_type{ 1u } << LEAF_BITS) - 1)] = entry;
+		return true;
+	}
+
+	bool PageMapAllocator::refill(size_type class_idx)
+	{
+		auto * span = reinterpret_cast<unsigned char *>(system_map(SPAN_SIZE, SPAN_SIZE));
+		if (span == nullptr)	return false;
+		if (!set_entry(span, static_cast<Entry>(class_idx + 1)))
+		{
+			system_unmap(span, SPAN_SIZE);
+			return false;
+		}
+		m_span_num++;
+
+		// linked from the end, so the objects are handed out in address order
+		const auto size = SizeClassAllocator::class_size(class_idx);
+		for (size_type offset = SPAN_SIZE; offset >= size; offset -= size)
+			push(span + offset - size, class_idx);
+		return true;
+	}
+
+	void * PageMapAllocator::allocate_large(size_type bytes, size_type alignment)
+	{
+		// the over aligned allocations can be small, they still take a span
+		const auto spans = bytes ? (bytes + SPAN_SIZE - 1) >> SPAN_SHIFT : 1;
+		MEMORY_ASSERT(spans < LARGE_SPAN);
+
+		auto * mem = system_map(spans << SPAN_SHIFT, alignment);
+		if (mem == nullptr)	return nullptr;
+		if (!set_entry(mem, LARGE_SPAN | static_cast<Entry>(spans)))
+		{
+			system_unmap(mem, spans << SPAN_SHIFT);
+			return nullptr;
+		}
+		m_span_num += spans;
+
+		if (m_traced)
+			trace_allocation(this, mem, bytes, alignment);
+		return mem;
+	}
+
+	void PageMapAllocator::deallocate_large(void * mem, size_type spans)
+	{
+		MEMORY_ASSERT(lookup(mem) == (LARGE_SPAN | static_cast<Entry>(spans)));
+		if (m_traced)
+			trace_deallocation(this, mem, spans << SPAN_SHIFT, SPAN_SIZE);
+
+		set_entry(mem, 0);
+		system_unmap(mem, spans << SPAN_SHIFT);
+		m_span_num -= spans;
+	}
+
+	void * PageMapAllocator::pop(size_type class_idx)
+	{
+		auto * obj = m_free_lists[class_idx];
+		m_free_lists[class_idx] = obj->m_next;
+		return obj;
+	}
+	void PageMapAllocator::push(void * mem, size_type class_idx)
+	{
+		auto * obj = reinterpret_cast<FreeObject *>(mem);
+		obj->m_next = m_free_lists[class_idx];
+		m_free_lists[class_idx] = obj;
+	}
+}
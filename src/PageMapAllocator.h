@@ -0,0 +1,92 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "SizeClassAllocator.h"
+
+#include <cstdint>
+
+namespace memory
+{
+	/// \brief	General purpose allocator that does not need the size to free the memory and does not
+	///			store headers in the allocations, so it can replace malloc/free.
+	///			The memory is split in spans aligned to SPAN_SIZE, each span holds objects of one of the size
+	///			classes of the SizeClassAllocator or is the beginning of a big allocation. A radix tree
+	///			(page map) keeps what every span holds, deallocate finds it from the address of the object.
+	///			sized_free skips the page map when the caller knows the size.
+	///			The spans and the page map are mapped straight from the system.
+	class PageMapAllocator
+	{
+	public:
+		static constexpr size_type SPAN_SHIFT = 16;
+		static constexpr size_type SPAN_SIZE = size_type{ 1u } << SPAN_SHIFT;
+		static_assert(SPAN_SIZE >= SizeClassAllocator::MAX_CLASS_SIZE, "A span needs to fit objects of all the size classes.");
+
+		/// \brief	Allocators used by the tracing itself (i.e. a malloc replacement) can't be traced.
+		explicit PageMapAllocator(bool traced = true);
+		~PageMapAllocator();
+
+		PageMapAllocator(const PageMapAllocator &) = delete;
+		PageMapAllocator & operator=(const PageMapAllocator &) = delete;
+
+		/// \brief	The objects of the size classes are aligned to their size, big allocations to SPAN_SIZE.
+		///			Returns nullptr if the spans can't be mapped.
+		void * allocate(size_type bytes);
+		/// \brief	alignment needs to be a power of two, the allocations aligned to more than SPAN_SIZE
+		///			are big allocations mapped with that alignment (at most 64KB on Windows).
+		void * allocate_aligned(size_type bytes, size_type alignment);
+		/// \brief	Finds the size of the allocation in the page map.
+		void deallocate(void * mem);
+		/// \brief	The size needs to be the one used to allocate the memory.
+		void sized_free(void * mem, size_type bytes);
+
+		/// \brief	Bytes that can be used from the memory, at least the ones that were requested.
+		size_type usable_size(const void * mem) const;
+		/// \brief	Only true for the memory returned by allocate.
+		bool owns(const void * mem) const;
+
+		/// \brief	Spans requested to the system, including the ones of big allocations.
+		size_type allocated_spans() const { return m_span_num; }
+
+	private:
+		struct FreeObject { FreeObject * m_next; };
+
+		/// \brief	0 for spans that are not ours, class index + 1 for spans of the size classes,
+		///			LARGE_SPAN | span number for the first span of big allocations.
+		using Entry = std::uint32_t;
+		static constexpr Entry LARGE_SPAN = Entry{ 1u } << 31;
+
+		static constexpr size_type ADDRESS_BITS = 48;
+		static constexpr size_type ROOT_BITS = 16;
+		static constexpr size_type LEAF_BITS = ADDRESS_BITS - SPAN_SHIFT - ROOT_BITS;
+		static constexpr size_type ROOT_BYTES = sizeof(Entry *) << ROOT_BITS;
+		static constexpr size_type LEAF_BYTES = sizeof(Entry) << LEAF_BITS;
+
+		Entry lookup(const void * mem) const;
+		/// \brief	False if the leaf of the span is missing and can't be mapped.
+		bool set_entry(const void * span, Entry entry);
+
+		/// \brief	Carves a new span in objects of the size class, false if the span can't be mapped.
+		bool refill(size_type class_idx);
+		void * allocate_large(size_type bytes, size_type alignment = SPAN_SIZE);
+		void deallocate_large(void * mem, size_type spans);
+
+		void * pop(size_type class_idx);
+		void push(void * mem, size_type class_idx);
+
+	private:
+		/// \brief	Leaves are allocated when a span of their range is used.
+		Entry ** m_root{ nullptr };
+		FreeObject * m_free_lists[SizeClassAllocator::CLASS_NUM];
+
+		size_type m_span_num{ 0u };
+		bool m_traced{ true };
+	};
+}
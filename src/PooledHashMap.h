@@ -0,0 +1,229 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "GlobalAllocator.h"
+#include "ObjectPool.h"
+#include "PageAllocator.h"
+
+#include <functional>	// std::hash, std::equal_to
+#include <new>			// placement new
+#include <utility>		// std::pair, std::forward, std::piecewise_construct
+#include <tuple>		// std::forward_as_tuple
+
+namespace memory
+{
+	/// \brief	Hash map with open addressing (linear probing) that creates its key-value pairs in the pages of
+	///			a PageAllocator (through an ObjectPool), so the pairs don't move when the table grows and
+	///			clear() drops their pages at once. The table only holds a pointer to the pair and its hash,
+	///			a lookup only compares the keys whose hash matches. It is allocated from BucketAlloc, an
+	///			allocator of bytes with the interface of the GlobalAllocator.
+	///			Erasing shifts the next buckets back instead of leaving tombstones.
+	///			The pairs are allocated a page at a time through the bulk allocation of the pool.
+	template <typename K,
+			  typename V,
+			  typename Hash = std::hash<K>,
+			  typename Equal = std::equal_to<K>,
+			  typename PageAlloc = PageAllocator,
+			  typename BucketAlloc = DefaultGlobalAllocator<unsigned char>>
+	class PooledHashMap
+		: private Hash
+		, private Equal
+		, private BucketAlloc
+	{
+	public:
+		using value_type = std::pair<const K, V>;
+
+		static constexpr size_type MIN_BUCKETS = 16;
+
+		explicit PooledHashMap(size_type nodes_per_page = 64)
+			: m_pool{ nodes_per_page }
+		{}
+		~PooledHashMap()
+		{
+			release_buckets();
+		}
+
+		PooledHashMap(const PooledHashMap &) = delete;
+		PooledHashMap & operator=(const PooledHashMap &) = delete;
+
+		/// \brief	Constructs the value with args if the key is not in the map.
+		///			Returns the value of the key and true if it was inserted.
+		template <typename... Args>
+		std::pair<V *, bool> emplace(const K & key, Args &&... args)
+		{
+			const auto hash = hash_key(key);
+			if (auto * found = find_bucket(key, hash))
+				return { &found->m_node->second, false };
+
+			if ((m_size + 1) * 4 > m_bucket_num * 3)
+				rehash(m_bucket_num ? m_bucket_num * 2 : MIN_BUCKETS);
+
+			if (m_pool.reserved_objects() == 0)
+				m_pool.reserve(m_pool.get_per_page_obj_num());
+			auto * node = m_pool.create(std::piecewise_construct,
+										std::forward_as_tuple(key),
+										std::forward_as_tuple(std::forward<Args>(args)...));
+			insert_bucket(Bucket{ node, hash });
+			m_size++;
+			return { &node->second, true };
+		}
+		V & operator[](const K & key) { return *emplace(key).first; }
+
+		/// \brief	nullptr if the key is not in the map.
+		V * find(const K & key)
+		{
+			auto * bucket = find_bucket(key, hash_key(key));
+			return bucket ? &bucket->m_node->second : nullptr;
+		}
+		const V * find(const K & key) const { return const_cast<PooledHashMap *>(this)->find(key); }
+		bool contains(const K & key) const { return find(key) != nullptr; }
+
+		/// \brief	Returns false if the key was not in the map.
+		bool erase(const K & key)
+		{
+			auto * bucket = find_bucket(key, hash_key(key));
+			if (bucket == nullptr)	return false;
+
+			m_pool.destroy(bucket->m_node);
+			remove_bucket(static_cast<size_type>(bucket - m_buckets));
+			m_size--;
+			return true;
+		}
+
+		/// \brief	Destroys the pairs and releases their pages at once, the table is kept.
+		void clear()
+		{
+			m_pool.destroy_all();
+			for (size_type i = 0; i < m_bucket_num; ++i)
+				m_buckets[i] = Bucket{};
+			m_size = 0;
+		}
+		/// \brief	Grows the table so that n pairs fit without growing it again and
+		///			allocates the pairs that are missing at once.
+		void reserve(size_type n)
+		{
+			auto bucket_num = m_bucket_num ? m_bucket_num : MIN_BUCKETS;
+			while (n * 4 > bucket_num * 3)
+				bucket_num *= 2;
+			if (bucket_num != m_bucket_num)
+				rehash(bucket_num);
+
+			const auto available = m_size + m_pool.reserved_objects();
+			if (n > available)
+				m_pool.reserve(n - available);
+		}
+
+		/// \brief	Calls f(key, value) with every pair, in the order of the pages.
+		template <typename F>
+		void for_each(F && f)
+		{
+			m_pool.for_each_live([&](value_type & pair) { f(pair.first, pair.second); });
+		}
+		template <typename F>
+		void for_each(F && f) const
+		{
+			m_pool.for_each_live([&](const value_type & pair) { f(pair.first, pair.second); });
+		}
+
+		size_type size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+		size_type bucket_count() const { return m_bucket_num; }
+
+		/// \brief	Pool of the pairs, i.e. to read the pages it uses.
+		const ObjectPool<value_type, PageAlloc> & get_pool() const { return m_pool; }
+
+	private:
+		/// \brief	Empty when m_node is nullptr.
+		struct Bucket
+		{
+			value_type * m_node{ nullptr };
+			size_type m_hash{ 0u };
+		};
+
+		size_type hash_key(const K & key) const { return static_cast<size_type>(Hash::operator()(key)); }
+		size_type mask() const { return m_bucket_num - 1; }
+
+		Bucket * find_bucket(const K & key, size_type hash)
+		{
+			if (m_bucket_num == 0)	return nullptr;
+
+			for (auto idx = hash & mask(); m_buckets[idx].m_node != nullptr; idx = (idx + 1) & mask())
+			{
+				auto & bucket = m_buckets[idx];
+				if (bucket.m_hash == hash && Equal::operator()(bucket.m_node->first, key))
+					return &bucket;
+			}
+			return nullptr;
+		}
+		/// \brief	The key can't be in the table.
+		void insert_bucket(const Bucket & bucket)
+		{
+			auto idx = bucket.m_hash & mask();
+			while (m_buckets[idx].m_node != nullptr)
+				idx = (idx + 1) & mask();
+			m_buckets[idx] = bucket;
+		}
+		/// \brief	Moves back the buckets that follow the hole and are not in their ideal position,
+		///			so the lookups never need to skip removed buckets.
+		void remove_bucket(size_type hole)
+		{
+			for (auto idx = (hole + 1) & mask(); m_buckets[idx].m_node != nullptr; idx = (idx + 1) & mask())
+			{
+				// the bucket can fill the hole if it is not further from its ideal position than the hole
+				const auto distance = (idx - (m_buckets[idx].m_hash & mask())) & mask();
+				if (distance >= ((idx - hole) & mask()))
+				{
+					m_buckets[hole] = m_buckets[idx];
+					hole = idx;
+				}
+			}
+			m_buckets[hole] = Bucket{};
+		}
+
+		void rehash(size_type bucket_num)
+		{
+			MEMORY_ASSERT(is_power_of_two(bucket_num));
+
+			auto * old_buckets = m_buckets;
+			const auto old_bucket_num = m_bucket_num;
+
+			auto * mem = BucketAlloc::allocate(bucket_num * sizeof(Bucket));
+			MEMORY_ASSERT(mem != nullptr);
+			m_buckets = reinterpret_cast<Bucket *>(mem);
+			m_bucket_num = bucket_num;
+			for (size_type i = 0; i < m_bucket_num; ++i)
+				new (m_buckets + i) Bucket{};
+
+			for (size_type i = 0; i < old_bucket_num; ++i)
+			{
+				if (old_buckets[i].m_node != nullptr)
+					insert_bucket(old_buckets[i]);
+			}
+			if (old_buckets != nullptr)
+				BucketAlloc::deallocate(reinterpret_cast<unsigned char *>(old_buckets), old_bucket_num * sizeof(Bucket));
+		}
+		void release_buckets()
+		{
+			if (m_buckets != nullptr)
+				BucketAlloc::deallocate(reinterpret_cast<unsigned char *>(m_buckets), m_bucket_num * sizeof(Bucket));
+			m_buckets = nullptr;
+			m_bucket_num = 0;
+		}
+
+		ObjectPool<value_type, PageAlloc> m_pool;
+		Bucket * m_buckets{ nullptr };
+		size_type m_bucket_num{ 0u };
+		size_type m_size{ 0u };
+	};
+
+	template <typename K, typename V, typename H, typename E, typename P, typename B>
+	constexpr size_type PooledHashMap<K, V, H, E, P, B>::MIN_BUCKETS;
+}
@@ -0,0 +1,82 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "SizeClassAllocator.h"
+#include "NumaPageSource.h"
+
+namespace memory
+{
+	SizeClassAllocator::SizeClassAllocator(size_type objects_per_page)
+	{
+		// pages are allocated on demand, most programs won't use all the size classes
+		constexpr bool allocate_first_page = false;
+		for (size_type i = 0; i < CLASS_NUM; ++i)
+			m_classes[i].reset(new PageAllocator{ class_size(i), objects_per_page, allocate_first_page });
+	}
+	SizeClassAllocator::SizeClassAllocator(NumaPageSource & source, size_type node, size_type objects_per_page)
+		: m_source{ &source }
+		, m_node{ node }
+	{
+		for (size_type i = 0; i < CLASS_NUM; ++i)
+			m_classes[i].reset(new NumaPageAllocator{ source, node, class_size(i), objects_per_page });
+	}
+	SizeClassAllocator::~SizeClassAllocator() = default;
+
+	size_type SizeClassAllocator::class_index(size_type bytes)
+	{
+		if (bytes <= MIN_CLASS_SIZE)	return 0;
+
+		// the smallest power of two that fits the bytes, relative to the smallest class
+		const auto idx = log2_floor(bytes - 1) + 1 - log2_floor(MIN_CLASS_SIZE);
+		return idx < CLASS_NUM ? idx : CLASS_NUM;
+	}
+
+	void * SizeClassAllocator::allocate(size_type bytes)
+	{
+		const auto idx = class_index(bytes);
+		if (idx < CLASS_NUM)
+			return m_classes[idx]->allocate();
+
+		auto * mem = m_source ? m_source->allocate(bytes, m_node) : global_alloc(bytes);
+		trace_allocation(this, mem, bytes, alignof(std::max_align_t));
+		return mem;
+	}
+	void SizeClassAllocator::deallocate(void * mem, size_type bytes)
+	{
+		const auto idx = class_index(bytes);
+		if (idx < CLASS_NUM)
+			m_classes[idx]->deallocate(mem);
+		else
+		{
+			trace_deallocation(this, mem, bytes, alignof(std::max_align_t));
+			if (m_source)
+				m_source->deallocate(mem, bytes, m_node);
+			else
+				global_dealloc(mem);
+		}
+	}
+
+	bool SizeClassAllocator::owns(void * mem) const
+	{
+		for (const auto & page_alloc : m_classes)
+		{
+			if (page_alloc->owns(mem))
+				return true;
+		}
+
+		return false;
+	}
+
+	size_type SizeClassAllocator::page_bytes() const
+	{
+		size_type bytes = 0;
+		for (const auto & page_alloc : m_classes)
+			bytes += page_alloc->allocated_pages() * page_alloc->get_page_size();
+		return bytes;
+	}
+}
@@ -0,0 +1,61 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "PageAllocator.h"
+
+#include <memory>	// std::unique_ptr
+
+namespace memory
+{
+	class NumaPageSource;
+
+	/// \brief	Serves variable size allocations by rounding the requested size up to the closest
+	///			power of two size class, each size class is backed by its own PageAllocator.
+	///			Allocations bigger than the biggest size class are forwarded to global_alloc.
+	class SizeClassAllocator
+	{
+	public:
+		static constexpr size_type MIN_CLASS_SIZE = 8;
+		static constexpr size_type CLASS_NUM = 10;	// 8, 16, 32 ... 4096 bytes
+		static constexpr size_type MAX_CLASS_SIZE = MIN_CLASS_SIZE << (CLASS_NUM - 1);
+
+		explicit SizeClassAllocator(size_type objects_per_page = 64);
+		/// \brief	The pages of the size classes and the big allocations are placed on the given node.
+		SizeClassAllocator(NumaPageSource & source, size_type node, size_type objects_per_page = 64);
+		~SizeClassAllocator();
+
+		SizeClassAllocator(const SizeClassAllocator &) = delete;
+		SizeClassAllocator & operator=(const SizeClassAllocator &) = delete;
+
+		void * allocate(size_type bytes);
+		/// \brief	The size needs to be the same one used to allocate the memory.
+		void deallocate(void * mem, size_type bytes);
+
+		bool owns(void * mem) const;
+
+		/// \brief	Returns the index of the size class that serves allocations of the given size,
+		///			CLASS_NUM if the size is bigger than the biggest size class.
+		static size_type class_index(size_type bytes);
+		static size_type class_size(size_type class_idx) { return MIN_CLASS_SIZE << class_idx; }
+
+		/// \brief	Bytes requested to the system by the pages of all the size classes.
+		size_type page_bytes() const;
+
+		const PageAllocator & get_class_allocator(size_type class_idx) const { return *m_classes[class_idx]; }
+
+	private:
+		std::unique_ptr<PageAllocator> m_classes[CLASS_NUM];
+
+		/// \brief	Big allocations come from the source when there is one.
+		NumaPageSource * m_source{ nullptr };
+		size_type m_node{ 0u };
+	};
+}
@@ -0,0 +1,388 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "SlabAllocator.h"
+
+namespace memory
+{
+	namespace impl
+	{
+		constexpr size_type SLAB_BITS_PER_WORD = 64;
+		/// \brief	The objects of a slab are aligned as the memory returned by global_alloc.
+		constexpr size_type SLAB_OBJECTS_ALIGNMENT = alignof(std::max_align_t);
+
+		inline size_type align_up(size_type n, size_type alignment)
+		{
+			return (n + alignment - 1) & ~(alignment - 1);
+		}
+
+		/// \brief	The slab map grows when it is 3/4 full.
+		constexpr size_type SLAB_MAP_MIN_CAPACITY = 16;
+	}
+
+#pragma region // SlabMap
+
+	SlabAllocator::SlabMap::~SlabMap()
+	{
+		if (m_entries)
+			global_dealloc(m_entries);
+	}
+
+	void SlabAllocator::SlabMap::insert(size_type granule, Slab * slab)
+	{
+		MEMORY_ASSERT(granule != 0 && find(granule) == nullptr);
+
+		if ((m_size + 1) * 4 > m_capacity * 3)
+			rehash(m_capacity ? m_capacity * 2 : impl::SLAB_MAP_MIN_CAPACITY);
+
+		auto idx = index_of(granule);
+		while (m_entries[idx].m_granule != 0)
+			idx = (idx + 1) & (m_capacity - 1);
+		m_entries[idx] = Entry{ granule, slab };
+		m_size++;
+	}
+
+	void SlabAllocator::SlabMap::erase(size_type granule)
+	{
+		const auto mask = m_capacity - 1;
+		auto hole = index_of(granule);
+		while (m_entries[hole].m_granule != granule)
+		{
+			MEMORY_ASSERT(m_entries[hole].m_granule != 0);
+			hole = (hole + 1) & mask;
+		}
+
+		// move back the entries that follow the hole and are not in their ideal position
+		for (auto idx = (hole + 1) & mask; m_entries[idx].m_granule != 0; idx = (idx + 1) & mask)
+		{
+			const auto distance = (idx - index_of(m_entries[idx].m_granule)) & mask;
+			if (distance >= ((idx - hole) & mask))
+			{
+				m_entries[hole] = m_entries[idx];
+				hole = idx;
+			}
+		}
+		m_entries[hole] = Entry{ 0u, nullptr };
+		m_size--;
+	}
+
+	SlabAllocator::Slab * SlabAllocator::SlabMap::find(size_type granule) const
+	{
+		if (m_size == 0)	return nullptr;
+
+		for (auto idx = index_of(granule); m_entries[idx].m_granule != 0; idx = (idx + 1) & (m_capacity - 1))
+		{
+			if (m_entries[idx].m_granule == granule)
+				return m_entries[idx].m_slab;
+		}
+		return nullptr;
+	}
+
+	size_type SlabAllocator::SlabMap::index_of(size_type granule) const
+	{
+		// fibonacci hashing, the granules of the slabs are consecutive numbers
+		const auto hash = static_cast<std::uint64_t>(granule) * 0x9E3779B97F4A7C15ull;
+		return static_cast<size_type>(hash >> 32) & (m_capacity - 1);
+	}
+
+	void SlabAllocator::SlabMap::rehash(size_type capacity)
+	{
+		auto * old_entries = m_entries;
+		const auto old_capacity = m_capacity;
+
+		m_entries = reinterpret_cast<Entry *>(global_alloc(capacity * sizeof(Entry)));
+		m_capacity = capacity;
+		m_size = 0;
+		for (size_type i = 0; i < m_capacity; ++i)
+			m_entries[i] = Entry{ 0u, nullptr };
+
+		for (size_type i = 0; i < old_capacity; ++i)
+		{
+			if (old_entries[i].m_granule != 0)
+				insert(old_entries[i].m_granule, old_entries[i].m_slab);
+		}
+		if (old_entries)
+			global_dealloc(old_entries);
+	}
+
+#pragma endregion
+
+	SlabAllocator::SlabAllocator(size_type obj_size,
+								 size_type obj_num,
+								 size_type max_cached_slabs)
+		: m_object_size{ obj_size ? obj_size : 1 }
+		, m_object_num{ obj_num }
+		, m_max_cached_slabs{ max_cached_slabs }
+		, m_bitmap_words{ (obj_num + impl::SLAB_BITS_PER_WORD - 1) / impl::SLAB_BITS_PER_WORD }
+	{
+		MEMORY_ASSERT(obj_num > 0);
+
+		for (auto & list : m_lists)
+			list = nullptr;
+
+		m_objects_offset = impl::align_up(sizeof(Slab) + m_bitmap_words * sizeof(std::uint64_t), impl::SLAB_OBJECTS_ALIGNMENT);
+		m_slab_size = m_objects_offset + m_object_num * m_object_size;
+		// aligning the big slabs to their size would waste up to half of the memory they take from the system
+		m_slab_alignment = round_up_to_power_of_two(m_slab_size);
+		if (m_slab_alignment > system_page_size())
+			m_slab_alignment = system_page_size();
+		m_granule_shift = log2_floor(m_slab_alignment);
+		m_granules_per_slab = (m_slab_size + m_slab_alignment - 1) / m_slab_alignment;
+	}
+	SlabAllocator::~SlabAllocator()
+	{
+		release_all_slabs();
+	}
+
+	void * SlabAllocator::allocate()
+	{
+		Slab * slab = nullptr;
+		if (m_partial_mask)
+			slab = m_lists[find_last_set(m_partial_mask)];
+		else if (m_lists[EMPTY_LIST])
+		{
+			slab = m_lists[EMPTY_LIST];
+			m_cached_slab_num--;
+		}
+		else
+			slab = create_slab();
+
+		auto * bits = free_bits(slab);
+		size_type word = 0;
+		while (bits[word] == 0)
+			++word;
+
+		const auto bit = find_first_set(static_cast<size_type>(bits[word]));
+		bits[word] &= ~(std::uint64_t{ 1u } << bit);
+		slab->m_used++;
+		update_list(slab);
+
+		auto * mem = objects(slab) + (word * impl::SLAB_BITS_PER_WORD + bit) * m_object_size;
+		trace_allocation(this, mem, m_object_size, impl::SLAB_OBJECTS_ALIGNMENT);
+		return mem;
+	}
+
+	void SlabAllocator::deallocate(void * mem)
+	{
+		MEMORY_ASSERT(owns(mem));
+		trace_deallocation(this, mem, m_object_size, impl::SLAB_OBJECTS_ALIGNMENT);
+
+		auto * slab = slab_of(mem);
+		const auto idx = (reinterpret_cast<unsigned char *>(mem) - objects(slab)) / m_object_size;
+		auto & word = free_bits(slab)[idx / impl::SLAB_BITS_PER_WORD];
+		const auto mask = std::uint64_t{ 1u } << (idx % impl::SLAB_BITS_PER_WORD);
+		MEMORY_ASSERT((word & mask) == 0);
+
+		word |= mask;
+		slab->m_used--;
+
+		if (slab->m_used == 0 && m_cached_slab_num >= m_max_cached_slabs)
+		{
+			unlink(slab);
+			release_slab(slab);
+			return;
+		}
+
+		if (slab->m_used == 0)
+			m_cached_slab_num++;
+		update_list(slab);
+	}
+
+	bool SlabAllocator::owns(void * mem) const
+	{
+		auto * slab = slab_of(mem);
+		if (slab == nullptr)	return false;
+
+		// the header and the end of the last granule are not objects
+		const auto offset = ptr_to_num(mem) - ptr_to_num(objects(slab));
+		return offset < m_object_num * m_object_size && offset % m_object_size == 0;
+	}
+
+	void SlabAllocator::release_empty_slabs()
+	{
+		while (auto * slab = m_lists[EMPTY_LIST])
+		{
+			unlink(slab);
+			release_slab(slab);
+		}
+		m_cached_slab_num = 0;
+	}
+
+	void SlabAllocator::release_all_slabs()
+	{
+		for (auto & list : m_lists)
+		{
+			while (auto * slab = list)
+			{
+				unlink(slab);
+				release_slab(slab);
+			}
+		}
+		m_cached_slab_num = 0;
+	}
+
+	SlabAllocator::Slab * SlabAllocator::do_slab_alloc()
+	{
+		return reinterpret_cast<Slab *>(global_aligned_alloc(m_slab_size, m_slab_alignment));
+	}
+	void SlabAllocator::do_slab_dealloc(Slab * slab)
+	{
+		global_aligned_dealloc(slab);
+	}
+
+	SlabAllocator::Slab * SlabAllocator::create_slab()
+	{
+		auto * slab = do_slab_alloc();
+		slab->m_prev = nullptr;
+		slab->m_next = nullptr;
+		slab->m_used = 0;
+		slab->m_list = LIST_NUM;
+
+		// all the objects are free, the bits past the last object are never set
+		auto * bits = free_bits(slab);
+		for (size_type i = 0; i < m_bitmap_words; ++i)
+			bits[i] = ~std::uint64_t{ 0u };
+		const auto last_bits = m_object_num % impl::SLAB_BITS_PER_WORD;
+		if (last_bits)
+			bits[m_bitmap_words - 1] = (std::uint64_t{ 1u } << last_bits) - 1;
+
+		const auto first_granule = ptr_to_num(slab) >> m_granule_shift;
+		for (size_type i = 0; i < m_granules_per_slab; ++i)
+			m_slab_map.insert(first_granule + i, slab);
+
+		m_slab_num++;
+		return slab;
+	}
+	void SlabAllocator::release_slab(Slab * slab)
+	{
+		const auto first_granule = ptr_to_num(slab) >> m_granule_shift;
+		for (size_type i = 0; i < m_granules_per_slab; ++i)
+			m_slab_map.erase(first_granule + i);
+
+		do_slab_dealloc(slab);
+		m_slab_num--;
+	}
+
+	void SlabAllocator::update_list(Slab * slab)
+	{
+		size_type list = 0;
+		if (slab->m_used == 0)					list = EMPTY_LIST;
+		else if (slab->m_used == m_object_num)	list = FULL_LIST;
+		else									list = slab->m_used * OCCUPANCY_BUCKETS / m_object_num;
+
+		if (slab->m_list == list)	return;
+
+		unlink(slab);
+		link(slab, list);
+	}
+	void SlabAllocator::link(Slab * slab, size_type list)
+	{
+		slab->m_list = list;
+		slab->m_prev = nullptr;
+		slab->m_next = m_lists[list];
+		if (slab->m_next)
+			slab->m_next->m_prev = slab;
+		m_lists[list] = slab;
+
+		if (list < OCCUPANCY_BUCKETS)
+			m_partial_mask |= size_type{ 1u } << list;
+	}
+	void SlabAllocator::unlink(Slab * slab)
+	{
+		const auto list = slab->m_list;
+		if (list == LIST_NUM)	return;
+
+		if (slab->m_prev)
+			slab->m_prev->m_next = slab->m_next;
+		else
+			m_lists[list] = slab->m_next;
+		if (slab->m_next)
+			slab->m_next->m_prev = slab->m_prev;
+
+		if (list < OCCUPANCY_BUCKETS && m_lists[list] == nullptr)
+			m_partial_mask &= ~(size_type{ 1u } << list);
+
+		slab->m_list = LIST_NUM;
+	}
+
+	SlabAllocator::Slab * SlabAllocator::slab_of(void * mem) const
+	{
+		return m_slab_map.find(ptr_to_num(mem) >> m_granule_shift);
+	}
+	std::uint64_t * SlabAllocator::free_bits(Slab * slab) const
+	{
+		return reinterpret_cast<std::uint64_t *>(slab + 1);
+	}
+	unsigned char * SlabAllocator::objects(Slab * slab) const
+	{
+		return reinterpret_cast<unsigned char *>(slab) + m_objects_offset;
+	}
+
+#if MEMORY_DEBUG_ENABLED
+
+	DebugSlabAllocator::DebugSlabAllocator(size_type obj_size,
+										   size_type obj_num,
+										   size_type max_cached_slabs)
+		: Base{ obj_size, obj_num, max_cached_slabs }
+	{}
+	DebugSlabAllocator::~DebugSlabAllocator()
+	{
+		release_all_slabs();
+	}
+
+	void * DebugSlabAllocator::allocate()
+	{
+		auto * mem = Base::allocate();
+		fill_with_pattern(DebugPattern::ALLOCATED, mem, get_obj_size());
+		m_stats.allocated_objects++;
+		if (m_stats.allocated_objects > m_stats.max_allocated_objects)
+			m_stats.max_allocated_objects = m_stats.allocated_objects;
+		return mem;
+	}
+	void DebugSlabAllocator::deallocate(void * ptr)
+	{
+		fill_with_pattern(DebugPattern::DEALLOCATED, ptr, get_obj_size());
+		Base::deallocate(ptr);
+		m_stats.allocated_objects--;
+	}
+
+	AllocatorAnalytics DebugSlabAllocator::get_analytics() const
+	{
+		// the objects are not padded, what the user asks for is what it gets
+		AllocatorAnalytics analytics;
+		analytics.requested_bytes = m_stats.allocated_objects * get_obj_size();
+		analytics.granted_bytes = analytics.requested_bytes;
+		analytics.free_bytes = (allocated_slabs() * get_per_slab_obj_num() - m_stats.allocated_objects) * get_obj_size();
+		analytics.largest_free_block = analytics.free_bytes;
+		analytics.high_water_mark = m_stats.max_allocated_objects * get_obj_size();
+
+		for_each_slab_usage([&](size_type used)
+		{
+			analytics.add_page(used, get_per_slab_obj_num());
+		});
+		return analytics;
+	}
+
+	DebugSlabAllocator::Slab * DebugSlabAllocator::do_slab_alloc()
+	{
+		auto * slab = Base::do_slab_alloc();
+		fill_with_pattern(DebugPattern::ACQUIRED, slab, get_slab_size());
+		m_stats.acquired_slabs++;
+		return slab;
+	}
+	void DebugSlabAllocator::do_slab_dealloc(Slab * slab)
+	{
+		// if we call free on the memory of the slab, the runtime library may put its own
+		// pattern, just in case it does not (i.e. release build)
+		fill_with_pattern(DebugPattern::RELEASED, slab, get_slab_size());
+		Base::do_slab_dealloc(slab);
+		m_stats.released_slabs++;
+	}
+
+#endif
+}
@@ -0,0 +1,206 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "AllocationTrace.h"
+
+#if MEMORY_DEBUG_ENABLED
+#include "AllocatorAnalytics.h"
+#endif
+
+#include <cstdint>
+
+namespace memory
+{
+	/// \brief	Allocates objects of one size from slabs (pages) that track their own free objects with a bitmap.
+	///			Allocations are served from the fullest partially used slab, so the objects stay packed in
+	///			few slabs and the rest of them can become empty. Empty slabs are kept in a small cache and
+	///			the rest are given back to the system.
+	///			The slabs are aligned to their size rounded up to a power of two, but never to more than a page
+	///			of the system, and a hash table from the aligned blocks (granules) of the slabs to the slabs finds
+	///			the slab of an object in O(1).
+	class SlabAllocator
+	{
+	protected:
+		/// \brief	Header at the beginning of every slab, followed by the bitmap of free objects and the objects.
+		struct Slab
+		{
+			Slab * m_prev;
+			Slab * m_next;
+			/// \brief	Allocated objects.
+			size_type m_used;
+			/// \brief	List the slab is linked to.
+			size_type m_list;
+		};
+
+	public:
+		/// \brief	Partial slabs are grouped by how full they are, allocations use the fullest group.
+		static constexpr size_type OCCUPANCY_BUCKETS = 8;
+
+		SlabAllocator(size_type obj_size,
+					  size_type obj_num,
+					  size_type max_cached_slabs = 1);
+		virtual ~SlabAllocator();
+
+		SlabAllocator(const SlabAllocator &) = delete;
+		SlabAllocator & operator=(const SlabAllocator &) = delete;
+
+		virtual void * allocate();
+		virtual void deallocate(void * mem);
+
+		bool owns(void * mem) const;
+
+		/// \brief	Gives the cached empty slabs back to the system.
+		void release_empty_slabs();
+
+		size_type get_obj_size() const { return m_object_size; }
+		size_type get_per_slab_obj_num() const { return m_object_num; }
+		/// \brief	Bytes of a slab.
+		size_type get_slab_size() const { return m_slab_size; }
+		/// \brief	The slab size rounded up to a power of two, at most the page size of the system.
+		size_type get_slab_alignment() const { return m_slab_alignment; }
+
+		/// \brief	All the slabs, including the empty ones that are cached.
+		size_type allocated_slabs() const { return m_slab_num; }
+		size_type cached_slabs() const { return m_cached_slab_num; }
+
+	protected:
+		/// \brief	Allocates memory for the slab.
+		virtual Slab * do_slab_alloc();
+		/// \brief	Deallocates the memory of the slab.
+		virtual void do_slab_dealloc(Slab * slab);
+		/// \brief	Gives all the slabs back to the system, all the allocated objects become invalid.
+		void release_all_slabs();
+
+		/// \brief	Calls f with the number of allocated objects of every slab, including the cached ones.
+		template <typename F>
+		void for_each_slab_usage(F && f) const
+		{
+			for (auto * list : m_lists)
+			{
+				for (auto * slab = list; slab != nullptr; slab = slab->m_next)
+					f(slab->m_used);
+			}
+		}
+
+	private:
+		static constexpr size_type FULL_LIST = OCCUPANCY_BUCKETS;
+		static constexpr size_type EMPTY_LIST = OCCUPANCY_BUCKETS + 1;
+		static constexpr size_type LIST_NUM = OCCUPANCY_BUCKETS + 2;
+
+		Slab * create_slab();
+		void release_slab(Slab * slab);
+
+		/// \brief	Moves the slab to the list that corresponds to the number of objects it has.
+		void update_list(Slab * slab);
+		void link(Slab * slab, size_type list);
+		void unlink(Slab * slab);
+
+		/// \brief	nullptr if mem is not in one of our slabs.
+		Slab * slab_of(void * mem) const;
+		std::uint64_t * free_bits(Slab * slab) const;
+		unsigned char * objects(Slab * slab) const;
+
+		/// \brief	Open addressing hash table from the granules of the slabs to the slabs.
+		class SlabMap
+		{
+		public:
+			SlabMap() = default;
+			~SlabMap();
+
+			SlabMap(const SlabMap &) = delete;
+			SlabMap & operator=(const SlabMap &) = delete;
+
+			void insert(size_type granule, Slab * slab);
+			void erase(size_type granule);
+			/// \brief	nullptr if the granule is not in the map.
+			Slab * find(size_type granule) const;
+
+		private:
+			/// \brief	Empty when m_granule is 0, no memory is at address 0.
+			struct Entry
+			{
+				size_type m_granule;
+				Slab * m_slab;
+			};
+
+			size_type index_of(size_type granule) const;
+			void rehash(size_type capacity);
+
+			Entry * m_entries{ nullptr };
+			size_type m_capacity{ 0u };
+			size_type m_size{ 0u };
+		};
+
+	private:
+		Slab * m_lists[LIST_NUM];
+		/// \brief	Bit i is set when the partial list i has slabs.
+		size_type m_partial_mask{ 0u };
+
+		size_type m_object_size{ 0u };
+		size_type m_object_num{ 0u };
+		size_type m_max_cached_slabs{ 0u };
+
+		size_type m_bitmap_words{ 0u };
+		size_type m_objects_offset{ 0u };
+		size_type m_slab_size{ 0u };
+		size_type m_slab_alignment{ 0u };
+		size_type m_granule_shift{ 0u };
+		/// \brief	Granules a slab spans, it begins at the start of the first one.
+		size_type m_granules_per_slab{ 0u };
+		SlabMap m_slab_map;
+
+		size_type m_slab_num{ 0u };
+		size_type m_cached_slab_num{ 0u };
+	};
+
+#if MEMORY_DEBUG_ENABLED
+
+	/// \brief	Provides the same functionality of a slab allocator and
+	///			writes patters in the memory to detect memory corruption.
+	class DebugSlabAllocator
+		: public SlabAllocator
+	{
+		using Base = SlabAllocator;
+	public:
+		struct Stats
+		{
+			size_type allocated_objects{ 0u };
+			/// \brief	Slabs requested to and given back to the system.
+			size_type acquired_slabs{ 0u };
+			size_type released_slabs{ 0u };
+			/// \brief	Maximum of allocated_objects.
+			size_type max_allocated_objects{ 0u };
+		};
+
+	public:
+		DebugSlabAllocator(size_type obj_size,
+						   size_type obj_num,
+						   size_type max_cached_slabs = 1);
+		~DebugSlabAllocator();
+
+		void * allocate() override;
+		void deallocate(void * ptr) override;
+
+		const Stats & get_stats() const { return m_stats; }
+		/// \brief	The cached empty slabs count as free memory.
+		AllocatorAnalytics get_analytics() const;
+
+	protected:
+		Slab * do_slab_alloc() override;
+		void do_slab_dealloc(Slab * slab) override;
+
+	private:
+		Stats m_stats;
+	};
+
+#endif
+
+}
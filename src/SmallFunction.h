@@ -0,0 +1,193 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "GlobalAllocator.h"
+
+#include <cstddef>		// std::max_align_t, std::nullptr_t
+#include <new>			// placement new
+#include <type_traits>	// std::decay, std::integral_constant, std::is_nothrow_move_constructible
+#include <utility>		// std::move, std::forward
+
+namespace memory
+{
+	template <typename Signature, size_type N = 4 * sizeof(void *), typename Fallback = DefaultGlobalAllocator<unsigned char>>
+	class SmallFunction;
+
+	/// \brief	Move only std::function that stores the callables of up to N bytes inside the object and
+	///			allocates the bigger ones from Fallback (an allocator of bytes). Moving it steals the fallback
+	///			memory, only the callables stored inline are moved.
+	template <typename R, typename... Args, size_type N, typename Fallback>
+	class SmallFunction<R(Args...), N, Fallback>
+		: private Fallback
+	{
+		static_assert(N >= sizeof(void *), "SmallFunction needs room for the pointer to the fallback memory.");
+
+	public:
+		/// \brief	True if the callable F is stored in the function without allocating.
+		template <typename F>
+		static constexpr bool fits_inline()
+		{
+			return sizeof(F) <= N && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<F>::value;
+		}
+
+		SmallFunction() = default;
+		SmallFunction(std::nullptr_t) {}
+		template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, SmallFunction>::value>::type>
+		SmallFunction(F && f)
+		{
+			assign(std::forward<F>(f));
+		}
+		SmallFunction(SmallFunction && other) noexcept
+			: Fallback{ std::move(other) }
+		{
+			steal(other);
+		}
+		~SmallFunction()
+		{
+			reset();
+		}
+
+		SmallFunction(const SmallFunction &) = delete;
+		SmallFunction & operator=(const SmallFunction &) = delete;
+
+		SmallFunction & operator=(SmallFunction && other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+				steal(other);
+			}
+			return *this;
+		}
+		SmallFunction & operator=(std::nullptr_t)
+		{
+			reset();
+			return *this;
+		}
+		template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, SmallFunction>::value>::type>
+		SmallFunction & operator=(F && f)
+		{
+			reset();
+			assign(std::forward<F>(f));
+			return *this;
+		}
+
+		R operator()(Args... args) const
+		{
+			MEMORY_ASSERT(m_operations != nullptr);
+			return m_operations->invoke(object(), std::forward<Args>(args)...);
+		}
+
+		explicit operator bool() const { return m_operations != nullptr; }
+		/// \brief	True if there is a callable and it is stored in the fallback memory.
+		bool is_heap() const { return m_operations != nullptr && m_operations->heap_size != 0; }
+
+		void reset()
+		{
+			if (m_operations == nullptr)	return;
+
+			m_operations->destroy(object());
+			if (m_operations->heap_size)
+				Fallback::deallocate(heap_object(), m_operations->heap_size);
+			m_operations = nullptr;
+		}
+
+	private:
+		/// \brief	What the function needs to know of the callable, one instance per type of callable.
+		struct Operations
+		{
+			R (*invoke)(void * f, Args &&... args);
+			void (*destroy)(void * f);
+			/// \brief	Only called for the callables stored inline.
+			void (*move)(void * dst, void * src);
+			/// \brief	0 for the callables stored inline.
+			size_type heap_size;
+		};
+
+		template <typename F>
+		struct OperationsFor
+		{
+			static R invoke(void * f, Args &&... args) { return (*static_cast<F *>(f))(std::forward<Args>(args)...); }
+			static void destroy(void * f) { static_cast<F *>(f)->~F(); }
+			static void move(void * dst, void * src) { new (dst) F(std::move(*static_cast<F *>(src))); }
+
+			static const Operations value;
+		};
+
+		template <typename F>
+		void assign(F && f)
+		{
+			using Callable = typename std::decay<F>::type;
+			static_assert(alignof(Callable) <= alignof(std::max_align_t), "SmallFunction can't align the callable.");
+
+			construct<Callable>(std::forward<F>(f), std::integral_constant<bool, fits_inline<Callable>()>{});
+			m_operations = &OperationsFor<Callable>::value;
+		}
+		template <typename Callable, typename F>
+		void construct(F && f, std::true_type /*inline*/)
+		{
+			new (m_buffer) Callable(std::forward<F>(f));
+		}
+		template <typename Callable, typename F>
+		void construct(F && f, std::false_type /*inline*/)
+		{
+			auto * mem = Fallback::allocate(sizeof(Callable));
+			MEMORY_ASSERT(mem != nullptr);
+			try
+			{
+				new (mem) Callable(std::forward<F>(f));
+			}
+			catch (...)
+			{
+				Fallback::deallocate(mem, sizeof(Callable));
+				throw;
+			}
+			heap_object() = mem;
+		}
+		/// \brief	Takes the callable of other, which is left empty.
+		void steal(SmallFunction & other)
+		{
+			m_operations = other.m_operations;
+			if (m_operations == nullptr)	return;
+
+			if (m_operations->heap_size)
+				heap_object() = other.heap_object();
+			else
+			{
+				m_operations->move(m_buffer, other.m_buffer);
+				m_operations->destroy(other.m_buffer);
+			}
+			other.m_operations = nullptr;
+		}
+
+		void * object() const
+		{
+			return m_operations->heap_size ? heap_object() : const_cast<unsigned char *>(m_buffer);
+		}
+		unsigned char *& heap_object() const
+		{
+			return *reinterpret_cast<unsigned char **>(const_cast<unsigned char *>(m_buffer));
+		}
+
+		const Operations * m_operations{ nullptr };
+		alignas(std::max_align_t) unsigned char m_buffer[N];
+	};
+
+	template <typename R, typename... Args, size_type N, typename Fallback>
+	template <typename F>
+	const typename SmallFunction<R(Args...), N, Fallback>::Operations SmallFunction<R(Args...), N, Fallback>::OperationsFor<F>::value =
+	{
+		&OperationsFor<F>::invoke,
+		&OperationsFor<F>::destroy,
+		&OperationsFor<F>::move,
+		SmallFunction<R(Args...), N, Fallback>::template fits_inline<F>() ? 0 : sizeof(F),
+	};
+}
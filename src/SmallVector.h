@@ -0,0 +1,336 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "GlobalAllocator.h"
+
+#include <initializer_list>
+#include <new>			// placement new
+#include <type_traits>	// std::is_nothrow_move_constructible
+#include <utility>		// std::move, std::forward, std::swap
+
+namespace memory
+{
+	/// \brief	Vector that stores up to N elements in a buffer inside the object and only allocates
+	///			from Fallback (an allocator of T with the interface of the GlobalAllocator) when they don't fit.
+	///			The inline capacity is used before any allocation, the growth starts after it. The fallback memory
+	///			is grown and shrunk in place with Fallback::expand when it can, the elements only move when it can't.
+	///			Moving a vector whose elements are in the fallback memory steals it, the inline elements are moved
+	///			one by one, the fallback allocators need to be able to free the memory of each other.
+	///			The elements are assumed to be moved without throwing.
+	template <typename T, size_type N, typename Fallback = DefaultGlobalAllocator<T>>
+	class SmallVector
+		: private Fallback
+	{
+		static_assert(N > 0, "SmallVector needs room for one inline element at least.");
+
+	public:
+		using value_type = T;
+		using iterator = T *;
+		using const_iterator = const T *;
+
+		static constexpr size_type inline_capacity = N;
+
+		SmallVector() = default;
+		explicit SmallVector(size_type n)
+		{
+			resize(n);
+		}
+		SmallVector(size_type n, const T & value)
+		{
+			resize(n, value);
+		}
+		SmallVector(std::initializer_list<T> values)
+		{
+			append(values.begin(), values.end());
+		}
+		SmallVector(const SmallVector & other)
+			: Fallback{ other }
+		{
+			append(other.begin(), other.end());
+		}
+		SmallVector(SmallVector && other) noexcept(std::is_nothrow_move_constructible<T>::value)
+			: Fallback{ std::move(other) }
+		{
+			steal(other);
+		}
+		~SmallVector()
+		{
+			clear();
+			release();
+		}
+
+		SmallVector & operator=(const SmallVector & other)
+		{
+			if (this != &other)
+			{
+				clear();
+				append(other.begin(), other.end());
+			}
+			return *this;
+		}
+		SmallVector & operator=(SmallVector && other) noexcept(std::is_nothrow_move_constructible<T>::value)
+		{
+			if (this != &other)
+			{
+				clear();
+				release();
+				steal(other);
+			}
+			return *this;
+		}
+
+		template <typename... Args>
+		T & emplace_back(Args &&... args)
+		{
+			if (m_size == m_capacity)
+				return grow_and_emplace_back(std::forward<Args>(args)...);
+
+			new (m_data + m_size) T(std::forward<Args>(args)...);
+			return m_data[m_size++];
+		}
+		void push_back(const T & value) { emplace_back(value); }
+		void push_back(T && value) { emplace_back(std::move(value)); }
+		void pop_back()
+		{
+			MEMORY_ASSERT(m_size > 0);
+			m_data[--m_size].~T();
+		}
+
+		template <typename It>
+		void append(It first, It last)
+		{
+			for (; first != last; ++first)
+				emplace_back(*first);
+		}
+
+		/// \brief	Moves the elements after pos one position forward.
+		iterator insert(const_iterator pos, T value)
+		{
+			const auto idx = static_cast<size_type>(pos - m_data);
+			MEMORY_ASSERT(idx <= m_size);
+
+			emplace_back(std::move(value));
+			for (auto i = m_size - 1; i > idx; --i)
+				std::swap(m_data[i], m_data[i - 1]);
+			return m_data + idx;
+		}
+		/// \brief	Moves the elements after pos one position back.
+		iterator erase(const_iterator pos)
+		{
+			const auto idx = static_cast<size_type>(pos - m_data);
+			MEMORY_ASSERT(idx < m_size);
+
+			for (auto i = idx; i + 1 < m_size; ++i)
+				m_data[i] = std::move(m_data[i + 1]);
+			pop_back();
+			return m_data + idx;
+		}
+
+		void resize(size_type n)
+		{
+			reserve(n);
+			while (m_size < n)
+				emplace_back();
+			while (m_size > n)
+				pop_back();
+		}
+		void resize(size_type n, const T & value)
+		{
+			reserve(n);
+			while (m_size < n)
+				emplace_back(value);
+			while (m_size > n)
+				pop_back();
+		}
+		void reserve(size_type n)
+		{
+			if (n > m_capacity)
+				grow(n);
+		}
+		/// \brief	Destroys the elements, the memory is kept.
+		void clear()
+		{
+			while (m_size > 0)
+				pop_back();
+		}
+		/// \brief	Moves the elements back to the inline buffer if they fit, or to fallback memory of their size.
+		void shrink_to_fit()
+		{
+			if (is_inline() || m_size == m_capacity)	return;
+			if (m_size <= N)
+				move_inline();
+			else if (Fallback::expand(m_data, m_capacity, m_size))
+				m_capacity = m_size;
+			else
+				relocate(m_size);
+		}
+
+		T & operator[](size_type idx) { MEMORY_ASSERT(idx < m_size); return m_data[idx]; }
+		const T & operator[](size_type idx) const { MEMORY_ASSERT(idx < m_size); return m_data[idx]; }
+		T & front() { return (*this)[0]; }
+		const T & front() const { return (*this)[0]; }
+		T & back() { return (*this)[m_size - 1]; }
+		const T & back() const { return (*this)[m_size - 1]; }
+
+		T * data() { return m_data; }
+		const T * data() const { return m_data; }
+		iterator begin() { return m_data; }
+		iterator end() { return m_data + m_size; }
+		const_iterator begin() const { return m_data; }
+		const_iterator end() const { return m_data + m_size; }
+
+		size_type size() const { return m_size; }
+		size_type capacity() const { return m_capacity; }
+		bool empty() const { return m_size == 0; }
+		/// \brief	True while the elements are in the buffer of the vector.
+		bool is_inline() const { return m_data == inline_data(); }
+
+		Fallback & get_fallback() { return *this; }
+
+	private:
+		T * inline_data() { return reinterpret_cast<T *>(m_buffer); }
+		const T * inline_data() const { return reinterpret_cast<const T *>(m_buffer); }
+
+		size_type grown_capacity(size_type needed) const
+		{
+			const auto doubled = m_capacity * 2;
+			return doubled > needed ? doubled : needed;
+		}
+		/// \brief	True if the fallback memory could be grown without moving the elements.
+		bool expand(size_type capacity)
+		{
+			if (is_inline() || !Fallback::expand(m_data, m_capacity, capacity))
+				return false;
+			m_capacity = capacity;
+			return true;
+		}
+		void grow(size_type needed)
+		{
+			const auto capacity = grown_capacity(needed);
+			if (!expand(capacity))
+				relocate(capacity);
+		}
+		/// \brief	The arguments may refer to the current elements (i.e. v.push_back(v[0])), so the new element
+		///			is constructed before the old ones are moved and their memory released.
+		template <typename... Args>
+		T & grow_and_emplace_back(Args &&... args)
+		{
+			const auto capacity = grown_capacity(m_size + 1);
+			if (expand(capacity))
+			{
+				new (m_data + m_size) T(std::forward<Args>(args)...);
+				return m_data[m_size++];
+			}
+
+			auto * data = Fallback::allocate(capacity);
+			MEMORY_ASSERT(data != nullptr);
+			try
+			{
+				new (data + m_size) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				Fallback::deallocate(data, capacity);
+				throw;
+			}
+
+			move_elements(data, m_data, m_size);
+			release();
+			m_data = data;
+			m_capacity = capacity;
+			return m_data[m_size++];
+		}
+		/// \brief	Moves the elements to new fallback memory for the given capacity, which doesn't fit inline.
+		void relocate(size_type capacity)
+		{
+			MEMORY_ASSERT(capacity > N && capacity >= m_size);
+			auto * data = Fallback::allocate(capacity);
+			MEMORY_ASSERT(data != nullptr);
+
+			move_elements(data, m_data, m_size);
+			release();
+			m_data = data;
+			m_capacity = capacity;
+		}
+		/// \brief	Moves the elements from the fallback memory back to the inline buffer.
+		void move_inline()
+		{
+			MEMORY_ASSERT(!is_inline() && m_size <= N);
+			auto * data = m_data;
+			const auto capacity = m_capacity;
+
+			move_elements(inline_data(), data, m_size);
+			Fallback::deallocate(data, capacity);
+			m_data = inline_data();
+			m_capacity = N;
+		}
+		/// \brief	Gives back the fallback memory, the elements need to be destroyed or moved.
+		void release()
+		{
+			if (!is_inline())
+				Fallback::deallocate(m_data, m_capacity);
+			m_data = inline_data();
+			m_capacity = N;
+		}
+		/// \brief	Takes the elements of other, which is left empty and inline.
+		void steal(SmallVector & other)
+		{
+			if (other.is_inline())
+			{
+				move_elements(inline_data(), other.m_data, other.m_size);
+				m_size = other.m_size;
+				other.m_size = 0;
+				return;
+			}
+
+			m_data = other.m_data;
+			m_size = other.m_size;
+			m_capacity = other.m_capacity;
+			other.m_data = other.inline_data();
+			other.m_size = 0;
+			other.m_capacity = N;
+		}
+		/// \brief	Moves the objects to uninitialized memory and destroys them.
+		static void move_elements(T * dst, T * src, size_type n)
+		{
+			for (size_type i = 0; i < n; ++i)
+			{
+				new (dst + i) T(std::move(src[i]));
+				src[i].~T();
+			}
+		}
+
+		T * m_data{ inline_data() };
+		size_type m_size{ 0u };
+		size_type m_capacity{ N };
+		alignas(T) unsigned char m_buffer[N * sizeof(T)];
+	};
+
+	template <typename T, size_type N, typename Fallback>
+	constexpr size_type SmallVector<T, N, Fallback>::inline_capacity;
+
+	template <typename T, size_type N, typename A, typename B>
+	bool operator==(const SmallVector<T, N, A> & lhs, const SmallVector<T, N, B> & rhs)
+	{
+		if (lhs.size() != rhs.size())	return false;
+		for (size_type i = 0; i < lhs.size(); ++i)
+		{
+			if (!(lhs[i] == rhs[i]))
+				return false;
+		}
+		return true;
+	}
+	template <typename T, size_type N, typename A, typename B>
+	bool operator!=(const SmallVector<T, N, A> & lhs, const SmallVector<T, N, B> & rhs)
+	{
+		return !(lhs == rhs);
+	}
+}
@@ -0,0 +1,219 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+
+#include <new>			// placement new
+#include <tuple>		// std::tuple_element
+#include <utility>		// std::index_sequence, std::move
+#include <vector>
+
+namespace memory
+{
+	/// \brief	Pool of objects whose fields are stored in parallel arrays (structure of arrays).
+	///			Every page has one column per field, the columns are aligned to COLUMN_ALIGNMENT so
+	///			SIMD loops can run directly over the objects of a field.
+	///			The objects are kept densely packed: removing an object moves the last one to its index,
+	///			so the objects are identified by an index that changes when other objects are removed.
+	template <typename... Fields>
+	class SoaPool
+	{
+		static_assert(sizeof...(Fields) > 0, "SoaPool needs at least one field.");
+
+	public:
+		static constexpr size_type field_count = sizeof...(Fields);
+		static constexpr size_type COLUMN_ALIGNMENT = 64;
+
+		template <size_type I>
+		using field_type = typename std::tuple_element<I, std::tuple<Fields...>>::type;
+
+		explicit SoaPool(size_type objects_per_page = 256)
+			: m_objects_per_page{ objects_per_page }
+		{
+			MEMORY_ASSERT(objects_per_page > 0);
+
+			const size_type sizes[] = { sizeof(Fields)... };
+			const size_type alignments[] = { alignof(Fields)... };
+			for (size_type i = 0; i < field_count; ++i)
+			{
+				MEMORY_ASSERT(alignments[i] <= COLUMN_ALIGNMENT);
+				m_column_offsets[i] = m_page_size;
+				m_page_size = (m_page_size + sizes[i] * objects_per_page + COLUMN_ALIGNMENT - 1) & ~(COLUMN_ALIGNMENT - 1);
+			}
+		}
+		~SoaPool()
+		{
+			clear();
+			shrink_to_fit();
+		}
+
+		SoaPool(const SoaPool &) = delete;
+		SoaPool & operator=(const SoaPool &) = delete;
+
+		/// \brief	Adds an object with all the fields default constructed, returns its index.
+		size_type allocate()
+		{
+			reserve_one();
+			construct(m_size, std::index_sequence_for<Fields...>{});
+			return m_size++;
+		}
+		/// \brief	Adds an object with the given value for every field, returns its index.
+		size_type allocate(Fields... values)
+		{
+			reserve_one();
+			construct(m_size, std::index_sequence_for<Fields...>{}, std::move(values)...);
+			return m_size++;
+		}
+
+		/// \brief	Removes the object moving the last object to its index.
+		///			Returns the previous index of the moved object (== index when the last object was removed),
+		///			so the users can update their references to it.
+		size_type deallocate(size_type index)
+		{
+			MEMORY_ASSERT(index < m_size);
+
+			const auto last = m_size - 1;
+			if (index != last)
+				move(last, index, std::index_sequence_for<Fields...>{});
+			destroy(last, std::index_sequence_for<Fields...>{});
+			m_size--;
+			return last;
+		}
+
+		/// \brief	Destroys all the objects, the pages are kept.
+		void clear()
+		{
+			for (size_type i = 0; i < m_size; ++i)
+				destroy(i, std::index_sequence_for<Fields...>{});
+			m_size = 0;
+		}
+
+		/// \brief	Gives back to the system the pages without objects.
+		void shrink_to_fit()
+		{
+			const auto used_pages = (m_size + m_objects_per_page - 1) / m_objects_per_page;
+			while (m_pages.size() > used_pages)
+			{
+				fill_with_pattern(DebugPattern::RELEASED, m_pages.back(), m_page_size);
+				global_aligned_dealloc(m_pages.back());
+				m_pages.pop_back();
+			}
+		}
+
+		template <size_type I>
+		field_type<I> & get(size_type index)
+		{
+			MEMORY_ASSERT(index < m_size);
+			return *address<I>(index);
+		}
+		template <size_type I>
+		const field_type<I> & get(size_type index) const
+		{
+			MEMORY_ASSERT(index < m_size);
+			return *address<I>(index);
+		}
+
+		/// \brief	The objects of the field I in the given page, aligned to COLUMN_ALIGNMENT.
+		///			Only the first page_object_count(page) are valid.
+		template <size_type I>
+		field_type<I> * column(size_type page)
+		{
+			MEMORY_ASSERT(page < m_pages.size());
+			return reinterpret_cast<field_type<I> *>(m_pages[page] + m_column_offsets[I]);
+		}
+		template <size_type I>
+		const field_type<I> * column(size_type page) const
+		{
+			MEMORY_ASSERT(page < m_pages.size());
+			return reinterpret_cast<const field_type<I> *>(m_pages[page] + m_column_offsets[I]);
+		}
+
+		/// \brief	Calls f(column, count) for the objects of the field I of every page in use.
+		template <size_type I, typename F>
+		void for_each_column(F && f)
+		{
+			for (size_type page = 0; page < used_pages(); ++page)
+				f(column<I>(page), page_object_count(page));
+		}
+
+		size_type size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+		size_type capacity() const { return m_pages.size() * m_objects_per_page; }
+
+		size_type get_per_page_obj_num() const { return m_objects_per_page; }
+		/// \brief	Bytes of a page, including the padding between columns.
+		size_type get_page_size() const { return m_page_size; }
+		size_type allocated_pages() const { return m_pages.size(); }
+		size_type used_pages() const { return (m_size + m_objects_per_page - 1) / m_objects_per_page; }
+		size_type page_object_count(size_type page) const
+		{
+			const auto first = page * m_objects_per_page;
+			if (first >= m_size)	return 0;
+			return m_size - first < m_objects_per_page ? m_size - first : m_objects_per_page;
+		}
+
+	private:
+		template <size_type I>
+		field_type<I> * address(size_type index) const
+		{
+			auto * page = m_pages[index / m_objects_per_page];
+			return reinterpret_cast<field_type<I> *>(page + m_column_offsets[I]) + index % m_objects_per_page;
+		}
+
+		void reserve_one()
+		{
+			if (m_size < capacity())	return;
+
+			auto * page = reinterpret_cast<unsigned char *>(global_aligned_alloc(m_page_size, COLUMN_ALIGNMENT));
+			fill_with_pattern(DebugPattern::ACQUIRED, page, m_page_size);
+			m_pages.push_back(page);
+		}
+
+		// the fields are visited expanding the index sequence in the initializer of an array
+
+		template <size_type... Is>
+		void construct(size_type index, std::index_sequence<Is...>)
+		{
+			const int expand[] = { (new (address<Is>(index)) field_type<Is>(), 0)... };
+			(void)expand;
+		}
+		template <size_type... Is>
+		void construct(size_type index, std::index_sequence<Is...>, Fields &&... values)
+		{
+			const int expand[] = { (new (address<Is>(index)) field_type<Is>(std::move(values)), 0)... };
+			(void)expand;
+		}
+		template <size_type... Is>
+		void move(size_type from, size_type to, std::index_sequence<Is...>)
+		{
+			const int expand[] = { (*address<Is>(to) = std::move(*address<Is>(from)), 0)... };
+			(void)expand;
+		}
+		template <size_type... Is>
+		void destroy(size_type index, std::index_sequence<Is...>)
+		{
+			const int expand[] = { (destroy_field(address<Is>(index)), 0)... };
+			(void)expand;
+		}
+		template <typename T>
+		static void destroy_field(T * field)
+		{
+			field->~T();
+			fill_with_pattern(DebugPattern::DEALLOCATED, field, sizeof(T));
+		}
+
+	private:
+		std::vector<unsigned char *> m_pages;
+		size_type m_column_offsets[field_count];
+		size_type m_objects_per_page{ 0u };
+		size_type m_page_size{ 0u };
+		size_type m_size{ 0u };
+	};
+}
@@ -13,7 +13,9 @@ namespace memory
 	StackAllocator::StackAllocator(size_type bytes)
 		: m_memory_chunk{ bytes }
 		, m_top{ m_memory_chunk.memory() }
-	{}
+	{
+		poison_memory(m_memory_chunk.memory(), m_memory_chunk.bytes());
+	}
 
 	unsigned char * StackAllocator::allocate(size_type bytes)
 	{
@@ -21,10 +23,24 @@ namespace memory
 
 		auto * result = m_top;
 		m_top += bytes;
+		sanitizer_allocate(result, bytes);
+		trace_allocation(this, result, bytes, 1);
 		return result;
 	}
 
-	size_type StackAllocator::get_offset_from_base(unsigned char * ptr)
+	bool StackAllocator::expand(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		if (mem != m_top - old_bytes)	return false;
+		if (new_bytes > old_bytes && new_bytes - old_bytes > free_size())	return false;
+
+		trace_deallocation(this, mem, old_bytes, 1);
+		m_top = mem + new_bytes;
+		sanitizer_resize(mem, old_bytes, new_bytes);
+		trace_allocation(this, mem, new_bytes, 1);
+		return true;
+	}
+
+	size_type StackAllocator::get_offset_from_base(const unsigned char * ptr) const
 	{
 		return ptr_to_num(ptr) - ptr_to_num(m_memory_chunk.memory());
 	}
@@ -32,6 +48,7 @@ namespace memory
 #if MEMORY_DEBUG_ENABLED
 	DebugStackAllocator::DebugStackAllocator(size_type bytes)
 		: Base{ bytes }
+		, m_high_water{ m_top }
 	{
 		fill_with_pattern(DebugPattern::ACQUIRED, m_memory_chunk.memory(), m_memory_chunk.bytes());
 	}
@@ -44,6 +61,19 @@ namespace memory
 
 	unsigned char * DebugStackAllocator::allocate(size_type bytes)
 	{
+		// the allocation comes from the stack if the guard can't map its pages
+		auto * guarded = m_guard && m_guard->should_guard() ? m_guard->allocate(bytes, 1) : nullptr;
+		if (guarded != nullptr)
+		{
+			m_stats.allocations++;
+			m_stats.guarded++;
+			fill_with_pattern(DebugPattern::ALLOCATED, guarded, bytes);
+			return guarded;
+		}
+
+		if (bytes <= free_size())
+			check_reused(m_top, bytes);
+
 		if (auto * allocated = Base::allocate(bytes))
 		{
 			m_stats.allocations++;
@@ -59,9 +89,103 @@ namespace memory
 	void DebugStackAllocator::deallocate(unsigned char * mem, size_type bytes)
 	{
 		m_stats.deallocations++;
-		fill_with_pattern(DebugPattern::DEALLOCATED, mem, bytes);
+		if (m_guard && m_guard->owns(mem))
+		{
+			m_guard->deallocate(mem, bytes);
+			return;
+		}
+
+		fill_freed(mem, bytes);
 		Base::deallocate(mem, bytes);
 	}
+
+	bool DebugStackAllocator::expand(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		// the guarded allocations touch their guard page
+		const bool top = mem == m_top - old_bytes && !(m_guard && m_guard->owns(mem));
+		if (top && new_bytes > old_bytes && new_bytes - old_bytes <= free_size())
+			check_reused(m_top, new_bytes - old_bytes);
+
+		if (!top || !Base::expand(mem, old_bytes, new_bytes))
+		{
+			m_stats.failures++;
+			return false;
+		}
+
+		// the history is never popped, the last record at the offset of mem is the one of this allocation
+		const auto offset = get_offset_from_base(mem);
+		auto & records = m_stats.per_allocation_stats;
+		auto it = records.rbegin();
+		while (it != records.rend() && it->offset != offset)
+			++it;
+		if (it != records.rend())
+			it->size = new_bytes;
+		else
+			records.emplace_back(new_bytes, offset);
+
+		if (new_bytes > old_bytes)
+			fill_with_pattern(DebugPattern::ALLOCATED, mem + old_bytes, new_bytes - old_bytes);
+		else
+			fill_freed(mem + new_bytes, old_bytes - new_bytes);
+		return true;
+	}
+
+	void DebugStackAllocator::enable_guard_pages(const GuardPageConfig & config)
+	{
+		m_guard.reset(new GuardPageAllocator{ config });
+	}
+
+	AllocatorAnalytics DebugStackAllocator::get_analytics() const
+	{
+		AllocatorAnalytics analytics;
+		analytics.requested_bytes = get_offset_from_base(m_top);
+		analytics.granted_bytes = analytics.requested_bytes;
+		analytics.free_bytes = free_size();
+		analytics.largest_free_block = free_size();
+		analytics.high_water_mark = get_offset_from_base(m_high_water);
+		return analytics;
+	}
+
+	void DebugStackAllocator::defer_fills(bool defer)
+	{
+		if (!defer)
+			m_deferred_fills.flush();
+		m_defer_fills = defer;
+	}
+
+	bool DebugStackAllocator::verify_heap()
+	{
+		m_deferred_fills.flush();
+
+		const auto deallocated = static_cast<size_type>(m_high_water - m_top);
+		const auto acquired = static_cast<size_type>(m_memory_chunk.end_of_memory() - m_high_water);
+		const bool valid = verify_pattern(this, m_top, deallocated, DebugPattern::DEALLOCATED);
+		return verify_pattern(this, m_high_water, acquired, DebugPattern::ACQUIRED) && valid;
+	}
+
+	void DebugStackAllocator::fill_freed(unsigned char * mem, size_type bytes)
+	{
+		if (m_defer_fills)
+			m_deferred_fills.add(mem, bytes, DebugPattern::DEALLOCATED);
+		else
+			fill_with_pattern(DebugPattern::DEALLOCATED, mem, bytes);
+	}
+
+	void DebugStackAllocator::check_reused(unsigned char * mem, size_type bytes)
+	{
+		auto * end = mem + bytes;
+		if (!m_deferred_fills.cancel(mem, bytes))
+		{
+			auto * high_water = m_high_water < end ? m_high_water : end;
+			if (mem < high_water)
+				verify_pattern(this, mem, static_cast<size_type>(high_water - mem), DebugPattern::DEALLOCATED);
+			if (high_water < end)
+				verify_pattern(this, high_water, static_cast<size_type>(end - high_water), DebugPattern::ACQUIRED);
+		}
+
+		if (m_high_water < end)
+			m_high_water = end;
+	}
 #endif
 
 }
\ No newline at end of file
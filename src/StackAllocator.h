@@ -11,6 +11,7 @@ found in the top-level directory of this distribution.
 
 #include "MemoryCore.h"
 #include "MemoryChunk.h"
+#include "AllocationTrace.h"
 
 namespace memory
 {
@@ -21,14 +22,28 @@ namespace memory
 	{
 	public:
 		explicit StackAllocator(size_type bytes);
-		virtual ~StackAllocator() = default;
+		virtual ~StackAllocator()
+		{
+			unpoison_memory(m_memory_chunk.memory(), m_memory_chunk.bytes());
+		}
 
 		virtual unsigned char * allocate(size_type bytes);
 		virtual void deallocate(unsigned char * mem, size_type bytes)
 		{
 			MEMORY_ASSERT(mem == m_top - bytes);
+			trace_deallocation(this, mem, bytes, 1);
+			sanitizer_deallocate(mem, bytes);
 			m_top = mem;
 		}
+		/// \brief	Only the allocation at the top of the stack can grow or shrink, it does not move.
+		///			Returns false if it can't.
+		virtual bool expand(unsigned char * mem, size_type old_bytes, size_type new_bytes);
+		/// \brief	The memory can't be moved (it would break the order of the deallocations),
+		///			so it is the same as expand. Returns nullptr if it can't, mem is still valid then.
+		unsigned char * reallocate(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+		{
+			return expand(mem, old_bytes, new_bytes) ? mem : nullptr;
+		}
 
 		bool is_full() const { return free_size() == 0; }
 		size_type owns(unsigned char * mem) const { return m_memory_chunk.owns(mem); }
@@ -38,7 +53,7 @@ namespace memory
 		}
 
 	protected:
-		size_type get_offset_from_base(unsigned char * ptr);
+		size_type get_offset_from_base(const unsigned char * ptr) const;
 
 		// IMPORTANT(Borja): don't change the order of these two variables, construction order matters
 		MemoryChunk m_memory_chunk;
@@ -48,7 +63,12 @@ namespace memory
 
 #if MEMORY_DEBUG_ENABLED
 
+#include "AllocatorAnalytics.h"
+#include "DebugPatterns.h"
+#include "GuardPageAllocator.h"
+
 #include <deque>
+#include <memory>	// std::unique_ptr
 
 namespace memory
 {
@@ -79,6 +99,8 @@ namespace memory
 			size_type allocations{ 0 };
 			size_type deallocations{ 0 };
 			size_type failures{ 0 };
+			/// \brief	Allocations that got their own guard page, they are not in per_allocation_stats.
+			size_type guarded{ 0 };
 
 			// STUDY(Borja): use a linked list here? We manage it, no stl dependency...
 			std::deque<AllocationStats> per_allocation_stats;
@@ -90,11 +112,36 @@ namespace memory
 
 		unsigned char * allocate(size_type bytes) override;
 		void deallocate(unsigned char * mem, size_type bytes) override;
+		bool expand(unsigned char * mem, size_type old_bytes, size_type new_bytes) override;
+
+		/// \brief	The sampled allocations are served by a GuardPageAllocator instead of the stack,
+		///			so an overrun faults right away. They don't need to follow the order of the stack.
+		///			Needs to be called before allocating.
+		void enable_guard_pages(const GuardPageConfig & config = GuardPageConfig{});
+		const GuardPageAllocator * get_guard() const { return m_guard.get(); }
+
+		/// \brief	The deallocated memory is filled in batches, the memory allocated again before is never filled.
+		void defer_fills(bool defer);
+		/// \brief	Checks that nobody wrote to the memory above the top, the corruptions go to the corruption
+		///			callback. The memory is also checked when it is allocated again.
+		bool verify_heap();
 
 		const Stats & get_stats() const { return m_stats; }
+		/// \brief	The stack gives the exact bytes requested and has no fragmentation, the high water
+		///			mark is the highest the top has been. Without the guarded allocations.
+		AllocatorAnalytics get_analytics() const;
 
 	private:
+		void fill_freed(unsigned char * mem, size_type bytes);
+		/// \brief	Verifies the pattern of memory above the top that is going to be used.
+		void check_reused(unsigned char * mem, size_type bytes);
+
 		Stats m_stats;
+		std::unique_ptr<GuardPageAllocator> m_guard;
+		impl::DeferredFills m_deferred_fills;
+		bool m_defer_fills{ false };
+		/// \brief	The memory between the top and here was deallocated, the one after it was never used.
+		unsigned char * m_high_water{ nullptr };
 	};
 }
 
@@ -0,0 +1,276 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "ThreadCachedAllocator.h"
+#include "AllocationTrace.h"
+
+#include <cstdint>
+#include <mutex>
+#include <new>			// placement new
+#include <type_traits>	// std::aligned_storage
+
+#if defined(_WIN32)
+#define MEMORY_THREAD_CACHE_PTHREAD 0
+#else
+#include <pthread.h>
+#define MEMORY_THREAD_CACHE_PTHREAD 1
+#endif
+
+namespace memory
+{
+	namespace impl
+	{
+		struct CachedObject { CachedObject * m_next; };
+
+		/// \brief	Trivial, so the cache of a thread is initialized without running code (and allocating)
+		///			and its destruction does not need to be registered.
+		struct ThreadCache
+		{
+			CachedObject * m_lists[SizeClassAllocator::CLASS_NUM];
+			std::uint32_t m_counts[SizeClassAllocator::CLASS_NUM];
+			bool m_registered;
+		};
+		thread_local ThreadCache s_thread_cache;
+
+		/// \brief	Never destroyed, memory can be freed after the static destructors run.
+		struct CentralAllocator
+		{
+			/// \brief	Protects the free lists and the page map of m_alloc.
+			std::mutex m_mutex;
+			PageMapAllocator m_alloc{ false };
+#if MEMORY_THREAD_CACHE_PTHREAD
+			pthread_key_t m_thread_exit_key;
+#endif
+		};
+
+		CentralAllocator & central();
+
+		void flush_thread_cache(ThreadCache & cache);
+
+#if MEMORY_THREAD_CACHE_PTHREAD
+		/// \brief	pthread keys don't allocate, thread_local objects with destructors may.
+		void on_thread_exit(void * cache)
+		{
+			flush_thread_cache(*reinterpret_cast<ThreadCache *>(cache));
+		}
+
+		/// \brief	The child of a fork only has the thread that called fork, if an other thread held the lock
+		///			it would never be unlocked. Holding it while forking leaves the free lists and the page map
+		///			consistent in both processes.
+		void lock_before_fork() { central().m_mutex.lock(); }
+		void unlock_after_fork() { central().m_mutex.unlock(); }
+#else
+		struct ThreadExit
+		{
+			~ThreadExit() { flush_thread_cache(s_thread_cache); }
+		};
+#endif
+
+		CentralAllocator & central()
+		{
+			static typename std::aligned_storage<sizeof(CentralAllocator), alignof(CentralAllocator)>::type storage;
+			static CentralAllocator * const central = []
+			{
+				auto * result = new (&storage) CentralAllocator;
+#if MEMORY_THREAD_CACHE_PTHREAD
+				pthread_key_create(&result->m_thread_exit_key, on_thread_exit);
+				// before any thread can take the lock, a fork racing with the registration could copy it held
+				// (the C library keeps the first handlers in static storage, registering them does not allocate)
+				pthread_atfork(lock_before_fork, unlock_after_fork, unlock_after_fork);
+#endif
+				return result;
+			}();
+			return *central;
+		}
+
+		ThreadCache & thread_cache()
+		{
+			auto & cache = s_thread_cache;
+			if (!cache.m_registered)
+			{
+				cache.m_registered = true;
+#if MEMORY_THREAD_CACHE_PTHREAD
+				pthread_setspecific(central().m_thread_exit_key, &cache);
+#else
+				thread_local ThreadExit thread_exit;
+				(void)thread_exit;
+#endif
+			}
+			return cache;
+		}
+
+		/// \brief	Gives the first n objects of the list to the central allocator.
+		void release_objects(ThreadCache & cache, size_type class_idx, size_type n)
+		{
+			auto & central_alloc = central();
+			const auto size = SizeClassAllocator::class_size(class_idx);
+
+			std::lock_guard<std::mutex> lock{ central_alloc.m_mutex };
+			for (size_type i = 0; i < n; ++i)
+			{
+				auto * obj = cache.m_lists[class_idx];
+				cache.m_lists[class_idx] = obj->m_next;
+				central_alloc.m_alloc.sized_free(obj, size);
+			}
+			cache.m_counts[class_idx] -= static_cast<std::uint32_t>(n);
+		}
+
+		void flush_thread_cache(ThreadCache & cache)
+		{
+			for (size_type i = 0; i < SizeClassAllocator::CLASS_NUM; ++i)
+			{
+				if (cache.m_counts[i])
+					release_objects(cache, i, cache.m_counts[i]);
+			}
+
+			// the thread can still allocate while other thread exit code runs, it registers again
+			cache.m_registered = false;
+		}
+
+		/// \brief	Stops at the first object the central allocator can't give, the list may still be empty.
+		void fill_thread_cache(ThreadCache & cache, size_type class_idx)
+		{
+			auto & central_alloc = central();
+			const auto size = SizeClassAllocator::class_size(class_idx);
+			const auto batch = ThreadCachedAllocator::batch_size(class_idx);
+
+			std::lock_guard<std::mutex> lock{ central_alloc.m_mutex };
+			size_type filled = 0;
+			for (; filled < batch; ++filled)
+			{
+				auto * obj = reinterpret_cast<CachedObject *>(central_alloc.m_alloc.allocate(size));
+				if (obj == nullptr)	break;
+
+				obj->m_next = cache.m_lists[class_idx];
+				cache.m_lists[class_idx] = obj;
+			}
+			cache.m_counts[class_idx] += static_cast<std::uint32_t>(filled);
+		}
+	}
+
+	size_type ThreadCachedAllocator::batch_size(size_type class_idx)
+	{
+		const auto batch = BATCH_BYTES / SizeClassAllocator::class_size(class_idx);
+		if (batch < MIN_BATCH)	return MIN_BATCH;
+		if (batch > MAX_BATCH)	return MAX_BATCH;
+		return batch;
+	}
+
+	void * ThreadCachedAllocator::allocate(size_type bytes)
+	{
+		const auto class_idx = SizeClassAllocator::class_index(bytes);
+		if (class_idx == SizeClassAllocator::CLASS_NUM)
+		{
+			auto & central_alloc = impl::central();
+			void * mem = nullptr;
+			{
+				std::lock_guard<std::mutex> lock{ central_alloc.m_mutex };
+				mem = central_alloc.m_alloc.allocate(bytes);
+			}
+			if (mem == nullptr)	return nullptr;
+			// out of the lock, the recorder may allocate
+			trace_allocation(nullptr, mem, bytes, PageMapAllocator::SPAN_SIZE);
+			return mem;
+		}
+
+		auto & cache = impl::thread_cache();
+		if (cache.m_lists[class_idx] == nullptr)
+		{
+			impl::fill_thread_cache(cache, class_idx);
+			if (cache.m_lists[class_idx] == nullptr)
+				return nullptr;
+		}
+
+		auto * obj = cache.m_lists[class_idx];
+		cache.m_lists[class_idx] = obj->m_next;
+		cache.m_counts[class_idx]--;
+
+		trace_allocation(nullptr, obj, bytes, SizeClassAllocator::class_size(class_idx));
+		return obj;
+	}
+
+	void * ThreadCachedAllocator::allocate_aligned(size_type bytes, size_type alignment)
+	{
+		MEMORY_ASSERT(is_power_of_two(alignment));
+
+		// the objects of the size classes are aligned to their size and the big allocations to the spans
+		if (alignment <= PageMapAllocator::SPAN_SIZE)
+			return allocate(bytes < alignment ? alignment : bytes);
+
+		auto & central_alloc = impl::central();
+		void * mem = nullptr;
+		{
+			std::lock_guard<std::mutex> lock{ central_alloc.m_mutex };
+			mem = central_alloc.m_alloc.allocate_aligned(bytes, alignment);
+		}
+		if (mem == nullptr)	return nullptr;
+		trace_allocation(nullptr, mem, bytes, alignment);
+		return mem;
+	}
+
+	void ThreadCachedAllocator::deallocate(void * mem)
+	{
+		if (mem == nullptr)	return;
+
+		// the page map of the central allocator can be read without the lock,
+		// the span of the object was registered before the object was allocated
+		sized_free(mem, impl::central().m_alloc.usable_size(mem));
+	}
+
+	void ThreadCachedAllocator::sized_free(void * mem, size_type bytes)
+	{
+		if (mem == nullptr)	return;
+
+		const auto class_idx = SizeClassAllocator::class_index(bytes);
+		if (class_idx == SizeClassAllocator::CLASS_NUM)
+		{
+			trace_deallocation(nullptr, mem, bytes, PageMapAllocator::SPAN_SIZE);
+
+			auto & central_alloc = impl::central();
+			std::lock_guard<std::mutex> lock{ central_alloc.m_mutex };
+			central_alloc.m_alloc.sized_free(mem, bytes);
+			return;
+		}
+
+		trace_deallocation(nullptr, mem, bytes, SizeClassAllocator::class_size(class_idx));
+
+		auto & cache = impl::thread_cache();
+		auto * obj = reinterpret_cast<impl::CachedObject *>(mem);
+		obj->m_next = cache.m_lists[class_idx];
+		cache.m_lists[class_idx] = obj;
+		cache.m_counts[class_idx]++;
+
+		// keep one batch, so a thread that allocates and frees around the limit does not hit the lock every time
+		const auto batch = batch_size(class_idx);
+		if (cache.m_counts[class_idx] > 2 * batch)
+			impl::release_objects(cache, class_idx, batch);
+	}
+
+	size_type ThreadCachedAllocator::usable_size(const void * mem)
+	{
+		return impl::central().m_alloc.usable_size(mem);
+	}
+
+	bool ThreadCachedAllocator::owns(const void * mem)
+	{
+		return impl::central().m_alloc.owns(mem);
+	}
+
+	void ThreadCachedAllocator::flush_thread_cache()
+	{
+		impl::flush_thread_cache(impl::s_thread_cache);
+	}
+
+	size_type ThreadCachedAllocator::thread_cached_objects()
+	{
+		size_type objects = 0;
+		for (const auto count : impl::s_thread_cache.m_counts)
+			objects += count;
+		return objects;
+	}
+}
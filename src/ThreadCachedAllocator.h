@@ -0,0 +1,52 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "PageMapAllocator.h"
+
+namespace memory
+{
+	/// \brief	Thread safe size class allocator: every thread keeps a cache of free objects of each size class
+	///			and moves them in batches from and to a central PageMapAllocator shared by all the threads,
+	///			so most allocations and deallocations don't take a lock. Big allocations go to the central one.
+	///			It does not need the size to free the memory, and neither it nor its central allocator go
+	///			through malloc or operator new, so it is the allocator behind the replacements of
+	///			operator new/delete (OperatorNewReplacement.cpp) and malloc/free (MallocInterpose.cpp).
+	///			The cache of a thread is given back when the thread ends.
+	class ThreadCachedAllocator
+	{
+	public:
+		/// \brief	Bytes moved between a thread cache and the central allocator at once,
+		///			a cache keeps up to twice these bytes of each size class.
+		static constexpr size_type BATCH_BYTES = 16 * 1024;
+		static constexpr size_type MIN_BATCH = 4;
+		static constexpr size_type MAX_BATCH = 128;
+
+		/// \brief	Returns nullptr if the central allocator can't map more memory.
+		static void * allocate(size_type bytes);
+		/// \brief	alignment needs to be a power of two, the allocations aligned to more than
+		///			PageMapAllocator::SPAN_SIZE are served by the central allocator.
+		static void * allocate_aligned(size_type bytes, size_type alignment);
+		static void deallocate(void * mem);
+		/// \brief	The size needs to be the one used to allocate the memory (or the usable size).
+		static void sized_free(void * mem, size_type bytes);
+
+		static size_type usable_size(const void * mem);
+		static bool owns(const void * mem);
+
+		/// \brief	Gives the objects cached by the calling thread back to the central allocator.
+		static void flush_thread_cache();
+		/// \brief	Objects in the cache of the calling thread.
+		static size_type thread_cached_objects();
+
+		/// \brief	Objects of the size class moved between a thread cache and the central allocator at once.
+		static size_type batch_size(size_type class_idx);
+	};
+}
@@ -0,0 +1,388 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "TlsfAllocator.h"
+
+namespace memory
+{
+	namespace impl
+	{
+		constexpr size_type TLSF_FREE_BIT = 1u;
+		constexpr size_type TLSF_PREV_FREE_BIT = 2u;
+		constexpr size_type TLSF_FLAGS = TLSF_FREE_BIT | TLSF_PREV_FREE_BIT;
+
+		inline size_type tlsf_size(const TlsfBlockHeader * block) { return block->m_size & ~TLSF_FLAGS; }
+		inline void tlsf_set_size(TlsfBlockHeader * block, size_type size)
+		{
+			block->m_size = size | (block->m_size & TLSF_FLAGS);
+		}
+		inline bool tlsf_is_free(const TlsfBlockHeader * block) { return (block->m_size & TLSF_FREE_BIT) != 0; }
+		inline bool tlsf_is_prev_free(const TlsfBlockHeader * block) { return (block->m_size & TLSF_PREV_FREE_BIT) != 0; }
+		inline void tlsf_set_flag(TlsfBlockHeader * block, size_type flag, bool set)
+		{
+			if (set)	block->m_size |= flag;
+			else		block->m_size &= ~flag;
+		}
+
+		inline unsigned char * tlsf_user_memory(TlsfBlockHeader * block)
+		{
+			return reinterpret_cast<unsigned char *>(block) + TlsfAllocator::BLOCK_OVERHEAD;
+		}
+		inline TlsfBlockHeader * tlsf_block_from_user_memory(const unsigned char * mem)
+		{
+			return reinterpret_cast<TlsfBlockHeader *>(const_cast<unsigned char *>(mem) - TlsfAllocator::BLOCK_OVERHEAD);
+		}
+		inline TlsfBlockHeader * tlsf_next_physical(TlsfBlockHeader * block)
+		{
+			return reinterpret_cast<TlsfBlockHeader *>(tlsf_user_memory(block) + tlsf_size(block));
+		}
+
+		/// \brief	Marks the block as free or used, the next block needs to know about it to merge with it.
+		inline void tlsf_mark_free(TlsfBlockHeader * block, bool free)
+		{
+			auto * next = tlsf_next_physical(block);
+			tlsf_set_flag(block, TLSF_FREE_BIT, free);
+			tlsf_set_flag(next, TLSF_PREV_FREE_BIT, free);
+			if (free)
+				next->m_prev_physical = block;
+		}
+
+		inline size_type tlsf_round_up(size_type bytes)
+		{
+			return (bytes + TlsfAllocator::ALIGNMENT - 1) & ~(TlsfAllocator::ALIGNMENT - 1);
+		}
+
+		/// \brief	Smallest size that goes to the given list.
+		inline size_type tlsf_list_min_size(size_type fl, size_type sl)
+		{
+			if (fl == 0)
+				return sl * (TlsfAllocator::SMALL_BLOCK_SIZE / TlsfAllocator::SL_INDEX_COUNT);
+
+			const auto bit = fl + TlsfAllocator::FL_INDEX_SHIFT - 1;
+			return (size_type{ 1u } << bit) + sl * (size_type{ 1u } << (bit - TlsfAllocator::SL_INDEX_COUNT_LOG2));
+		}
+	}
+
+	TlsfAllocator::TlsfAllocator(size_type bytes)
+		: m_memory_chunk{ bytes & ~(ALIGNMENT - 1) }
+	{
+		// first block + its header + the sentinel header at the end
+		MEMORY_ASSERT(m_memory_chunk.bytes() >= 2 * BLOCK_OVERHEAD + MIN_BLOCK_SIZE);
+		MEMORY_ASSERT(ptr_to_num(m_memory_chunk.memory()) % ALIGNMENT == 0);
+
+		for (auto & bitmap : m_sl_bitmap)
+			bitmap = 0u;
+		for (auto & lists : m_free_lists)
+			for (auto & list : lists)
+				list = nullptr;
+
+		// the whole chunk is a free block followed by an empty block that is never free,
+		// so that the last block does not need special cases
+		auto * block = reinterpret_cast<BlockHeader *>(m_memory_chunk.memory());
+		block->m_prev_physical = nullptr;
+		block->m_size = m_memory_chunk.bytes() - 2 * BLOCK_OVERHEAD;
+
+		auto * sentinel = impl::tlsf_next_physical(block);
+		sentinel->m_size = 0u;
+
+		impl::tlsf_mark_free(block, true);
+		insert_free_block(block);
+	}
+
+	unsigned char * TlsfAllocator::allocate(size_type bytes)
+	{
+		if (bytes > m_memory_chunk.bytes())	return nullptr;
+
+		auto size = impl::tlsf_round_up(bytes);
+		if (size < MIN_BLOCK_SIZE)	size = MIN_BLOCK_SIZE;
+
+		size_type fl, sl;
+		mapping_search(size, fl, sl);
+		if (fl >= FL_INDEX_COUNT)	return nullptr;
+
+		auto * block = find_suitable_block(fl, sl);
+		if (block == nullptr)	return nullptr;
+
+		remove_free_block(block, fl, sl);
+		impl::tlsf_mark_free(block, false);
+		trim_used_block(block, size);
+
+		auto * result = impl::tlsf_user_memory(block);
+		trace_allocation(this, result, bytes, ALIGNMENT);
+		return result;
+	}
+
+	void TlsfAllocator::deallocate(unsigned char * mem, size_type bytes)
+	{
+		MEMORY_ASSERT(owns(mem));
+		trace_deallocation(this, mem, bytes, ALIGNMENT);
+
+		auto * block = impl::tlsf_block_from_user_memory(mem);
+		MEMORY_ASSERT(!impl::tlsf_is_free(block));
+
+		// merge with the neighbours, they are always merged, so they can't have free neighbours
+		if (impl::tlsf_is_prev_free(block))
+		{
+			auto * prev = block->m_prev_physical;
+			remove_free_block(prev);
+			impl::tlsf_set_size(prev, impl::tlsf_size(prev) + BLOCK_OVERHEAD + impl::tlsf_size(block));
+			block = prev;
+		}
+
+		auto * next = impl::tlsf_next_physical(block);
+		if (impl::tlsf_is_free(next))
+		{
+			remove_free_block(next);
+			impl::tlsf_set_size(block, impl::tlsf_size(block) + BLOCK_OVERHEAD + impl::tlsf_size(next));
+		}
+
+		impl::tlsf_mark_free(block, true);
+		insert_free_block(block);
+	}
+
+	bool TlsfAllocator::expand(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		MEMORY_ASSERT(owns(mem));
+
+		auto size = impl::tlsf_round_up(new_bytes);
+		if (size < MIN_BLOCK_SIZE)	size = MIN_BLOCK_SIZE;
+
+		auto * block = impl::tlsf_block_from_user_memory(mem);
+		MEMORY_ASSERT(!impl::tlsf_is_free(block));
+
+		const auto block_size = impl::tlsf_size(block);
+		if (size > block_size)
+		{
+			auto * next = impl::tlsf_next_physical(block);
+			if (!impl::tlsf_is_free(next) || block_size + BLOCK_OVERHEAD + impl::tlsf_size(next) < size)
+				return false;
+
+			remove_free_block(next);
+			impl::tlsf_set_size(block, block_size + BLOCK_OVERHEAD + impl::tlsf_size(next));
+			// the block after next needs to know its previous block is used now
+			impl::tlsf_mark_free(block, false);
+		}
+		trim_used_block(block, size);
+
+		trace_deallocation(this, mem, old_bytes, ALIGNMENT);
+		trace_allocation(this, mem, new_bytes, ALIGNMENT);
+		return true;
+	}
+
+	unsigned char * TlsfAllocator::reallocate(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		if (expand(mem, old_bytes, new_bytes))	return mem;
+
+		auto * result = allocate(new_bytes);
+		if (result == nullptr)	return nullptr;
+
+		std::memcpy(result, mem, old_bytes < new_bytes ? old_bytes : new_bytes);
+		deallocate(mem, old_bytes);
+		return result;
+	}
+
+	size_type TlsfAllocator::usable_size(const unsigned char * mem) const
+	{
+		MEMORY_ASSERT(owns(mem));
+		return impl::tlsf_size(impl::tlsf_block_from_user_memory(mem));
+	}
+
+	size_type TlsfAllocator::max_allocation_size() const
+	{
+		if (m_fl_bitmap == 0)	return 0;
+
+		const auto fl = find_last_set(m_fl_bitmap);
+		const auto sl = find_last_set(m_sl_bitmap[fl]);
+		const auto size = impl::tlsf_list_min_size(fl, sl);
+		return size < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : size;
+	}
+
+	size_type TlsfAllocator::largest_free_block() const
+	{
+		if (m_fl_bitmap == 0)	return 0;
+
+		// the blocks of the last list are the only ones that can be the biggest
+		const auto fl = find_last_set(m_fl_bitmap);
+		const auto sl = find_last_set(m_sl_bitmap[fl]);
+		size_type largest = 0;
+		for (auto * block = m_free_lists[fl][sl]; block != nullptr; block = block->m_next_free)
+		{
+			if (impl::tlsf_size(block) > largest)
+				largest = impl::tlsf_size(block);
+		}
+		return largest;
+	}
+
+	void TlsfAllocator::trim_used_block(BlockHeader * block, size_type size)
+	{
+		const auto block_size = impl::tlsf_size(block);
+		if (block_size < size + BLOCK_OVERHEAD + MIN_BLOCK_SIZE)	return;
+
+		// the previous block of the remaining one is used, no flags
+		auto * remaining = reinterpret_cast<BlockHeader *>(impl::tlsf_user_memory(block) + size);
+		remaining->m_size = block_size - size - BLOCK_OVERHEAD;
+		impl::tlsf_set_size(block, size);
+
+		// when shrinking an allocation the next block may be free
+		auto * next = impl::tlsf_next_physical(remaining);
+		if (impl::tlsf_is_free(next))
+		{
+			remove_free_block(next);
+			impl::tlsf_set_size(remaining, impl::tlsf_size(remaining) + BLOCK_OVERHEAD + impl::tlsf_size(next));
+		}
+
+		impl::tlsf_mark_free(remaining, true);
+		insert_free_block(remaining);
+	}
+
+	void TlsfAllocator::mapping_insert(size_type size, size_type & fl, size_type & sl)
+	{
+		if (size < SMALL_BLOCK_SIZE)
+		{
+			fl = 0;
+			sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+		}
+		else
+		{
+			const auto bit = find_last_set(size);
+			sl = (size >> (bit - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+			fl = bit - (FL_INDEX_SHIFT - 1);
+		}
+	}
+
+	void TlsfAllocator::mapping_search(size_type size, size_type & fl, size_type & sl)
+	{
+		if (size >= SMALL_BLOCK_SIZE)
+			size += (size_type{ 1u } << (find_last_set(size) - SL_INDEX_COUNT_LOG2)) - 1;
+		mapping_insert(size, fl, sl);
+	}
+
+	TlsfAllocator::BlockHeader * TlsfAllocator::find_suitable_block(size_type & fl, size_type & sl) const
+	{
+		// first look for a list in the same first level, then in the bigger ones
+		std::uint32_t sl_map = m_sl_bitmap[fl] & (~std::uint32_t{ 0u } << sl);
+		if (sl_map == 0)
+		{
+			const std::uint32_t fl_map = fl + 1 < FL_INDEX_COUNT ? m_fl_bitmap & (~std::uint32_t{ 0u } << (fl + 1)) : 0u;
+			if (fl_map == 0)	return nullptr;
+
+			fl = find_first_set(fl_map);
+			sl_map = m_sl_bitmap[fl];
+		}
+
+		sl = find_first_set(sl_map);
+		return m_free_lists[fl][sl];
+	}
+
+	void TlsfAllocator::insert_free_block(BlockHeader * block)
+	{
+		size_type fl, sl;
+		mapping_insert(impl::tlsf_size(block), fl, sl);
+		MEMORY_ASSERT(fl < FL_INDEX_COUNT);
+
+		auto *& head = m_free_lists[fl][sl];
+		block->m_prev_free = nullptr;
+		block->m_next_free = head;
+		if (head)
+			head->m_prev_free = block;
+		head = block;
+
+		m_fl_bitmap |= std::uint32_t{ 1u } << fl;
+		m_sl_bitmap[fl] |= std::uint32_t{ 1u } << sl;
+		m_free_bytes += impl::tlsf_size(block);
+	}
+
+	void TlsfAllocator::remove_free_block(BlockHeader * block)
+	{
+		size_type fl, sl;
+		mapping_insert(impl::tlsf_size(block), fl, sl);
+		remove_free_block(block, fl, sl);
+	}
+
+	void TlsfAllocator::remove_free_block(BlockHeader * block, size_type fl, size_type sl)
+	{
+		if (block->m_prev_free)
+			block->m_prev_free->m_next_free = block->m_next_free;
+		else
+			m_free_lists[fl][sl] = block->m_next_free;
+		if (block->m_next_free)
+			block->m_next_free->m_prev_free = block->m_prev_free;
+
+		if (m_free_lists[fl][sl] == nullptr)
+		{
+			m_sl_bitmap[fl] &= ~(std::uint32_t{ 1u } << sl);
+			if (m_sl_bitmap[fl] == 0)
+				m_fl_bitmap &= ~(std::uint32_t{ 1u } << fl);
+		}
+
+		m_free_bytes -= impl::tlsf_size(block);
+	}
+
+#if MEMORY_DEBUG_ENABLED
+	DebugTlsfAllocator::DebugTlsfAllocator(size_type bytes)
+		: Base{ bytes }
+	{
+	}
+	DebugTlsfAllocator::~DebugTlsfAllocator()
+	{
+		// if we call delete on the memory, the runtime library may put its own
+		// pattern, just in case it does not (i.e. release build)
+		fill_with_pattern(DebugPattern::RELEASED, m_memory_chunk.memory(), m_memory_chunk.bytes());
+	}
+
+	unsigned char * DebugTlsfAllocator::allocate(size_type bytes)
+	{
+		if (auto * allocated = Base::allocate(bytes))
+		{
+			m_stats.allocations++;
+			m_usage.allocated(bytes, usable_size(allocated));
+			fill_with_pattern(DebugPattern::ALLOCATED, allocated, bytes);
+			fill_with_pattern(DebugPattern::PADDING, allocated + bytes, usable_size(allocated) - bytes);
+			return allocated;
+		}
+
+		m_stats.failures++;
+		return nullptr;
+	}
+
+	void DebugTlsfAllocator::deallocate(unsigned char * mem, size_type bytes)
+	{
+		m_stats.deallocations++;
+		m_usage.deallocated(bytes, usable_size(mem));
+		verify_pattern(this, mem + bytes, usable_size(mem) - bytes, DebugPattern::PADDING);
+		// the beginning of the block will be overwritten by the free list links
+		const auto links = MIN_BLOCK_SIZE;
+		fill_with_pattern(DebugPattern::DEALLOCATED, mem + links, usable_size(mem) - links);
+		Base::deallocate(mem, bytes);
+	}
+
+	bool DebugTlsfAllocator::expand(unsigned char * mem, size_type old_bytes, size_type new_bytes)
+	{
+		verify_pattern(this, mem + old_bytes, usable_size(mem) - old_bytes, DebugPattern::PADDING);
+		const auto old_usable = usable_size(mem);
+		if (!Base::expand(mem, old_bytes, new_bytes))	return false;
+
+		m_usage.deallocated(old_bytes, old_usable);
+		m_usage.allocated(new_bytes, usable_size(mem));
+
+		if (new_bytes > old_bytes)
+			fill_with_pattern(DebugPattern::ALLOCATED, mem + old_bytes, new_bytes - old_bytes);
+		fill_with_pattern(DebugPattern::PADDING, mem + new_bytes, usable_size(mem) - new_bytes);
+		return true;
+	}
+
+	AllocatorAnalytics DebugTlsfAllocator::get_analytics() const
+	{
+		AllocatorAnalytics analytics;
+		m_usage.fill(analytics);
+		analytics.free_bytes = free_size();
+		analytics.largest_free_block = largest_free_block();
+		return analytics;
+	}
+#endif
+}
@@ -0,0 +1,212 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+#include "MemoryChunk.h"
+#include "AllocationTrace.h"
+
+#include <cstdint>
+
+namespace memory
+{
+	namespace impl
+	{
+		struct TlsfBlockHeader
+		{
+			/// \brief	Only valid when the previous block is free.
+			TlsfBlockHeader * m_prev_physical;
+			/// \brief	Size of the user memory, the two lowest bits are the flags.
+			size_type m_size;
+			/// \brief	Only valid while the block is free, overlap with the user memory.
+			TlsfBlockHeader * m_next_free;
+			TlsfBlockHeader * m_prev_free;
+		};
+	}
+
+	/// \brief	Two level segregated fit allocator (http://www.gii.upv.es/tlsf/).
+	///			Free blocks are kept in lists indexed by two levels: the first one is the power of two
+	///			of the size and the second one splits each power of two in linear ranges. A bitmap per
+	///			level tells which lists have blocks, so the list to allocate from is found with a couple
+	///			of bit scans. Every block has a header with its size and the previous physical block,
+	///			which allows merging the neighbours right away on deallocation.
+	///			Allocation and deallocation are O(1), there are no loops depending on the number of blocks.
+	class TlsfAllocator
+	{
+	public:
+		/// \brief	All the allocations are aligned to (and have a size multiple of) this value.
+		static constexpr size_type ALIGNMENT = 2 * sizeof(void *);
+
+		static constexpr size_type SL_INDEX_COUNT_LOG2 = 4;
+		static constexpr size_type SL_INDEX_COUNT = size_type{ 1u } << SL_INDEX_COUNT_LOG2;
+		/// \brief	Blocks smaller than SMALL_BLOCK_SIZE all go to the first level 0,
+		///			split linearly in SL_INDEX_COUNT lists.
+		static constexpr size_type FL_INDEX_SHIFT = SL_INDEX_COUNT_LOG2 + (sizeof(void *) == 8 ? 4 : 3);
+		static constexpr size_type SMALL_BLOCK_SIZE = size_type{ 1u } << FL_INDEX_SHIFT;
+		/// \brief	One bit per first level in a 32 bit bitmap.
+		static constexpr size_type FL_INDEX_COUNT = 32;
+
+		/// \brief	Bytes used by the header of an allocated block (the free list links use the user memory).
+		static constexpr size_type BLOCK_OVERHEAD = 2 * sizeof(void *);
+		static constexpr size_type MIN_BLOCK_SIZE = sizeof(impl::TlsfBlockHeader) - BLOCK_OVERHEAD;
+
+		explicit TlsfAllocator(size_type bytes);
+		virtual ~TlsfAllocator() = default;
+
+		TlsfAllocator(const TlsfAllocator &) = delete;
+		TlsfAllocator & operator=(const TlsfAllocator &) = delete;
+
+		virtual unsigned char * allocate(size_type bytes);
+		/// \brief	The size is only used for tracing, the block knows its own size.
+		virtual void deallocate(unsigned char * mem, size_type bytes);
+		/// \brief	Grows or shrinks the allocation without moving it, growing takes the next block if it is free.
+		///			Returns false if it can't.
+		virtual bool expand(unsigned char * mem, size_type old_bytes, size_type new_bytes);
+		/// \brief	Expands the allocation or moves it to a new block. Returns nullptr if there is no room,
+		///			mem is still valid then.
+		unsigned char * reallocate(unsigned char * mem, size_type old_bytes, size_type new_bytes);
+
+		bool owns(const unsigned char * mem) const
+		{
+			return ptr_to_num(mem) - ptr_to_num(m_memory_chunk.memory()) < m_memory_chunk.bytes();
+		}
+		bool is_full() const { return m_fl_bitmap == 0; }
+		/// \brief	Sum of the sizes of the free blocks, a single allocation may not be able to use all of it.
+		size_type free_size() const { return m_free_bytes; }
+
+		size_type get_capacity() const { return m_memory_chunk.bytes(); }
+
+		/// \brief	Bytes the user can use in an allocation, at least the requested ones.
+		size_type usable_size(const unsigned char * mem) const;
+		/// \brief	Biggest allocation that will succeed for sure in O(1).
+		size_type max_allocation_size() const;
+		/// \brief	Size of the biggest free block, walks the list of the biggest blocks.
+		size_type largest_free_block() const;
+
+	protected:
+		MemoryChunk m_memory_chunk;
+
+	private:
+		using BlockHeader = impl::TlsfBlockHeader;
+
+		static void mapping_insert(size_type size, size_type & fl, size_type & sl);
+		/// \brief	Rounds the size up to the next list, so that any block in it is big enough.
+		static void mapping_search(size_type size, size_type & fl, size_type & sl);
+
+		BlockHeader * find_suitable_block(size_type & fl, size_type & sl) const;
+		void insert_free_block(BlockHeader * block);
+		void remove_free_block(BlockHeader * block);
+		void remove_free_block(BlockHeader * block, size_type fl, size_type sl);
+		/// \brief	Gives back the end of a used block past size if it is big enough to be a block.
+		void trim_used_block(BlockHeader * block, size_type size);
+
+		std::uint32_t m_fl_bitmap{ 0u };
+		std::uint32_t m_sl_bitmap[FL_INDEX_COUNT];
+		BlockHeader * m_free_lists[FL_INDEX_COUNT][SL_INDEX_COUNT];
+		size_type m_free_bytes{ 0u };
+	};
+}
+
+#if MEMORY_DEBUG_ENABLED
+
+#include "AllocatorAnalytics.h"
+#include "DebugPatterns.h"
+
+namespace memory
+{
+	/// \brief	Fills the memory with debug patterns and generates statistics of the allocations.
+	///			The end of the blocks that is not used by the allocations is padding, it is checked when
+	///			the memory is deallocated or resized to find overruns.
+	class DebugTlsfAllocator
+		: public TlsfAllocator
+	{
+	public:
+		using Base = TlsfAllocator;
+
+		struct Stats
+		{
+			size_type allocations{ 0u };
+			size_type deallocations{ 0u };
+			size_type failures{ 0u };
+		};
+
+	public:
+		explicit DebugTlsfAllocator(size_type bytes);
+		~DebugTlsfAllocator();
+
+		unsigned char * allocate(size_type bytes) override;
+		void deallocate(unsigned char * mem, size_type bytes) override;
+		bool expand(unsigned char * mem, size_type old_bytes, size_type new_bytes) override;
+
+		const Stats & get_stats() const { return m_stats; }
+		/// \brief	The granted bytes are the usable sizes of the blocks.
+		AllocatorAnalytics get_analytics() const;
+
+	private:
+		Stats m_stats;
+		impl::AllocationUsage m_usage;
+	};
+}
+
+#endif
+
+namespace memory
+{
+#if MEMORY_DEBUG_ENABLED
+	using DefaultTlsfAllocator = DebugTlsfAllocator;
+#else
+	using DefaultTlsfAllocator = TlsfAllocator;
+#endif
+
+	/// \brief	TLSF allocator of BYTES that allocates T objects, so that it can be used in a FallbackAllocator.
+	///			(i.e. FallbackAllocator<FixedTlsfAllocator<1024>, GlobalAllocator<unsigned char>>)
+	///			Rebinding it creates a new allocator with its own memory.
+	template <size_type BYTES, typename T = unsigned char, typename Tlsf = DefaultTlsfAllocator>
+	class FixedTlsfAllocator
+	{
+		static_assert(alignof(T) <= TlsfAllocator::ALIGNMENT, "TlsfAllocator can't align T.");
+
+	public:
+		using value_type = T;
+
+		template <typename U>
+		using rebind_t = FixedTlsfAllocator<BYTES, U, Tlsf>;
+
+		FixedTlsfAllocator() : m_tlsf{ BYTES } {}
+		template <typename U>
+		FixedTlsfAllocator(const rebind_t<U> &) : m_tlsf{ BYTES } {}
+
+		T * allocate(size_type n = 1)
+		{
+			return reinterpret_cast<T *>(m_tlsf.allocate(n * sizeof(T)));
+		}
+		void deallocate(T * mem, size_type n = 1)
+		{
+			m_tlsf.deallocate(reinterpret_cast<unsigned char *>(mem), n * sizeof(T));
+		}
+		bool expand(T * mem, size_type old_n, size_type new_n)
+		{
+			return m_tlsf.expand(reinterpret_cast<unsigned char *>(mem), old_n * sizeof(T), new_n * sizeof(T));
+		}
+		T * reallocate(T * mem, size_type old_n, size_type new_n)
+		{
+			return reinterpret_cast<T *>(m_tlsf.reallocate(reinterpret_cast<unsigned char *>(mem), old_n * sizeof(T), new_n * sizeof(T)));
+		}
+
+		bool owns(const T * mem) const { return m_tlsf.owns(reinterpret_cast<const unsigned char *>(mem)); }
+		bool is_full() const { return m_tlsf.is_full(); }
+		size_type free_size() const { return m_tlsf.free_size(); }
+
+		Tlsf & get_tlsf() { return m_tlsf; }
+		const Tlsf & get_tlsf() const { return m_tlsf; }
+
+	private:
+		Tlsf m_tlsf;
+	};
+}
@@ -8,10 +8,21 @@ found in the top-level directory of this distribution.
 
 #include "testing.h"
 
+#include <algorithm>	// std::sort
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <thread>
 
-#define WIN32_LEAN_AND_MEAN 1
-#include <Windows.h>	// console colors
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN 1
+#	include <Windows.h>	// console colors
+#else
+#	include <cstdio>		// fileno
+#	include <unistd.h>	// isatty
+#endif
 
 namespace testing
 {
@@ -22,9 +33,101 @@ namespace testing
 			<< "  Failed: " << m_failed_tests;
 	}
 
+	void BenchmarkStats::dump(std::ostream & os) const
+	{
+		os << m_test_name << " (" << m_iterations << " iterations)\n"
+			<< "  Min: " << m_min << " us"
+			<< ", Median: " << m_median << " us"
+			<< ", P99: " << m_p99 << " us";
+	}
+
 #pragma region // Test
 	namespace impl
 	{
+		/// \brief	Buffer of the test running in this thread.
+		static thread_local std::ostream * s_test_output{ nullptr };
+
+		/// \brief	Redirects test_output() to the buffer while alive.
+		class TestOutputScope
+		{
+		public:
+			explicit TestOutputScope(std::ostream & os)
+				: m_previous{ s_test_output }
+			{
+				s_test_output = &os;
+			}
+			~TestOutputScope() { s_test_output = m_previous; }
+
+		private:
+			std::ostream * m_previous{ nullptr };
+		};
+
+		/// \brief	Stream buffer of std::cout and std::cerr while the tests run. It has no buffer of its own,
+		///			so the threads only share the original one, used when no test runs in the thread.
+		class TestOutputBuffer
+			: public std::streambuf
+		{
+		public:
+			explicit TestOutputBuffer(std::streambuf * original)
+				: m_original{ original }
+			{}
+
+			std::streambuf * get_original() const { return m_original; }
+
+		protected:
+			int_type overflow(int_type c) override
+			{
+				if (traits_type::eq_int_type(c, traits_type::eof()))
+					return traits_type::not_eof(c);
+
+				if (s_test_output == nullptr)
+					return m_original->sputc(traits_type::to_char_type(c));
+
+				s_test_output->put(traits_type::to_char_type(c));
+				return c;
+			}
+			std::streamsize xsputn(const char * s, std::streamsize n) override
+			{
+				if (s_test_output == nullptr)
+					return m_original->sputn(s, n);
+
+				s_test_output->write(s, n);
+				return n;
+			}
+			int sync() override
+			{
+				return s_test_output ? 0 : m_original->pubsync();
+			}
+
+		private:
+			std::streambuf * m_original{ nullptr };
+		};
+
+		/// \brief	Sends std::cout and std::cerr through a TestOutputBuffer while alive.
+		class StandardStreamsRedirect
+		{
+		public:
+			StandardStreamsRedirect()
+				: m_cout{ std::cout.rdbuf() }
+				, m_cerr{ std::cerr.rdbuf() }
+			{
+				std::cout.rdbuf(&m_cout);
+				std::cerr.rdbuf(&m_cerr);
+			}
+			~StandardStreamsRedirect()
+			{
+				std::cout.rdbuf(m_cout.get_original());
+				std::cerr.rdbuf(m_cerr.get_original());
+			}
+
+			StandardStreamsRedirect(const StandardStreamsRedirect &) = delete;
+			StandardStreamsRedirect & operator=(const StandardStreamsRedirect &) = delete;
+
+		private:
+			TestOutputBuffer m_cout;
+			TestOutputBuffer m_cerr;
+		};
+
 		TestResult Test::run() const
 		{
 			TestResult result{};
@@ -73,29 +176,58 @@ namespace testing
 	{
 		set_config(config);		// config we will be using this run
 		m_stats = TestingStats{};	// reset to track new stats
+		m_benchmark_stats.clear();
 
 		auto & os = get_ostream();
+		const auto tests = select_tests();
+		impl::StandardStreamsRedirect redirect;
 
 		bool all_succeded = true;
-		for (const auto & test : m_tests)
+		if (run_in_parallel())
 		{
-			if (verbose())
-				os << "Running: " << test.get_name() << std::endl;
-
-			const auto test_result = test.run();
-			all_succeded &= test_result.m_succeded;
+			const auto results = run_parallel(tests);
+			for (std::size_t i = 0; i < results.size(); ++i)
+			{
+				if (verbose())
+					os << "Running: " << tests[i]->get_name();
 
-			track_test_result(test, test_result);
+				finish_test(*tests[i], results[i]);
+				all_succeded &= results[i].m_succeded;
+			}
 
-			if (!test_result.m_succeded && abort_on_failure())
-			{
+			if (!all_succeded && abort_on_failure())
 				os << "Aborting test execution.\n";
-				break;
+		}
+		else
+		{
+			for (const auto * test : tests)
+			{
+				// flush so that we know what test was running in case it crashes
+				if (verbose())
+					os << "Running: " << test->get_name() << std::flush;
+
+				const auto test_result = run_test(*test);
+				all_succeded &= test_result.m_succeded;
+
+				finish_test(*test, test_result);
+
+				if (!test_result.m_succeded && abort_on_failure())
+				{
+					os << "Aborting test execution.\n";
+					break;
+				}
 			}
 		}
 
 		m_stats.m_run_tests = m_stats.m_succeded_tests + m_stats.m_failed_tests;
 
+		if (!m_benchmark_stats.empty())
+		{
+			os << "\nBenchmarks:\n";
+			for (const auto & stats : m_benchmark_stats)
+				os << stats << '\n';
+		}
+
 		os << '\n';
 		os << "Final stats:\n";
 		m_stats.dump(os);
@@ -103,6 +235,148 @@ namespace testing
 		return all_succeded;
 	}
 
+	bool TestRunner::passes_filter(const Test & test) const
+	{
+		return std::string{ test.get_name() }.find(m_config.m_filter) != std::string::npos;
+	}
+
+	std::vector<const TestRunner::Test *> TestRunner::select_tests() const
+	{
+		const unsigned shard_count = m_config.m_shard_count == 0 ? 1 : m_config.m_shard_count;
+
+		std::vector<const Test *> tests;
+		unsigned idx = 0;
+		for (const auto & test : m_tests)
+		{
+			if (!passes_filter(test))
+				continue;
+
+			if (idx++ % shard_count == m_config.m_shard_index)
+				tests.push_back(&test);
+		}
+
+		return tests;
+	}
+
+	bool TestRunner::run_in_parallel() const
+	{
+		return m_config.m_thread_count > 1 && !m_config.m_benchmark;
+	}
+
+	std::vector<TestRunner::TestResult> TestRunner::run_parallel(const std::vector<const Test *> & tests)
+	{
+		std::vector<TestResult> results(tests.size());
+		std::vector<char> finished(tests.size(), false);
+
+		std::atomic<std::size_t> next_test{ 0 };
+		std::atomic<bool> failed{ false };
+
+		const auto worker = [&]()
+		{
+			for (auto i = next_test++; i < tests.size(); i = next_test++)
+			{
+				if (failed && abort_on_failure())
+					break;
+				if (tests[i]->is_serial())
+					continue;
+
+				// run_test only modifies the runner in benchmark mode, which never runs in parallel
+				results[i] = run_test(*tests[i]);
+				finished[i] = true;
+
+				if (!results[i].m_succeded)
+					failed = true;
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < m_config.m_thread_count; ++i)
+			threads.emplace_back(worker);
+		for (auto & thread : threads)
+			thread.join();
+
+		// nothing else is running now
+		for (std::size_t i = 0; i < tests.size(); ++i)
+		{
+			if (failed && abort_on_failure())
+				break;
+			if (!tests[i]->is_serial())
+				continue;
+
+			results[i] = run_test(*tests[i]);
+			finished[i] = true;
+
+			if (!results[i].m_succeded)
+				failed = true;
+		}
+
+		// report the tests in order until the first one that did not run
+		const auto first_not_run = std::find(finished.begin(), finished.end(), false) - finished.begin();
+		results.resize(static_cast<std::size_t>(first_not_run));
+		return results;
+	}
+
+	TestRunner::TestResult TestRunner::run_test(const Test & test)
+	{
+		using clock = std::chrono::steady_clock;
+
+		std::ostringstream output;
+		impl::TestOutputScope output_scope{ output };
+
+		const auto start = clock::now();
+		auto result = m_config.m_benchmark ? benchmark_test(test) : test.run();
+		result.m_milliseconds = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+		result.m_output = output.str();
+		return result;
+	}
+
+	void TestRunner::finish_test(const Test & test, const TestResult & test_result)
+	{
+		auto & os = get_ostream();
+		if (verbose())
+			os << " [" << test_result.m_milliseconds << " ms]" << std::endl;
+
+		os << test_result.m_output;
+		track_test_result(test, test_result);
+	}
+
+	TestRunner::TestResult TestRunner::benchmark_test(const Test & test)
+	{
+		using clock = std::chrono::steady_clock;
+
+		std::vector<double> timings;
+		timings.reserve(m_config.m_benchmark_iterations);
+
+		TestResult result;
+		for (unsigned i = 0; i < m_config.m_benchmark_iterations; ++i)
+		{
+			const auto start = clock::now();
+			result = test.run();
+			const auto end = clock::now();
+
+			// the timings of a failing test are meaningless
+			if (!result.m_succeded)
+				return result;
+
+			timings.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+		}
+
+		if (timings.empty())
+			return result;
+
+		std::sort(timings.begin(), timings.end());
+
+		BenchmarkStats stats;
+		stats.m_test_name = test.get_name();
+		stats.m_iterations = static_cast<unsigned>(timings.size());
+		stats.m_min = timings.front();
+		stats.m_median = timings[timings.size() / 2];
+		stats.m_p99 = timings[(timings.size() * 99) / 100];
+		m_benchmark_stats.push_back(stats);
+
+		return result;
+	}
+
 	std::ostream & TestRunner::get_ostream() const
 	{
 		return *m_config.m_ostream;
@@ -144,9 +418,11 @@ namespace testing
 		set_console_color(ConsoleColors::DEFAULT);
 	}
 
+#if defined(_WIN32)
+
 	void TestRunner::set_console_color(ConsoleColors color) const
 	{
-		WORD color_attr;
+		WORD color_attr = 0x07;
 		switch (color)
 		{
 		case ConsoleColors::DEFAULT:
@@ -162,6 +438,29 @@ namespace testing
 		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), color_attr);
 	}
 
+#else
+
+	void TestRunner::set_console_color(ConsoleColors color) const
+	{
+		// only terminals understand the escape codes, don't pollute files or pipes with them
+		if (&get_ostream() != &std::cout || !isatty(fileno(stdout)))
+			return;
+
+		switch (color)
+		{
+		case ConsoleColors::DEFAULT:
+		{
+			get_ostream() << "\033[0m";
+		} break;
+		case ConsoleColors::RED:
+		{
+			get_ostream() << "\033[31m";
+		} break;
+		}
+	}
+
+#endif
+
 	void TestRunner::register_test(const Test & test)
 	{
 		m_tests.emplace_back(test);
@@ -184,5 +483,12 @@ namespace testing
 	{
 		return TestRunner::get_instance().run_all_tests(config);
 	}
+
+	std::ostream & test_output()
+	{
+		if (impl::s_test_output)
+			return *impl::s_test_output;
+		return std::cout;
+	}
 }
 
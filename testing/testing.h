@@ -21,6 +21,22 @@ namespace testing
 		std::ostream * m_ostream{ nullptr };
 		bool m_verbose{ true };
 		bool m_abort_on_failure{ false };
+
+		/// \brief	Only the tests whose name contains this text are run (all if empty).
+		std::string m_filter;
+
+		/// \brief	In benchmark mode each test is run m_benchmark_iterations times and timed.
+		bool m_benchmark{ false };
+		unsigned m_benchmark_iterations{ 100 };
+
+		/// \brief	Number of threads running tests at the same time, the tests run on the calling thread when <= 1.
+		///			Benchmark mode always runs the tests one after another to get reliable timings.
+		unsigned m_thread_count{ 1 };
+
+		/// \brief	The selected tests are split in m_shard_count groups and only the group m_shard_index is run,
+		///			used to distribute the tests between processes.
+		unsigned m_shard_index{ 0 };
+		unsigned m_shard_count{ 1 };
 	};
 		
 	///	\brief Stores statistics of the last run tests.
@@ -33,6 +49,18 @@ namespace testing
 		unsigned m_run_tests{ 0 };
 	};
 
+	/// \brief	Timings of one test run in benchmark mode, in microseconds.
+	struct BenchmarkStats
+	{
+		void dump(std::ostream & os) const;
+
+		std::string m_test_name;
+		unsigned m_iterations{ 0 };
+		double m_min{ 0.0 };
+		double m_median{ 0.0 };
+		double m_p99{ 0.0 };
+	};
+
 	namespace impl
 	{
 		struct TestResult
@@ -42,6 +70,11 @@ namespace testing
 			bool m_succeded{ true };
 			unsigned m_line{ 0 };
 			std::string m_fail_reason;
+
+			/// \brief	Wall time of the test.
+			double m_milliseconds{ 0.0 };
+			/// \brief	What the test wrote to test_output(), std::cout or std::cerr.
+			std::string m_output;
 		};
 
 		/// \brief	Thrown when a test fails, contains information about failure.
@@ -53,7 +86,7 @@ namespace testing
 				, m_line{ line }
 			{}
 
-			const char * what() const override { return get_failed_condition(); }
+			const char * what() const noexcept override { return get_failed_condition(); }
 
 			const char * get_failed_condition() const { return m_failed_cond; }
 			unsigned get_line() const { return m_line; }
@@ -70,20 +103,24 @@ namespace testing
 			using test_fn = void(*)();
 
 		public:
-			explicit Test(test_fn test, const char * name)
+			explicit Test(test_fn test, const char * name, bool serial = false)
 				: m_test_fn{ test }
 				, m_test_name{ name }
+				, m_serial{ serial }
 			{}
 
 			TestResult run() const;
 
 			const char * get_name() const { return m_test_name; }
+			/// \brief	Serial tests never run at the same time as an other test.
+			bool is_serial() const { return m_serial; }
 
 		private:
 			void run_test() const;
 
 			test_fn m_test_fn{ nullptr };
 			const char * m_test_name{ "" };
+			bool m_serial{ false };
 		};
 
 		/// \brief	Helper for not including TestRunner here.
@@ -146,6 +183,8 @@ namespace testing
 
 		/// \brief	Returns the statistics of the last call to run tests.
 		TestingStats get_stats() const { return m_stats; }
+		/// \brief	Returns the timings of the last call to run tests in benchmark mode.
+		const std::vector<BenchmarkStats> & get_benchmark_stats() const { return m_benchmark_stats; }
 
 	private:
 		using Test = impl::Test;
@@ -157,6 +196,19 @@ namespace testing
 
 	private:
 		void set_config(const TestingConfig & config);
+		bool passes_filter(const Test & test) const;
+		/// \brief	Tests that pass the filter and belong to the shard we are running.
+		std::vector<const Test *> select_tests() const;
+		bool run_in_parallel() const;
+
+		/// \brief	Runs the tests on a pool of m_thread_count threads, the results are in the same order as the tests.
+		///			The serial tests run on the calling thread once the pool has finished.
+		///			Tests not run because an other one failed (and we abort on failure) are not in the results.
+		std::vector<TestResult> run_parallel(const std::vector<const Test *> & tests);
+		TestResult run_test(const Test & test);
+		TestResult benchmark_test(const Test & test);
+		/// \brief	Reports the output and result of a test that has finished.
+		void finish_test(const Test & test, const TestResult & test_result);
 		void track_test_result(const Test & test, const TestResult & test_result);
 		void track_succeded_test(const Test & test, const TestResult & test_result);
 		void track_failed_test(const Test & test, const TestResult & test_result);
@@ -178,6 +230,7 @@ namespace testing
 
 		/// \brief	Stats about the last execution of tests.
 		TestingStats m_stats;
+		std::vector<BenchmarkStats> m_benchmark_stats;
 
 		/// \brief	Stores all the tests that have been compiled in the program.
 		std::vector<Test> m_tests;
@@ -190,11 +243,21 @@ inline std::ostream & operator<<(std::ostream & os, const ::testing::TestingStat
 	stats.dump(os);
 	return os;
 }
+inline std::ostream & operator<<(std::ostream & os, const ::testing::BenchmarkStats & stats)
+{
+	stats.dump(os);
+	return os;
+}
 
 namespace testing
 {
 	/// \brief	Runs all the tests that have been compiled.
 	bool run_all_tests(const TestingConfig & config = TestingConfig{});
+
+	/// \brief	Stream tests should write to, each test has its own buffer (even when running in parallel)
+	///			that is printed after the test finishes. While the tests run, what a test writes to
+	///			std::cout and std::cerr (i.e. the default callbacks of the library) also goes to its buffer.
+	std::ostream & test_output();
 }
 
 /// \brief	Declares a variable name that won't be duplicated.
@@ -204,22 +267,22 @@ namespace testing
 #define _TESTING_UNNAMED_VARIABLE_INNER2(x, line, counter)	x ## _unnamed_var_ ## line ## _ ## counter
 
 /// \brief	Register the test before main is called.
-#define _TESTING_REGISTER_TEST(category, name, func)										\
-namespace testing { namespace impl {														\
-	static const bool _TESTING_UNNAMED_VARIABLE(test_register_ ## func) = []()	\
-	{																						\
-		::testing::impl::register_test(::testing::impl::Test{ func, #category "::" #name });\
-		return true;																		\
-	}();																					\
+#define _TESTING_REGISTER_TEST(category, name, func, serial)										\
+namespace testing { namespace impl {																\
+	static const bool _TESTING_UNNAMED_VARIABLE(test_register_ ## func) = []()			\
+	{																								\
+		::testing::impl::register_test(::testing::impl::Test{ func, #category "::" #name, serial });\
+		return true;																				\
+	}();																							\
 } }
 
-#define _TESTING_DECLARE_TEST_INNER(category, name, func)	\
-	void func();											\
-	_TESTING_REGISTER_TEST(category, name, func);			\
+#define _TESTING_DECLARE_TEST_INNER(category, name, func, serial)	\
+	void func();													\
+	_TESTING_REGISTER_TEST(category, name, func, serial);			\
 	void func()
 
 #define _TESTING_DECLARE_TEST(category, name)	\
-	_TESTING_DECLARE_TEST_INNER(category, name, category ##_## name)
+	_TESTING_DECLARE_TEST_INNER(category, name, category ##_## name, false)
 
 #define _TESTING_STRINGIFY(x)		_TESTING_STRINGIFY_INNER(x)
 #define _TESTING_STRINGIFY_INNER(x)	#x
@@ -231,7 +294,7 @@ namespace testing { namespace impl {														\
 
 
 ///	\brief	If the condition is not satisfied the test fails.
-#define TEST_ASSERT(cond) do { if (!(cond))	throw std::exception{ "Condition ( " #cond " ) at line " _TESTING_STRINGIFY(__LINE__) " not satisfied." , __LINE__ }; } while (0)
+#define TEST_ASSERT(cond) do { if (!(cond))	throw ::testing::impl::TestFailedException{ "Condition ( " #cond " ) at line " _TESTING_STRINGIFY(__LINE__) " not satisfied." , __LINE__ }; } while (0)
 
 ///	\brief	Test fails inmediately.
 #define TEST_FAILED() TEST_ASSERT(false)
@@ -249,6 +312,10 @@ namespace testing { namespace impl {														\
 /// \brief	Declares a test
 #define TEST_F(test_name)	_TESTING_DECLARE_TEST(global, test_name)
 
+/// \brief	Declares a test that never runs at the same time as an other test, for the tests that modify
+///			global state the rest of the tests use (i.e. install a trace recorder).
+#define TEST_SERIAL_F(test_name)	_TESTING_DECLARE_TEST_INNER(global, test_name, global_ ## test_name, true)
+
 /// \brief	Declares a test within a category.
 ///			Categories need to inherit from ::testing::TestCategory and member variables created in them are 
 ///			accesible from the tests.
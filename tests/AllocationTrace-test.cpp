@@ -0,0 +1,107 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "AllocationTrace.h"
+#include "PageAllocator.h"
+#include "StackAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <sstream>
+
+TEST_F(trace_reader_reads_the_events_written_by_the_recorder)
+{
+	std::stringstream stream{ std::ios::in | std::ios::out | std::ios::binary };
+	TraceRecorder recorder{ stream };
+
+	TraceEvent written;
+	written.timestamp = 0x0102030405060708ull;
+	written.allocator_id = 42;
+	written.address = 0xFFFFFFFF00000010ull;
+	written.size = 1234;
+	written.alignment = 16;
+	written.thread_id = 7;
+	written.type = TraceEventType::DEALLOCATE;
+	recorder.record(written);
+	TEST_ASSERT(recorder.recorded_events() == 1);
+
+	TraceReader reader{ stream };
+	TEST_ASSERT(reader.valid());
+
+	TraceEvent read;
+	TEST_ASSERT(reader.next(read));
+	TEST_ASSERT(read.timestamp == written.timestamp);
+	TEST_ASSERT(read.allocator_id == written.allocator_id);
+	TEST_ASSERT(read.address == written.address);
+	TEST_ASSERT(read.size == written.size);
+	TEST_ASSERT(read.alignment == written.alignment);
+	TEST_ASSERT(read.thread_id == written.thread_id);
+	TEST_ASSERT(read.type == written.type);
+
+	TEST_ASSERT(reader.next(read) == false);
+}
+
+TEST_F(trace_reader_rejects_streams_that_do_not_contain_a_trace)
+{
+	std::stringstream stream{ "definitely not a trace", std::ios::in | std::ios::binary };
+	TraceReader reader{ stream };
+	TEST_ASSERT(reader.valid() == false);
+
+	TraceEvent event;
+	TEST_ASSERT(reader.next(event) == false);
+}
+
+#if MEMORY_TRACE_ENABLED
+
+// the recorder is destroyed at the end of the test, no other test can be allocating while it is installed
+TEST_SERIAL_F(allocators_send_their_allocations_to_the_trace_recorder)
+{
+	std::stringstream stream{ std::ios::in | std::ios::out | std::ios::binary };
+	TraceRecorder recorder{ stream };
+
+	set_trace_recorder(&recorder);
+	TEST_ON_EXIT(){ set_trace_recorder(nullptr); };
+
+	PageAllocator page_alloc{ sizeof(long long), 4 };
+	StackAllocator stack_alloc{ 64 };
+
+	auto * a = page_alloc.allocate();
+	auto * b = stack_alloc.allocate(24);
+	stack_alloc.deallocate(b, 24);
+	page_alloc.deallocate(a);
+	set_trace_recorder(nullptr);
+
+	// ignore the allocations of tests running in other threads
+	TraceReader reader{ stream };
+	std::vector<TraceEvent> events;
+	for (TraceEvent event; reader.next(event); )
+	{
+		if (event.thread_id == current_thread_id())
+			events.push_back(event);
+	}
+
+	TEST_ASSERT(events.size() == 4);
+	TEST_ASSERT(events[0].type == TraceEventType::ALLOCATE);
+	TEST_ASSERT(events[0].allocator_id == ptr_to_num(&page_alloc));
+	TEST_ASSERT(events[0].address == ptr_to_num(a));
+	TEST_ASSERT(events[0].size == sizeof(long long));
+
+	TEST_ASSERT(events[1].type == TraceEventType::ALLOCATE);
+	TEST_ASSERT(events[1].allocator_id == ptr_to_num(&stack_alloc));
+	TEST_ASSERT(events[1].size == 24);
+
+	TEST_ASSERT(events[2].type == TraceEventType::DEALLOCATE);
+	TEST_ASSERT(events[2].address == ptr_to_num(b));
+
+	TEST_ASSERT(events[3].type == TraceEventType::DEALLOCATE);
+	TEST_ASSERT(events[3].address == ptr_to_num(a));
+	TEST_ASSERT(events[3].timestamp >= events[0].timestamp);
+}
+
+#endif
@@ -0,0 +1,218 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "AllocatorAnalytics.h"
+#include "BuddyAllocator.h"
+#include "GlobalAllocator.h"
+#include "InlineAllocator.h"
+#include "PageAllocator.h"
+#include "SlabAllocator.h"
+#include "StackAllocator.h"
+#include "TlsfAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <sstream>
+
+TEST_F(allocator_analytics_computes_the_fragmentation_from_the_bytes)
+{
+	AllocatorAnalytics analytics;
+	TEST_ASSERT(analytics.internal_fragmentation() == 0.f);
+	TEST_ASSERT(analytics.external_fragmentation() == 0.f);
+
+	analytics.requested_bytes = 48;
+	analytics.granted_bytes = 64;
+	analytics.free_bytes = 128;
+	analytics.largest_free_block = 32;
+	TEST_ASSERT(analytics.internal_fragmentation() == 0.25f);
+	TEST_ASSERT(analytics.external_fragmentation() == 0.75f);
+}
+
+TEST_F(allocator_analytics_buckets_the_pages_by_utilization)
+{
+	AllocatorAnalytics analytics;
+	analytics.add_page(0, 4);
+	analytics.add_page(1, 4);
+	analytics.add_page(4, 4);
+	analytics.add_page(99, 100);
+	TEST_ASSERT(analytics.analyzed_pages() == 4);
+	TEST_ASSERT(analytics.page_utilization[0] == 1);
+	TEST_ASSERT(analytics.page_utilization[2] == 1);
+	TEST_ASSERT(analytics.page_utilization[9] == 2);
+
+	std::ostringstream os;
+	os << analytics;
+	TEST_ASSERT(os.str().find("Page utilization") != std::string::npos);
+}
+
+TEST_F(allocator_analytics_can_be_added)
+{
+	AllocatorAnalytics a;
+	a.granted_bytes = 10;
+	a.free_bytes = 20;
+	a.largest_free_block = 20;
+	a.high_water_mark = 15;
+	AllocatorAnalytics b;
+	b.granted_bytes = 5;
+	b.free_bytes = 40;
+	b.largest_free_block = 8;
+	b.high_water_mark = 5;
+	b.add_page(1, 2);
+
+	a += b;
+	TEST_ASSERT(a.granted_bytes == 15);
+	TEST_ASSERT(a.free_bytes == 60);
+	TEST_ASSERT(a.largest_free_block == 20);
+	TEST_ASSERT(a.high_water_mark == 20);
+	TEST_ASSERT(a.page_utilization[5] == 1);
+}
+
+TEST_F(inline_allocator_analytics_find_the_longest_free_run)
+{
+	InlineAllocator<8, int> alloc;
+	auto * a = alloc.allocate(2);
+	auto * b = alloc.allocate(2);
+	auto * c = alloc.allocate(2);
+	alloc.deallocate(b, 2);
+
+	const auto analytics = alloc.get_analytics();
+	TEST_ASSERT(analytics.granted_bytes == 4 * sizeof(int));
+	TEST_ASSERT(analytics.free_bytes == 4 * sizeof(int));
+	TEST_ASSERT(analytics.largest_free_block == 2 * sizeof(int));
+	TEST_ASSERT(analytics.external_fragmentation() == 0.5f);
+	TEST_ASSERT(analytics.page_utilization[5] == 1);
+
+	alloc.deallocate(a, 2);
+	alloc.deallocate(c, 2);
+}
+
+TEST_F(fallback_allocator_adds_the_free_size_and_the_analytics_of_both_tiers)
+{
+	FallbackAllocator<InlineAllocator<4, int>, InlineAllocator<8, int>> alloc;
+	TEST_ASSERT(alloc.free_size() == 12 * sizeof(int));
+
+	auto * primary = alloc.allocate(4);
+	auto * fallback = alloc.allocate(2);
+	TEST_ASSERT(alloc.free_size() == 6 * sizeof(int));
+
+	const auto analytics = alloc.get_analytics();
+	TEST_ASSERT(analytics.granted_bytes == 6 * sizeof(int));
+	TEST_ASSERT(analytics.free_bytes == 6 * sizeof(int));
+	TEST_ASSERT(analytics.analyzed_pages() == 2);
+
+	alloc.deallocate(fallback, 2);
+	alloc.deallocate(primary, 4);
+
+	// the system memory is unbounded
+	GlobalAsFallback<InlineAllocator<4, int>> global;
+	TEST_ASSERT(global.free_size() == ~size_type{ 0u });
+	TEST_ASSERT(global.get_analytics().free_bytes == 4 * sizeof(int));
+}
+
+#if MEMORY_DEBUG_ENABLED
+
+TEST_F(debug_page_allocator_analytics_report_the_padding_and_the_pages)
+{
+	// the objects are padded to fit the free list links
+	DebugPageAllocator alloc{ 4, 4 };
+	void * objects[5];
+	alloc.allocate_bulk(objects, 5);
+	alloc.deallocate(objects[4]);
+	objects[4] = alloc.allocate();
+
+	const auto analytics = alloc.get_analytics();
+	TEST_ASSERT(analytics.requested_bytes == 5 * 4);
+	TEST_ASSERT(analytics.granted_bytes == 5 * alloc.get_obj_size());
+	TEST_ASSERT(analytics.free_bytes == 3 * alloc.get_obj_size());
+	TEST_ASSERT(analytics.largest_free_block == analytics.free_bytes);
+	TEST_ASSERT(analytics.high_water_mark == analytics.granted_bytes);
+	TEST_ASSERT(analytics.analyzed_pages() == 2);
+	TEST_ASSERT(analytics.page_utilization[9] == 1);
+	TEST_ASSERT(analytics.page_utilization[2] == 1);
+
+	alloc.deallocate_bulk(objects, 5);
+	TEST_ASSERT(alloc.get_analytics().high_water_mark == 5 * alloc.get_obj_size());
+}
+
+TEST_F(debug_slab_allocator_analytics_report_the_usage_of_the_slabs)
+{
+	DebugSlabAllocator alloc{ 16, 4 };
+	void * objects[5];
+	for (auto *& obj : objects)
+		obj = alloc.allocate();
+
+	const auto analytics = alloc.get_analytics();
+	TEST_ASSERT(analytics.granted_bytes == 5 * 16);
+	TEST_ASSERT(analytics.free_bytes == 3 * 16);
+	TEST_ASSERT(analytics.analyzed_pages() == 2);
+	TEST_ASSERT(analytics.page_utilization[9] == 1);
+	TEST_ASSERT(analytics.page_utilization[2] == 1);
+
+	for (auto * obj : objects)
+		alloc.deallocate(obj);
+}
+
+TEST_F(debug_buddy_allocator_analytics_report_the_rounding_to_the_blocks)
+{
+	DebugBuddyAllocator alloc{ 1024, 64 };
+	auto * a = alloc.allocate(40);
+	auto * b = alloc.allocate(100);
+
+	const auto analytics = alloc.get_analytics();
+	TEST_ASSERT(analytics.requested_bytes == 140);
+	TEST_ASSERT(analytics.granted_bytes == 64 + 128);
+	TEST_ASSERT(analytics.free_bytes == 1024 - 192);
+	TEST_ASSERT(analytics.largest_free_block == 512);
+	TEST_ASSERT(analytics.external_fragmentation() > 0.f);
+
+	alloc.deallocate(b, 100);
+	alloc.deallocate(a, 40);
+	TEST_ASSERT(alloc.get_analytics().largest_free_block == 1024);
+	TEST_ASSERT(alloc.get_analytics().high_water_mark == 192);
+}
+
+TEST_F(debug_tlsf_allocator_analytics_report_the_holes)
+{
+	DebugTlsfAllocator alloc{ 4096 };
+	TEST_ASSERT(alloc.largest_free_block() == alloc.free_size());
+
+	auto * a = alloc.allocate(64);
+	auto * b = alloc.allocate(64);
+	auto * c = alloc.allocate(64);
+	alloc.deallocate(b, 64);
+
+	const auto analytics = alloc.get_analytics();
+	TEST_ASSERT(analytics.requested_bytes == 128);
+	TEST_ASSERT(analytics.granted_bytes == alloc.usable_size(a) + alloc.usable_size(c));
+	TEST_ASSERT(analytics.largest_free_block == alloc.largest_free_block());
+	TEST_ASSERT(analytics.largest_free_block < analytics.free_bytes);
+	TEST_ASSERT(analytics.external_fragmentation() > 0.f);
+
+	alloc.deallocate(a, 64);
+	alloc.deallocate(c, 64);
+	TEST_ASSERT(alloc.largest_free_block() == alloc.free_size());
+}
+
+TEST_F(debug_stack_allocator_analytics_report_the_high_water_mark)
+{
+	DebugStackAllocator alloc{ 64 };
+	auto * a = alloc.allocate(16);
+	auto * b = alloc.allocate(16);
+	alloc.deallocate(b, 16);
+
+	const auto analytics = alloc.get_analytics();
+	TEST_ASSERT(analytics.granted_bytes == 16);
+	TEST_ASSERT(analytics.free_bytes == 48);
+	TEST_ASSERT(analytics.largest_free_block == 48);
+	TEST_ASSERT(analytics.high_water_mark == 32);
+
+	alloc.deallocate(a, 16);
+}
+
+#endif
@@ -0,0 +1,220 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+
+#include "testing/testing.h"
+
+#include "BuddyAllocator.h"
+
+#include <vector>
+using namespace memory;	// avoid verbosity on tests
+
+// BuddyAllocator
+
+class BuddyAllocatorTest : public testing::TestCategory
+{
+public:
+	// 16 blocks of 64 bytes
+	BuddyAllocator alloc{ 1024, 64 };
+};
+
+TEST(BuddyAllocatorTest, buddy_allocator_manages_a_power_of_two_number_of_blocks)
+{
+	TEST_ASSERT(alloc.free_size() == 1024);
+	TEST_ASSERT(alloc.get_max_order() == 4);
+	TEST_ASSERT(alloc.largest_free_block() == 1024);
+
+	// the memory that does not make a power of two number of blocks is not used
+	BuddyAllocator odd{ 1000, 64 };
+	TEST_ASSERT(odd.free_size() == 512);
+}
+
+TEST(BuddyAllocatorTest, buddy_allocator_rounds_allocations_up_to_a_power_of_two)
+{
+	TEST_ASSERT(alloc.order_for(1) == 0);
+	TEST_ASSERT(alloc.order_for(64) == 0);
+	TEST_ASSERT(alloc.order_for(65) == 1);
+	TEST_ASSERT(alloc.order_for(300) == 3);
+
+	alloc.allocate(100);
+	TEST_ASSERT(alloc.free_size() == 1024 - 128);
+}
+
+TEST(BuddyAllocatorTest, buddy_allocator_splits_blocks_to_serve_small_allocations)
+{
+	auto * a = alloc.allocate(64);
+	auto * b = alloc.allocate(64);
+	auto * c = alloc.allocate(128);
+
+	// a and b are buddies, c comes from splitting the buddy of their parent
+	TEST_ASSERT(b == a + 64);
+	TEST_ASSERT(c == a + 128);
+	TEST_ASSERT(alloc.largest_free_block() == 512);
+	TEST_ASSERT(alloc.free_size() == 1024 - 256);
+}
+
+TEST(BuddyAllocatorTest, buddy_allocator_merges_free_buddies)
+{
+	auto * a = alloc.allocate(64);
+	auto * b = alloc.allocate(64);
+	auto * c = alloc.allocate(256);
+
+	alloc.deallocate(a, 64);
+	TEST_ASSERT(alloc.largest_free_block() == 512);
+
+	alloc.deallocate(c, 256);
+	alloc.deallocate(b, 64);
+	TEST_ASSERT(alloc.free_size() == 1024);
+	TEST_ASSERT(alloc.largest_free_block() == 1024);
+	TEST_ASSERT(alloc.allocate(1024) == a);
+}
+
+TEST(BuddyAllocatorTest, buddy_allocator_deallocations_can_happen_in_any_order)
+{
+	unsigned char * blocks[16];
+	for (auto & block : blocks)
+		block = alloc.allocate(64);
+
+	TEST_ASSERT(alloc.is_full());
+	TEST_ASSERT(alloc.allocate(1) == nullptr);
+
+	const int order[16] = { 5, 0, 15, 9, 2, 7, 12, 1, 3, 14, 8, 11, 4, 6, 10, 13 };
+	for (const auto i : order)
+		alloc.deallocate(blocks[i], 64);
+
+	TEST_ASSERT(alloc.free_size() == 1024);
+	TEST_ASSERT(alloc.largest_free_block() == 1024);
+}
+
+TEST(BuddyAllocatorTest, buddy_allocator_returns_null_when_cannot_allocate_the_requested_size)
+{
+	TEST_ASSERT(alloc.allocate(2048) == nullptr);
+
+	auto * a = alloc.allocate(64);
+	TEST_ASSERT(alloc.allocate(1024) == nullptr);
+	TEST_ASSERT(alloc.allocate(512) != nullptr);
+	TEST_ASSERT(alloc.owns(a));
+
+	unsigned char not_owned;
+	TEST_ASSERT(alloc.owns(&not_owned) == false);
+}
+
+TEST(BuddyAllocatorTest, buddy_allocator_expands_allocations_merging_free_buddies)
+{
+	auto * a = alloc.allocate(64);
+	auto * b = alloc.allocate(64);
+
+	// the buddy of b is used
+	TEST_ASSERT(alloc.expand(b, 64, 128) == false);
+
+	// a takes its buddy and the next block of 128 bytes, nothing moves
+	alloc.deallocate(b, 64);
+	TEST_ASSERT(alloc.expand(a, 64, 200));
+	TEST_ASSERT(alloc.free_size() == 1024 - 256);
+	TEST_ASSERT(alloc.reallocate(a, 200, 1000) == a);
+	TEST_ASSERT(alloc.is_full());
+
+	// shrinking gives the second halves back
+	TEST_ASSERT(alloc.expand(a, 1000, 64));
+	TEST_ASSERT(alloc.free_size() == 1024 - 64);
+	TEST_ASSERT(alloc.largest_free_block() == 512);
+	alloc.deallocate(a, 64);
+	TEST_ASSERT(alloc.largest_free_block() == 1024);
+}
+
+TEST(BuddyAllocatorTest, buddy_allocator_reallocate_moves_the_memory_when_it_cant_expand)
+{
+	auto * a = alloc.allocate(64);
+	auto * b = alloc.allocate(64);
+	std::memset(a, 7, 64);
+
+	auto * c = alloc.reallocate(a, 64, 128);
+	TEST_ASSERT(c != a && c != nullptr);
+	TEST_ASSERT_ALL(c, c + 64, == 7);
+
+	TEST_ASSERT(alloc.reallocate(b, 64, 1024) == nullptr);
+	TEST_ASSERT(alloc.free_size() == 1024 - 64 - 128);
+}
+
+// DebugBuddyAllocator
+
+#if MEMORY_DEBUG_ENABLED
+
+TEST_F(debug_buddy_allocator_generates_statistics)
+{
+	DebugBuddyAllocator alloc{ 1024, 64 };
+
+	auto * a = alloc.allocate(100);
+	alloc.allocate(64);
+	alloc.allocate(2048);
+	alloc.deallocate(a, 100);
+
+	const auto & stats = alloc.get_stats();
+	TEST_ASSERT(stats.allocations == 2);
+	TEST_ASSERT(stats.deallocations == 1);
+	TEST_ASSERT(stats.failures == 1);
+	TEST_ASSERT(stats.internal_fragmentation == 0);
+}
+
+TEST_F(debug_buddy_allocator_only_counts_the_failures_of_the_requests)
+{
+	DebugBuddyAllocator alloc{ 1024, 64 };
+
+	auto * a = alloc.allocate(64);
+	alloc.allocate(64);
+
+	// the block can't grow, but reallocate moves it
+	TEST_ASSERT(alloc.expand(a, 64, 128) == false);
+	TEST_ASSERT(alloc.get_stats().failures == 1);
+	TEST_ASSERT(alloc.reallocate(a, 64, 128) != nullptr);
+	TEST_ASSERT(alloc.get_stats().failures == 1);
+}
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+
+TEST_F(debug_buddy_allocator_fills_the_memory_with_patterns)
+{
+	DebugBuddyAllocator alloc{ 1024, 64 };
+
+	auto * a = alloc.allocate(100);
+	TEST_ASSERT_ALL(a, a + 100, == DebugPattern::ALLOCATED);
+	TEST_ASSERT_ALL(a + 100, a + 128, == DebugPattern::PADDING);
+
+	alloc.deallocate(a, 100);
+	TEST_ASSERT_ALL(a + 2 * sizeof(void *), a + 128, == DebugPattern::DEALLOCATED);
+}
+
+TEST_F(debug_buddy_allocator_verifies_the_padding_and_the_free_blocks)
+{
+	std::vector<PatternCorruption> corruptions;
+	set_corruption_callback([&](const PatternCorruption & corruption) { corruptions.push_back(corruption); });
+
+	DebugBuddyAllocator alloc{ 1024, 64 };
+	auto * a = alloc.allocate(100);
+	auto * b = alloc.allocate(64);
+	TEST_ASSERT_ALL(a + 100, a + 128, == DebugPattern::PADDING);
+	TEST_ASSERT(alloc.verify_heap());
+
+	// overrun
+	a[110] = 0;
+	alloc.deallocate(a, 100);
+	TEST_ASSERT(corruptions.size() == 1 && corruptions[0].address == a + 110);
+
+	// use after free
+	b[40] = 0;
+	alloc.deallocate(b, 64);
+	b[40] = 0;
+	TEST_ASSERT(alloc.verify_heap() == false);
+	TEST_ASSERT(corruptions.size() == 2 && corruptions[1].address == b + 40);
+	set_corruption_callback(nullptr);
+}
+
+#endif
+
+
+#endif
@@ -0,0 +1,105 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "DebugPatterns.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <vector>
+
+TEST_F(find_pattern_mismatch_finds_the_first_byte_without_the_pattern)
+{
+	unsigned char memory[300];
+	std::memset(memory, DebugPattern::DEALLOCATED, sizeof(memory));
+	TEST_ASSERT(find_pattern_mismatch(memory, sizeof(memory), DebugPattern::DEALLOCATED) == nullptr);
+
+	// in the vectorized part and in the remaining bytes
+	for (const size_type corrupted : { 0, 15, 16, 63, 64, 130, 255, 256, 299 })
+	{
+		memory[corrupted] = 0;
+		TEST_ASSERT(find_pattern_mismatch(memory, sizeof(memory), DebugPattern::DEALLOCATED) == memory + corrupted);
+		TEST_ASSERT(find_pattern_mismatch(memory, corrupted, DebugPattern::DEALLOCATED) == nullptr);
+		memory[corrupted] = DebugPattern::DEALLOCATED;
+	}
+
+	// unaligned memory
+	memory[200] = 0;
+	TEST_ASSERT(find_pattern_mismatch(memory + 3, 250, DebugPattern::DEALLOCATED) == memory + 200);
+}
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+
+TEST_F(verify_pattern_reports_the_corrupted_address_and_allocator)
+{
+	std::vector<PatternCorruption> corruptions;
+	set_corruption_callback([&](const PatternCorruption & corruption) { corruptions.push_back(corruption); });
+
+	unsigned char memory[64];
+	int allocator;
+	std::memset(memory, DebugPattern::PADDING, sizeof(memory));
+	TEST_ASSERT(verify_pattern(&allocator, memory, sizeof(memory), DebugPattern::PADDING));
+
+	memory[40] = 0x12;
+	TEST_ASSERT(verify_pattern(&allocator, memory, sizeof(memory), DebugPattern::PADDING) == false);
+	set_corruption_callback(nullptr);
+
+	TEST_ASSERT(corruptions.size() == 1);
+	TEST_ASSERT(corruptions[0].allocator == &allocator);
+	TEST_ASSERT(corruptions[0].address == memory + 40);
+	TEST_ASSERT(corruptions[0].expected == DebugPattern::PADDING);
+	TEST_ASSERT(corruptions[0].found == 0x12);
+}
+
+TEST_F(verify_free_pattern_accepts_memory_acquired_or_deallocated)
+{
+	unsigned char memory[32];
+	std::memset(memory, DebugPattern::ACQUIRED, sizeof(memory));
+	TEST_ASSERT(verify_free_pattern(nullptr, memory, sizeof(memory)));
+	std::memset(memory, DebugPattern::DEALLOCATED, sizeof(memory));
+	TEST_ASSERT(verify_free_pattern(nullptr, memory, sizeof(memory)));
+}
+
+TEST_F(deferred_fills_are_done_in_batches_and_cancelled_when_the_memory_is_reused)
+{
+	unsigned char memory[256];
+	std::memset(memory, 0, sizeof(memory));
+
+	impl::DeferredFills fills;
+	fills.add(memory, 64, DebugPattern::DEALLOCATED);
+	fills.add(memory + 64, 64, DebugPattern::DEALLOCATED);
+	fills.add(memory + 128, 128, DebugPattern::DEALLOCATED);
+	TEST_ASSERT(memory[0] == 0 && fills.pending() == 3);
+
+	// the whole first fill, the end of the second one and the middle of the third one
+	TEST_ASSERT(fills.cancel(memory, 100));
+	TEST_ASSERT(fills.cancel(memory + 160, 32));
+	TEST_ASSERT(fills.cancel(memory + 100, 0) == false);
+
+	fills.flush();
+	TEST_ASSERT(fills.empty());
+	TEST_ASSERT_ALL(memory, memory + 100, == 0);
+	TEST_ASSERT_ALL(memory + 100, memory + 160, == DebugPattern::DEALLOCATED);
+	TEST_ASSERT_ALL(memory + 160, memory + 192, == 0);
+	TEST_ASSERT_ALL(memory + 192, memory + 256, == DebugPattern::DEALLOCATED);
+}
+
+TEST_F(deferred_fills_are_flushed_when_the_batch_is_full)
+{
+	unsigned char memory[impl::DeferredFills::CAPACITY + 1];
+	std::memset(memory, 0, sizeof(memory));
+
+	impl::DeferredFills fills;
+	for (auto & byte : memory)
+		fills.add(&byte, 1, DebugPattern::DEALLOCATED);
+
+	TEST_ASSERT(fills.pending() == 1);
+	TEST_ASSERT_ALL(memory, memory + impl::DeferredFills::CAPACITY, == DebugPattern::DEALLOCATED);
+}
+
+#endif
@@ -7,7 +7,7 @@ found in the top-level directory of this distribution.
 */
 
 
-#include "testing\testing.h"
+#include "testing/testing.h"
 
 #define DEBUG_INLINE_ALLOCATOR_ENABLED 1
 #include "InlineAllocator.h"
@@ -0,0 +1,78 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "FlatMap.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+	template <typename Map>
+	std::vector<int> keys(const Map & map)
+	{
+		std::vector<int> result;
+		for (const auto & pair : map)
+			result.push_back(pair.first);
+		return result;
+	}
+}
+
+TEST_F(flat_map_keeps_the_pairs_sorted)
+{
+	FlatMap<int, std::string, 4> map;
+	map[3] = "three";
+	map[1] = "one";
+	TEST_ASSERT(map.emplace(2, "two").second);
+	TEST_ASSERT(!map.emplace(2, "dos").second);
+
+	TEST_ASSERT((keys(map) == std::vector<int>{ 1, 2, 3 }));
+	TEST_ASSERT(map.find(2)->second == "two");
+	TEST_ASSERT(map.find(4) == map.end());
+	TEST_ASSERT(map.lower_bound(4) == map.end() && map.lower_bound(0) == map.begin());
+	TEST_ASSERT(map.contains(3) && map.is_inline());
+}
+
+TEST_F(flat_map_moves_to_the_fallback_memory_when_it_grows)
+{
+	FlatMap<int, int, 4> map;
+	for (int i = 9; i >= 0; --i)
+		map[i] = i * i;
+
+	TEST_ASSERT(!map.is_inline() && map.size() == 10);
+	TEST_ASSERT((keys(map) == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+	for (const auto & pair : map)
+		TEST_ASSERT(pair.second == pair.first * pair.first);
+
+	for (int i = 0; i < 10; i += 2)
+		TEST_ASSERT(map.erase(i));
+	TEST_ASSERT(!map.erase(0));
+	map.shrink_to_fit();
+	TEST_ASSERT((keys(map) == std::vector<int>{ 1, 3, 5, 7, 9 }));
+
+	map.erase(map.begin());
+	map.erase(map.find(9));
+	map.shrink_to_fit();
+	TEST_ASSERT(map.is_inline());
+	TEST_ASSERT((keys(map) == std::vector<int>{ 3, 5, 7 }));
+}
+
+TEST_F(flat_map_uses_the_comparison)
+{
+	FlatMap<int, int, 8, std::greater<int>> map;
+	for (int i = 0; i < 5; ++i)
+		map[i] = i;
+	TEST_ASSERT((keys(map) == std::vector<int>{ 4, 3, 2, 1, 0 }));
+
+	map.clear();
+	TEST_ASSERT(map.empty());
+}
@@ -0,0 +1,247 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "GuardPageAllocator.h"
+#include "PageAllocator.h"
+#include "StackAllocator.h"
+#include "TlsfAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+// AddressSanitizer handles the faults itself
+#if defined(__linux__) && !MEMORY_ASAN_ENABLED
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+	/// \brief	Runs f in a child process, true if the child was killed by a segmentation fault.
+	template <typename F>
+	bool faults(F && f)
+	{
+		const auto pid = fork();
+		if (pid == 0)
+		{
+			f();
+			_exit(0);
+		}
+
+		int status = 0;
+		waitpid(pid, &status, 0);
+		return WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV;
+	}
+}
+#endif
+
+TEST_F(guard_page_allocator_places_the_allocations_against_the_guard_page)
+{
+	GuardPageAllocator alloc;
+	const auto page_size = system_page_size();
+
+	auto * exact = alloc.allocate(100, 1);
+	auto * aligned = alloc.allocate(100, 16);
+	TEST_ASSERT((ptr_to_num(exact) + 100) % page_size == 0);
+	TEST_ASSERT((ptr_to_num(aligned) + 112) % page_size == 0);
+	TEST_ASSERT(alloc.owns(exact) && alloc.owns(aligned));
+	TEST_ASSERT(alloc.guarded_allocations() == 2);
+	TEST_ASSERT(alloc.mapped_bytes() == 4 * page_size);
+
+	// all the bytes can be used
+	for (size_type i = 0; i < 100; ++i)
+		exact[i] = static_cast<unsigned char>(i);
+
+	alloc.deallocate(exact, 100);
+	alloc.deallocate(aligned, 100);
+	TEST_ASSERT(alloc.guarded_allocations() == 0);
+	TEST_ASSERT(alloc.mapped_bytes() == 0);
+}
+
+TEST_F(guard_page_allocator_can_protect_the_memory_below_the_allocations)
+{
+	GuardPageConfig config;
+	config.protect_below = true;
+	GuardPageAllocator alloc{ config };
+
+	auto * mem = alloc.allocate(5000);
+	TEST_ASSERT(ptr_to_num(mem) % system_page_size() == 0);
+	alloc.deallocate(mem, 5000);
+}
+
+TEST_F(guard_page_allocator_keeps_the_freed_memory_in_quarantine)
+{
+	GuardPageConfig config;
+	config.quarantine = 2;
+	GuardPageAllocator alloc{ config };
+	const auto page_size = system_page_size();
+
+	unsigned char * mem[3];
+	for (auto *& m : mem)
+		m = alloc.allocate(8);
+	for (auto * m : mem)
+		alloc.deallocate(m, 8);
+
+	// the oldest one is unmapped
+	TEST_ASSERT(alloc.mapped_bytes() == 4 * page_size);
+	alloc.deallocate_all();
+	TEST_ASSERT(alloc.mapped_bytes() == 0);
+}
+
+TEST_F(guard_page_allocator_samples_the_allocations_to_guard)
+{
+	GuardPageConfig config;
+	config.sample_rate = 4;
+	GuardPageAllocator alloc{ config };
+
+	size_type guarded = 0;
+	for (int i = 0; i < 16; ++i)
+		guarded += alloc.should_guard() ? 1 : 0;
+	TEST_ASSERT(guarded == 4);
+
+	config.sample_rate = 0;
+	GuardPageAllocator disabled{ config };
+	TEST_ASSERT(disabled.should_guard() == false);
+}
+
+TEST_F(guarded_allocator_guards_one_in_n_allocations)
+{
+	GuardPageConfig config;
+	config.sample_rate = 2;
+	GuardedAllocator<TlsfAllocator> alloc{ config, 4096 };
+
+	auto * a = alloc.allocate(32);
+	auto * b = alloc.allocate(32);
+	TEST_ASSERT(alloc.get_guard().owns(a) == false);
+	TEST_ASSERT(alloc.get_guard().owns(b));
+	TEST_ASSERT(alloc.owns(a) && alloc.owns(b));
+
+	alloc.deallocate(a, 32);
+	alloc.deallocate(b, 32);
+	TEST_ASSERT(alloc.get_guard().guarded_allocations() == 0);
+}
+
+TEST_F(guarded_allocator_moves_the_guarded_allocations_when_reallocating)
+{
+	GuardPageConfig config;
+	config.sample_rate = 2;
+	GuardedAllocator<TlsfAllocator> alloc{ config, 4096 };
+	const auto free_size = alloc.free_size();
+
+	auto * a = alloc.allocate(10);
+	auto * b = alloc.allocate(10);
+	TEST_ASSERT(alloc.get_guard().owns(b));
+	TEST_ASSERT(ptr_to_num(b) % TlsfAllocator::ALIGNMENT == 0);
+	TEST_ASSERT(alloc.usable_size(b) >= 10);
+	TEST_ASSERT(alloc.expand(b, 10, 20) == false);
+
+	for (unsigned char i = 0; i < 10; ++i)
+		b[i] = i;
+
+	// the third allocation is not sampled, the block moves to the TLSF
+	auto * moved = alloc.reallocate(b, 10, 100);
+	TEST_ASSERT(moved != nullptr && moved != b);
+	TEST_ASSERT(alloc.get_guard().guarded_allocations() == 0);
+	TEST_ASSERT(alloc.usable_size(moved) >= 100);
+	for (unsigned char i = 0; i < 10; ++i)
+		TEST_ASSERT(moved[i] == i);
+
+	alloc.deallocate(a, 10);
+	alloc.deallocate(moved, 100);
+	TEST_ASSERT(alloc.free_size() == free_size);
+}
+
+#if defined(__linux__) && !MEMORY_ASAN_ENABLED
+
+TEST_F(guard_page_allocator_faults_on_overruns_underruns_and_uses_after_free)
+{
+	TEST_ASSERT(faults([]
+	{
+		GuardPageAllocator alloc;
+		auto * mem = alloc.allocate(10, 1);
+		mem[10] = 0;
+	}));
+
+	TEST_ASSERT(faults([]
+	{
+		GuardPageConfig config;
+		config.protect_below = true;
+		GuardPageAllocator alloc{ config };
+		auto * mem = alloc.allocate(10);
+		mem[-1] = 0;
+	}));
+
+	TEST_ASSERT(faults([]
+	{
+		GuardPageConfig config;
+		config.quarantine = 1;
+		GuardPageAllocator alloc{ config };
+		auto * mem = alloc.allocate(10);
+		alloc.deallocate(mem, 10);
+		mem[0] = 0;
+	}));
+
+	// no false positives
+	TEST_ASSERT(!faults([]
+	{
+		GuardPageAllocator alloc;
+		auto * mem = alloc.allocate(10, 1);
+		mem[9] = 0;
+	}));
+}
+
+#endif
+
+#if MEMORY_DEBUG_ENABLED
+
+TEST_F(debug_stack_allocator_can_guard_its_allocations)
+{
+	DebugStackAllocator alloc{ 64 };
+	GuardPageConfig config;
+	config.sample_rate = 2;
+	alloc.enable_guard_pages(config);
+
+	auto * a = alloc.allocate(8);	// stack
+	auto * b = alloc.allocate(8);	// guarded
+	auto * c = alloc.allocate(8);	// stack
+	TEST_ASSERT(c == a + 8);
+	TEST_ASSERT(alloc.get_guard()->owns(b));
+	TEST_ASSERT((ptr_to_num(b) + 8) % system_page_size() == 0);
+	TEST_ASSERT(alloc.get_stats().guarded == 1);
+
+	// the guarded allocation is not part of the stack
+	alloc.deallocate(b, 8);
+	alloc.deallocate(c, 8);
+	alloc.deallocate(a, 8);
+	TEST_ASSERT(alloc.free_size() == 64);
+}
+
+TEST_F(debug_page_allocator_can_guard_its_objects)
+{
+	DebugPageAllocator alloc{ 24, 4 };
+	alloc.enable_guard_pages();
+
+	auto * a = reinterpret_cast<unsigned char *>(alloc.allocate());
+	TEST_ASSERT(alloc.owns(a) == false);
+	TEST_ASSERT((ptr_to_num(a) + 24) % system_page_size() == 0);
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+	TEST_ASSERT_ALL(a, a + 24, == DebugPattern::ALLOCATED);
+#endif
+
+	void * objects[3];
+	alloc.allocate_bulk(objects, 3);
+	TEST_ASSERT(alloc.get_stats().guarded_objects == 4);
+	TEST_ASSERT(alloc.get_stats().allocated_objects == 0);
+
+	alloc.deallocate_bulk(objects, 3);
+	alloc.deallocate(a);
+	TEST_ASSERT(alloc.get_stats().guarded_objects == 0);
+	TEST_ASSERT(alloc.get_guard()->mapped_bytes() == 0);
+}
+
+#endif
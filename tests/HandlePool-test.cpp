@@ -0,0 +1,160 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "HandlePool.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <string>
+#include <vector>
+
+TEST_F(handles_store_the_index_and_the_generation)
+{
+	const auto handle = Handle32::make(5, 3);
+	TEST_ASSERT(handle.index() == 5);
+	TEST_ASSERT(handle.generation() == 3);
+	TEST_ASSERT(sizeof(handle) == 4);
+
+	const auto big_handle = Handle64::make(0xFFFFFFFE, 0xFFFFFFFF);
+	TEST_ASSERT(big_handle.index() == 0xFFFFFFFE);
+	TEST_ASSERT(big_handle.generation() == 0xFFFFFFFF);
+
+	TEST_ASSERT(Handle32{}.is_null());
+}
+
+TEST_F(handle_pool_resolves_the_handles_to_the_objects)
+{
+	HandlePool<std::string> pool{ 4 };
+
+	const auto a = pool.create("a");
+	const auto b = pool.create("b");
+	TEST_ASSERT(!a.is_null() && !b.is_null());
+	TEST_ASSERT(*pool.get(a) == "a");
+	TEST_ASSERT(*pool.get(b) == "b");
+	TEST_ASSERT(pool.live_objects() == 2);
+}
+
+TEST_F(handle_pool_detects_stale_handles)
+{
+	HandlePool<int> pool{ 4 };
+
+	const auto a = pool.create(1);
+	TEST_ASSERT(pool.destroy(a));
+	TEST_ASSERT(pool.get(a) == nullptr);
+	TEST_ASSERT(pool.destroy(a) == false);
+
+	// the slot is reused with a new generation
+	const auto b = pool.create(2);
+	TEST_ASSERT(b.index() == a.index());
+	TEST_ASSERT(b != a);
+	TEST_ASSERT(pool.is_valid(b));
+	TEST_ASSERT(pool.is_valid(a) == false);
+
+	// handles from other pools or invalid indices
+	TEST_ASSERT(pool.get(Handle32::make(100, 1)) == nullptr);
+	TEST_ASSERT(pool.get(Handle32{}) == nullptr);
+}
+
+TEST_F(handle_pool_does_not_reuse_slots_that_used_all_the_generations)
+{
+	using SmallHandle = Handle<std::uint8_t, 6>;	// 2 generation bits
+	HandlePool<int, SmallHandle> pool{ 4 };
+
+	auto handle = pool.create(0);
+	const auto index = handle.index();
+	for (int i = 1; i < 3; ++i)
+	{
+		pool.destroy(handle);
+		handle = pool.create(i);
+		TEST_ASSERT(handle.index() == index);
+	}
+
+	TEST_ASSERT(handle.generation() == SmallHandle::max_generation);
+	pool.destroy(handle);
+	TEST_ASSERT(pool.create(3).index() != index);
+}
+
+TEST_F(handle_pool_returns_a_null_handle_when_there_are_no_indices_left)
+{
+	using SmallHandle = Handle<std::uint8_t, 2>;
+	HandlePool<int, SmallHandle> pool{ 4 };
+
+	for (size_type i = 0; i < HandlePool<int, SmallHandle>::max_objects; ++i)
+		TEST_ASSERT(!pool.create(0).is_null());
+	TEST_ASSERT(pool.create(0).is_null());
+}
+
+TEST_F(handle_pool_keeps_the_handles_valid_after_compacting)
+{
+	HandlePool<std::string> pool{ 4 };
+
+	std::vector<HandlePool<std::string>::handle_type> handles;
+	for (int i = 0; i < 16; ++i)
+		handles.push_back(pool.create(std::to_string(i)));
+	for (int i = 0; i < 16; ++i)
+	{
+		if (i % 4 != 0)
+			pool.destroy(handles[i]);
+	}
+	TEST_ASSERT(pool.allocated_pages() == 4);
+
+	pool.compact();
+	TEST_ASSERT(pool.allocated_pages() == 1);
+	TEST_ASSERT(pool.live_objects() == 4);
+	for (int i = 0; i < 16; i += 4)
+		TEST_ASSERT(*pool.get(handles[i]) == std::to_string(i));
+
+	// the objects are contiguous in the order of the slots
+	TEST_ASSERT(pool.get(handles[4]) == pool.get(handles[0]) + 1);
+
+	int visited = 0;
+	pool.for_each([&](HandlePool<std::string>::handle_type handle, std::string & str)
+	{
+		TEST_ASSERT(pool.get(handle) == &str);
+		visited++;
+	});
+	TEST_ASSERT(visited == 4);
+}
+
+TEST_F(handle_pool_destroys_the_objects_left)
+{
+	static int alive = 0;
+	struct Counted
+	{
+		Counted() { alive++; }
+		~Counted() { alive--; }
+	};
+
+	{
+		HandlePool<Counted> pool;
+		pool.create();
+		pool.create();
+		TEST_ASSERT(alive == 2);
+	}
+	TEST_ASSERT(alive == 0);
+}
+
+#if MEMORY_DEBUG_ENABLED
+
+TEST_F(handle_pool_can_use_the_debug_page_allocator)
+{
+	HandlePool<int, Handle64, DebugPageAllocator> pool{ 4 };
+
+	const auto a = pool.create(1);
+	pool.create(2);
+	pool.destroy(a);
+
+	const auto & stats = pool.get_page_allocator().get_stats();
+	TEST_ASSERT(stats.allocated_objects == 1);
+
+	pool.compact();
+	TEST_ASSERT(pool.get_page_allocator().get_stats().allocated_objects == 1);
+}
+
+#endif
@@ -7,13 +7,16 @@ found in the top-level directory of this distribution.
 */
 
 
-#include "testing\testing.h"
+#include "testing/testing.h"
 
 #define DEBUG_INLINE_ALLOCATOR_ENABLED 1
 #include "InlineAllocator.h"
 using namespace memory;	// avoid verbosity on tests
 
+#include <sstream>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 
 
@@ -60,9 +63,11 @@ TEST_F(inline_allocator_can_check_if_has_more_space_left)
 
 	int * an_int = int_alloc.allocate();
 	int * two_ints = int_alloc.allocate(2);
+	TEST_ASSERT(an_int != nullptr && two_ints != nullptr);
 
 	TEST_ASSERT(int_alloc.is_full() == false);
 	int * last_int = int_alloc.allocate();
+	TEST_ASSERT(last_int != nullptr);
 
 	TEST_ASSERT(int_alloc.is_full());
 }
@@ -112,6 +117,22 @@ TEST_F(inline_allocator_can_deallocate_objects)
 
 	TEST_ASSERT(int_alloc.allocate(3) == b);
 }
+TEST_F(inline_allocator_can_be_moved)
+{
+	static_assert(std::is_nothrow_move_constructible<InlineAllocator<4, int>>::value, "InlineAllocator needs to be movable.");
+
+	InlineAllocator<4, int> alloc;
+	int * a = alloc.allocate(2);
+	a[0] = 1;
+	a[1] = 2;
+
+	// the moved allocator has its own copy of the allocated objects
+	InlineAllocator<4, int> moved{ std::move(alloc) };
+	TEST_ASSERT(moved.free_size() == 2 * sizeof(int));
+	int * moved_a = moved.allocate(2) - 2;
+	TEST_ASSERT(moved.owns(moved_a) && moved_a != a);
+	TEST_ASSERT(moved_a[0] == 1 && moved_a[1] == 2);
+}
 TEST_F(inline_allocator_provides_an_interface_to_rebind_the_type)
 {
 	using int_alloc_type = InlineAllocator<4>::rebind_t<int>;
@@ -124,6 +145,98 @@ TEST_F(inline_allocator_provides_an_interface_to_rebind_the_type)
 	same_type = std::is_same<char_alloc_type, InlineAllocator<4, char>>::value;
 	TEST_ASSERT(same_type);
 }
+TEST_F(inline_allocator_can_allocate_and_deallocate_objects_in_bulk)
+{
+	InlineAllocator<4, int> int_alloc;
+
+	int * single = int_alloc.allocate();	// a 0 0 0
+	int * objects[4];
+	TEST_ASSERT(int_alloc.allocate_bulk(objects, 4) == 3);	// a o o o
+	TEST_ASSERT(objects[0] == single + 1);
+	TEST_ASSERT(objects[2] == single + 3);
+	TEST_ASSERT(int_alloc.is_full());
+
+	int_alloc.deallocate_bulk(objects, 2);	// a 0 0 o
+	TEST_ASSERT(int_alloc.free_size() == 2 * sizeof(int));
+	TEST_ASSERT(int_alloc.allocate(2) == single + 1);
+}
+TEST_F(inline_allocator_expands_allocations_when_the_next_objects_are_free)
+{
+	InlineAllocator<8, int> int_alloc;
+
+	int * a = int_alloc.allocate(2);	// a a 0 0 0 0 0 0
+	int * b = int_alloc.allocate(2);	// a a b b 0 0 0 0
+	TEST_ASSERT(int_alloc.expand(a, 2, 3) == false);
+
+	TEST_ASSERT(int_alloc.expand(b, 2, 6));	// a a b b b b b b
+	TEST_ASSERT(int_alloc.is_full());
+	TEST_ASSERT(int_alloc.expand(b, 6, 7) == false);
+
+	TEST_ASSERT(int_alloc.expand(b, 6, 1));	// a a b 0 0 0 0 0
+	TEST_ASSERT(int_alloc.free_size() == 5 * sizeof(int));
+	TEST_ASSERT(int_alloc.allocate() == b + 1);
+}
+TEST_F(inline_allocator_reallocate_moves_the_objects_when_it_cant_expand)
+{
+	InlineAllocator<8, int> int_alloc;
+
+	int * a = int_alloc.allocate(2);	// a a 0 0 0 0 0 0
+	int_alloc.allocate(1);				// a a x 0 0 0 0 0
+	a[0] = 1;
+	a[1] = 2;
+
+	int * b = int_alloc.reallocate(a, 2, 4);	// 0 0 x b b b b 0
+	TEST_ASSERT(b == a + 3);
+	TEST_ASSERT(b[0] == 1 && b[1] == 2);
+	TEST_ASSERT(int_alloc.reallocate(b, 4, 6) == nullptr);
+	TEST_ASSERT(int_alloc.free_size() == 3 * sizeof(int));
+}
+TEST_F(fallback_allocator_only_moves_the_objects_to_the_fallback_when_primary_cant_reallocate)
+{
+	DefaultInlineAllocator<4, int> int_alloc;
+
+	int * a = int_alloc.allocate(2);
+	a[0] = 1;
+	a[1] = 2;
+	TEST_ASSERT(int_alloc.reallocate(a, 2, 4) == a);
+
+	int * b = int_alloc.reallocate(a, 4, 16);
+	TEST_ASSERT(int_alloc.get_primary().owns(b) == false);
+	TEST_ASSERT(int_alloc.get_primary().free_size() == 4 * sizeof(int));
+	TEST_ASSERT(b[0] == 1 && b[1] == 2);
+
+	// the fallback can shrink the memory in place, it stays there
+	TEST_ASSERT(int_alloc.reallocate(b, 16, 2) == b);
+	int_alloc.deallocate(b, 2);
+}
+TEST_F(fallback_allocator_allocates_in_bulk_from_both_allocators)
+{
+	DefaultInlineAllocator<4, int> int_alloc;
+
+	int * objects[6];
+	TEST_ASSERT(int_alloc.allocate_bulk(objects, 6) == 6);
+	TEST_ASSERT(int_alloc.get_primary().is_full());
+	TEST_ASSERT(int_alloc.get_primary().owns(objects[3]));
+	TEST_ASSERT(int_alloc.get_primary().owns(objects[4]) == false);
+
+	int_alloc.deallocate_bulk(objects, 6);
+	TEST_ASSERT(int_alloc.get_primary().free_size() == 4 * sizeof(int));
+}
+
+#if MEMORY_ASAN_ENABLED
+
+TEST_F(inline_allocator_poisons_the_free_objects)
+{
+	InlineAllocator<4, int> alloc;
+	int * a = alloc.allocate(2);
+	TEST_ASSERT(__asan_address_is_poisoned(a) == 0);
+	TEST_ASSERT(__asan_address_is_poisoned(a + 2));
+
+	alloc.deallocate(a, 2);
+	TEST_ASSERT(__asan_address_is_poisoned(a));
+}
+
+#endif
 
 
 // DebugInlineAllocator
@@ -156,8 +269,8 @@ TEST(DebugInlineAllocatorTest, can_generate_debug_statistics_of_inline_allocator
 	}	// 23 objects
 
 	TEST_ASSERT(stats.allocated_bytes() == sizeof(int) * 23);
-	TEST_ASSERT(stats.non_inline_allocs == 2);
-	TEST_ASSERT(stats.total_alloc_objects == 23);
+	TEST_ASSERT(stats.get_counters().non_inline_allocs == 2);
+	TEST_ASSERT(stats.get_counters().total_alloc_objects == 23);
 }
 TEST(DebugInlineAllocatorTest, inline_allocator_debug_statistics_contain_information_about_multiple_runs)
 {
@@ -196,19 +309,218 @@ TEST(DebugInlineAllocatorTest, inline_allocator_debug_statistics_contain_informa
 	}	// 21 objects
 
 	TEST_ASSERT(stats.allocated_bytes() == sizeof(int) * 21);
-	TEST_ASSERT(stats.non_inline_allocs == 3);
-	TEST_ASSERT(stats.total_alloc_objects == 21);
-	TEST_ASSERT(stats.use_num == 3);
-	TEST_ASSERT(stats.uses_implying_non_inline_allocs == 2);
+	TEST_ASSERT(stats.get_counters().non_inline_allocs == 3);
+	TEST_ASSERT(stats.get_counters().total_alloc_objects == 21);
+	TEST_ASSERT(stats.get_counters().use_num == 3);
+	TEST_ASSERT(stats.get_counters().uses_implying_non_inline_allocs == 2);
+}
+
+TEST(DebugInlineAllocatorTest, debug_inline_allocator_generates_statistics_of_bulk_allocations)
+{
+	{
+		memory::impl::DebugInlineAllocator<4, int> alloc{ stats };
+
+		int * objects[6];
+		TEST_ASSERT(alloc.allocate_bulk(objects, 6) == 6);	// 4 inline, 2 dynamic
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+		for (auto * obj : objects)
+			TEST_ASSERT_ALL(reinterpret_cast<unsigned char *>(obj), reinterpret_cast<unsigned char *>(obj + 1), == DebugPattern::ALLOCATED);
+#endif
+
+		alloc.deallocate_bulk(objects, 6);
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+		TEST_ASSERT_ALL(reinterpret_cast<unsigned char *>(objects[0]), reinterpret_cast<unsigned char *>(objects[0] + 1), == DebugPattern::DEALLOCATED);
+#endif
+	}
+
+	TEST_ASSERT(stats.get_counters().allocation_num == 6);
+	TEST_ASSERT(stats.get_counters().total_alloc_objects == 6);
+	TEST_ASSERT(stats.get_counters().non_inline_allocs == 2);
+	TEST_ASSERT(stats.get_counters().uses_implying_non_inline_allocs == 1);
 }
 
+TEST(DebugInlineAllocatorTest, debug_inline_allocator_counts_reallocations_as_allocations)
+{
+	{
+		memory::impl::DebugInlineAllocator<8, int> alloc{ stats };
+
+		int * a = alloc.allocate(2);		// inline
+		a = alloc.reallocate(a, 2, 4);		// inline, in place
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+		TEST_ASSERT_ALL(reinterpret_cast<unsigned char *>(a + 2), reinterpret_cast<unsigned char *>(a + 4), == DebugPattern::ALLOCATED);
+#endif
+		a = alloc.reallocate(a, 4, 16);		// dynamic
+
+		alloc.deallocate(a, 16);
+	}
+
+	TEST_ASSERT(stats.get_counters().allocation_num == 3);
+	TEST_ASSERT(stats.get_counters().total_alloc_objects == 22);
+	TEST_ASSERT(stats.get_counters().non_inline_allocs == 1);
+	TEST_ASSERT(stats.get_counters().uses_implying_non_inline_allocs == 1);
+}
+
+TEST(DebugInlineAllocatorTest, debug_inline_allocator_records_the_peak_objects_of_each_use)
+{
+	{
+		memory::impl::DebugInlineAllocator<4, int> alloc{ stats };
+		int * a = alloc.allocate(2);
+		int * b = alloc.allocate(1);
+		alloc.deallocate(a, 2);
+		a = alloc.allocate(1);
+		alloc.deallocate(a, 1);
+		alloc.deallocate(b, 1);
+	}	// peak of 3
+	{
+		memory::impl::DebugInlineAllocator<4, int> alloc{ stats };
+		int * a = alloc.allocate(6);
+		alloc.deallocate(a, 6);
+	}	// peak of 6
+	{
+		memory::impl::DebugInlineAllocator<4, int> alloc{ stats };
+		int * a = alloc.allocate(1);
+		alloc.deallocate(a, 1);
+	}	// peak of 1
+
+	TEST_ASSERT(stats.get_counters().use_num == 3);
+	TEST_ASSERT(stats.get_counters().peak_histogram[1] == 1);
+	TEST_ASSERT(stats.get_counters().peak_histogram[3] == 1);
+	TEST_ASSERT(stats.get_counters().peak_histogram[6] == 1);
+	TEST_ASSERT(stats.get_counters().max_peak_objects == 6);
+	TEST_ASSERT(stats.inline_hit_rate(6) == 1.f);
+	TEST_ASSERT(stats.inline_hit_rate(0) == 0.f);
+	TEST_ASSERT(stats.recommended_inline_objects(0.6f) == 3);
+	TEST_ASSERT(stats.recommended_inline_objects(1.f) == 6);
+}
+
+TEST(DebugInlineAllocatorTest, debug_inline_allocator_peaks_bigger_than_the_histogram_share_the_last_bucket)
+{
+	constexpr auto last = DebugInlineAllocatorStats::PEAK_HISTOGRAM_SIZE - 1;
+	stats.add_use_peak(2);
+	stats.add_use_peak(200);
+	TEST_ASSERT(stats.get_counters().peak_histogram[last] == 1);
+	TEST_ASSERT(stats.inline_hit_rate(100) == 0.5f);
+	TEST_ASSERT(stats.inline_hit_rate(200) == 1.f);
+	TEST_ASSERT(stats.recommended_inline_objects(1.f) == 200);
+}
+
+namespace
+{
+	struct ListNode
+	{
+		ListNode * next;
+		ListNode * prev;
+		int value;
+	};
+}
+
+TEST(DebugInlineAllocatorTest, rebound_debug_inline_allocators_use_the_stats_of_their_type)
+{
+	DebugInlineAllocatorStats site{ __FILE__, __LINE__, "int", sizeof(int), 4, &typeid(int) };
+	{
+		memory::impl::DebugInlineAllocator<4, int> alloc{ site };
+		memory::impl::DebugInlineAllocator<4, ListNode> nodes{ alloc };
+		ListNode * a = nodes.allocate(3);
+		ListNode * b = nodes.allocate(2);	// dynamic
+		nodes.deallocate(b, 2);
+		nodes.deallocate(a, 3);
+
+		// rebinding back uses the stats of the call site
+		memory::impl::DebugInlineAllocator<4, int> back{ nodes };
+	}
+
+	auto & node_stats = site.get_rebound<ListNode>();
+	TEST_ASSERT(&site.get_rebound<int>() == &site);
+	TEST_ASSERT(&node_stats.get_rebound<ListNode>() == &node_stats);
+	TEST_ASSERT(node_stats.object_size == sizeof(ListNode));
+	TEST_ASSERT(node_stats.inline_object_num == 4);
+	TEST_ASSERT(node_stats.line == site.line);
+
+	TEST_ASSERT(site.get_counters().use_num == 2);
+	TEST_ASSERT(site.get_counters().total_alloc_objects == 0);
+	TEST_ASSERT(node_stats.get_counters().use_num == 1);
+	TEST_ASSERT(node_stats.get_counters().total_alloc_objects == 5);
+	TEST_ASSERT(node_stats.allocated_bytes() == 5 * sizeof(ListNode));
+	TEST_ASSERT(node_stats.get_counters().non_inline_allocs == 1);
+	TEST_ASSERT(node_stats.get_counters().uses_implying_non_inline_allocs == 1);
+	TEST_ASSERT(node_stats.get_counters().max_peak_objects == 5);
+}
+
+TEST(DebugInlineAllocatorTest, copied_debug_inline_allocators_are_new_uses)
+{
+	{
+		memory::impl::DebugInlineAllocator<4, int> alloc{ stats };
+		int * a = alloc.allocate(2);
+
+		// the copy has its own copy of the objects
+		memory::impl::DebugInlineAllocator<4, int> copy{ alloc };
+		int * b = copy.allocate(1);
+		copy.deallocate(b, 1);
+		alloc.deallocate(a, 2);
+	}
+
+	TEST_ASSERT(stats.get_counters().use_num == 2);
+	TEST_ASSERT(stats.get_counters().peak_histogram[2] == 1);
+	TEST_ASSERT(stats.get_counters().peak_histogram[3] == 1);
+}
+
+TEST(DebugInlineAllocatorTest, debug_inline_allocator_stats_can_be_shared_by_several_threads)
+{
+	constexpr size_type thread_num = 8;
+	constexpr size_type uses_per_thread = 1000;
+
+	std::vector<std::thread> threads;
+	for (size_type t = 0; t < thread_num; ++t)
+	{
+		threads.emplace_back([&]
+		{
+			for (size_type i = 0; i < uses_per_thread; ++i)
+			{
+				memory::impl::DebugInlineAllocator<4, int> alloc{ stats };
+				int * a = alloc.allocate(3);	// inline
+				int * b = alloc.allocate(2);	// dynamic
+				alloc.deallocate(b, 2);
+				alloc.deallocate(a, 3);
+			}
+		});
+	}
+	for (auto & thread : threads)
+		thread.join();
+
+	const auto counters = stats.get_counters();
+	TEST_ASSERT(counters.use_num == thread_num * uses_per_thread);
+	TEST_ASSERT(counters.allocation_num == 2 * thread_num * uses_per_thread);
+	TEST_ASSERT(counters.total_alloc_objects == 5 * thread_num * uses_per_thread);
+	TEST_ASSERT(counters.non_inline_allocs == thread_num * uses_per_thread);
+	TEST_ASSERT(counters.uses_implying_non_inline_allocs == thread_num * uses_per_thread);
+	TEST_ASSERT(counters.peak_histogram[5] == thread_num * uses_per_thread);
+}
+
+TEST_F(inline_allocator_report_recommends_the_inline_objects_of_every_site)
+{
+	DebugInlineAllocatorStats site{ "report_site.cpp", 12, "int", sizeof(int), 8 };
+	for (const size_type peak : { 1, 2, 2, 10 })
+		site.add_use_peak(peak);
+
+	bool found = false;
+	for_each_inline_allocator_stats([&](const DebugInlineAllocatorStats & stats) { found |= &stats == &site; });
+	TEST_ASSERT(found);
+
+	std::ostringstream os;
+	write_inline_allocator_report(os, 0.75f);
+	const auto report = os.str();
+	TEST_ASSERT(report.find("\"file\": \"report_site.cpp\", \"line\": 12") != std::string::npos);
+	TEST_ASSERT(report.find("\"peak_histogram\": [[1, 1], [2, 2], [10, 1]]") != std::string::npos);
+	TEST_ASSERT(report.find("\"recommended_inline_objects\": 2, \"recommended_inline_bytes\": 8") != std::string::npos);
+}
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+
 TEST(DebugInlineAllocatorTest, debug_inline_allocator_sets_memory_patterns)
 {
 	unsigned char * allocated_raw = nullptr;
 	unsigned char * free_raw = nullptr;
 
-	constexpr size_type inlined_object_num = 4;
-
 	impl::DebugInlineAllocator<4, int> alloc{ stats };
 
 	int * a = alloc.allocate(2);
@@ -229,6 +541,27 @@ TEST(DebugInlineAllocatorTest, debug_inline_allocator_sets_memory_patterns)
 		TEST_ASSERT(free_raw[i] == DebugPattern::ACQUIRED);
 }
 
+TEST(DebugInlineAllocatorTest, debug_inline_allocator_reallocate_fills_the_released_objects)
+{
+	impl::DebugInlineAllocator<8, int> alloc{ stats };
+
+	int * a = alloc.allocate(2);
+	alloc.allocate(1);	// a a b
+	a[0] = 7;
+	auto * raw = reinterpret_cast<unsigned char *>(a);
+
+	TEST_ASSERT(alloc.reallocate(a, 2, 1) == a);	// shrinks in place
+	TEST_ASSERT_ALL(raw + sizeof(int), raw + 2 * sizeof(int), == DebugPattern::DEALLOCATED);
+
+	int * moved = alloc.reallocate(a, 1, 3);	// b is in the way
+	TEST_ASSERT(moved != a && alloc.get_primary().owns(moved));
+	TEST_ASSERT(moved[0] == 7);
+	TEST_ASSERT_ALL(raw, raw + sizeof(int), == DebugPattern::DEALLOCATED);
+	TEST_ASSERT_ALL(reinterpret_cast<unsigned char *>(moved + 1), reinterpret_cast<unsigned char *>(moved + 3), == DebugPattern::ALLOCATED);
+}
+
+#endif
+
 #endif
 
 #if DEBUG_INLINE_ALLOCATOR_ENABLED
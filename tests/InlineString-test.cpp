@@ -0,0 +1,72 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "InlineString.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <sstream>
+#include <type_traits>
+
+static_assert(std::is_nothrow_move_constructible<InlineString<8>>::value, "InlineString needs to be moved without throwing.");
+static_assert(std::is_nothrow_move_assignable<InlineString<8>>::value, "InlineString needs to be moved without throwing.");
+
+TEST_F(inline_string_stores_the_short_strings_inline)
+{
+	InlineString<8> str{ "12345678" };
+	TEST_ASSERT(str.is_inline());
+	TEST_ASSERT(str.size() == 8 && str.capacity() == 8);
+	TEST_ASSERT(str == "12345678");
+	TEST_ASSERT(str.c_str()[8] == '\0');
+
+	str += '9';
+	TEST_ASSERT(str.is_inline() == false);
+	TEST_ASSERT(str == "123456789");
+	TEST_ASSERT(str.c_str()[9] == '\0');
+}
+
+TEST_F(inline_string_can_be_appended_and_compared)
+{
+	InlineString<4> str;
+	TEST_ASSERT(str.empty() && str == "");
+
+	str += "ab";
+	str.append("cdef", 2);
+	str += InlineString<2>{ "e" };
+	TEST_ASSERT(str == "abcde");
+
+	// with itself, that moves to the fallback memory
+	str.append(str);
+	TEST_ASSERT(str == "abcdeabcde");
+
+	str.pop_back();
+	str.resize(3);
+	TEST_ASSERT(str == "abc");
+	TEST_ASSERT(str < InlineString<4>{ "abd" });
+	TEST_ASSERT(str.compare("ab") > 0 && str.compare("abcd") < 0);
+
+	std::ostringstream os;
+	os << str;
+	TEST_ASSERT(os.str() == "abc");
+}
+
+TEST_F(moving_an_inline_string_steals_the_fallback_memory)
+{
+	InlineString<4> long_str{ "a long string" };
+	const auto * chars = long_str.c_str();
+
+	auto moved = std::move(long_str);
+	TEST_ASSERT(moved.c_str() == chars);
+	TEST_ASSERT(long_str.empty() && long_str == "");
+
+	InlineString<4> short_str{ "abc" };
+	moved = std::move(short_str);
+	TEST_ASSERT(moved == "abc" && moved.is_inline());
+	TEST_ASSERT(short_str.empty());
+}
@@ -0,0 +1,154 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "IntrusiveList.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <vector>
+
+namespace
+{
+	struct SecondList {};
+
+	struct Item
+		: IntrusiveListHook<>
+		, IntrusiveListHook<SecondList>
+	{
+		explicit Item(int v) : value{ v } {}
+		int value;
+	};
+
+	// the tests may run in parallel
+	thread_local int s_alive = 0;
+
+	struct Counted
+	{
+		explicit Counted(int v) : value{ v } { s_alive++; }
+		~Counted() { s_alive--; }
+		int value;
+	};
+
+	template <typename List>
+	std::vector<int> values(const List & list)
+	{
+		std::vector<int> result;
+		for (const auto & item : list)
+			result.push_back(item.value);
+		return result;
+	}
+}
+
+TEST_F(intrusive_list_links_the_objects_in_order)
+{
+	Item a{ 1 }, b{ 2 }, c{ 3 };
+	IntrusiveList<Item> list;
+	list.push_back(b);
+	list.push_front(a);
+	list.push_back(c);
+	TEST_ASSERT(list.size() == 3);
+	TEST_ASSERT((values(list) == std::vector<int>{ 1, 2, 3 }));
+	TEST_ASSERT(&list.front() == &a && &list.back() == &c);
+
+	list.erase(b);
+	TEST_ASSERT(!static_cast<IntrusiveListHook<> &>(b).is_linked());
+	TEST_ASSERT((values(list) == std::vector<int>{ 1, 3 }));
+
+	list.insert(list.begin(), b);
+	list.pop_back();
+	TEST_ASSERT((values(list) == std::vector<int>{ 2, 1 }));
+
+	list.clear();
+	TEST_ASSERT(list.empty());
+	TEST_ASSERT(!static_cast<IntrusiveListHook<> &>(a).is_linked());
+}
+
+TEST_F(intrusive_list_objects_can_be_in_several_lists)
+{
+	Item a{ 1 }, b{ 2 };
+	IntrusiveList<Item> first;
+	IntrusiveList<Item, SecondList> second;
+	first.push_back(a);
+	first.push_back(b);
+	second.push_back(b);
+	second.push_back(a);
+
+	TEST_ASSERT((values(first) == std::vector<int>{ 1, 2 }));
+	TEST_ASSERT((values(second) == std::vector<int>{ 2, 1 }));
+
+	first.erase(first.begin());
+	TEST_ASSERT(first.size() == 1 && second.size() == 2);
+}
+
+TEST_F(pooled_list_creates_the_nodes_in_pages)
+{
+	PooledList<Counted> list{ 4 };
+	s_alive = 0;
+	for (int i = 0; i < 6; ++i)
+		list.emplace_back(i);
+	list.emplace_front(-1);
+
+	TEST_ASSERT(list.size() == 7 && s_alive == 7);
+	TEST_ASSERT(list.get_pool().allocated_pages() == 2);
+	TEST_ASSERT(list.front().value == -1 && list.back().value == 5);
+
+	// erase the even values
+	for (auto it = list.begin(); it != list.end();)
+	{
+		if (it->value % 2 == 0)
+			it = list.erase(it);
+		else
+			++it;
+	}
+	TEST_ASSERT((values(list) == std::vector<int>{ -1, 1, 3, 5 }));
+	TEST_ASSERT(s_alive == 4);
+
+	list.emplace(++list.begin(), 0);
+	list.pop_front();
+	TEST_ASSERT((values(list) == std::vector<int>{ 0, 1, 3, 5 }));
+}
+
+TEST_F(pooled_list_clear_releases_the_pages)
+{
+	s_alive = 0;
+	{
+		PooledList<Counted> list{ 4 };
+		for (int i = 0; i < 10; ++i)
+			list.emplace_back(i);
+
+		list.clear();
+		TEST_ASSERT(list.empty() && s_alive == 0);
+		TEST_ASSERT(list.get_pool().allocated_pages() == 0);
+
+		// the list can be used again
+		list.emplace_back(1);
+		list.emplace_back(2);
+		TEST_ASSERT((values(list) == std::vector<int>{ 1, 2 }));
+	}
+	TEST_ASSERT(s_alive == 0);
+}
+
+TEST_F(pooled_list_inserts_a_range_allocating_the_nodes_at_once)
+{
+	s_alive = 0;
+	{
+		PooledList<Counted> list{ 4 };
+		list.emplace_back(0);
+		list.emplace_back(9);
+		TEST_ASSERT(list.get_pool().reserved_objects() == 2);
+
+		const std::vector<int> range{ 1, 2, 3, 4, 5, 6, 7, 8 };
+		list.insert(++list.begin(), range.begin(), range.end());
+		TEST_ASSERT((values(list) == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+		TEST_ASSERT(list.get_pool().allocated_pages() == 3);
+		TEST_ASSERT(list.get_pool().reserved_objects() == 0);
+		TEST_ASSERT(s_alive == 10);
+	}
+	TEST_ASSERT(s_alive == 0);
+}
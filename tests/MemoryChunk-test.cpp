@@ -6,7 +6,7 @@ This file is subject to the license terms in the LICENSE file
 found in the top-level directory of this distribution.
 */
 
-#include "testing\testing.h"
+#include "testing/testing.h"
 
 #include "MemoryChunk.h"
 using namespace memory;	// avoid verbosity on tests
@@ -1,7 +1,7 @@
 
 #include "MemoryCore.h"
 
-#include "testing\testing.h"
+#include "testing/testing.h"
 
 using namespace memory;	// avoid verbosity on tests
 
@@ -14,7 +14,19 @@ TEST_F(can_convert_between_common_memory_units)
 	TEST_ASSERT(megabyte_to_byte(2) == 2048 * 1024);
 }
 
-#ifndef _DEBUG
+TEST_F(global_aligned_alloc_returns_memory_with_the_requested_alignment)
+{
+	for (size_type alignment = sizeof(void *); alignment <= 4096; alignment *= 2)
+	{
+		auto * mem = global_aligned_alloc(100, alignment);
+		TEST_ASSERT(mem != nullptr);
+		TEST_ASSERT(ptr_to_num(mem) % alignment == 0);
+		global_aligned_dealloc(mem);
+	}
+}
+
+// Other platforms overcommit memory, the allocations won't fail and the process gets killed instead.
+#if defined(_WIN32) && !defined(_DEBUG)
 
 TEST_F(when_we_run_out_of_memory_the_callback_is_called)
 {
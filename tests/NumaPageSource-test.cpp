@@ -0,0 +1,104 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "NumaPageSource.h"
+#include "SizeClassAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <thread>
+
+TEST_F(numa_page_source_places_the_memory_on_the_requested_node)
+{
+	FakeNumaTopology topology{ 2 };
+	NumaPageSource source{ topology };
+
+	auto * mem = source.allocate(100, 1);
+	TEST_ASSERT(topology.node_of(mem) == 1);
+	TEST_ASSERT(ptr_to_num(mem) % NumaPageSource::system_page_size() == 0);
+
+	const auto stats = source.get_node_stats(1);
+	TEST_ASSERT(stats.allocated_pages == 1);
+	TEST_ASSERT(stats.allocated_bytes == NumaPageSource::system_page_size());
+	TEST_ASSERT(stats.misplaced_pages == 0);
+	TEST_ASSERT(source.get_node_stats(0).allocated_pages == 0);
+
+	source.deallocate(mem, 100, 1);
+	TEST_ASSERT(source.get_node_stats(1).allocated_pages == 0);
+}
+
+TEST_F(numa_page_allocator_takes_its_pages_from_the_node)
+{
+	FakeNumaTopology topology{ 2 };
+	NumaPageSource source{ topology };
+
+	{
+		NumaPageAllocator page_alloc{ source, 1, 32, 16 };
+		TEST_ASSERT(page_alloc.allocated_pages() == 0);
+
+		auto * obj = page_alloc.allocate();
+		TEST_ASSERT(topology.node_of(obj) == 1);
+		TEST_ASSERT(source.get_node_stats(1).allocated_pages == 1);
+		page_alloc.deallocate(obj);
+	}
+
+	// the pages are given back to the source
+	TEST_ASSERT(source.get_node_stats(1).allocated_pages == 0);
+}
+
+TEST_F(per_node_pools_select_the_pool_of_the_thread_node)
+{
+	FakeNumaTopology topology{ 2 };
+	NumaPageSource source{ topology };
+	PerNodePools<SizeClassAllocator> pools{ topology, [&](size_type node)
+	{
+		return std::unique_ptr<SizeClassAllocator>{ new SizeClassAllocator{ source, node } };
+	} };
+	TEST_ASSERT(pools.node_count() == 2);
+
+	void * node0_mem = nullptr;
+	void * node1_mem = nullptr;
+	std::thread node1_thread{ [&]
+	{
+		topology.set_current_node(1);
+		node1_mem = pools.local().allocate(64);
+	} };
+	node1_thread.join();
+	node0_mem = pools.local().allocate(64);
+
+	TEST_ASSERT(topology.node_of(node0_mem) == 0);
+	TEST_ASSERT(topology.node_of(node1_mem) == 1);
+	TEST_ASSERT(pools.on_node(1).owns(node1_mem));
+	TEST_ASSERT(!pools.on_node(0).owns(node1_mem));
+
+	// big allocations are placed on the node too
+	auto * big = pools.on_node(1).allocate(SizeClassAllocator::MAX_CLASS_SIZE * 2);
+	TEST_ASSERT(topology.node_of(big) == 1);
+	pools.on_node(1).deallocate(big, SizeClassAllocator::MAX_CLASS_SIZE * 2);
+
+	pools.on_node(0).deallocate(node0_mem, 64);
+	pools.on_node(1).deallocate(node1_mem, 64);
+}
+
+TEST_F(system_numa_topology_allocates_on_the_local_node)
+{
+	SystemNumaTopology topology;
+	TEST_ASSERT(topology.node_count() >= 1);
+
+	NumaPageSource source{ topology };
+	auto * mem = reinterpret_cast<unsigned char *>(source.allocate(4096, 0));
+	mem[0] = 1;
+
+	// the binding may not be allowed (i.e. containers), the memory is usable anyway
+	const auto stats = source.get_node_stats(0);
+	TEST_ASSERT(stats.allocated_pages >= 1);
+	TEST_ASSERT(stats.misplaced_pages <= stats.allocated_pages);
+
+	source.deallocate(mem, 4096, 0);
+}
@@ -0,0 +1,201 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "ObjectPool.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	struct Counted
+	{
+		static int s_alive;
+
+		explicit Counted(int value) : m_value{ value } { s_alive++; }
+		~Counted() { s_alive--; }
+
+		int m_value;
+	};
+	int Counted::s_alive = 0;
+
+	struct Throwing
+	{
+		explicit Throwing(bool should_throw)
+		{
+			if (should_throw)
+				throw std::runtime_error{ "Throwing" };
+		}
+	};
+
+	struct Point
+	{
+		int x;
+		int y;
+	};
+}
+
+TEST_F(object_pool_constructs_the_objects_in_place)
+{
+	ObjectPool<Point> pool{ 4 };
+
+	auto * p = pool.create(Point{ 1, 2 });
+	TEST_ASSERT(p->x == 1 && p->y == 2);
+	TEST_ASSERT(pool.owns(p));
+	TEST_ASSERT(pool.live_objects() == 1);
+
+	pool.destroy(p);
+	TEST_ASSERT(pool.live_objects() == 0);
+	TEST_ASSERT(pool.allocated_pages() == 1);
+}
+
+TEST_F(object_pool_calls_the_destructors)
+{
+	Counted::s_alive = 0;
+	{
+		ObjectPool<Counted> pool{ 4 };
+
+		auto * a = pool.create(1);
+		pool.create(2);
+		pool.create(3);
+		TEST_ASSERT(Counted::s_alive == 3);
+
+		pool.destroy(a);
+		TEST_ASSERT(Counted::s_alive == 2);
+	}
+	// the pool destroys the objects that are left
+	TEST_ASSERT(Counted::s_alive == 0);
+}
+
+TEST_F(object_pool_destroy_all_destroys_the_objects_and_releases_the_pages)
+{
+	Counted::s_alive = 0;
+	ObjectPool<Counted> pool{ 4 };
+	for (int i = 0; i < 10; ++i)
+		pool.create(i);
+	TEST_ASSERT(pool.allocated_pages() == 3);
+
+	pool.destroy_all();
+	TEST_ASSERT(Counted::s_alive == 0);
+	TEST_ASSERT(pool.live_objects() == 0);
+	TEST_ASSERT(pool.allocated_pages() == 0);
+
+	// the pool can be used again
+	TEST_ASSERT(pool.create(5)->m_value == 5);
+	TEST_ASSERT(pool.allocated_pages() == 1);
+}
+
+TEST_F(object_pool_drops_the_pages_of_trivially_destructible_objects)
+{
+	ObjectPool<Point> pool{ 4 };
+	for (int i = 0; i < 10; ++i)
+		pool.create(Point{ i, i });
+
+	pool.destroy_all();
+	TEST_ASSERT(pool.live_objects() == 0);
+	TEST_ASSERT(pool.allocated_pages() == 0);
+}
+
+TEST_F(object_pool_visits_only_the_live_objects)
+{
+	ObjectPool<Point> pool{ 4 };
+
+	std::vector<Point *> points;
+	for (int i = 0; i < 10; ++i)
+		points.push_back(pool.create(Point{ i, 0 }));
+	for (int i = 0; i < 10; i += 3)
+		pool.destroy(points[i]);
+
+	int visited = 0;
+	int sum = 0;
+	pool.for_each_live([&](Point & p) { visited++; sum += p.x; });
+	TEST_ASSERT(visited == 6);
+	TEST_ASSERT(sum == 1 + 2 + 4 + 5 + 7 + 8);
+
+	const auto & const_pool = pool;
+	visited = 0;
+	const_pool.for_each_live([&](const Point &) { visited++; });
+	TEST_ASSERT(visited == 6);
+}
+
+TEST_F(object_pool_does_not_leak_the_slot_if_the_constructor_throws)
+{
+	ObjectPool<Throwing> pool{ 1 };
+
+	bool thrown = false;
+	try
+	{
+		pool.create(true);
+	}
+	catch (const std::runtime_error &)
+	{
+		thrown = true;
+	}
+
+	TEST_ASSERT(thrown);
+	TEST_ASSERT(pool.live_objects() == 0);
+
+	// reuses the same slot
+	pool.create(false);
+	TEST_ASSERT(pool.allocated_pages() == 1);
+}
+
+TEST_F(object_pool_creates_the_reserved_objects_in_the_order_of_the_pages)
+{
+	ObjectPool<Point> pool{ 4 };
+	pool.reserve(6);
+	TEST_ASSERT(pool.reserved_objects() == 6 && pool.live_objects() == 0);
+	TEST_ASSERT(pool.allocated_pages() == 2);
+
+	auto * first = pool.create(Point{ 1, 1 });
+	auto * second = pool.create(Point{ 2, 2 });
+	TEST_ASSERT(reinterpret_cast<unsigned char *>(second) - reinterpret_cast<unsigned char *>(first) ==
+				static_cast<std::ptrdiff_t>(pool.get_page_allocator().get_obj_size()));
+	TEST_ASSERT(pool.reserved_objects() == 4 && pool.live_objects() == 2);
+
+	// the reserved slots are not alive
+	int visited = 0;
+	pool.for_each_live([&](Point &) { visited++; });
+	TEST_ASSERT(visited == 2);
+
+	pool.destroy_all();
+	TEST_ASSERT(pool.reserved_objects() == 0 && pool.allocated_pages() == 0);
+	pool.create(Point{ 3, 3 });
+	TEST_ASSERT(pool.allocated_pages() == 1);
+}
+
+#if MEMORY_DEBUG_ENABLED
+
+TEST_F(object_pool_can_use_the_debug_page_allocator)
+{
+	ObjectPool<Point, DebugPageAllocator> pool{ 4 };
+
+	auto * a = pool.create(Point{ 1, 1 });
+	pool.create(Point{ 2, 2 });
+	pool.destroy(a);
+
+	// the patterns written on deallocation do not make the slot look alive
+	int visited = 0;
+	pool.for_each_live([&](Point & p) { visited++; TEST_ASSERT(p.x == 2); });
+	TEST_ASSERT(visited == 1);
+
+	const auto & stats = pool.get_page_allocator().get_stats();
+	TEST_ASSERT(stats.allocated_objects == 1);
+	TEST_ASSERT(stats.free_objects == 3);
+
+	pool.destroy_all();
+	TEST_ASSERT(stats.allocated_pages == 0);
+	TEST_ASSERT(stats.allocated_objects == 0);
+	TEST_ASSERT(stats.free_objects == 0);
+}
+
+#endif
@@ -8,9 +8,12 @@ found in the top-level directory of this distribution.
 
 #include "PageAllocator.h"
 
-#include "testing\testing.h"
+#include "testing/testing.h"
 using namespace memory;	// avoid verbosity on tests
 
+#include <vector>
+
+
 TEST_F(page_allocator_computes_the_size_of_the_page_correctly)
 {
 	PageAllocator alloc1{ sizeof(long long), 4 };
@@ -76,9 +79,119 @@ TEST_F(page_allocator_returns_objects_at_the_correct_offsets)
 	TEST_ASSERT(a2 + 1 == a3);
 }
 
+TEST_F(page_allocator_carves_bulk_allocations_from_new_pages)
+{
+	PageAllocator alloc{ sizeof(long long), 4, false };
+
+	void * objects[6];
+	alloc.allocate_bulk(objects, 6);
+	TEST_ASSERT(alloc.allocated_pages() == 2);
+
+	// the objects of each page are contiguous
+	for (int i = 1; i < 4; ++i)
+		TEST_ASSERT(reinterpret_cast<long long *>(objects[i - 1]) + 1 == objects[i]);
+	TEST_ASSERT(reinterpret_cast<long long *>(objects[4]) + 1 == objects[5]);
+
+	// the rest of the last page is in the free list
+	alloc.allocate();
+	alloc.allocate();
+	TEST_ASSERT(alloc.allocated_pages() == 2);
+}
+
+TEST_F(page_allocator_bulk_operations_use_the_free_list)
+{
+	PageAllocator alloc{ sizeof(int), 4, false };
+
+	void * objects[4];
+	alloc.allocate_bulk(objects, 4);
+	alloc.deallocate_bulk(objects, 3);
+
+	void * reused[3];
+	alloc.allocate_bulk(reused, 3);
+	TEST_ASSERT(alloc.allocated_pages() == 1);
+	for (auto * obj : reused)
+		TEST_ASSERT(obj == objects[0] || obj == objects[1] || obj == objects[2]);
+
+	alloc.deallocate_bulk(reused, 3);
+	alloc.deallocate(objects[3]);
+	for (int i = 0; i < 4; ++i)
+		alloc.allocate();
+	TEST_ASSERT(alloc.allocated_pages() == 1);
+}
+
+
+namespace
+{
+	class RecordingPageAllocator
+		: public PageAllocator
+	{
+	public:
+		using PageAllocator::PageAllocator;
+
+		std::vector<unsigned char *> m_pages;
+
+	protected:
+		Page * do_page_alloc() override
+		{
+			auto * page = PageAllocator::do_page_alloc();
+			m_pages.push_back(reinterpret_cast<unsigned char *>(page));
+			return page;
+		}
+	};
+}
+
+TEST_F(page_allocator_rotates_the_color_of_the_pages)
+{
+	constexpr size_type colors = 3;
+	RecordingPageAllocator alloc{ 64, 4, false, colors };
+	TEST_ASSERT(alloc.get_page_size() == 64 * 4 + 2 * sizeof(void*) + (colors - 1) * CACHE_LINE_SIZE);
+
+	void * objects[4 * 5];
+	alloc.allocate_bulk(objects, 4 * 5);
+	TEST_ASSERT(alloc.m_pages.size() == 5);
+
+	for (size_type i = 0; i < alloc.m_pages.size(); ++i)
+	{
+		auto * first = reinterpret_cast<unsigned char *>(objects[i * 4]);
+		TEST_ASSERT(first == alloc.m_pages[i] + 2 * sizeof(void*) + (i % colors) * CACHE_LINE_SIZE);
+		TEST_ASSERT(alloc.owns(first));
+	}
+
+	alloc.deallocate_bulk(objects, 4 * 5);
+	for (size_type i = 0; i < 4 * 5; ++i)
+		TEST_ASSERT(alloc.allocate() != nullptr);
+}
 
 #if MEMORY_DEBUG_ENABLED
 
+#if MEMORY_ASAN_ENABLED
+
+TEST_F(page_allocator_poisons_the_free_objects_but_their_link)
+{
+	constexpr size_type object_size = 32;
+	PageAllocator alloc{ object_size, 4 };
+	auto * a = reinterpret_cast<unsigned char *>(alloc.allocate());
+	auto * b = reinterpret_cast<unsigned char *>(alloc.allocate());
+	TEST_ASSERT(__asan_address_is_poisoned(a + object_size - 1) == 0);
+	TEST_ASSERT(__asan_address_is_poisoned(b - 1));	// the objects are taken from the end of the page
+
+	alloc.deallocate(a);
+	TEST_ASSERT(__asan_address_is_poisoned(a) == 0);
+	TEST_ASSERT(__asan_address_is_poisoned(a + sizeof(void *)));
+
+	// the bytes the user keeps using in the free objects
+	PageAllocator kept{ object_size, 4 };
+	kept.keep_free_bytes(16, 8);
+	auto * c = reinterpret_cast<unsigned char *>(kept.allocate());
+	kept.deallocate(c);
+	TEST_ASSERT(__asan_address_is_poisoned(c + 16) == 0);
+	TEST_ASSERT(__asan_address_is_poisoned(c + 24));
+}
+
+#endif
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+
 TEST_F(debug_page_allocator_fills_memory_with_paterns)
 {
 	constexpr size_type object_size = sizeof(char) * 16;
@@ -97,6 +210,8 @@ TEST_F(debug_page_allocator_fills_memory_with_paterns)
 	TEST_ASSERT_ALL(mem1, mem1 + object_size, == DebugPattern::ALLOCATED);
 }
 
+#endif
+
 TEST_F(debug_page_allocator_collects_stats_about_the_allocations)
 {
 	DebugPageAllocator alloc{ sizeof(int), 3, false };
@@ -125,6 +240,81 @@ TEST_F(debug_page_allocator_collects_stats_about_the_allocations)
 	TEST_ASSERT(stats.free_objects == 3);
 }
 
+TEST_F(debug_page_allocator_collects_stats_about_the_bulk_allocations)
+{
+	constexpr size_type object_size = sizeof(char) * 16;
+	DebugPageAllocator alloc{ object_size, 3, false };
+
+	void * objects[4];
+	alloc.allocate_bulk(objects, 4);
+	auto stats = alloc.get_stats();
+	TEST_ASSERT(stats.allocated_objects == 4);
+	TEST_ASSERT(stats.allocated_pages == 2);
+	TEST_ASSERT(stats.free_objects == 2);
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+	auto * raw = reinterpret_cast<unsigned char *>(objects[3]);
+	TEST_ASSERT_ALL(raw, raw + object_size, == DebugPattern::ALLOCATED);
+#endif
+
+	alloc.deallocate_bulk(objects, 4);
+	stats = alloc.get_stats();
+	TEST_ASSERT(stats.allocated_objects == 0);
+	TEST_ASSERT(stats.free_objects == 6);
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+	TEST_ASSERT_ALL(raw + sizeof(void*), raw + object_size, == DebugPattern::DEALLOCATED);
+#endif
+}
+
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+
+TEST_F(debug_page_allocator_verifies_the_free_objects)
+{
+	std::vector<PatternCorruption> corruptions;
+	set_corruption_callback([&](const PatternCorruption & corruption) { corruptions.push_back(corruption); });
+
+	DebugPageAllocator alloc{ 32, 4 };
+	auto * a = reinterpret_cast<unsigned char *>(alloc.allocate());
+	auto * b = reinterpret_cast<unsigned char *>(alloc.allocate());
+	TEST_ASSERT(alloc.verify_heap());
+
+	// use after free
+	alloc.deallocate(a);
+	a[20] = 0;
+	TEST_ASSERT(alloc.verify_heap() == false);
+	TEST_ASSERT(corruptions.size() == 1);
+	TEST_ASSERT(corruptions[0].address == a + 20);
+	TEST_ASSERT(corruptions[0].allocator == &alloc);
+
+	// also found when the object is allocated again
+	TEST_ASSERT(alloc.allocate() == a);
+	TEST_ASSERT(corruptions.size() == 2);
+
+	set_corruption_callback(nullptr);
+	alloc.deallocate(a);
+	alloc.deallocate(b);
+}
+
+TEST_F(debug_page_allocator_can_defer_the_fills_of_the_free_objects)
+{
+	DebugPageAllocator alloc{ 32, 4 };
+	alloc.defer_fills(true);
+
+	auto * a = reinterpret_cast<unsigned char *>(alloc.allocate());
+	alloc.deallocate(a);
+	TEST_ASSERT(a[20] == DebugPattern::ALLOCATED);
+
+	// reused before the fill, it is never filled
+	TEST_ASSERT(alloc.allocate() == a);
+	alloc.deallocate(a);
+
+	TEST_ASSERT(alloc.verify_heap());
+	TEST_ASSERT_ALL(a + sizeof(void *), a + 32, == DebugPattern::DEALLOCATED);
+}
+
+#endif
+
 
 #endif
 
@@ -0,0 +1,101 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "PageMapAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <vector>
+
+TEST_F(page_map_allocator_finds_the_size_from_the_address)
+{
+	PageMapAllocator alloc;
+
+	auto * small = alloc.allocate(24);
+	auto * medium = alloc.allocate(1000);
+	auto * big = alloc.allocate(PageMapAllocator::SPAN_SIZE + 1);
+
+	TEST_ASSERT(alloc.usable_size(small) == 32);
+	TEST_ASSERT(alloc.usable_size(medium) == 1024);
+	TEST_ASSERT(alloc.usable_size(big) == 2 * PageMapAllocator::SPAN_SIZE);
+
+	// no headers, the objects of a class are next to each other
+	auto * next = alloc.allocate(30);
+	TEST_ASSERT(reinterpret_cast<unsigned char *>(next) == reinterpret_cast<unsigned char *>(small) + 32);
+
+	alloc.deallocate(small);
+	alloc.deallocate(medium);
+	alloc.deallocate(big);
+	alloc.deallocate(next);
+	TEST_ASSERT(!alloc.owns(big));
+
+	// the freed object is reused
+	TEST_ASSERT(alloc.allocate(32) == next);
+}
+
+TEST_F(page_map_allocator_aligns_the_objects_to_their_class)
+{
+	PageMapAllocator alloc;
+	for (size_type bytes = 1; bytes <= SizeClassAllocator::MAX_CLASS_SIZE; bytes *= 3)
+	{
+		auto * mem = alloc.allocate(bytes);
+		TEST_ASSERT(ptr_to_num(mem) % SizeClassAllocator::class_size(SizeClassAllocator::class_index(bytes)) == 0);
+		alloc.deallocate(mem);
+	}
+}
+
+TEST_F(page_map_allocator_maps_the_over_aligned_allocations)
+{
+	PageMapAllocator alloc;
+	for (size_type alignment = 2 * PageMapAllocator::SPAN_SIZE; alignment <= 16 * PageMapAllocator::SPAN_SIZE; alignment *= 2)
+	{
+		auto * mem = alloc.allocate_aligned(24, alignment);
+		TEST_ASSERT(ptr_to_num(mem) % alignment == 0);
+		TEST_ASSERT(alloc.owns(mem));
+		TEST_ASSERT(alloc.usable_size(mem) == PageMapAllocator::SPAN_SIZE);
+		TEST_ASSERT(alloc.allocated_spans() == 1);
+		alloc.deallocate(mem);
+	}
+	TEST_ASSERT(alloc.allocated_spans() == 0);
+}
+
+TEST_F(page_map_allocator_owns_only_its_memory)
+{
+	PageMapAllocator alloc;
+	int on_stack = 0;
+	TEST_ASSERT(!alloc.owns(&on_stack));
+	TEST_ASSERT(!alloc.owns(nullptr));
+
+	auto * mem = reinterpret_cast<unsigned char *>(alloc.allocate(64));
+	TEST_ASSERT(alloc.owns(mem));
+	TEST_ASSERT(!alloc.owns(mem + 8));
+	alloc.sized_free(mem, 64);
+}
+
+TEST_F(page_map_allocator_sized_free_gives_the_memory_back)
+{
+	PageMapAllocator alloc;
+
+	std::vector<void *> objects;
+	for (size_type i = 0; i < 5000; ++i)
+		objects.push_back(alloc.allocate(100));
+	const auto spans = alloc.allocated_spans();
+	TEST_ASSERT(spans > 1);
+
+	for (auto * obj : objects)
+		alloc.sized_free(obj, 100);
+	for (size_type i = 0; i < 5000; ++i)
+		alloc.allocate(100);
+	TEST_ASSERT(alloc.allocated_spans() == spans);
+
+	auto * big = alloc.allocate(3 * PageMapAllocator::SPAN_SIZE);
+	TEST_ASSERT(alloc.allocated_spans() == spans + 3);
+	alloc.sized_free(big, 3 * PageMapAllocator::SPAN_SIZE);
+	TEST_ASSERT(alloc.allocated_spans() == spans);
+}
@@ -0,0 +1,128 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "PooledHashMap.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <random>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	/// \brief	Sends all the keys to few buckets, so they collide.
+	struct BadHash
+	{
+		size_type operator()(int key) const { return static_cast<size_type>(key % 4); }
+	};
+}
+
+TEST_F(pooled_hash_map_inserts_finds_and_erases)
+{
+	PooledHashMap<int, std::string> map;
+	TEST_ASSERT(map.find(1) == nullptr && map.bucket_count() == 0);
+
+	TEST_ASSERT(map.emplace(1, "one").second);
+	TEST_ASSERT(!map.emplace(1, "uno").second);
+	map[2] = "two";
+	TEST_ASSERT(map.size() == 2);
+	TEST_ASSERT(*map.find(1) == "one" && map[2] == "two");
+	TEST_ASSERT(map.contains(2) && !map.contains(3));
+
+	TEST_ASSERT(map.erase(1));
+	TEST_ASSERT(!map.erase(1));
+	TEST_ASSERT(map.size() == 1 && !map.contains(1));
+}
+
+TEST_F(pooled_hash_map_values_dont_move_when_the_table_grows)
+{
+	PooledHashMap<int, int> map{ 16 };
+	auto * first = map.emplace(0, 0).first;
+	for (int i = 1; i < 1000; ++i)
+		map[i] = i;
+
+	TEST_ASSERT(map.find(0) == first);
+	TEST_ASSERT(map.bucket_count() * 3 >= map.size() * 4);
+	TEST_ASSERT(map.get_pool().allocated_pages() == 1000 / 16 + 1);
+
+	int sum = 0;
+	map.for_each([&](int key, int value) { sum += key == value ? 1 : 0; });
+	TEST_ASSERT(sum == 1000);
+}
+
+TEST_F(pooled_hash_map_erasing_keeps_the_colliding_keys_reachable)
+{
+	PooledHashMap<int, int, BadHash> map;
+	for (int i = 0; i < 12; ++i)
+		map[i] = i;
+
+	// the chains of the buckets are shifted back
+	for (int i = 0; i < 12; i += 3)
+		TEST_ASSERT(map.erase(i));
+	for (int i = 0; i < 12; ++i)
+		TEST_ASSERT(map.contains(i) == (i % 3 != 0));
+}
+
+TEST_F(pooled_hash_map_matches_unordered_map)
+{
+	PooledHashMap<unsigned, unsigned> map{ 32 };
+	std::unordered_map<unsigned, unsigned> reference;
+	std::mt19937 rng{ 42 };
+
+	for (int i = 0; i < 5000; ++i)
+	{
+		const unsigned key = rng() % 512;
+		if (rng() % 3 == 0)
+			TEST_ASSERT(map.erase(key) == (reference.erase(key) == 1));
+		else
+		{
+			map[key] = static_cast<unsigned>(i);
+			reference[key] = static_cast<unsigned>(i);
+		}
+	}
+
+	TEST_ASSERT(map.size() == reference.size());
+	for (const auto & pair : reference)
+		TEST_ASSERT(map.find(pair.first) != nullptr && *map.find(pair.first) == pair.second);
+}
+
+TEST_F(pooled_hash_map_clear_releases_the_pages_and_keeps_the_table)
+{
+	PooledHashMap<int, std::string> map{ 8 };
+	map.reserve(100);
+	const auto buckets = map.bucket_count();
+	TEST_ASSERT(buckets >= 128);
+
+	for (int i = 0; i < 100; ++i)
+		map[i] = std::to_string(i);
+	TEST_ASSERT(map.bucket_count() == buckets);
+
+	map.clear();
+	TEST_ASSERT(map.empty() && !map.contains(5));
+	TEST_ASSERT(map.get_pool().allocated_pages() == 0);
+	TEST_ASSERT(map.bucket_count() == buckets);
+
+	map[5] = "five";
+	TEST_ASSERT(*map.find(5) == "five");
+}
+
+TEST_F(pooled_hash_map_reserve_allocates_the_pairs_at_once)
+{
+	PooledHashMap<int, int> map{ 8 };
+	map.reserve(100);
+	TEST_ASSERT(map.get_pool().reserved_objects() == 100);
+	TEST_ASSERT(map.get_pool().allocated_pages() == 13);
+
+	for (int i = 0; i < 100; ++i)
+		map[i] = i;
+	TEST_ASSERT(map.get_pool().reserved_objects() == 0);
+	TEST_ASSERT(map.get_pool().allocated_pages() == 13);
+	TEST_ASSERT(map.size() == 100 && *map.find(99) == 99);
+}
@@ -0,0 +1,62 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "SizeClassAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+TEST_F(size_class_allocator_rounds_sizes_up_to_the_closest_class)
+{
+	TEST_ASSERT(SizeClassAllocator::class_index(1) == 0);
+	TEST_ASSERT(SizeClassAllocator::class_index(8) == 0);
+	TEST_ASSERT(SizeClassAllocator::class_index(9) == 1);
+	TEST_ASSERT(SizeClassAllocator::class_index(16) == 1);
+	TEST_ASSERT(SizeClassAllocator::class_index(100) == 4);
+	TEST_ASSERT(SizeClassAllocator::class_index(SizeClassAllocator::MAX_CLASS_SIZE) == SizeClassAllocator::CLASS_NUM - 1);
+	TEST_ASSERT(SizeClassAllocator::class_index(SizeClassAllocator::MAX_CLASS_SIZE + 1) == SizeClassAllocator::CLASS_NUM);
+
+	TEST_ASSERT(SizeClassAllocator::class_size(0) == 8);
+	TEST_ASSERT(SizeClassAllocator::class_size(4) == 128);
+}
+
+TEST_F(size_class_allocator_serves_each_size_from_its_own_page_allocator)
+{
+	SizeClassAllocator alloc{ 4 };
+	TEST_ASSERT(alloc.page_bytes() == 0);
+
+	auto * a = alloc.allocate(20);
+	auto * b = alloc.allocate(30);
+	auto * c = alloc.allocate(100);
+	TEST_ASSERT(alloc.owns(a));
+	TEST_ASSERT(alloc.owns(b));
+	TEST_ASSERT(alloc.owns(c));
+
+	TEST_ASSERT(alloc.get_class_allocator(2).allocated_pages() == 1);
+	TEST_ASSERT(alloc.get_class_allocator(4).allocated_pages() == 1);
+	TEST_ASSERT(alloc.page_bytes() == alloc.get_class_allocator(2).get_page_size() + alloc.get_class_allocator(4).get_page_size());
+
+	alloc.deallocate(a, 20);
+	TEST_ASSERT(alloc.allocate(32) == a);
+
+	alloc.deallocate(a, 32);
+	alloc.deallocate(b, 30);
+	alloc.deallocate(c, 100);
+}
+
+TEST_F(size_class_allocator_forwards_big_allocations_to_the_global_allocator)
+{
+	SizeClassAllocator alloc;
+
+	auto * big = alloc.allocate(SizeClassAllocator::MAX_CLASS_SIZE * 2);
+	TEST_ASSERT(big != nullptr);
+	TEST_ASSERT(alloc.owns(big) == false);
+	TEST_ASSERT(alloc.page_bytes() == 0);
+
+	alloc.deallocate(big, SizeClassAllocator::MAX_CLASS_SIZE * 2);
+}
@@ -0,0 +1,195 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "SlabAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <vector>
+
+TEST_F(slab_allocator_allocates_slabs_on_demand)
+{
+	SlabAllocator alloc{ sizeof(int), 4 };
+	TEST_ASSERT(alloc.allocated_slabs() == 0);
+
+	for (int i = 0; i < 4; ++i)
+		alloc.allocate();
+	TEST_ASSERT(alloc.allocated_slabs() == 1);
+
+	alloc.allocate();
+	TEST_ASSERT(alloc.allocated_slabs() == 2);
+}
+
+TEST_F(slab_allocator_returns_contiguous_objects_of_a_new_slab)
+{
+	SlabAllocator alloc{ sizeof(long long), 4 };
+
+	auto * a0 = reinterpret_cast<long long *>(alloc.allocate());
+	auto * a1 = reinterpret_cast<long long *>(alloc.allocate());
+	auto * a2 = reinterpret_cast<long long *>(alloc.allocate());
+
+	TEST_ASSERT(a0 + 1 == a1);
+	TEST_ASSERT(a1 + 1 == a2);
+	TEST_ASSERT(ptr_to_num(a0) % alignof(std::max_align_t) == 0);
+	TEST_ASSERT(alloc.owns(a2));
+
+	int not_owned;
+	TEST_ASSERT(alloc.owns(&not_owned) == false);
+}
+
+TEST_F(slab_allocator_reuses_the_freed_objects_of_the_slab)
+{
+	SlabAllocator alloc{ sizeof(int), 4 };
+
+	alloc.allocate();
+	auto * a1 = alloc.allocate();
+	alloc.allocate();
+
+	alloc.deallocate(a1);
+	TEST_ASSERT(alloc.allocate() == a1);
+	TEST_ASSERT(alloc.allocated_slabs() == 1);
+}
+
+TEST_F(slab_allocator_allocates_from_the_fullest_slab)
+{
+	SlabAllocator alloc{ sizeof(int), 8 };
+
+	std::vector<void *> slab0, slab1;
+	for (int i = 0; i < 8; ++i)	slab0.push_back(alloc.allocate());
+	for (int i = 0; i < 8; ++i)	slab1.push_back(alloc.allocate());
+
+	// slab0 becomes almost empty and slab1 almost full
+	for (int i = 0; i < 7; ++i)	alloc.deallocate(slab0[i]);
+	alloc.deallocate(slab1[3]);
+	alloc.deallocate(slab1[5]);
+
+	TEST_ASSERT(alloc.allocate() == slab1[3]);
+	TEST_ASSERT(alloc.allocate() == slab1[5]);
+	// slab1 is full now, the only partial slab is slab0
+	TEST_ASSERT(alloc.allocate() == slab0[0]);
+	TEST_ASSERT(alloc.allocated_slabs() == 2);
+}
+
+TEST_F(slab_allocator_caches_empty_slabs_and_releases_the_rest)
+{
+	SlabAllocator alloc{ sizeof(int), 4, 1 };
+
+	std::vector<void *> objects;
+	for (int i = 0; i < 12; ++i)
+		objects.push_back(alloc.allocate());
+	TEST_ASSERT(alloc.allocated_slabs() == 3);
+
+	for (auto * obj : objects)
+		alloc.deallocate(obj);
+
+	// one empty slab is kept to avoid allocating it again
+	TEST_ASSERT(alloc.allocated_slabs() == 1);
+	TEST_ASSERT(alloc.cached_slabs() == 1);
+
+	alloc.allocate();
+	TEST_ASSERT(alloc.allocated_slabs() == 1);
+	TEST_ASSERT(alloc.cached_slabs() == 0);
+}
+
+TEST_F(slab_allocator_can_release_the_cached_slabs)
+{
+	SlabAllocator alloc{ sizeof(int), 4, 8 };
+
+	std::vector<void *> objects;
+	for (int i = 0; i < 12; ++i)
+		objects.push_back(alloc.allocate());
+	for (auto * obj : objects)
+		alloc.deallocate(obj);
+	TEST_ASSERT(alloc.cached_slabs() == 3);
+
+	alloc.release_empty_slabs();
+	TEST_ASSERT(alloc.allocated_slabs() == 0);
+	TEST_ASSERT(alloc.cached_slabs() == 0);
+}
+
+TEST_F(slab_allocator_supports_slabs_with_many_objects)
+{
+	SlabAllocator alloc{ sizeof(int), 200 };
+
+	std::vector<void *> objects;
+	for (int i = 0; i < 200; ++i)
+		objects.push_back(alloc.allocate());
+	TEST_ASSERT(alloc.allocated_slabs() == 1);
+
+	alloc.deallocate(objects[150]);
+	TEST_ASSERT(alloc.allocate() == objects[150]);
+	TEST_ASSERT(alloc.allocate() != nullptr);
+	TEST_ASSERT(alloc.allocated_slabs() == 2);
+}
+
+TEST_F(slab_allocator_aligns_the_big_slabs_to_the_page_size)
+{
+	SlabAllocator alloc{ 1000, 20 };
+	TEST_ASSERT(alloc.get_slab_alignment() == system_page_size());
+
+	std::vector<unsigned char *> objects;
+	for (int i = 0; i < 40; ++i)
+		objects.push_back(reinterpret_cast<unsigned char *>(alloc.allocate()));
+	TEST_ASSERT(alloc.allocated_slabs() == 2);
+	for (auto * obj : objects)
+		TEST_ASSERT(alloc.owns(obj));
+
+	// the objects in the last pages of the slabs find their slab too
+	TEST_ASSERT(alloc.owns(objects[19] + 1) == false);
+	TEST_ASSERT(alloc.owns(objects[19] + 1000) == false);
+	alloc.deallocate(objects[19]);
+	alloc.deallocate(objects[39]);
+	auto * a = alloc.allocate();
+	auto * b = alloc.allocate();
+	TEST_ASSERT((a == objects[19] && b == objects[39]) || (a == objects[39] && b == objects[19]));
+	TEST_ASSERT(alloc.allocated_slabs() == 2);
+}
+
+#if MEMORY_DEBUG_ENABLED
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+
+TEST_F(debug_slab_allocator_fills_memory_with_paterns)
+{
+	constexpr size_type object_size = sizeof(char) * 16;
+	DebugSlabAllocator alloc{ object_size, 3 };
+
+	auto * mem0 = reinterpret_cast<unsigned char *>(alloc.allocate());
+	auto * mem1 = reinterpret_cast<unsigned char *>(alloc.allocate());
+	TEST_ASSERT_ALL(mem0, mem0 + object_size, == DebugPattern::ALLOCATED);
+	TEST_ASSERT_ALL(mem1 + object_size, mem1 + 2 * object_size, == DebugPattern::ACQUIRED);
+
+	alloc.deallocate(mem0);
+	// the slabs do not use the memory of the free objects
+	TEST_ASSERT_ALL(mem0, mem0 + object_size, == DebugPattern::DEALLOCATED);
+	TEST_ASSERT_ALL(mem1, mem1 + object_size, == DebugPattern::ALLOCATED);
+}
+
+#endif
+
+TEST_F(debug_slab_allocator_collects_stats_about_the_allocations)
+{
+	DebugSlabAllocator alloc{ sizeof(int), 2, 0 };
+
+	auto * a = alloc.allocate();
+	auto * b = alloc.allocate();
+	alloc.allocate();
+	auto stats = alloc.get_stats();
+	TEST_ASSERT(stats.allocated_objects == 3);
+	TEST_ASSERT(stats.acquired_slabs == 2);
+	TEST_ASSERT(stats.released_slabs == 0);
+
+	alloc.deallocate(a);
+	alloc.deallocate(b);
+	stats = alloc.get_stats();
+	TEST_ASSERT(stats.allocated_objects == 1);
+	TEST_ASSERT(stats.released_slabs == 1);
+}
+
+#endif
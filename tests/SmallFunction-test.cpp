@@ -0,0 +1,119 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "SmallFunction.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+namespace
+{
+	// the tests may run in parallel
+	thread_local size_type s_live_allocations = 0;
+
+	/// \brief	GlobalAllocator that counts its allocations.
+	struct CountingAllocator
+	{
+		static unsigned char * allocate(size_type n)
+		{
+			s_live_allocations++;
+			return GlobalAllocator<unsigned char>::allocate(n);
+		}
+		static void deallocate(unsigned char * mem, size_type n)
+		{
+			s_live_allocations--;
+			GlobalAllocator<unsigned char>::deallocate(mem, n);
+		}
+	};
+
+	using Function = SmallFunction<int(int), 2 * sizeof(void *), CountingAllocator>;
+
+	struct Big
+	{
+		int values[16];
+		int operator()(int i) const { return values[i]; }
+	};
+
+	struct BigThrowing
+	{
+		BigThrowing() = default;
+		BigThrowing(const BigThrowing &) { throw std::runtime_error{ "BigThrowing" }; }
+
+		int values[16] = {};
+		int operator()(int i) const { return values[i]; }
+	};
+
+	static_assert(std::is_nothrow_move_constructible<Function>::value, "SmallFunction needs to be moved without throwing.");
+	static_assert(std::is_nothrow_move_assignable<Function>::value, "SmallFunction needs to be moved without throwing.");
+}
+
+TEST_F(small_function_stores_the_small_callables_inline)
+{
+	int offset = 10;
+	Function f = [offset](int i) { return i + offset; };
+	TEST_ASSERT(f && f.is_heap() == false);
+	TEST_ASSERT(f(5) == 15);
+	TEST_ASSERT(s_live_allocations == 0);
+
+	f = nullptr;
+	TEST_ASSERT(!f);
+}
+
+TEST_F(small_function_allocates_the_big_callables_from_the_fallback)
+{
+	Big big;
+	for (int i = 0; i < 16; ++i)
+		big.values[i] = i * 2;
+
+	{
+		Function f = big;
+		TEST_ASSERT(f.is_heap());
+		TEST_ASSERT(s_live_allocations == 1);
+		TEST_ASSERT(f(3) == 6);
+	}
+	TEST_ASSERT(s_live_allocations == 0);
+}
+
+TEST_F(moving_a_small_function_steals_the_fallback_memory)
+{
+	Big big{};
+	big.values[1] = 42;
+	Function heap = big;
+	Function moved = std::move(heap);
+	TEST_ASSERT(!heap && moved(1) == 42);
+	TEST_ASSERT(s_live_allocations == 1);
+
+	// move only callables are moved inline
+	auto value = std::make_unique<int>(7);
+	Function inlined = [value = std::move(value)](int i) { return *value + i; };
+	moved = std::move(inlined);
+	TEST_ASSERT(!inlined && moved(1) == 8);
+	TEST_ASSERT(s_live_allocations == 0);
+}
+
+TEST_F(small_function_releases_the_fallback_memory_if_the_callable_throws)
+{
+	const BigThrowing callable;
+
+	bool thrown = false;
+	try
+	{
+		Function f = callable;
+	}
+	catch (const std::runtime_error &)
+	{
+		thrown = true;
+	}
+
+	TEST_ASSERT(thrown);
+	TEST_ASSERT(s_live_allocations == 0);
+}
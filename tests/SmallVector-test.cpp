@@ -0,0 +1,247 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "SmallVector.h"
+#include "StackAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace
+{
+	// the tests may run in parallel
+	thread_local size_type s_allocations = 0;
+	thread_local size_type s_live_allocations = 0;
+
+	/// \brief	GlobalAllocator that counts its allocations.
+	template <typename T>
+	struct CountingAllocator
+	{
+		static T * allocate(size_type n)
+		{
+			s_allocations++;
+			s_live_allocations++;
+			return GlobalAllocator<T>::allocate(n);
+		}
+		static void deallocate(T * mem, size_type n)
+		{
+			s_live_allocations--;
+			GlobalAllocator<T>::deallocate(mem, n);
+		}
+		static bool expand(T * mem, size_type old_n, size_type new_n)
+		{
+			return GlobalAllocator<T>::expand(mem, old_n, new_n);
+		}
+	};
+
+	struct Throwing
+	{
+		explicit Throwing(bool should_throw)
+		{
+			if (should_throw)
+				throw std::runtime_error{ "Throwing" };
+		}
+	};
+
+	/// \brief	Allocates from a stack of the thread, the last allocation can grow in place.
+	template <typename T>
+	struct StackFallback
+	{
+		static StackAllocator & stack()
+		{
+			thread_local StackAllocator s_stack{ 1024 };
+			return s_stack;
+		}
+
+		static T * allocate(size_type n)
+		{
+			s_allocations++;
+			s_live_allocations++;
+			return reinterpret_cast<T *>(stack().allocate(n * sizeof(T)));
+		}
+		static void deallocate(T * mem, size_type n)
+		{
+			s_live_allocations--;
+			stack().deallocate(reinterpret_cast<unsigned char *>(mem), n * sizeof(T));
+		}
+		static bool expand(T * mem, size_type old_n, size_type new_n)
+		{
+			return stack().expand(reinterpret_cast<unsigned char *>(mem), old_n * sizeof(T), new_n * sizeof(T));
+		}
+	};
+}
+
+class SmallVectorTest : public testing::TestCategory
+{
+public:
+	SmallVectorTest()
+	{
+		s_allocations = 0;
+		s_live_allocations = 0;
+	}
+};
+
+TEST(SmallVectorTest, small_vector_stores_the_first_elements_inline)
+{
+	SmallVector<int, 4, CountingAllocator<int>> v;
+	TEST_ASSERT(v.capacity() == 4 && v.empty() && v.is_inline());
+
+	for (int i = 0; i < 4; ++i)
+		v.push_back(i);
+	TEST_ASSERT(v.is_inline());
+	TEST_ASSERT(s_allocations == 0);
+	TEST_ASSERT(reinterpret_cast<unsigned char *>(v.data()) >= reinterpret_cast<unsigned char *>(&v));
+	TEST_ASSERT(reinterpret_cast<unsigned char *>(v.data()) < reinterpret_cast<unsigned char *>(&v + 1));
+
+	v.push_back(4);
+	TEST_ASSERT(v.is_inline() == false);
+	TEST_ASSERT(v.capacity() == 8);
+	TEST_ASSERT(s_allocations == 1);
+	for (int i = 0; i < 5; ++i)
+		TEST_ASSERT(v[i] == i);
+}
+
+TEST(SmallVectorTest, small_vector_goes_back_inline_when_shrunk)
+{
+	SmallVector<int, 4, CountingAllocator<int>> v{ 1, 2, 3, 4, 5, 6 };
+	TEST_ASSERT(v.is_inline() == false);
+
+	v.resize(3);
+	v.shrink_to_fit();
+	TEST_ASSERT(v.is_inline());
+	TEST_ASSERT(v.size() == 3 && v.back() == 3);
+	TEST_ASSERT(s_live_allocations == 0);
+}
+
+TEST(SmallVectorTest, moving_a_small_vector_steals_the_fallback_memory)
+{
+	SmallVector<std::unique_ptr<int>, 2, CountingAllocator<std::unique_ptr<int>>> heap;
+	for (int i = 0; i < 3; ++i)
+		heap.emplace_back(new int{ i });
+	const auto * data = heap.data();
+
+	auto stolen = std::move(heap);
+	TEST_ASSERT(stolen.data() == data);
+	TEST_ASSERT(stolen.size() == 3 && *stolen[2] == 2);
+	TEST_ASSERT(heap.empty() && heap.is_inline());
+	TEST_ASSERT(s_allocations == 1);
+
+	// the inline elements are moved one by one
+	SmallVector<std::unique_ptr<int>, 2, CountingAllocator<std::unique_ptr<int>>> inlined;
+	inlined.emplace_back(new int{ 7 });
+	heap = std::move(inlined);
+	TEST_ASSERT(heap.is_inline() && heap.size() == 1 && *heap[0] == 7);
+	TEST_ASSERT(inlined.empty());
+
+	stolen = std::move(heap);
+	TEST_ASSERT(stolen.size() == 1 && *stolen[0] == 7);
+	TEST_ASSERT(s_live_allocations == 0);
+}
+
+TEST(SmallVectorTest, small_vector_can_insert_and_erase_elements)
+{
+	SmallVector<int, 4, CountingAllocator<int>> v{ 1, 3 };
+	v.insert(v.begin() + 1, 2);
+	v.insert(v.end(), 4);
+	v.insert(v.begin(), 0);
+	TEST_ASSERT(v.size() == 5);
+	for (int i = 0; i < 5; ++i)
+		TEST_ASSERT(v[i] == i);
+
+	v.erase(v.begin());
+	v.erase(v.begin() + 2);
+	const SmallVector<int, 4> expected{ 1, 2, 4 };
+	TEST_ASSERT(v == expected);
+}
+
+TEST(SmallVectorTest, small_vector_copies_the_elements)
+{
+	SmallVector<int, 2, CountingAllocator<int>> a{ 1, 2, 3 };
+	auto b = a;
+	TEST_ASSERT(a == b);
+	TEST_ASSERT(b.data() != a.data());
+
+	b.clear();
+	b = a;
+	TEST_ASSERT(a == b);
+	TEST_ASSERT(s_allocations == 2);
+}
+
+TEST(SmallVectorTest, small_vector_grows_the_fallback_memory_in_place)
+{
+	SmallVector<int, 2, StackFallback<int>> v{ 1, 2, 3 };
+	const auto * data = v.data();
+	TEST_ASSERT(v.capacity() == 4 && s_allocations == 1);
+
+	for (int i = 4; i <= 20; ++i)
+		v.push_back(i);
+	TEST_ASSERT(v.data() == data && v.capacity() == 32);
+	TEST_ASSERT(s_allocations == 1);
+
+	v.resize(10);
+	v.shrink_to_fit();
+	TEST_ASSERT(v.data() == data && v.capacity() == 10);
+	for (int i = 0; i < 10; ++i)
+		TEST_ASSERT(v[i] == i + 1);
+}
+
+TEST(SmallVectorTest, small_vector_can_push_back_its_own_elements)
+{
+	SmallVector<int, 2, CountingAllocator<int>> v{ 1, 2, 3, 4 };
+	TEST_ASSERT(v.size() == v.capacity());
+
+	// the argument lives in the buffer that is released when growing
+	v.push_back(v[0]);
+	TEST_ASSERT(v.size() == 5 && v[4] == 1);
+
+	SmallVector<std::string, 1, CountingAllocator<std::string>> strings{ "a long string that is not stored inline" };
+	strings.push_back(strings.back());
+	strings.emplace_back(std::move(strings[0]));
+	TEST_ASSERT(strings.size() == 3);
+	TEST_ASSERT(strings[1] == strings[2] && strings[2] == "a long string that is not stored inline");
+}
+
+TEST(SmallVectorTest, small_vector_releases_the_new_memory_if_the_element_throws)
+{
+	SmallVector<Throwing, 1, CountingAllocator<Throwing>> v;
+	v.emplace_back(false);
+
+	bool thrown = false;
+	try
+	{
+		v.emplace_back(true);
+	}
+	catch (const std::runtime_error &)
+	{
+		thrown = true;
+	}
+
+	TEST_ASSERT(thrown);
+	TEST_ASSERT(v.size() == 1 && v.is_inline());
+	TEST_ASSERT(s_allocations == 1 && s_live_allocations == 0);
+}
+
+namespace
+{
+	struct ThrowingMove
+	{
+		ThrowingMove() = default;
+		ThrowingMove(ThrowingMove &&) {}
+		ThrowingMove & operator=(ThrowingMove &&) { return *this; }
+	};
+
+	// the containers of SmallVectors can move them when they grow
+	static_assert(std::is_nothrow_move_constructible<SmallVector<int, 2>>::value, "SmallVector needs to be moved without throwing.");
+	static_assert(std::is_nothrow_move_assignable<SmallVector<std::string, 2>>::value, "SmallVector needs to be moved without throwing.");
+	static_assert(!std::is_nothrow_move_constructible<SmallVector<ThrowingMove, 2>>::value, "SmallVector can only be moved without throwing if T can.");
+}
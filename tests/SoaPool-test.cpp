@@ -0,0 +1,118 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "SoaPool.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <string>
+
+TEST_F(soa_pool_stores_the_fields_in_parallel_arrays)
+{
+	SoaPool<float, int, std::string> pool{ 4 };
+
+	const auto a = pool.allocate(1.f, 10, "a");
+	const auto b = pool.allocate(2.f, 20, "b");
+	TEST_ASSERT(a == 0 && b == 1);
+	TEST_ASSERT(pool.size() == 2);
+
+	TEST_ASSERT(pool.get<0>(a) == 1.f);
+	TEST_ASSERT(pool.get<1>(a) == 10);
+	TEST_ASSERT(pool.get<2>(a) == "a");
+	TEST_ASSERT(pool.get<2>(b) == "b");
+
+	// consecutive objects are consecutive in each column
+	TEST_ASSERT(&pool.get<0>(b) == &pool.get<0>(a) + 1);
+	TEST_ASSERT(&pool.get<1>(b) == &pool.get<1>(a) + 1);
+
+	const auto c = pool.allocate();
+	TEST_ASSERT(pool.get<1>(c) == 0);
+	TEST_ASSERT(pool.get<2>(c).empty());
+}
+
+TEST_F(soa_pool_columns_are_aligned_for_simd)
+{
+	using Pool = SoaPool<char, double, short>;
+	Pool pool{ 7 };
+	for (int i = 0; i < 20; ++i)
+		pool.allocate();
+
+	TEST_ASSERT(pool.allocated_pages() == 3);
+	for (size_type page = 0; page < pool.allocated_pages(); ++page)
+	{
+		TEST_ASSERT(ptr_to_num(pool.column<0>(page)) % Pool::COLUMN_ALIGNMENT == 0);
+		TEST_ASSERT(ptr_to_num(pool.column<1>(page)) % Pool::COLUMN_ALIGNMENT == 0);
+		TEST_ASSERT(ptr_to_num(pool.column<2>(page)) % Pool::COLUMN_ALIGNMENT == 0);
+	}
+}
+
+TEST_F(soa_pool_moves_the_last_object_to_the_removed_index)
+{
+	SoaPool<int, std::string> pool{ 2 };
+	for (int i = 0; i < 5; ++i)
+		pool.allocate(i, std::to_string(i));
+
+	TEST_ASSERT(pool.deallocate(1) == 4);
+	TEST_ASSERT(pool.size() == 4);
+	TEST_ASSERT(pool.get<0>(1) == 4);
+	TEST_ASSERT(pool.get<1>(1) == "4");
+
+	// removing the last one does not move anything
+	TEST_ASSERT(pool.deallocate(3) == 3);
+	TEST_ASSERT(pool.size() == 3);
+	TEST_ASSERT(pool.get<0>(0) == 0 && pool.get<0>(1) == 4 && pool.get<0>(2) == 2);
+}
+
+TEST_F(soa_pool_visits_the_columns_of_the_used_pages)
+{
+	SoaPool<float, int> pool{ 8 };
+	for (int i = 0; i < 20; ++i)
+		pool.allocate(1.f, i);
+
+	size_type visited = 0;
+	pool.for_each_column<0>([&](float * values, size_type count)
+	{
+		for (size_type i = 0; i < count; ++i)
+			values[i] *= 2.f;
+		visited += count;
+	});
+	TEST_ASSERT(visited == 20);
+	TEST_ASSERT(pool.page_object_count(2) == 4);
+	for (size_type i = 0; i < pool.size(); ++i)
+		TEST_ASSERT(pool.get<0>(i) == 2.f);
+}
+
+TEST_F(soa_pool_releases_the_pages_without_objects)
+{
+	static int alive = 0;
+	struct Counted
+	{
+		Counted() { alive++; }
+		Counted(const Counted &) { alive++; }
+		Counted & operator=(const Counted &) = default;
+		~Counted() { alive--; }
+	};
+
+	{
+		SoaPool<Counted, int> pool{ 4 };
+		for (int i = 0; i < 10; ++i)
+			pool.allocate();
+		TEST_ASSERT(alive == 10);
+
+		while (pool.size() > 3)
+			pool.deallocate(0);
+		TEST_ASSERT(alive == 3);
+		TEST_ASSERT(pool.allocated_pages() == 3);
+
+		pool.shrink_to_fit();
+		TEST_ASSERT(pool.allocated_pages() == 1);
+		TEST_ASSERT(pool.capacity() == 4);
+	}
+	TEST_ASSERT(alive == 0);
+}
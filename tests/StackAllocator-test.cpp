@@ -7,9 +7,11 @@ found in the top-level directory of this distribution.
 */
 
 
-#include "testing\testing.h"
+#include "testing/testing.h"
 
 #include "StackAllocator.h"
+
+#include <vector>
 using namespace memory;	// avoid verbosity on tests
 
 // StackAllocator
@@ -73,6 +75,40 @@ TEST(StackAllocatorTest, stack_allocator_retunrs_null_when_cannot_allocated_the_
 	TEST_ASSERT(alloc.allocate(2) != nullptr);
 }
 
+TEST(StackAllocatorTest, stack_allocator_can_resize_the_allocation_at_the_top)
+{
+	auto * a = alloc.allocate(4);
+	auto * b = alloc.allocate(4);
+
+	// only the top can change its size
+	TEST_ASSERT(alloc.expand(a, 4, 6) == false);
+	TEST_ASSERT(alloc.expand(b, 4, 10));
+	TEST_ASSERT(alloc.free_size() == 2);
+	TEST_ASSERT(alloc.reallocate(b, 10, 13) == nullptr);
+
+	TEST_ASSERT(alloc.reallocate(b, 10, 2) == b);
+	TEST_ASSERT(alloc.free_size() == 10);
+	TEST_ASSERT(alloc.allocate(1) == b + 2);
+}
+
+#if MEMORY_ASAN_ENABLED
+
+TEST_F(stack_allocator_poisons_the_memory_above_the_top)
+{
+	StackAllocator alloc{ 64 };
+	auto * a = alloc.allocate(16);
+	TEST_ASSERT(__asan_address_is_poisoned(a + 15) == 0);
+	TEST_ASSERT(__asan_address_is_poisoned(a + 16));
+
+	TEST_ASSERT(alloc.expand(a, 16, 32));
+	TEST_ASSERT(__asan_address_is_poisoned(a + 31) == 0);
+
+	alloc.deallocate(a, 32);
+	TEST_ASSERT(__asan_address_is_poisoned(a));
+}
+
+#endif
+
 
 // DebugStackAllocator
 
@@ -85,6 +121,7 @@ TEST_F(debug_stack_allocator_generates_statistics)
 	auto * a = alloc.allocate(8);
 	auto * b = alloc.allocate(4);
 	auto * c = alloc.allocate(3);
+	TEST_ASSERT(b == a + 8 && c == b + 4);
 	alloc.allocate(100);
 	alloc.deallocate(c, 3);
 
@@ -102,6 +139,41 @@ TEST_F(debug_stack_allocator_generates_statistics)
 	TEST_ASSERT(stats.per_allocation_stats[2].offset == 12);
 }
 
+TEST_F(debug_stack_allocator_tracks_the_resized_allocations)
+{
+	DebugStackAllocator alloc{ 16 };
+
+	auto * a = alloc.allocate(4);
+	TEST_ASSERT(alloc.expand(a, 4, 8));
+	TEST_ASSERT(alloc.get_stats().per_allocation_stats.back().size == 8);
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+	TEST_ASSERT_ALL(a, a + 8, == DebugPattern::ALLOCATED);
+#endif
+
+	TEST_ASSERT(alloc.expand(a, 8, 2));
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+	TEST_ASSERT_ALL(a + 2, a + 8, == DebugPattern::DEALLOCATED);
+#endif
+}
+
+TEST_F(debug_stack_allocator_updates_the_record_of_the_expanded_allocation)
+{
+	DebugStackAllocator alloc{ 32 };
+
+	auto * a = alloc.allocate(4);
+	auto * b = alloc.allocate(4);
+	alloc.deallocate(b, 4);
+	TEST_ASSERT(alloc.expand(a, 4, 12));
+
+	// b is still the last record, a is the one that changes
+	const auto & records = alloc.get_stats().per_allocation_stats;
+	TEST_ASSERT(records.size() == 2);
+	TEST_ASSERT(records[0].offset == 0 && records[0].size == 12);
+	TEST_ASSERT(records[1].offset == 4 && records[1].size == 4);
+}
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+
 TEST_F(debug_stack_allocator_fills_the_memory_with_patternss)
 {
 	DebugStackAllocator alloc{ 16 };
@@ -128,4 +200,48 @@ TEST_F(debug_stack_allocator_fills_the_memory_with_patternss)
 					== DebugPattern::ACQUIRED);
 }
 
+TEST_F(debug_stack_allocator_verifies_the_memory_above_the_top)
+{
+	std::vector<PatternCorruption> corruptions;
+	set_corruption_callback([&](const PatternCorruption & corruption) { corruptions.push_back(corruption); });
+
+	DebugStackAllocator alloc{ 32 };
+	auto * a = alloc.allocate(8);
+	auto * b = alloc.allocate(8);
+	TEST_ASSERT(alloc.verify_heap());
+
+	// write after the deallocation and past the memory ever used
+	alloc.deallocate(b, 8);
+	b[2] = 0;
+	a[20] = 0;
+	TEST_ASSERT(alloc.verify_heap() == false);
+	TEST_ASSERT(corruptions.size() == 2);
+	TEST_ASSERT(corruptions[0].address == b + 2 && corruptions[0].expected == DebugPattern::DEALLOCATED);
+	TEST_ASSERT(corruptions[1].address == a + 20 && corruptions[1].expected == DebugPattern::ACQUIRED);
+
+	// also found when the memory is allocated again
+	corruptions.clear();
+	alloc.allocate(8);
+	TEST_ASSERT(corruptions.size() == 1 && corruptions[0].address == b + 2);
+	set_corruption_callback(nullptr);
+}
+
+TEST_F(debug_stack_allocator_can_defer_the_fills_of_the_deallocated_memory)
+{
+	DebugStackAllocator alloc{ 32 };
+	alloc.defer_fills(true);
+
+	auto * a = alloc.allocate(16);
+	alloc.deallocate(a, 16);
+	TEST_ASSERT_ALL(a, a + 16, == DebugPattern::ALLOCATED);
+
+	// the beginning is reused, only the rest is filled
+	auto * b = alloc.allocate(4);
+	TEST_ASSERT(alloc.verify_heap());
+	TEST_ASSERT_ALL(b, b + 4, == DebugPattern::ALLOCATED);
+	TEST_ASSERT_ALL(a + 4, a + 16, == DebugPattern::DEALLOCATED);
+}
+
+#endif
+
 #endif
@@ -0,0 +1,138 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "ThreadCachedAllocator.h"
+
+#include "testing/testing.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+TEST_F(thread_cached_allocator_frees_without_the_size)
+{
+	auto * small = ThreadCachedAllocator::allocate(40);
+	auto * big = ThreadCachedAllocator::allocate(100 * 1024);
+	TEST_ASSERT(ThreadCachedAllocator::owns(small));
+	TEST_ASSERT(ThreadCachedAllocator::owns(big));
+	TEST_ASSERT(ThreadCachedAllocator::usable_size(small) == 64);
+	TEST_ASSERT(ThreadCachedAllocator::usable_size(big) >= 100 * 1024);
+
+	ThreadCachedAllocator::deallocate(small);
+	ThreadCachedAllocator::deallocate(big);
+	ThreadCachedAllocator::deallocate(nullptr);
+}
+
+TEST_F(thread_cached_allocator_aligns_the_allocations)
+{
+	for (size_type alignment = 8; alignment <= 16 * PageMapAllocator::SPAN_SIZE; alignment *= 4)
+	{
+		auto * mem = ThreadCachedAllocator::allocate_aligned(24, alignment);
+		TEST_ASSERT(ptr_to_num(mem) % alignment == 0);
+		ThreadCachedAllocator::deallocate(mem);
+	}
+}
+
+TEST_F(thread_cached_allocator_keeps_a_bounded_cache_per_thread)
+{
+	std::thread worker{ []
+	{
+		const auto batch = ThreadCachedAllocator::batch_size(SizeClassAllocator::class_index(32));
+		TEST_ASSERT(ThreadCachedAllocator::thread_cached_objects() == 0);
+
+		auto * first = ThreadCachedAllocator::allocate(32);
+		TEST_ASSERT(ThreadCachedAllocator::thread_cached_objects() == batch - 1);
+
+		std::vector<void *> objects;
+		for (size_type i = 0; i < 4 * batch; ++i)
+			objects.push_back(ThreadCachedAllocator::allocate(32));
+		for (auto * obj : objects)
+			ThreadCachedAllocator::sized_free(obj, 32);
+		TEST_ASSERT(ThreadCachedAllocator::thread_cached_objects() <= 2 * batch);
+
+		ThreadCachedAllocator::deallocate(first);
+		ThreadCachedAllocator::flush_thread_cache();
+		TEST_ASSERT(ThreadCachedAllocator::thread_cached_objects() == 0);
+	} };
+	worker.join();
+}
+
+TEST_F(thread_cached_allocator_frees_memory_of_other_threads)
+{
+	constexpr size_type objects_per_thread = 2000;
+	std::vector<void *> objects[4];
+
+	std::vector<std::thread> producers;
+	for (auto & thread_objects : objects)
+	{
+		producers.emplace_back([&thread_objects]
+		{
+			for (size_type i = 0; i < objects_per_thread; ++i)
+			{
+				auto * mem = reinterpret_cast<unsigned char *>(ThreadCachedAllocator::allocate(8 + i % 200));
+				mem[0] = static_cast<unsigned char>(i);
+				thread_objects.push_back(mem);
+			}
+		});
+	}
+	for (auto & producer : producers)
+		producer.join();
+
+	// the producers are gone, their caches were given back
+	std::thread consumer{ [&]
+	{
+		for (auto & thread_objects : objects)
+		{
+			for (size_type i = 0; i < thread_objects.size(); ++i)
+			{
+				TEST_ASSERT(reinterpret_cast<unsigned char *>(thread_objects[i])[0] == static_cast<unsigned char>(i));
+				ThreadCachedAllocator::deallocate(thread_objects[i]);
+			}
+		}
+	} };
+	consumer.join();
+}
+
+#if !defined(_WIN32)
+
+TEST_F(thread_cached_allocator_can_be_used_after_fork_while_other_threads_allocate)
+{
+	std::atomic<bool> stop{ false };
+	std::thread allocating{ [&]
+	{
+		// big allocations take the lock of the central allocator every time
+		while (!stop)
+			ThreadCachedAllocator::deallocate(ThreadCachedAllocator::allocate(2 * PageMapAllocator::SPAN_SIZE));
+	} };
+	TEST_ON_EXIT(){ stop = true; allocating.join(); };
+
+	for (int i = 0; i < 20; ++i)
+	{
+		const auto pid = fork();
+		TEST_ASSERT(pid >= 0);
+		if (pid == 0)
+		{
+			// only this thread exists in the child, the lock was not left held by the other one
+			auto * mem = ThreadCachedAllocator::allocate(2 * PageMapAllocator::SPAN_SIZE);
+			ThreadCachedAllocator::deallocate(mem);
+			_exit(mem != nullptr ? 0 : 1);
+		}
+
+		int status = 0;
+		TEST_ASSERT(waitpid(pid, &status, 0) == pid);
+		TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+}
+
+#endif
@@ -0,0 +1,233 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+
+#include "testing/testing.h"
+
+#include "TlsfAllocator.h"
+#include "FallbackAllocator.h"
+#include "GlobalAllocator.h"
+using namespace memory;	// avoid verbosity on tests
+
+#include <algorithm>	// std::shuffle
+#include <random>
+#include <vector>
+
+// TlsfAllocator
+
+class TlsfAllocatorTest : public testing::TestCategory
+{
+public:
+	static constexpr size_type BYTES = 4096;
+	TlsfAllocator alloc{ BYTES };
+
+	/// \brief	Free memory when there are no allocations: the whole chunk minus the first and last headers.
+	static constexpr size_type EMPTY_FREE_SIZE = BYTES - 2 * TlsfAllocator::BLOCK_OVERHEAD;
+};
+
+TEST(TlsfAllocatorTest, tlsf_allocator_returns_aligned_memory)
+{
+	for (size_type bytes = 1; bytes < 100; bytes += 7)
+	{
+		auto * mem = alloc.allocate(bytes);
+		TEST_ASSERT(mem != nullptr);
+		TEST_ASSERT(ptr_to_num(mem) % TlsfAllocator::ALIGNMENT == 0);
+		TEST_ASSERT(alloc.usable_size(mem) >= bytes);
+		TEST_ASSERT(alloc.owns(mem));
+	}
+
+	unsigned char not_owned;
+	TEST_ASSERT(alloc.owns(&not_owned) == false);
+}
+
+TEST(TlsfAllocatorTest, tlsf_allocator_splits_the_free_blocks)
+{
+	TEST_ASSERT(alloc.free_size() == EMPTY_FREE_SIZE);
+
+	auto * a = alloc.allocate(64);
+	auto * b = alloc.allocate(64);
+
+	// b is right after a and its header
+	TEST_ASSERT(b == a + 64 + TlsfAllocator::BLOCK_OVERHEAD);
+	TEST_ASSERT(alloc.free_size() == EMPTY_FREE_SIZE - 2 * (64 + TlsfAllocator::BLOCK_OVERHEAD));
+}
+
+TEST(TlsfAllocatorTest, tlsf_allocator_merges_the_neighbours_on_deallocation)
+{
+	auto * a = alloc.allocate(64);
+	auto * b = alloc.allocate(64);
+	auto * c = alloc.allocate(64);
+	alloc.allocate(64);
+
+	// merge with the next one
+	alloc.deallocate(b, 64);
+	alloc.deallocate(a, 64);
+	// merge with the previous one
+	alloc.deallocate(c, 64);
+
+	// the three blocks are a single one now
+	auto * merged = alloc.allocate(3 * 64 + 2 * TlsfAllocator::BLOCK_OVERHEAD);
+	TEST_ASSERT(merged == a);
+}
+
+TEST(TlsfAllocatorTest, tlsf_allocator_gets_back_to_a_single_block_after_deallocating_everything)
+{
+	std::vector<std::pair<unsigned char *, size_type>> allocations;
+	std::mt19937 rng{ 42 };
+	std::uniform_int_distribution<size_type> sizes{ 1, 200 };
+
+	while (true)
+	{
+		const auto bytes = sizes(rng);
+		auto * mem = alloc.allocate(bytes);
+		if (mem == nullptr)	break;
+		allocations.emplace_back(mem, bytes);
+	}
+
+	std::shuffle(allocations.begin(), allocations.end(), rng);
+	for (const auto & allocation : allocations)
+		alloc.deallocate(allocation.first, allocation.second);
+
+	TEST_ASSERT(alloc.free_size() == EMPTY_FREE_SIZE);
+
+	// good fit: the size is rounded up to the next list so that any block in it is big enough,
+	// asking for exactly the size of the only block is not guaranteed to succeed
+	auto * all = alloc.allocate(alloc.max_allocation_size());
+	TEST_ASSERT(all != nullptr);
+	TEST_ASSERT(alloc.free_size() < 256);
+}
+
+TEST(TlsfAllocatorTest, tlsf_allocator_returns_null_when_cannot_allocate_the_requested_size)
+{
+	TEST_ASSERT(alloc.allocate(BYTES) == nullptr);
+	TEST_ASSERT(alloc.allocate(~size_type{ 0u }) == nullptr);
+
+	const auto max_size = alloc.max_allocation_size();
+	TEST_ASSERT(max_size > 0 && max_size <= alloc.free_size());
+	TEST_ASSERT(alloc.allocate(max_size) != nullptr);
+}
+
+TEST(TlsfAllocatorTest, tlsf_allocator_expands_allocations_into_the_next_free_block)
+{
+	auto * a = alloc.allocate(64);
+	auto * b = alloc.allocate(64);
+	auto * c = alloc.allocate(64);
+
+	TEST_ASSERT(alloc.expand(a, 64, 128) == false);
+
+	alloc.deallocate(b, 64);
+	TEST_ASSERT(alloc.expand(a, 64, 100));
+	TEST_ASSERT(alloc.usable_size(a) >= 100);
+
+	// the rest of the block of b is still free, it can be allocated
+	auto * d = alloc.allocate(16);
+	TEST_ASSERT(d > a && d < c);
+	alloc.deallocate(d, 16);
+
+	// all the memory after c is free
+	TEST_ASSERT(alloc.reallocate(c, 64, 2048) == c);
+	TEST_ASSERT(alloc.usable_size(c) >= 2048);
+
+	// shrinking gives the end of the block back, merged with the free memory after it
+	const auto free_size = alloc.free_size();
+	TEST_ASSERT(alloc.expand(c, 2048, 64));
+	TEST_ASSERT(alloc.free_size() > free_size + 1024);
+	TEST_ASSERT(alloc.max_allocation_size() > 2048);
+
+	alloc.deallocate(a, 100);
+	alloc.deallocate(c, 64);
+	TEST_ASSERT(alloc.free_size() == EMPTY_FREE_SIZE);
+}
+
+TEST(TlsfAllocatorTest, tlsf_allocator_reallocate_moves_the_memory_when_it_cant_expand)
+{
+	auto * a = alloc.allocate(64);
+	alloc.allocate(64);
+	std::memset(a, 7, 64);
+
+	auto * b = alloc.reallocate(a, 64, 256);
+	TEST_ASSERT(b != a && b != nullptr);
+	TEST_ASSERT_ALL(b, b + 64, == 7);
+	TEST_ASSERT(alloc.reallocate(b, 256, BYTES) == nullptr);
+}
+
+TEST_F(tlsf_allocator_can_be_used_as_primary_allocator_of_a_fallback_allocator)
+{
+	FallbackAllocator<
+		FixedTlsfAllocator<256, int>,
+		GlobalAllocator<int>
+	> fallback_alloc;
+
+	auto * small = fallback_alloc.allocate(4);
+	auto * big = fallback_alloc.allocate(1024);
+
+	TEST_ASSERT(fallback_alloc.get_primary().owns(small));
+	TEST_ASSERT(fallback_alloc.get_primary().owns(big) == false);
+
+	fallback_alloc.deallocate(small, 4);
+	fallback_alloc.deallocate(big, 1024);
+}
+
+// DebugTlsfAllocator
+
+#if MEMORY_DEBUG_ENABLED
+
+TEST_F(debug_tlsf_allocator_generates_statistics)
+{
+	DebugTlsfAllocator alloc{ 1024 };
+
+	auto * a = alloc.allocate(100);
+	alloc.allocate(64);
+	alloc.allocate(2048);
+	alloc.deallocate(a, 100);
+
+	const auto & stats = alloc.get_stats();
+	TEST_ASSERT(stats.allocations == 2);
+	TEST_ASSERT(stats.deallocations == 1);
+	TEST_ASSERT(stats.failures == 1);
+}
+
+#if MEMORY_ENABLE_DEBUG_PATTERNS
+
+TEST_F(debug_tlsf_allocator_fills_the_memory_with_patterns)
+{
+	DebugTlsfAllocator alloc{ 1024 };
+
+	auto * a = alloc.allocate(100);
+	const auto usable = alloc.usable_size(a);
+	TEST_ASSERT_ALL(a, a + 100, == DebugPattern::ALLOCATED);
+	TEST_ASSERT_ALL(a + 100, a + usable, == DebugPattern::PADDING);
+
+	alloc.allocate(16);	// avoid merging a with the rest of the memory
+	alloc.deallocate(a, 100);
+	TEST_ASSERT_ALL(a + TlsfAllocator::MIN_BLOCK_SIZE, a + usable, == DebugPattern::DEALLOCATED);
+}
+
+TEST_F(debug_tlsf_allocator_verifies_the_padding)
+{
+	std::vector<PatternCorruption> corruptions;
+	set_corruption_callback([&](const PatternCorruption & corruption) { corruptions.push_back(corruption); });
+
+	DebugTlsfAllocator alloc{ 1024 };
+	auto * a = alloc.allocate(20);
+	auto * b = alloc.allocate(20);
+	TEST_ASSERT(alloc.usable_size(a) > 20);
+
+	alloc.deallocate(b, 20);
+	TEST_ASSERT(corruptions.empty());
+
+	a[20] = 0;
+	alloc.reallocate(a, 20, 40);
+	TEST_ASSERT(corruptions.size() == 1 && corruptions[0].address == a + 20);
+	set_corruption_callback(nullptr);
+}
+
+#endif
+
+
+#endif
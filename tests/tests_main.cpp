@@ -9,19 +9,61 @@ found in the top-level directory of this distribution.
 
 #include "testing/testing.h"
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-int main()
+///	usage: tests [--filter=<text>] [--benchmark[=<iterations>]] [--threads=<n>] [--shard=<index>/<count>] [--quiet]
+int main(int argc, char ** argv)
 {
 	testing::TestingConfig config;
 	config.m_abort_on_failure = false;
 	config.m_verbose = true;
 
+	for (int i = 1; i < argc; ++i)
+	{
+		const char * arg = argv[i];
+		if (std::strncmp(arg, "--filter=", 9) == 0)
+			config.m_filter = arg + 9;
+		else if (std::strcmp(arg, "--benchmark") == 0)
+			config.m_benchmark = true;
+		else if (std::strncmp(arg, "--benchmark=", 12) == 0)
+		{
+			config.m_benchmark = true;
+			config.m_benchmark_iterations = static_cast<unsigned>(std::strtoul(arg + 12, nullptr, 10));
+		}
+		else if (std::strncmp(arg, "--threads=", 10) == 0)
+			config.m_thread_count = static_cast<unsigned>(std::strtoul(arg + 10, nullptr, 10));
+		else if (std::strncmp(arg, "--shard=", 8) == 0)
+		{
+			// --shard=<index>/<count>
+			char * count = nullptr;
+			config.m_shard_index = static_cast<unsigned>(std::strtoul(arg + 8, &count, 10));
+			config.m_shard_count = *count == '/' ? static_cast<unsigned>(std::strtoul(count + 1, nullptr, 10)) : 0;
+			if (config.m_shard_count == 0 || config.m_shard_index >= config.m_shard_count)
+			{
+				std::cerr << "Invalid shard " << arg + 8 << ", expected <index>/<count>\n";
+				return 1;
+			}
+		}
+		else if (std::strcmp(arg, "--quiet") == 0)
+			config.m_verbose = false;
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--filter=<text>] [--benchmark[=<iterations>]]"
+				<< " [--threads=<n>] [--shard=<index>/<count>] [--quiet]\n";
+			return 1;
+		}
+	}
+
 	if (testing::run_all_tests(config) == false)
 	{
+#if defined(_WIN32)
+		// keep the console open when launched from Visual Studio
 		std::cin.get();
+#endif
+		return 1;
 	}
 
 	return 0;
 }
-
@@ -0,0 +1,66 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#include "ProcessStats.h"
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN 1
+#	include <Windows.h>
+#	include <Psapi.h>
+#	pragma comment(lib, "psapi.lib")
+#elif defined(__linux__) || defined(__APPLE__)
+#	include <sys/resource.h>
+#	include <unistd.h>
+#	include <cstdio>
+#endif
+
+namespace tools
+{
+	size_type peak_rss_bytes()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize;
+		return 0;
+#elif defined(__linux__) || defined(__APPLE__)
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#	if defined(__APPLE__)
+		return static_cast<size_type>(usage.ru_maxrss);			// bytes
+#	else
+		return static_cast<size_type>(usage.ru_maxrss) * 1024;	// kilobytes
+#	endif
+#else
+		return 0;
+#endif
+	}
+
+	size_type current_rss_bytes()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.WorkingSetSize;
+		return 0;
+#elif defined(__linux__)
+		size_type rss_pages = 0;
+		if (FILE * statm = std::fopen("/proc/self/statm", "r"))
+		{
+			size_type total_pages = 0;
+			if (std::fscanf(statm, "%zu %zu", &total_pages, &rss_pages) != 2)
+				rss_pages = 0;
+			std::fclose(statm);
+		}
+		return rss_pages * static_cast<size_type>(sysconf(_SC_PAGESIZE));
+#else
+		return 0;
+#endif
+	}
+}
@@ -0,0 +1,21 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+#pragma once
+
+#include "MemoryCore.h"
+
+namespace tools
+{
+	using memory::size_type;
+
+	/// \brief	Maximum resident set size the process has had, 0 if the platform can't report it.
+	size_type peak_rss_bytes();
+	/// \brief	Current resident set size of the process, 0 if the platform can't report it.
+	size_type current_rss_bytes();
+}
@@ -0,0 +1,528 @@
+/*!
+\author Borja Portugal Martin
+GitHub: https://github.com/borjaportugal
+
+This file is subject to the license terms in the LICENSE file
+found in the top-level directory of this distribution.
+*/
+
+/// Replays a trace captured with memory::TraceRecorder against one or all of the allocators
+/// and reports throughput, peak RSS and fragmentation of each of them.
+///
+///	usage: trace_replay <trace file> [malloc|page|stack|inline|size_class|page_map|buddy|tlsf|all]
+///
+/// The events are replayed in the order they were recorded from a single thread.
+/// Each allocator is replayed in its own process where the platform can fork.
+
+#include "AllocationTrace.h"
+#include "BuddyAllocator.h"
+#include "InlineAllocator.h"
+#include "PageAllocator.h"
+#include "PageMapAllocator.h"
+#include "SizeClassAllocator.h"
+#include "StackAllocator.h"
+#include "TlsfAllocator.h"
+
+#include "ProcessStats.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GLIBC__)
+#	include <malloc.h>	// malloc_usable_size, malloc_trim
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+#	include <sys/wait.h>
+#	include <unistd.h>
+#endif
+
+using namespace memory;
+
+namespace
+{
+	/// \brief	Common interface of all the allocators we can replay a trace on.
+	class ReplayTarget
+	{
+	public:
+		virtual ~ReplayTarget() = default;
+
+		virtual void * allocate(size_type bytes) = 0;
+		virtual void deallocate(void * mem, size_type bytes) = 0;
+
+		/// \brief	Bytes the allocator is holding at the moment (used and unused).
+		virtual size_type footprint() const = 0;
+	};
+
+	class MallocTarget : public ReplayTarget
+	{
+	public:
+		void * allocate(size_type bytes) override
+		{
+			auto * mem = std::malloc(bytes);
+			m_footprint += usable_size(mem, bytes);
+			return mem;
+		}
+		void deallocate(void * mem, size_type bytes) override
+		{
+			m_footprint -= usable_size(mem, bytes);
+			std::free(mem);
+		}
+		size_type footprint() const override { return m_footprint; }
+
+	private:
+		static size_type usable_size(void * mem, size_type bytes)
+		{
+#if defined(__GLIBC__)
+			(void)bytes;
+			return malloc_usable_size(mem);
+#else
+			(void)mem;
+			return bytes;
+#endif
+		}
+
+		size_type m_footprint{ 0u };
+	};
+
+	/// \brief	All the objects have the size of the biggest allocation in the trace.
+	class PageTarget : public ReplayTarget
+	{
+	public:
+		explicit PageTarget(size_type object_size)
+			: m_alloc{ object_size, 256, false }
+		{}
+
+		void * allocate(size_type) override { return m_alloc.allocate(); }
+		void deallocate(void * mem, size_type) override { m_alloc.deallocate(mem); }
+		size_type footprint() const override
+		{
+			return m_alloc.allocated_pages() * m_alloc.get_page_size();
+		}
+
+	private:
+		PageAllocator m_alloc;
+	};
+
+	/// \brief	Deallocations that are not on the top of the stack are delayed until
+	///			all the allocations above them have been deallocated.
+	class StackTarget : public ReplayTarget
+	{
+		struct Allocation
+		{
+			unsigned char * mem;
+			size_type bytes;
+			bool freed;
+		};
+
+	public:
+		explicit StackTarget(size_type bytes)
+			: m_alloc{ bytes }
+			, m_capacity{ bytes }
+		{}
+
+		void * allocate(size_type bytes) override
+		{
+			auto * mem = m_alloc.allocate(bytes);
+			if (mem)
+				m_allocations.push_back(Allocation{ mem, bytes, false });
+			return mem;
+		}
+		void deallocate(void * mem, size_type) override
+		{
+			for (auto it = m_allocations.rbegin(); it != m_allocations.rend(); ++it)
+			{
+				if (it->mem == mem)
+				{
+					it->freed = true;
+					break;
+				}
+			}
+
+			while (!m_allocations.empty() && m_allocations.back().freed)
+			{
+				m_alloc.deallocate(m_allocations.back().mem, m_allocations.back().bytes);
+				m_allocations.pop_back();
+			}
+		}
+		size_type footprint() const override { return m_capacity - m_alloc.free_size(); }
+
+	private:
+		StackAllocator m_alloc;
+		size_type m_capacity{ 0u };
+		std::vector<Allocation> m_allocations;
+	};
+
+	class InlineTarget : public ReplayTarget
+	{
+		static constexpr size_type INLINE_BYTES = 64 * 1024;
+		using Alloc = DefaultInlineAllocator<INLINE_BYTES, unsigned char>;
+
+	public:
+		// the allocator is too big for the stack
+		InlineTarget() : m_alloc{ new Alloc } {}
+
+		void * allocate(size_type bytes) override
+		{
+			auto * mem = m_alloc->allocate(bytes);
+			if (!m_alloc->get_primary().owns(mem))
+				m_non_inline_bytes += bytes;
+			return mem;
+		}
+		void deallocate(void * mem, size_type bytes) override
+		{
+			auto * raw = reinterpret_cast<unsigned char *>(mem);
+			if (!m_alloc->get_primary().owns(raw))
+				m_non_inline_bytes -= bytes;
+			m_alloc->deallocate(raw, bytes);
+		}
+		size_type footprint() const override { return Alloc::primary::total_size + m_non_inline_bytes; }
+
+	private:
+		std::unique_ptr<Alloc> m_alloc;
+		size_type m_non_inline_bytes{ 0u };
+	};
+
+	class SizeClassTarget : public ReplayTarget
+	{
+	public:
+		void * allocate(size_type bytes) override
+		{
+			if (SizeClassAllocator::class_index(bytes) == SizeClassAllocator::CLASS_NUM)
+				m_large_bytes += bytes;
+			return m_alloc.allocate(bytes);
+		}
+		void deallocate(void * mem, size_type bytes) override
+		{
+			if (SizeClassAllocator::class_index(bytes) == SizeClassAllocator::CLASS_NUM)
+				m_large_bytes -= bytes;
+			m_alloc.deallocate(mem, bytes);
+		}
+		size_type footprint() const override { return m_alloc.page_bytes() + m_large_bytes; }
+
+	private:
+		SizeClassAllocator m_alloc;
+		size_type m_large_bytes{ 0u };
+	};
+
+	class PageMapTarget : public ReplayTarget
+	{
+	public:
+		void * allocate(size_type bytes) override { return m_alloc.allocate(bytes); }
+		/// \brief	Frees without the size, as the programs that use free do.
+		void deallocate(void * mem, size_type) override { m_alloc.deallocate(mem); }
+		size_type footprint() const override { return m_alloc.allocated_spans() * PageMapAllocator::SPAN_SIZE; }
+
+	private:
+		PageMapAllocator m_alloc;
+	};
+
+	class BuddyTarget : public ReplayTarget
+	{
+	public:
+		/// \brief	The rounding to powers of two may double the live bytes, and only the biggest power of two
+		///			that fits in the bytes is managed, so the arena is four times the peak of live bytes.
+		explicit BuddyTarget(size_type peak_live_bytes) : m_alloc{ 4 * (peak_live_bytes ? peak_live_bytes : 1) + 64, 16 } {}
+
+		void * allocate(size_type bytes) override { return m_alloc.allocate(bytes); }
+		void deallocate(void * mem, size_type bytes) override
+		{
+			m_alloc.deallocate(reinterpret_cast<unsigned char *>(mem), bytes);
+		}
+		size_type footprint() const override
+		{
+			return m_alloc.block_size(m_alloc.get_max_order()) - m_alloc.free_size();
+		}
+
+	private:
+		BuddyAllocator m_alloc;
+	};
+
+	class TlsfTarget : public ReplayTarget
+	{
+	public:
+		/// \brief	Room for the headers of the blocks and the holes on top of the peak of live bytes.
+		explicit TlsfTarget(size_type peak_live_bytes) : m_alloc{ 2 * peak_live_bytes + 1024 } {}
+
+		void * allocate(size_type bytes) override { return m_alloc.allocate(bytes); }
+		void deallocate(void * mem, size_type bytes) override
+		{
+			m_alloc.deallocate(reinterpret_cast<unsigned char *>(mem), bytes);
+		}
+		size_type footprint() const override { return m_alloc.get_capacity() - m_alloc.free_size(); }
+
+	private:
+		TlsfAllocator m_alloc;
+	};
+
+	struct TraceSummary
+	{
+		size_type max_size{ 0u };
+		/// \brief	Most bytes allocated at once.
+		size_type peak_live_bytes{ 0u };
+		/// \brief	Most bytes the StackTarget holds at once, its delayed deallocations keep more bytes than the live ones.
+		size_type peak_stack_bytes{ 0u };
+	};
+
+	/// \brief	Sizes of the trace, to size the arenas of the targets that have a fixed capacity.
+	TraceSummary summarize(const std::vector<TraceEvent> & events)
+	{
+		struct StackAllocation
+		{
+			std::uint64_t address;
+			size_type bytes;
+			bool freed;
+		};
+		std::unordered_map<std::uint64_t, size_type> live;
+		std::vector<StackAllocation> stack;
+
+		TraceSummary summary;
+		size_type live_bytes = 0;
+		size_type stack_bytes = 0;
+		for (const auto & event : events)
+		{
+			const auto size = static_cast<size_type>(event.size);
+			if (event.type == TraceEventType::ALLOCATE)
+			{
+				live[event.address] = size;
+				live_bytes += size;
+				stack.push_back(StackAllocation{ event.address, size, false });
+				stack_bytes += size;
+
+				if (summary.max_size < size)					summary.max_size = size;
+				if (summary.peak_live_bytes < live_bytes)		summary.peak_live_bytes = live_bytes;
+				if (summary.peak_stack_bytes < stack_bytes)		summary.peak_stack_bytes = stack_bytes;
+				continue;
+			}
+
+			auto it = live.find(event.address);
+			if (it == live.end())
+				continue;
+			live_bytes -= it->second;
+			live.erase(it);
+
+			// same delayed deallocations as the StackTarget
+			for (auto st = stack.rbegin(); st != stack.rend(); ++st)
+			{
+				if (st->address == event.address && !st->freed)
+				{
+					st->freed = true;
+					break;
+				}
+			}
+			while (!stack.empty() && stack.back().freed)
+			{
+				stack_bytes -= stack.back().bytes;
+				stack.pop_back();
+			}
+		}
+		return summary;
+	}
+
+	std::unique_ptr<ReplayTarget> create_target(const std::string & name, const TraceSummary & summary)
+	{
+		if (name == "malloc")		return std::unique_ptr<ReplayTarget>{ new MallocTarget };
+		if (name == "page")			return std::unique_ptr<ReplayTarget>{ new PageTarget{ summary.max_size } };
+		if (name == "stack")		return std::unique_ptr<ReplayTarget>{ new StackTarget{ summary.peak_stack_bytes } };
+		if (name == "inline")		return std::unique_ptr<ReplayTarget>{ new InlineTarget };
+		if (name == "size_class")	return std::unique_ptr<ReplayTarget>{ new SizeClassTarget };
+		if (name == "page_map")		return std::unique_ptr<ReplayTarget>{ new PageMapTarget };
+		if (name == "buddy")		return std::unique_ptr<ReplayTarget>{ new BuddyTarget{ summary.peak_live_bytes } };
+		if (name == "tlsf")			return std::unique_ptr<ReplayTarget>{ new TlsfTarget{ summary.peak_live_bytes } };
+		return nullptr;
+	}
+
+	constexpr size_type RSS_SAMPLE_EVENTS = 4096;
+
+	struct ReplayResult
+	{
+		double seconds{ 0.0 };
+		size_type operations{ 0u };
+		size_type failures{ 0u };
+		size_type peak_live_bytes{ 0u };
+		size_type peak_footprint{ 0u };
+		size_type peak_rss_growth{ 0u };
+	};
+
+	/// \brief	Replays the events on a new target of the given name.
+	///			When track_footprint is set the footprint is queried after every event and the resident set
+	///			size every RSS_SAMPLE_EVENTS events, which makes the replay slower, so it is done on a different
+	///			run than the timed one. The resident set size is the current one and not the high water mark
+	///			of the process, so each target is measured from its own starting point.
+	ReplayResult replay(const std::string & name, const TraceSummary & summary, const std::vector<TraceEvent> & events, bool track_footprint)
+	{
+		struct LiveAllocation
+		{
+			void * mem;
+			size_type bytes;
+		};
+		std::unordered_map<std::uint64_t, LiveAllocation> live;
+		live.reserve(events.size() / 2);
+
+		ReplayResult result;
+		size_type live_bytes = 0;
+#if defined(__GLIBC__)
+		// give the free memory of the C runtime back to the system, or the target would reuse it without growing
+		malloc_trim(0);
+#endif
+		const auto rss_before = tools::current_rss_bytes();
+		auto peak_rss = rss_before;
+		// created after the baseline, the arenas of the targets are part of their growth
+		auto target_ptr = create_target(name, summary);
+		auto & target = *target_ptr;
+		const auto sample_rss = [&]()
+		{
+			const auto rss = tools::current_rss_bytes();
+			if (peak_rss < rss)	peak_rss = rss;
+		};
+		const auto start = std::chrono::steady_clock::now();
+
+		for (const auto & event : events)
+		{
+			if (event.type == TraceEventType::ALLOCATE)
+			{
+				auto * mem = target.allocate(static_cast<size_type>(event.size));
+				if (mem == nullptr)
+				{
+					result.failures++;
+					continue;
+				}
+
+				live[event.address] = LiveAllocation{ mem, static_cast<size_type>(event.size) };
+				live_bytes += static_cast<size_type>(event.size);
+			}
+			else
+			{
+				// the allocation may have happened before the trace started or failed during the replay
+				auto it = live.find(event.address);
+				if (it == live.end())
+					continue;
+
+				target.deallocate(it->second.mem, it->second.bytes);
+				live_bytes -= it->second.bytes;
+				live.erase(it);
+			}
+
+			result.operations++;
+			if (track_footprint)
+			{
+				const auto footprint = target.footprint();
+				if (result.peak_footprint < footprint)	result.peak_footprint = footprint;
+				if (result.peak_live_bytes < live_bytes)	result.peak_live_bytes = live_bytes;
+				if (result.operations % RSS_SAMPLE_EVENTS == 0)
+					sample_rss();
+			}
+		}
+
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (track_footprint)
+		{
+			sample_rss();
+			result.peak_rss_growth = peak_rss - rss_before;
+		}
+
+		// leave the target in a clean state
+		for (const auto & allocation : live)
+			target.deallocate(allocation.second.mem, allocation.second.bytes);
+
+		return result;
+	}
+
+	/// \brief	Runs f in a child process where there is one, so the memory a target leaves to the C runtime
+	///			is not reused (and not measured) by the next one.
+	template <typename F>
+	void run_in_own_process(F && f)
+	{
+#if defined(__linux__) || defined(__APPLE__)
+		std::cout.flush();
+		const auto pid = fork();
+		if (pid == 0)
+		{
+			f();
+			std::cout.flush();
+			_exit(0);
+		}
+		if (pid > 0)
+		{
+			int status = 0;
+			waitpid(pid, &status, 0);
+			return;
+		}
+#endif
+		f();
+	}
+
+	void report(const std::string & name, const ReplayResult & timed, const ReplayResult & measured)
+	{
+		const double fragmentation = measured.peak_footprint == 0 ? 0.0 :
+			1.0 - static_cast<double>(measured.peak_live_bytes) / measured.peak_footprint;
+
+		std::cout << name << '\n'
+			<< "    Operations: " << timed.operations
+			<< ", Failures: " << timed.failures
+			<< ", Time: " << timed.seconds * 1000.0 << " ms"
+			<< ", Throughput: " << (timed.seconds > 0.0 ? timed.operations / timed.seconds : 0.0) << " ops/s\n"
+			<< "    Peak RSS growth: " << measured.peak_rss_growth << " bytes"
+			<< ", Peak live: " << measured.peak_live_bytes << " bytes"
+			<< ", Peak footprint: " << measured.peak_footprint << " bytes"
+			<< ", Fragmentation: " << fragmentation * 100.0 << "%\n";
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <trace file> [malloc|page|stack|inline|size_class|page_map|buddy|tlsf|all]\n";
+		return 1;
+	}
+
+	std::ifstream file{ argv[1], std::ios::binary };
+	TraceReader reader{ file };
+	if (!reader.valid())
+	{
+		std::cerr << "Could not read a trace from " << argv[1] << '\n';
+		return 1;
+	}
+
+	std::vector<TraceEvent> events;
+	for (TraceEvent event; reader.next(event); )
+		events.push_back(event);
+	const auto summary = summarize(events);
+
+	const std::string requested = argc > 2 ? argv[2] : "all";
+	const char * all_targets[] = { "malloc", "page", "stack", "inline", "size_class", "page_map", "buddy", "tlsf" };
+
+	std::cout << "Replaying " << events.size() << " events from " << argv[1]
+		<< " (RSS before replay: " << tools::current_rss_bytes() << " bytes, peak live: " << summary.peak_live_bytes << " bytes)\n";
+
+	bool any_target = false;
+	for (const auto * name : all_targets)
+	{
+		if (requested != "all" && requested != name)
+			continue;
+
+		any_target = true;
+		run_in_own_process([&]()
+		{
+			// the measured run goes first, so the memory freed by the timed run doesn't hide the RSS growth
+			const auto measured = replay(name, summary, events, true);
+			const auto timed = replay(name, summary, events, false);
+			report(name, timed, measured);
+		});
+	}
+
+	if (!any_target)
+	{
+		std::cerr << "Unknown allocator " << requested << '\n';
+		return 1;
+	}
+
+	return 0;
+}